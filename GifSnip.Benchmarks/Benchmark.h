@@ -0,0 +1,57 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <string>
+
+class BenchmarkRunner
+{
+public:
+    BenchmarkRunner(std::string const& filter)
+    {
+        m_filter = filter;
+        printf("%-48s %12s %12s %10s\n", "Benchmark", "MB/s", "ns/pixel", "Iterations");
+    }
+
+    // Runs the function until enough time has passed to get a stable
+    // average. Throughput is computed from the bytes and pixels that a
+    // single iteration processes.
+    void Run(std::string const& name, uint64_t bytesPerIteration, uint64_t pixelsPerIteration, std::function<void()> const& function)
+    {
+        if (!m_filter.empty() && name.find(m_filter) == std::string::npos)
+        {
+            return;
+        }
+
+        // Warm up caches and any lazily built state
+        function();
+
+        uint64_t iterations = 0;
+        auto start = std::chrono::steady_clock::now();
+        auto elapsed = std::chrono::steady_clock::duration::zero();
+        while (iterations < MinIterations || elapsed < MinDuration)
+        {
+            function();
+            iterations++;
+            elapsed = std::chrono::steady_clock::now() - start;
+        }
+
+        auto seconds = std::chrono::duration<double>(elapsed).count() / static_cast<double>(iterations);
+        auto megabytesPerSecond = (static_cast<double>(bytesPerIteration) / (1024.0 * 1024.0)) / seconds;
+        auto nanosecondsPerPixel = pixelsPerIteration > 0 ? (seconds * 1e9) / static_cast<double>(pixelsPerIteration) : 0.0;
+        printf("%-48s %12.2f %12.3f %10llu\n", name.c_str(), megabytesPerSecond, nanosecondsPerPixel, static_cast<unsigned long long>(iterations));
+    }
+
+private:
+    static constexpr uint64_t MinIterations = 3;
+    static constexpr std::chrono::milliseconds MinDuration = std::chrono::milliseconds(500);
+
+    std::string m_filter;
+};
+
+void RunDiffBenchmarks(BenchmarkRunner& runner);
+void RunReadbackBenchmarks(BenchmarkRunner& runner);
+void RunColorBenchmarks(BenchmarkRunner& runner);
+void RunLzwBenchmarks(BenchmarkRunner& runner);
+void RunContainerBenchmarks(BenchmarkRunner& runner);
@@ -0,0 +1,176 @@
+#include "Benchmark.h"
+#include "ScreenContent.h"
+#include "ColorQuantizer.h"
+#include "PaletteMapper.h"
+#include "Ditherer.h"
+#include "CpuTextureDiffer.h"
+#include "UniqueColorSet.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+namespace
+{
+    // Dithers a frame and the same frame with a block of it changed, and
+    // diffs the two results. Returns the size of the changed rect, which
+    // for a temporally stable mode is no bigger than the block.
+    std::pair<uint32_t, uint32_t> MeasureDitheredEdit(ScreenFrame const& frame, PaletteMapper& mapper, Ditherer& ditherer, DiffRect const& edit)
+    {
+        auto width = frame.Width;
+        auto height = frame.Height;
+        auto edited = frame;
+        for (auto y = edit.Top; y < edit.Bottom; y++)
+        {
+            auto row = edited.Bytes.data() + (static_cast<size_t>(y) * edited.Stride);
+            for (auto x = edit.Left * 4; x < edit.Right * 4; x++)
+            {
+                row[x] = static_cast<uint8_t>(row[x] ^ 0x5A);
+            }
+        }
+
+        // Back to pixels the way a viewer would show them
+        auto render = [&](ScreenFrame const& source)
+        {
+            std::vector<uint8_t> indices(static_cast<size_t>(width) * height);
+            ditherer.MapPixels(mapper, source.Bytes.data(), source.Stride, width, height, 0, 0, indices.data());
+            std::vector<uint8_t> pixels(indices.size() * 4);
+            auto&& palette = mapper.Palette();
+            for (size_t i = 0; i < indices.size(); i++)
+            {
+                auto&& color = palette[indices[i]];
+                uint8_t const pixel[4] = { color.B, color.G, color.R, 0xFF };
+                memcpy(pixels.data() + (i * 4), pixel, sizeof(pixel));
+            }
+            return pixels;
+        };
+        auto before = render(frame);
+        auto after = render(edited);
+        auto stride = static_cast<size_t>(width) * 4;
+        auto diff = CpuTextureDiffer::DiffBuffers(after.data(), stride, before.data(), stride, width, height);
+        if (!diff.has_value())
+        {
+            return { 0, 0 };
+        }
+        auto&& rect = diff.value();
+        return { rect.Right - rect.Left + 1, rect.Bottom - rect.Top + 1 };
+    }
+}
+
+void RunColorBenchmarks(BenchmarkRunner& runner)
+{
+    const uint32_t width = 1920;
+    const uint32_t height = 1080;
+    const ScreenContentType contentTypes[] = { ScreenContentType::UserInterface, ScreenContentType::Text, ScreenContentType::Video };
+    const std::pair<QuantizerAlgorithm, char const*> algorithms[] = { { QuantizerAlgorithm::Octree, "Octree" }, { QuantizerAlgorithm::MedianCut, "MedianCut" }, { QuantizerAlgorithm::KMeans, "KMeans" } };
+    ThreadPool threadPool;
+
+    for (auto&& contentType : contentTypes)
+    {
+        auto frame = GenerateScreenContent(contentType, width, height);
+        auto frameBytes = frame.Bytes.size();
+        auto pixelCount = static_cast<uint64_t>(width) * height;
+        auto contentName = std::string(ScreenContentName(contentType));
+
+        // Color counting
+        ColorHistogram histogram;
+        runner.Run("Count/Histogram/" + contentName, frameBytes, pixelCount, [&]()
+            {
+                histogram.Clear();
+                histogram.AddPixels(frame.Bytes.data(), frame.Stride, width, height);
+            });
+        runner.Run("Count/HistogramParallel/" + contentName, frameBytes, pixelCount, [&]()
+            {
+                histogram.Clear();
+                histogram.AddPixels(frame.Bytes.data(), frame.Stride, width, height, &threadPool);
+            });
+        UniqueColorSet colorSet;
+        bool exact = false;
+        runner.Run("Count/Unique/" + contentName, frameBytes, pixelCount, [&]()
+            {
+                colorSet.Clear();
+                exact = colorSet.AddPixels(frame.Bytes.data(), frame.Stride, width, height);
+            });
+        if (!exact)
+        {
+            // Gives up early, so the numbers above are for a partial pass
+            printf("    more than %u colors\n", UniqueColorSet::MaxColors);
+        }
+
+        // Quantization, starting from an already counted histogram since
+        // that's measured above
+        for (auto&& [algorithm, algorithmName] : algorithms)
+        {
+            QuantizerOptions options = {};
+            options.Algorithm = algorithm;
+            ColorQuantizer quantizer(options, &threadPool);
+            std::vector<GifColor> palette;
+            runner.Run("Quantize/" + std::string(algorithmName) + "/" + contentName, frameBytes, pixelCount, [&]()
+                {
+                    palette = quantizer.BuildPalette(histogram);
+                });
+        }
+
+        // Palette mapping, through the cached lookup and brute force
+        QuantizerOptions options = {};
+        ColorQuantizer quantizer(options, &threadPool);
+        auto palette = quantizer.BuildPalette(histogram);
+        std::vector<uint8_t> indices(pixelCount);
+        PaletteMapper mapper;
+        mapper.SetPalette(palette);
+        runner.Run("Map/Mapper/" + contentName, frameBytes, pixelCount, [&]()
+            {
+                mapper.MapPixels(frame.Bytes.data(), frame.Stride, width, height, indices.data());
+            });
+        runner.Run("Map/Nearest/" + contentName, frameBytes, pixelCount, [&]()
+            {
+                MapToPalette(palette, frame.Bytes.data(), frame.Stride, width, height, indices.data());
+            });
+
+        // Dithering while mapping, then Floyd–Steinberg in bands on the
+        // pool like the encoder does with large regions. Every mode is
+        // also checked for how far a small edit spreads once dithered.
+        const std::pair<DitherMode, char const*> ditherModes[] = { { DitherMode::None, "None" }, { DitherMode::Ordered, "Ordered" }, { DitherMode::FloydSteinberg, "FloydSteinberg" } };
+        const DiffRect edit = { 101, 77, 165, 109 };
+        for (auto&& [mode, modeName] : ditherModes)
+        {
+            Ditherer ditherer(mode, options.MaxColors);
+            runner.Run("Dither/" + std::string(modeName) + "/" + contentName, frameBytes, pixelCount, [&]()
+                {
+                    ditherer.MapPixels(mapper, frame.Bytes.data(), frame.Stride, width, height, 0, 0, indices.data());
+                });
+            auto [changedWidth, changedHeight] = MeasureDitheredEdit(frame, mapper, ditherer, edit);
+            printf("    a %ux%u edit changes %ux%u pixels\n", edit.Right - edit.Left, edit.Bottom - edit.Top, changedWidth, changedHeight);
+        }
+        struct DitherBand
+        {
+            PaletteMapper Mapper;
+            Ditherer Dither = Ditherer(DitherMode::FloydSteinberg);
+        };
+        auto bandCount = std::max(threadPool.ThreadCount(), 1u);
+        auto rowsPerBand = (height + bandCount - 1) / bandCount;
+        std::vector<DitherBand> bands(bandCount);
+        for (auto&& band : bands)
+        {
+            band.Mapper.SetPalette(palette);
+        }
+        runner.Run("Dither/FloydSteinbergBands/" + contentName, frameBytes, pixelCount, [&]()
+            {
+                threadPool.ParallelFor(bandCount, [&](size_t bandIndex)
+                    {
+                        auto firstRow = std::min(static_cast<uint32_t>(bandIndex) * rowsPerBand, height);
+                        auto lastRow = std::min(firstRow + rowsPerBand, height);
+                        auto&& band = bands[bandIndex];
+                        band.Dither.MapPixels(
+                            band.Mapper,
+                            frame.Bytes.data() + (static_cast<size_t>(firstRow) * frame.Stride),
+                            frame.Stride,
+                            width,
+                            lastRow - firstRow,
+                            0,
+                            firstRow,
+                            indices.data() + (static_cast<size_t>(firstRow) * width));
+                    });
+            });
+    }
+}
@@ -0,0 +1,49 @@
+#include "Benchmark.h"
+#include "ScreenContent.h"
+#include "GifWriter.h"
+#include <utility>
+
+void RunContainerBenchmarks(BenchmarkRunner& runner)
+{
+    const uint32_t width = 1920;
+    const uint32_t height = 1080;
+    const ScreenContentType contentTypes[] = { ScreenContentType::UserInterface, ScreenContentType::Text, ScreenContentType::Video };
+
+    // MapToIndices uses a 3-3-2 palette
+    std::vector<GifColor> palette(256);
+    for (uint32_t i = 0; i < palette.size(); i++)
+    {
+        palette[i] = GifColor{ static_cast<uint8_t>(i & 0xE0), static_cast<uint8_t>((i << 3) & 0xE0), static_cast<uint8_t>((i << 6) & 0xC0) };
+    }
+
+    GifFrameDescription description = {};
+    description.Width = static_cast<uint16_t>(width);
+    description.Height = static_cast<uint16_t>(height);
+    description.Delay = 3;
+
+    for (auto&& contentType : contentTypes)
+    {
+        auto indices = MapToIndices(GenerateScreenContent(contentType, width, height));
+        auto contentName = std::string(ScreenContentName(contentType));
+        GifWriter writer(static_cast<uint16_t>(width), static_cast<uint16_t>(height));
+        std::vector<uint8_t> output;
+
+        // Everything a frame costs once its indices are ready
+        runner.Run("Container/WriteFrame/" + contentName, indices.size(), indices.size(), [&]()
+            {
+                writer.WriteFrame(description, palette, indices.data());
+                writer.TakeOutput(output);
+            });
+
+        // Only what's left on the writing thread once frames have been
+        // compressed elsewhere
+        LzwEncoder lzwEncoder;
+        std::vector<uint8_t> encodedFrame;
+        writer.EncodeFrame(description, palette, indices.data(), lzwEncoder, encodedFrame);
+        runner.Run("Container/WriteEncoded/" + contentName, encodedFrame.size(), indices.size(), [&]()
+            {
+                writer.WriteEncodedFrame(encodedFrame.data(), encodedFrame.size());
+                writer.TakeOutput(output);
+            });
+    }
+}
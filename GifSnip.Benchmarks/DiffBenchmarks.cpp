@@ -0,0 +1,76 @@
+#include "Benchmark.h"
+#include "ScreenContent.h"
+#include "CpuTextureDiffer.h"
+#include "TileHash.h"
+#include "ThreadPool.h"
+#include <utility>
+
+void RunDiffBenchmarks(BenchmarkRunner& runner)
+{
+    const std::pair<uint32_t, uint32_t> frameSizes[] = { { 1280, 720 }, { 1920, 1080 }, { 3840, 2160 } };
+    const ScreenScenario scenarios[] = { ScreenScenario::StaticDesktop, ScreenScenario::BlinkingCaret, ScreenScenario::ScrollingText, ScreenScenario::VideoRegion, ScreenScenario::Gradient, ScreenScenario::NoisyDesktop };
+    ThreadPool threadPool;
+    const std::pair<ThreadPool*, char const*> backends[] = { { nullptr, "Cpu" }, { &threadPool, "CpuParallel" } };
+
+    for (auto&& [width, height] : frameSizes)
+    {
+        auto sizeName = std::to_string(width) + "x" + std::to_string(height);
+        for (auto&& scenario : scenarios)
+        {
+            auto previous = GenerateScenarioFrame(scenario, width, height, 0);
+            auto current = GenerateScenarioFrame(scenario, width, height, 1);
+            DirtyTileMap dirtyTiles(width, height);
+            auto frameBytes = current.Bytes.size();
+            auto pixelCount = static_cast<uint64_t>(width) * height;
+
+            for (auto&& [backend, backendName] : backends)
+            {
+                // Diffs the same pair of frames every time, so every
+                // iteration finds the same changes.
+                auto name = std::string("Diff/") + backendName + "/" + sizeName + "/" + ScreenScenarioName(scenario);
+                runner.Run(name, frameBytes, pixelCount, [&]()
+                    {
+                        CpuTextureDiffer::DiffBuffers(
+                            current.Bytes.data(), current.Stride,
+                            previous.Bytes.data(), previous.Stride,
+                            width, height, backend, &dirtyTiles);
+                    });
+
+                // Hashes alternate between the two frames, so every
+                // iteration after the first finds the same changes.
+                constexpr uint32_t hashTileSize = 32;
+                TileHashDiffer hashDiffer(width, height, backend, hashTileSize);
+                DirtyTileMap hashTiles(width, height, hashTileSize);
+                auto frameIndex = 0;
+                auto hashName = std::string("DiffTileHash/") + backendName + "/" + sizeName + "/" + ScreenScenarioName(scenario);
+                runner.Run(hashName, frameBytes, pixelCount, [&]()
+                    {
+                        auto&& frame = (frameIndex++ % 2) == 0 ? previous : current;
+                        hashDiffer.ProcessFrame(frame.Bytes.data(), frame.Stride, hashTiles);
+                    });
+
+                // Tolerant diffs only carry over what they report, so the
+                // frames alternate the same way
+                const std::pair<DiffTolerance, char const*> tolerances[] =
+                {
+                    { DiffTolerance{ ToleranceMode::Channel, 4, 64 }, "Channel" },
+                    { DiffTolerance{ ToleranceMode::Luma, 4, 64 }, "Luma" },
+                };
+                for (auto&& [tolerance, toleranceName] : tolerances)
+                {
+                    CpuTextureDiffer tolerantDiffer(width, height, backend, DirtyTileMap::DefaultTileSize, ChangeDetection::Exact, tolerance);
+                    tolerantDiffer.ProcessFrame(previous.Bytes.data(), previous.Stride);
+                    auto tolerantFrameIndex = 1;
+                    auto tolerantName = std::string("Diff") + toleranceName + "/" + backendName + "/" + sizeName + "/" + ScreenScenarioName(scenario);
+                    runner.Run(tolerantName, frameBytes, pixelCount, [&]()
+                        {
+                            auto&& frame = (tolerantFrameIndex++ % 2) == 0 ? previous : current;
+                            tolerantDiffer.ProcessFrame(frame.Bytes.data(), frame.Stride);
+                        });
+                }
+            }
+            auto tileCount = static_cast<double>(dirtyTiles.ColumnCount()) * dirtyTiles.RowCount();
+            printf("    %.1f%% of tiles changed\n", (100.0 * static_cast<double>(dirtyTiles.DirtyCount())) / tileCount);
+        }
+    }
+}
@@ -0,0 +1,31 @@
+#include "Benchmark.h"
+#include "ScreenContent.h"
+#include "LzwEncoder.h"
+#include <utility>
+
+void RunLzwBenchmarks(BenchmarkRunner& runner)
+{
+    const uint32_t width = 1920;
+    const uint32_t height = 1080;
+    const ScreenContentType contentTypes[] = { ScreenContentType::UserInterface, ScreenContentType::Text, ScreenContentType::Video };
+    const std::pair<LzwResetPolicy, char const*> policies[] = { { LzwResetPolicy::WhenFull, "WhenFull" }, { LzwResetPolicy::Adaptive, "Adaptive" } };
+
+    for (auto&& contentType : contentTypes)
+    {
+        auto indices = MapToIndices(GenerateScreenContent(contentType, width, height));
+        for (auto&& [policy, policyName] : policies)
+        {
+            LzwEncoder encoder(policy);
+            std::vector<uint8_t> output;
+            output.reserve(indices.size());
+
+            auto name = std::string("Lzw/") + ScreenContentName(contentType) + "/" + policyName;
+            runner.Run(name, indices.size(), indices.size(), [&]()
+                {
+                    output.clear();
+                    encoder.Encode(8, indices.data(), indices.size(), output);
+                });
+            printf("    compressed to %.1f%%\n", (100.0 * static_cast<double>(output.size())) / static_cast<double>(indices.size()));
+        }
+    }
+}
@@ -0,0 +1,58 @@
+#include "Benchmark.h"
+#include "ScreenContent.h"
+#include "SoftwareFrameReadback.h"
+#include "FrameBufferPool.h"
+#include <cstring>
+#include <utility>
+
+void RunReadbackBenchmarks(BenchmarkRunner& runner)
+{
+    const std::pair<uint32_t, uint32_t> frameSizes[] = { { 1280, 720 }, { 1920, 1080 }, { 3840, 2160 } };
+
+    for (auto&& [width, height] : frameSizes)
+    {
+        auto sizeName = std::to_string(width) + "x" + std::to_string(height);
+        auto frame = GenerateScreenContent(ScreenContentType::UserInterface, width, height);
+        auto frameBytes = frame.Bytes.size();
+        auto pixelCount = static_cast<uint64_t>(width) * height;
+
+        // Copying whole frames through a ring of slots, the way the
+        // headless pipeline reads frames back
+        {
+            SoftwareFrameReadback readback(width, height, 3);
+            ReadbackRing<int> ring(readback, 2);
+            DirtyTileMap dirtyTiles(width, height);
+            dirtyTiles.MarkAll();
+            auto consume = [](ReadbackData const&, int&) {};
+            runner.Run("Readback/Fill/" + sizeName, frameBytes, pixelCount, [&]()
+                {
+                    auto slot = ring.BeginFrame(consume);
+                    readback.Fill(slot, frame.Bytes.data(), frame.Stride, DiffRect{ 0, 0, width - 1, height - 1 }, dirtyTiles);
+                    ring.EndFrame(0, consume);
+                });
+        }
+
+        // Cutting changed regions out of a mapped slot into pooled
+        // buffers. A quarter of the frame is a typical dirty region.
+        const std::pair<uint32_t, char const*> regionSizes[] = { { 1, "Full" }, { 2, "Quarter" } };
+        for (auto&& [divisor, regionName] : regionSizes)
+        {
+            FrameBufferPool pool;
+            auto regionWidth = width / divisor;
+            auto regionHeight = height / divisor;
+            auto left = (width - regionWidth) / 2;
+            auto top = (height - regionHeight) / 2;
+            auto regionPixels = static_cast<uint64_t>(regionWidth) * regionHeight;
+            runner.Run("Readback/Crop/" + sizeName + "/" + regionName, regionPixels * 4, regionPixels, [&]()
+                {
+                    auto buffer = pool.Acquire(regionWidth, regionHeight);
+                    auto&& view = buffer.View();
+                    auto rowBytes = static_cast<size_t>(regionWidth) * 4;
+                    for (uint32_t y = 0; y < regionHeight; y++)
+                    {
+                        memcpy(view.Row(y), frame.Bytes.data() + (static_cast<size_t>(top + y) * frame.Stride) + (static_cast<size_t>(left) * 4), rowBytes);
+                    }
+                });
+        }
+    }
+}
@@ -0,0 +1,315 @@
+#include "ScreenContent.h"
+#include <algorithm>
+
+namespace
+{
+    uint32_t Hash(uint32_t x, uint32_t y, uint32_t seed)
+    {
+        auto value = (x * 73856093u) ^ (y * 19349663u) ^ (seed * 83492791u);
+        value ^= value >> 13;
+        value *= 0x5bd1e995u;
+        value ^= value >> 15;
+        return value;
+    }
+
+    void SetPixel(ScreenFrame& frame, uint32_t x, uint32_t y, uint8_t r, uint8_t g, uint8_t b)
+    {
+        auto pixel = frame.Bytes.data() + (static_cast<size_t>(y) * frame.Stride) + (static_cast<size_t>(x) * 4);
+        pixel[0] = b;
+        pixel[1] = g;
+        pixel[2] = r;
+        pixel[3] = 255;
+    }
+
+    void FillRect(ScreenFrame& frame, uint32_t left, uint32_t top, uint32_t right, uint32_t bottom, uint8_t r, uint8_t g, uint8_t b)
+    {
+        for (auto y = top; y < bottom && y < frame.Height; y++)
+        {
+            for (auto x = left; x < right && x < frame.Width; x++)
+            {
+                SetPixel(frame, x, y, r, g, b);
+            }
+        }
+    }
+
+    void GenerateUserInterface(ScreenFrame& frame, uint32_t frameIndex)
+    {
+        FillRect(frame, 0, 0, frame.Width, frame.Height, 243, 243, 243);
+        // Title bar and side navigation
+        FillRect(frame, 0, 0, frame.Width, 32, 32, 32, 32);
+        FillRect(frame, 0, 32, 200, frame.Height, 230, 230, 236);
+        // Cards with a border and a few buttons
+        for (uint32_t top = 48; top + 120 < frame.Height; top += 140)
+        {
+            for (uint32_t left = 216; left + 240 < frame.Width; left += 256)
+            {
+                FillRect(frame, left, top, left + 240, top + 120, 200, 200, 200);
+                FillRect(frame, left + 1, top + 1, left + 239, top + 119, 255, 255, 255);
+                FillRect(frame, left + 16, top + 80, left + 96, top + 108, 0, 120, 215);
+                FillRect(frame, left + 16, top + 16, left + 48, top + 48, static_cast<uint8_t>(Hash(left, top, 1)), 96, 160);
+            }
+        }
+        // A blinking caret
+        if (frameIndex % 2 == 0)
+        {
+            FillRect(frame, 230, 60, 232, 76, 0, 0, 0);
+        }
+    }
+
+    void GenerateText(ScreenFrame& frame, uint32_t frameIndex)
+    {
+        FillRect(frame, 0, 0, frame.Width, frame.Height, 255, 255, 255);
+        const uint32_t cellWidth = 8;
+        const uint32_t lineHeight = 16;
+        for (uint32_t line = 0; (line + 1) * lineHeight <= frame.Height; line++)
+        {
+            auto lineLength = frame.Width / cellWidth - (Hash(line, 0, frameIndex) % 24);
+            for (uint32_t cell = 0; cell < lineLength; cell++)
+            {
+                auto glyph = Hash(cell, line + frameIndex, 7);
+                // Leave some spaces between words
+                if (glyph % 7 == 0)
+                {
+                    continue;
+                }
+                for (uint32_t y = 3; y < 13; y++)
+                {
+                    for (uint32_t x = 1; x < 7; x++)
+                    {
+                        auto bit = (glyph >> ((y * 3 + x) % 32)) & 1;
+                        if (bit)
+                        {
+                            // A few levels of anti-aliasing
+                            auto level = static_cast<uint8_t>(32 + ((glyph >> (x + y)) & 3) * 48);
+                            SetPixel(frame, cell * cellWidth + x, line * lineHeight + y, level, level, level);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    void GenerateVideo(ScreenFrame& frame, uint32_t frameIndex)
+    {
+        for (uint32_t y = 0; y < frame.Height; y++)
+        {
+            for (uint32_t x = 0; x < frame.Width; x++)
+            {
+                auto noise = static_cast<int32_t>(Hash(x, y, frameIndex) & 15) - 8;
+                auto r = static_cast<int32_t>(((x + frameIndex * 4) * 255) / (frame.Width + 1)) + noise;
+                auto g = static_cast<int32_t>(((y + frameIndex * 2) * 255) / (frame.Height + 1)) + noise;
+                auto b = static_cast<int32_t>(((x + y) * 255) / (frame.Width + frame.Height)) + noise;
+                SetPixel(frame, x, y,
+                    static_cast<uint8_t>(r < 0 ? 0 : (r > 255 ? 255 : r)),
+                    static_cast<uint8_t>(g < 0 ? 0 : (g > 255 ? 255 : g)),
+                    static_cast<uint8_t>(b < 0 ? 0 : (b > 255 ? 255 : b)));
+            }
+        }
+    }
+
+    void ScrollText(ScreenFrame& frame, uint32_t frameIndex)
+    {
+        // Render a page that's a little taller than the screen and show
+        // the part of it scrolled to.
+        const uint32_t pixelsPerFrame = 3;
+        auto offset = (frameIndex * pixelsPerFrame) % frame.Height;
+        ScreenFrame page = {};
+        page.Width = frame.Width;
+        page.Height = frame.Height * 2;
+        page.Stride = frame.Stride;
+        page.Bytes.resize(static_cast<size_t>(page.Stride) * page.Height);
+        GenerateText(page, 0);
+        for (uint32_t y = 0; y < frame.Height; y++)
+        {
+            std::copy_n(
+                page.Bytes.data() + (static_cast<size_t>(y + offset) * page.Stride),
+                frame.Stride,
+                frame.Bytes.data() + (static_cast<size_t>(y) * frame.Stride));
+        }
+    }
+
+    void GenerateVideoRegion(ScreenFrame& frame, uint32_t frameIndex)
+    {
+        // A static UI with a 16:9 player in the middle third
+        GenerateUserInterface(frame, 0);
+        auto videoWidth = std::max(frame.Width / 3, 1u);
+        auto videoHeight = std::max(std::min((videoWidth * 9) / 16, frame.Height), 1u);
+        ScreenFrame video = {};
+        video.Width = videoWidth;
+        video.Height = videoHeight;
+        video.Stride = videoWidth * 4;
+        video.Bytes.resize(static_cast<size_t>(video.Stride) * videoHeight);
+        GenerateVideo(video, frameIndex);
+
+        auto left = (frame.Width - videoWidth) / 2;
+        auto top = (frame.Height - videoHeight) / 2;
+        for (uint32_t y = 0; y < videoHeight; y++)
+        {
+            std::copy_n(
+                video.Bytes.data() + (static_cast<size_t>(y) * video.Stride),
+                video.Stride,
+                frame.Bytes.data() + (static_cast<size_t>(y + top) * frame.Stride) + (static_cast<size_t>(left) * 4));
+        }
+    }
+
+    void GenerateNoisyDesktop(ScreenFrame& frame, uint32_t frameIndex)
+    {
+        GenerateUserInterface(frame, 0);
+        // Compression noise: a few 8x8 blocks per frame drift by a
+        // couple of levels
+        for (uint32_t blockTop = 0; blockTop < frame.Height; blockTop += 8)
+        {
+            for (uint32_t blockLeft = 0; blockLeft < frame.Width; blockLeft += 8)
+            {
+                auto hash = Hash(blockLeft, blockTop, frameIndex);
+                if (hash % 16 != 0)
+                {
+                    continue;
+                }
+                auto delta = static_cast<int32_t>((hash >> 8) % 5) - 2;
+                for (auto y = blockTop; y < std::min(blockTop + 8, frame.Height); y++)
+                {
+                    for (auto x = blockLeft; x < std::min(blockLeft + 8, frame.Width); x++)
+                    {
+                        auto pixel = frame.Bytes.data() + (static_cast<size_t>(y) * frame.Stride) + (static_cast<size_t>(x) * 4);
+                        for (auto channel = 0; channel < 3; channel++)
+                        {
+                            pixel[channel] = static_cast<uint8_t>(std::clamp(pixel[channel] + delta, 0, 255));
+                        }
+                    }
+                }
+            }
+        }
+        // A 3x3 busy indicator in the title bar that pulses every frame
+        auto level = static_cast<uint8_t>(96 + ((frameIndex % 4) * 48));
+        auto left = frame.Width > 16 ? frame.Width - 16 : 0u;
+        FillRect(frame, left, 14, left + 3, 17, level, level, level);
+    }
+
+    void GenerateGradient(ScreenFrame& frame, uint32_t frameIndex)
+    {
+        // Without noise, so that it's smooth enough to band
+        for (uint32_t y = 0; y < frame.Height; y++)
+        {
+            for (uint32_t x = 0; x < frame.Width; x++)
+            {
+                SetPixel(frame, x, y,
+                    static_cast<uint8_t>((((x + frameIndex) % frame.Width) * 255) / frame.Width),
+                    static_cast<uint8_t>((y * 255) / frame.Height),
+                    static_cast<uint8_t>(255 - ((((x + y + frameIndex) % (frame.Width + frame.Height)) * 255) / (frame.Width + frame.Height))));
+            }
+        }
+    }
+}
+
+char const* ScreenContentName(ScreenContentType type)
+{
+    switch (type)
+    {
+    case ScreenContentType::UserInterface:
+        return "UI";
+    case ScreenContentType::Text:
+        return "Text";
+    case ScreenContentType::Video:
+        return "Video";
+    default:
+        return "Unknown";
+    }
+}
+
+ScreenFrame GenerateScreenContent(ScreenContentType type, uint32_t width, uint32_t height, uint32_t frameIndex)
+{
+    ScreenFrame frame = {};
+    frame.Width = width;
+    frame.Height = height;
+    frame.Stride = width * 4;
+    frame.Bytes.resize(static_cast<size_t>(frame.Stride) * height);
+
+    switch (type)
+    {
+    case ScreenContentType::UserInterface:
+        GenerateUserInterface(frame, frameIndex);
+        break;
+    case ScreenContentType::Text:
+        GenerateText(frame, frameIndex);
+        break;
+    case ScreenContentType::Video:
+        GenerateVideo(frame, frameIndex);
+        break;
+    }
+    return frame;
+}
+
+std::vector<uint8_t> MapToIndices(ScreenFrame const& frame)
+{
+    std::vector<uint8_t> indices(static_cast<size_t>(frame.Width) * frame.Height);
+    for (uint32_t y = 0; y < frame.Height; y++)
+    {
+        auto row = frame.Bytes.data() + (static_cast<size_t>(y) * frame.Stride);
+        for (uint32_t x = 0; x < frame.Width; x++)
+        {
+            auto pixel = row + (static_cast<size_t>(x) * 4);
+            indices[(static_cast<size_t>(y) * frame.Width) + x] =
+                static_cast<uint8_t>((pixel[2] & 0xE0) | ((pixel[1] >> 3) & 0x1C) | (pixel[0] >> 6));
+        }
+    }
+    return indices;
+}
+
+char const* ScreenScenarioName(ScreenScenario scenario)
+{
+    switch (scenario)
+    {
+    case ScreenScenario::StaticDesktop:
+        return "Static";
+    case ScreenScenario::BlinkingCaret:
+        return "Caret";
+    case ScreenScenario::ScrollingText:
+        return "Scroll";
+    case ScreenScenario::VideoRegion:
+        return "VideoRegion";
+    case ScreenScenario::Gradient:
+        return "Gradient";
+    case ScreenScenario::NoisyDesktop:
+        return "NoisyDesktop";
+    default:
+        return "Unknown";
+    }
+}
+
+ScreenFrame GenerateScenarioFrame(ScreenScenario scenario, uint32_t width, uint32_t height, uint32_t frameIndex)
+{
+    switch (scenario)
+    {
+    case ScreenScenario::StaticDesktop:
+        return GenerateScreenContent(ScreenContentType::UserInterface, width, height, 0);
+    case ScreenScenario::BlinkingCaret:
+        return GenerateScreenContent(ScreenContentType::UserInterface, width, height, frameIndex);
+    default:
+        break;
+    }
+
+    ScreenFrame frame = {};
+    frame.Width = width;
+    frame.Height = height;
+    frame.Stride = width * 4;
+    frame.Bytes.resize(static_cast<size_t>(frame.Stride) * height);
+    switch (scenario)
+    {
+    case ScreenScenario::ScrollingText:
+        ScrollText(frame, frameIndex);
+        break;
+    case ScreenScenario::VideoRegion:
+        GenerateVideoRegion(frame, frameIndex);
+        break;
+    case ScreenScenario::Gradient:
+        GenerateGradient(frame, frameIndex);
+        break;
+    case ScreenScenario::NoisyDesktop:
+        GenerateNoisyDesktop(frame, frameIndex);
+        break;
+    default:
+        break;
+    }
+    return frame;
+}
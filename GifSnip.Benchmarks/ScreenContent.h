@@ -0,0 +1,53 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+enum class ScreenContentType
+{
+    // Flat panels, borders and a handful of icons
+    UserInterface,
+    // Dark anti-aliased glyphs on a light background
+    Text,
+    // Smooth moving gradients with per-pixel noise
+    Video,
+};
+
+// Sequences of frames that look like what a recording usually sees.
+// Each one changes a different share of the screen from one frame to
+// the next.
+enum class ScreenScenario
+{
+    // Nothing moves at all
+    StaticDesktop,
+    // A UI where only a caret blinks
+    BlinkingCaret,
+    // A page of text scrolling a few pixels at a time
+    ScrollingText,
+    // A UI with a video playing in part of it
+    VideoRegion,
+    // A gradient covering the whole screen that shifts every frame
+    Gradient,
+    // A UI that's only disturbed by faint blocky noise, like a streamed
+    // desktop, and a tiny busy indicator
+    NoisyDesktop,
+};
+
+// A tightly packed BGRA8 frame
+struct ScreenFrame
+{
+    uint32_t Width = 0;
+    uint32_t Height = 0;
+    uint32_t Stride = 0;
+    std::vector<uint8_t> Bytes;
+};
+
+char const* ScreenContentName(ScreenContentType type);
+ScreenFrame GenerateScreenContent(ScreenContentType type, uint32_t width, uint32_t height, uint32_t frameIndex = 0);
+
+char const* ScreenScenarioName(ScreenScenario scenario);
+ScreenFrame GenerateScenarioFrame(ScreenScenario scenario, uint32_t width, uint32_t height, uint32_t frameIndex);
+
+// Maps BGRA pixels onto a fixed 3-3-2 palette. Good enough to feed
+// the stages that operate on palette indices.
+std::vector<uint8_t> MapToIndices(ScreenFrame const& frame);
@@ -0,0 +1,17 @@
+#include "Benchmark.h"
+
+int main(int argc, char** argv)
+{
+    // An optional argument only runs benchmarks whose name contains it
+    std::string filter = argc > 1 ? argv[1] : "";
+    BenchmarkRunner runner(filter);
+
+    // In pipeline order
+    RunDiffBenchmarks(runner);
+    RunReadbackBenchmarks(runner);
+    RunColorBenchmarks(runner);
+    RunLzwBenchmarks(runner);
+    RunContainerBenchmarks(runner);
+
+    return 0;
+}
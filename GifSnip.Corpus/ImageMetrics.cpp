@@ -0,0 +1,97 @@
+#include "ImageMetrics.h"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    constexpr uint32_t SsimBlockSize = 8;
+    // The usual stabilizing constants for 8-bit values
+    constexpr double SsimC1 = (0.01 * 255.0) * (0.01 * 255.0);
+    constexpr double SsimC2 = (0.03 * 255.0) * (0.03 * 255.0);
+
+    double Luma(uint8_t const* pixel)
+    {
+        return (0.114 * pixel[0]) + (0.587 * pixel[1]) + (0.299 * pixel[2]);
+    }
+}
+
+ImageDifference CompareImages(
+    uint8_t const* first,
+    size_t firstStride,
+    uint8_t const* second,
+    size_t secondStride,
+    uint32_t width,
+    uint32_t height)
+{
+    ImageDifference result = {};
+    if (width == 0 || height == 0)
+    {
+        return result;
+    }
+
+    uint64_t squaredError = 0;
+    for (uint32_t y = 0; y < height; y++)
+    {
+        auto firstRow = first + (static_cast<size_t>(y) * firstStride);
+        auto secondRow = second + (static_cast<size_t>(y) * secondStride);
+        for (uint32_t x = 0; x < width * 4; x += 4)
+        {
+            for (uint32_t channel = 0; channel < 3; channel++)
+            {
+                auto delta = static_cast<int32_t>(firstRow[x + channel]) - static_cast<int32_t>(secondRow[x + channel]);
+                squaredError += static_cast<uint64_t>(delta * delta);
+            }
+        }
+    }
+    result.MeanSquaredError = static_cast<double>(squaredError) / (static_cast<double>(width) * height * 3.0);
+
+    // Blocks at the right and bottom edges may be smaller
+    double ssimSum = 0.0;
+    uint64_t blockCount = 0;
+    for (uint32_t top = 0; top < height; top += SsimBlockSize)
+    {
+        for (uint32_t left = 0; left < width; left += SsimBlockSize)
+        {
+            auto right = std::min(left + SsimBlockSize, width);
+            auto bottom = std::min(top + SsimBlockSize, height);
+            double sumFirst = 0.0;
+            double sumSecond = 0.0;
+            double sumFirstSquared = 0.0;
+            double sumSecondSquared = 0.0;
+            double sumProduct = 0.0;
+            for (auto y = top; y < bottom; y++)
+            {
+                for (auto x = left; x < right; x++)
+                {
+                    auto a = Luma(first + (static_cast<size_t>(y) * firstStride) + (static_cast<size_t>(x) * 4));
+                    auto b = Luma(second + (static_cast<size_t>(y) * secondStride) + (static_cast<size_t>(x) * 4));
+                    sumFirst += a;
+                    sumSecond += b;
+                    sumFirstSquared += a * a;
+                    sumSecondSquared += b * b;
+                    sumProduct += a * b;
+                }
+            }
+            auto count = static_cast<double>((right - left) * (bottom - top));
+            auto meanFirst = sumFirst / count;
+            auto meanSecond = sumSecond / count;
+            auto varianceFirst = (sumFirstSquared / count) - (meanFirst * meanFirst);
+            auto varianceSecond = (sumSecondSquared / count) - (meanSecond * meanSecond);
+            auto covariance = (sumProduct / count) - (meanFirst * meanSecond);
+            ssimSum += ((2.0 * meanFirst * meanSecond + SsimC1) * (2.0 * covariance + SsimC2)) /
+                (((meanFirst * meanFirst) + (meanSecond * meanSecond) + SsimC1) * (varianceFirst + varianceSecond + SsimC2));
+            blockCount++;
+        }
+    }
+    result.Ssim = ssimSum / static_cast<double>(blockCount);
+    return result;
+}
+
+double PsnrFromMeanSquaredError(double meanSquaredError)
+{
+    if (meanSquaredError <= 0.0)
+    {
+        return MaxPsnr;
+    }
+    return std::min(10.0 * std::log10((255.0 * 255.0) / meanSquaredError), MaxPsnr);
+}
@@ -0,0 +1,24 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+struct ImageDifference
+{
+    // Over the R, G and B channels of every pixel
+    double MeanSquaredError = 0.0;
+    // Mean SSIM of the luma of 8x8 blocks
+    double Ssim = 1.0;
+};
+
+// Compares two BGRA8 images of the same size. Alpha is ignored.
+ImageDifference CompareImages(
+    uint8_t const* first,
+    size_t firstStride,
+    uint8_t const* second,
+    size_t secondStride,
+    uint32_t width,
+    uint32_t height);
+
+// Identical images would be infinitely good, so PSNR is capped.
+constexpr double MaxPsnr = 100.0;
+double PsnrFromMeanSquaredError(double meanSquaredError);
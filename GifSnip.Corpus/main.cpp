@@ -0,0 +1,414 @@
+#include "ImageMetrics.h"
+#include "ScreenContent.h"
+#include "HeadlessGifEncoder.h"
+#include "RawFrameFile.h"
+#include "FileGifOutputStream.h"
+#include "GifDecoder.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace
+{
+    struct SequenceResult
+    {
+        std::string Name;
+        uint32_t Width = 0;
+        uint32_t Height = 0;
+        uint64_t FramesReceived = 0;
+        uint64_t FramesAccepted = 0;
+        uint64_t FramesEmitted = 0;
+        double EncodeSeconds = 0.0;
+        // The part of EncodeSeconds spent handing frames over, which is
+        // what capture would see
+        double CaptureSeconds = 0.0;
+        uint64_t OutputBytes = 0;
+        uint64_t PeakRssBytes = 0;
+        double Psnr = 0.0;
+        double MinPsnr = 0.0;
+        double Ssim = 0.0;
+        double MinSsim = 0.0;
+        GifEncoderStatistics Statistics = {};
+    };
+
+    // The peak for the whole process so far, so sequences that run
+    // later include whatever the earlier ones needed.
+    uint64_t PeakResidentBytes()
+    {
+#ifdef _WIN32
+        PROCESS_MEMORY_COUNTERS counters = {};
+        if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        {
+            return counters.PeakWorkingSetSize;
+        }
+        return 0;
+#else
+        rusage usage = {};
+        getrusage(RUSAGE_SELF, &usage);
+        // Kilobytes on Linux
+        return static_cast<uint64_t>(usage.ru_maxrss) * 1024;
+#endif
+    }
+
+    SequenceResult RunSequence(std::filesystem::path const& recordingPath, std::filesystem::path const& gifPath, GifEncoderOptions const& options)
+    {
+        SequenceResult result = {};
+        result.Name = recordingPath.stem().string();
+
+        // Encode, only timing the encoder and not reading the recording
+        {
+            RawFrameReader reader(recordingPath);
+            result.Width = reader.Width();
+            result.Height = reader.Height();
+            FileGifOutputStream output(gifPath);
+            auto elapsed = std::chrono::steady_clock::duration::zero();
+            auto start = std::chrono::steady_clock::now();
+            HeadlessGifEncoder encoder(output, DiffRect{ 0, 0, reader.Width(), reader.Height() }, options);
+            elapsed += std::chrono::steady_clock::now() - start;
+
+            SourceFrame frame = {};
+            auto captureElapsed = std::chrono::steady_clock::duration::zero();
+            while (reader.TryGetNextFrame(frame))
+            {
+                result.FramesReceived++;
+                start = std::chrono::steady_clock::now();
+                if (encoder.ProcessFrame(frame))
+                {
+                    result.FramesAccepted++;
+                }
+                captureElapsed += std::chrono::steady_clock::now() - start;
+            }
+            elapsed += captureElapsed;
+            result.CaptureSeconds = std::chrono::duration<double>(captureElapsed).count();
+            start = std::chrono::steady_clock::now();
+            encoder.Stop();
+            elapsed += std::chrono::steady_clock::now() - start;
+
+            result.EncodeSeconds = std::chrono::duration<double>(elapsed).count();
+            result.Statistics = encoder.Statistics();
+        }
+        result.PeakRssBytes = PeakResidentBytes();
+        result.OutputBytes = static_cast<uint64_t>(std::filesystem::file_size(gifPath));
+
+        // Play the GIF back alongside the recording and compare every
+        // received frame against what a viewer would show at its time.
+        // GIF delays are in 10ms units, so times are rounded to those
+        // before comparing.
+        RawFrameReader reader(recordingPath);
+        GifDecoder decoder(gifPath);
+        GifCanvas canvas(decoder.Width(), decoder.Height());
+        if (decoder.Width() != reader.Width() || decoder.Height() != reader.Height())
+        {
+            throw std::runtime_error("Decoded GIF isn't the size of the recording");
+        }
+
+        GifDecodedFrame decodedFrame;
+        if (!decoder.ReadFrame(decodedFrame))
+        {
+            throw std::runtime_error("GIF has no frames");
+        }
+        canvas.DrawFrame(decodedFrame);
+        result.FramesEmitted = 1;
+
+        using Centiseconds = std::chrono::duration<int64_t, std::centi>;
+        SourceFrame frame = {};
+        FrameTime firstTime = {};
+        int64_t frameEnd = decodedFrame.Description.Delay;
+        bool firstFrame = true;
+        bool decoderDone = false;
+        double totalSquaredError = 0.0;
+        double totalSsim = 0.0;
+        result.MinPsnr = MaxPsnr;
+        result.MinSsim = 1.0;
+        while (reader.TryGetNextFrame(frame))
+        {
+            if (firstFrame)
+            {
+                firstTime = frame.SystemRelativeTime;
+                firstFrame = false;
+            }
+            auto time = std::chrono::round<Centiseconds>(frame.SystemRelativeTime - firstTime).count();
+            while (!decoderDone && time >= frameEnd)
+            {
+                if (!decoder.ReadFrame(decodedFrame))
+                {
+                    decoderDone = true;
+                    break;
+                }
+                canvas.DrawFrame(decodedFrame);
+                result.FramesEmitted++;
+                frameEnd += decodedFrame.Description.Delay;
+            }
+
+            auto difference = CompareImages(
+                frame.Surface.Data, frame.Surface.Stride,
+                canvas.Pixels(), canvas.Stride(),
+                frame.Surface.Width, frame.Surface.Height);
+            totalSquaredError += difference.MeanSquaredError;
+            totalSsim += difference.Ssim;
+            result.MinPsnr = std::min(result.MinPsnr, PsnrFromMeanSquaredError(difference.MeanSquaredError));
+            result.MinSsim = std::min(result.MinSsim, difference.Ssim);
+        }
+        while (!decoderDone && decoder.ReadFrame(decodedFrame))
+        {
+            result.FramesEmitted++;
+        }
+
+        auto frameCount = static_cast<double>(std::max<uint64_t>(result.FramesReceived, 1));
+        result.Psnr = PsnrFromMeanSquaredError(totalSquaredError / frameCount);
+        result.Ssim = totalSsim / frameCount;
+        return result;
+    }
+
+    std::string EscapeJson(std::string const& value)
+    {
+        std::string escaped;
+        for (auto character : value)
+        {
+            if (character == '"' || character == '\\')
+            {
+                escaped.push_back('\\');
+                escaped.push_back(character);
+            }
+            else if (static_cast<unsigned char>(character) < 0x20)
+            {
+                char code[8] = {};
+                snprintf(code, sizeof(code), "\\u%04x", static_cast<unsigned>(character));
+                escaped += code;
+            }
+            else
+            {
+                escaped.push_back(character);
+            }
+        }
+        return escaped;
+    }
+
+    void WriteResults(std::vector<SequenceResult> const& results, FILE* file)
+    {
+        fprintf(file, "{\n  \"sequences\": [");
+        for (size_t i = 0; i < results.size(); i++)
+        {
+            auto&& result = results[i];
+            auto seconds = std::max(result.EncodeSeconds, 1e-9);
+            auto pixels = static_cast<double>(result.Width) * result.Height * static_cast<double>(result.FramesReceived);
+            fprintf(file, "%s\n    {\n", i == 0 ? "" : ",");
+            fprintf(file, "      \"name\": \"%s\",\n", EscapeJson(result.Name).c_str());
+            fprintf(file, "      \"width\": %u,\n", result.Width);
+            fprintf(file, "      \"height\": %u,\n", result.Height);
+            fprintf(file, "      \"framesReceived\": %llu,\n", static_cast<unsigned long long>(result.FramesReceived));
+            fprintf(file, "      \"framesAccepted\": %llu,\n", static_cast<unsigned long long>(result.FramesAccepted));
+            fprintf(file, "      \"framesEmitted\": %llu,\n", static_cast<unsigned long long>(result.FramesEmitted));
+            fprintf(file, "      \"idleThrottledFrames\": %llu,\n", static_cast<unsigned long long>(result.Statistics.IdleThrottledFrames));
+            fprintf(file, "      \"backlogThrottledFrames\": %llu,\n", static_cast<unsigned long long>(result.Statistics.BacklogThrottledFrames));
+            fprintf(file, "      \"encodeSeconds\": %.6f,\n", result.EncodeSeconds);
+            fprintf(file, "      \"captureSeconds\": %.6f,\n", result.CaptureSeconds);
+            fprintf(file, "      \"encodeFps\": %.3f,\n", static_cast<double>(result.FramesReceived) / seconds);
+            fprintf(file, "      \"megapixelsPerSecond\": %.3f,\n", pixels / seconds / 1e6);
+            fprintf(file, "      \"outputBytes\": %llu,\n", static_cast<unsigned long long>(result.OutputBytes));
+            fprintf(file, "      \"bytesPerEmittedFrame\": %.1f,\n",
+                static_cast<double>(result.OutputBytes) / static_cast<double>(std::max<uint64_t>(result.FramesEmitted, 1)));
+            fprintf(file, "      \"peakRssBytes\": %llu,\n", static_cast<unsigned long long>(result.PeakRssBytes));
+            fprintf(file, "      \"psnr\": %.3f,\n", result.Psnr);
+            fprintf(file, "      \"minPsnr\": %.3f,\n", result.MinPsnr);
+            fprintf(file, "      \"ssim\": %.5f,\n", result.Ssim);
+            fprintf(file, "      \"minSsim\": %.5f,\n", result.MinSsim);
+            fprintf(file, "      \"invisibleFrames\": %llu,\n", static_cast<unsigned long long>(result.Statistics.InvisibleFrames));
+            fprintf(file, "      \"shrunkRegions\": %llu,\n", static_cast<unsigned long long>(result.Statistics.ShrunkRegions));
+            fprintf(file, "      \"spoolBytes\": %llu,\n", static_cast<unsigned long long>(result.Statistics.SpoolBytes));
+            fprintf(file, "      \"recordingPaletteBytes\": %llu,\n", static_cast<unsigned long long>(result.Statistics.RecordingPaletteBytes));
+            fprintf(file, "      \"localPaletteBytes\": %llu,\n", static_cast<unsigned long long>(result.Statistics.LocalPaletteBytes));
+            fprintf(file, "      \"globalPaletteRegions\": %llu,\n", static_cast<unsigned long long>(result.Statistics.GlobalPaletteRegions));
+            fprintf(file, "      \"regionsEncoded\": %llu,\n", static_cast<unsigned long long>(result.Statistics.RegionsEncoded));
+            fprintf(file, "      \"quantizedRegions\": %llu\n", static_cast<unsigned long long>(result.Statistics.QuantizedRegions));
+            fprintf(file, "    }");
+        }
+        fprintf(file, "\n  ]\n}\n");
+    }
+
+    // Writes a few seconds of every synthetic scenario, at 30fps
+    void GenerateCorpus(std::filesystem::path const& directory)
+    {
+        const uint32_t width = 1280;
+        const uint32_t height = 720;
+        const uint32_t frameCount = 90;
+        const ScreenScenario scenarios[] = { ScreenScenario::StaticDesktop, ScreenScenario::BlinkingCaret, ScreenScenario::ScrollingText, ScreenScenario::VideoRegion, ScreenScenario::Gradient, ScreenScenario::NoisyDesktop };
+
+        std::filesystem::create_directories(directory);
+        for (auto&& scenario : scenarios)
+        {
+            auto path = directory / (std::string(ScreenScenarioName(scenario)) + ".raw");
+            RawFrameWriter writer(path, width, height);
+            for (uint32_t i = 0; i < frameCount; i++)
+            {
+                auto screenFrame = GenerateScenarioFrame(scenario, width, height, i);
+                SourceFrame frame = {};
+                frame.Surface.Data = screenFrame.Bytes.data();
+                frame.Surface.Width = width;
+                frame.Surface.Height = height;
+                frame.Surface.Stride = screenFrame.Stride;
+                // Capture time stamps never start at zero
+                frame.SystemRelativeTime = std::chrono::seconds(1) + ((std::chrono::duration_cast<FrameTime>(std::chrono::seconds(1)) * i) / 30);
+                writer.WriteFrame(frame);
+            }
+            writer.Close();
+            printf("Wrote %s\n", path.string().c_str());
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    // GifSnip.Corpus.exe --generate corpus
+    // GifSnip.Corpus.exe [options] corpus [results.json]
+    //   --tile-hash                         find changes by tile hash
+    //   --tolerance <channel|luma> <steps>  ignore changes this small
+    //   --min-dirty-pixels <count>          ignore changes this sparse
+    //   --max-regions <count>               image blocks per frame
+    //   --drop-invisible                    check changes after mapping
+    //   --dither <none|ordered|fs>          dither quantized regions
+    //   --two-pass                          spool frames, encode at the end
+    //   --recording-palette                 two-pass, try one palette for it all
+    std::vector<std::string> args(argv + 1, argv + argc);
+    if (args.empty())
+    {
+        fprintf(stderr, "Usage: %s --generate <directory>\n       %s [options] <directory> [results.json]\n", argv[0], argv[0]);
+        return 1;
+    }
+
+    try
+    {
+        GifEncoderOptions options = {};
+        while (!args.empty() && args[0] != "--generate" && args[0].rfind("--", 0) == 0)
+        {
+            if (args[0] == "--tile-hash")
+            {
+                options.Detection = ChangeDetection::TileHash;
+                options.TileSize = 32;
+                args.erase(args.begin());
+            }
+            else if (args[0] == "--tolerance" && args.size() >= 3)
+            {
+                if (args[1] != "channel" && args[1] != "luma")
+                {
+                    throw std::invalid_argument("Tolerance must be channel or luma");
+                }
+                options.Tolerance.Mode = args[1] == "luma" ? ToleranceMode::Luma : ToleranceMode::Channel;
+                options.Tolerance.Threshold = static_cast<uint32_t>(std::stoul(args[2]));
+                args.erase(args.begin(), args.begin() + 3);
+            }
+            else if (args[0] == "--drop-invisible")
+            {
+                options.DropInvisibleChanges = true;
+                args.erase(args.begin());
+            }
+            else if (args[0] == "--dither" && args.size() >= 2)
+            {
+                if (args[1] == "none")
+                {
+                    options.Dither = DitherMode::None;
+                }
+                else if (args[1] == "ordered")
+                {
+                    options.Dither = DitherMode::Ordered;
+                }
+                else if (args[1] == "fs")
+                {
+                    options.Dither = DitherMode::FloydSteinberg;
+                }
+                else
+                {
+                    throw std::invalid_argument("Dithering must be none, ordered or fs");
+                }
+                args.erase(args.begin(), args.begin() + 2);
+            }
+            else if (args[0] == "--two-pass" || args[0] == "--recording-palette")
+            {
+                options.SpoolFile = std::filesystem::temp_directory_path() / "GifSnip.Corpus.spool";
+                options.UseRecordingPalette = options.UseRecordingPalette || args[0] == "--recording-palette";
+                args.erase(args.begin());
+            }
+            else if (args[0] == "--min-dirty-pixels" && args.size() >= 2)
+            {
+                options.Tolerance.MinDirtyPixels = static_cast<uint32_t>(std::stoul(args[1]));
+                args.erase(args.begin(), args.begin() + 2);
+            }
+            else if (args[0] == "--max-regions" && args.size() >= 2)
+            {
+                options.MaxRegionsPerFrame = static_cast<uint32_t>(std::stoul(args[1]));
+                if (options.MaxRegionsPerFrame == 0)
+                {
+                    throw std::invalid_argument("Frames need at least one region");
+                }
+                args.erase(args.begin(), args.begin() + 2);
+            }
+            else
+            {
+                throw std::invalid_argument("Unknown option " + args[0]);
+            }
+        }
+        if (args.empty())
+        {
+            throw std::invalid_argument("No corpus directory given");
+        }
+
+        if (args[0] == "--generate" && args.size() == 2)
+        {
+            GenerateCorpus(args[1]);
+            return 0;
+        }
+
+        std::filesystem::path corpusDirectory = args[0];
+        std::vector<std::filesystem::path> recordings;
+        for (auto&& entry : std::filesystem::directory_iterator(corpusDirectory))
+        {
+            if (entry.is_regular_file() && entry.path().extension() == ".raw")
+            {
+                recordings.push_back(entry.path());
+            }
+        }
+        std::sort(recordings.begin(), recordings.end());
+
+        auto outputDirectory = std::filesystem::temp_directory_path() / "GifSnip.Corpus";
+        std::filesystem::create_directories(outputDirectory);
+        std::vector<SequenceResult> results;
+        for (auto&& recording : recordings)
+        {
+            fprintf(stderr, "%s\n", recording.filename().string().c_str());
+            results.push_back(RunSequence(recording, outputDirectory / (recording.stem().string() + ".gif"), options));
+        }
+
+        if (args.size() > 1)
+        {
+            auto file = fopen(args[1].c_str(), "w");
+            if (file == nullptr)
+            {
+                throw std::runtime_error("Couldn't open " + args[1]);
+            }
+            WriteResults(results, file);
+            fclose(file);
+        }
+        else
+        {
+            WriteResults(results, stdout);
+        }
+    }
+    catch (std::exception const& error)
+    {
+        fprintf(stderr, "%s\n", error.what());
+        return 1;
+    }
+    return 0;
+}
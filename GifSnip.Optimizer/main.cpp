@@ -0,0 +1,87 @@
+#include "GifOptimizer.h"
+#include <cstdio>
+#include <exception>
+#include <string>
+#include <vector>
+
+namespace
+{
+    int PrintUsage(char const* program)
+    {
+        fprintf(stderr, "Usage: %s [--threads <count>] <input.gif output.gif | input output>\n", program);
+        return 1;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    // GifSnip.Optimizer [options] <input.gif output.gif | input output>
+    //   --threads <count>   files optimized at once, 0 for one per core
+    // The same as GifSnip.exe --optimize, on any platform
+    std::vector<std::string> args(argv + 1, argv + argc);
+    try
+    {
+        uint32_t threadCount = 0;
+        std::vector<std::string> paths;
+        for (size_t i = 0; i < args.size(); i++)
+        {
+            if (args[i] == "--threads" && i + 1 < args.size())
+            {
+                threadCount = static_cast<uint32_t>(std::stoul(args[++i]));
+            }
+            else if (args[i].rfind("--", 0) != 0 && paths.size() < 2)
+            {
+                paths.push_back(args[i]);
+            }
+            else
+            {
+                fprintf(stderr, "Unknown or incomplete argument: %s\n", args[i].c_str());
+                return PrintUsage(argv[0]);
+            }
+        }
+        if (paths.size() != 2)
+        {
+            return PrintUsage(argv[0]);
+        }
+
+        auto files = GifOptimizer::ListFiles(paths[0], paths[1]);
+        GifOptimizer optimizer(GifOptimizer::OfflineOptions({}), threadCount);
+        auto results = optimizer.OptimizeAll(files, [](GifOptimizerResult const& result)
+            {
+                if (!result.Error.empty())
+                {
+                    printf("%s: %s\n", result.Input.string().c_str(), result.Error.c_str());
+                    return;
+                }
+                printf("%s: %llu -> %llu bytes, %llu of %llu frames%s\n",
+                    result.Input.string().c_str(),
+                    static_cast<unsigned long long>(result.InputBytes),
+                    static_cast<unsigned long long>(result.OutputBytes),
+                    static_cast<unsigned long long>(result.FramesWritten),
+                    static_cast<unsigned long long>(result.FramesRead),
+                    result.KeptOriginal ? ", kept the original" : "");
+                fflush(stdout);
+            });
+
+        uint64_t inputBytes = 0;
+        uint64_t outputBytes = 0;
+        size_t failedCount = 0;
+        for (auto&& result : results)
+        {
+            inputBytes += result.InputBytes;
+            outputBytes += result.OutputBytes;
+            failedCount += result.Error.empty() ? 0 : 1;
+        }
+        printf("Optimized %zu of %zu files: %llu -> %llu bytes\n",
+            results.size() - failedCount,
+            results.size(),
+            static_cast<unsigned long long>(inputBytes),
+            static_cast<unsigned long long>(outputBytes));
+        return failedCount == 0 ? 0 : 1;
+    }
+    catch (std::exception const& error)
+    {
+        fprintf(stderr, "%s\n", error.what());
+        return 1;
+    }
+}
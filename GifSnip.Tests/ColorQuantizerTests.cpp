@@ -0,0 +1,123 @@
+#include "Test.h"
+#include "ColorQuantizer.h"
+#include <algorithm>
+#include <random>
+#include <string>
+#include <tuple>
+
+namespace
+{
+    const std::pair<QuantizerAlgorithm, char const*> Algorithms[] = { { QuantizerAlgorithm::Octree, "Octree" }, { QuantizerAlgorithm::MedianCut, "MedianCut" }, { QuantizerAlgorithm::KMeans, "KMeans" } };
+
+    // Distinct opaque colors, each in a histogram bin of its own so that
+    // no two get averaged together
+    std::vector<uint32_t> RandomColors(uint32_t count, std::mt19937& random)
+    {
+        std::vector<uint32_t> bins(ColorHistogram::BinCount);
+        for (uint32_t i = 0; i < ColorHistogram::BinCount; i++)
+        {
+            bins[i] = i;
+        }
+        std::shuffle(bins.begin(), bins.end(), random);
+
+        std::vector<uint32_t> colors;
+        for (uint32_t i = 0; i < count; i++)
+        {
+            auto bin = bins[i];
+            auto r = ((bin >> 10) << 3) | (random() & 7);
+            auto g = (((bin >> 5) & 0x1F) << 3) | (random() & 7);
+            auto b = ((bin & 0x1F) << 3) | (random() & 7);
+            colors.push_back(0xFF000000 | (r << 16) | (g << 8) | b);
+        }
+        return colors;
+    }
+
+    // A frame of the colors in random order, every one of them at least once
+    std::vector<uint32_t> FrameOf(std::vector<uint32_t> const& colors, uint32_t pixelCount, std::mt19937& random)
+    {
+        std::vector<uint32_t> pixels(colors);
+        std::uniform_int_distribution<size_t> pick(0, colors.size() - 1);
+        while (pixels.size() < pixelCount)
+        {
+            pixels.push_back(colors[pick(random)]);
+        }
+        std::shuffle(pixels.begin(), pixels.end(), random);
+        return pixels;
+    }
+
+    std::vector<std::tuple<uint8_t, uint8_t, uint8_t>> Sorted(std::vector<GifColor> const& palette)
+    {
+        std::vector<std::tuple<uint8_t, uint8_t, uint8_t>> colors;
+        for (auto&& color : palette)
+        {
+            colors.emplace_back(color.R, color.G, color.B);
+        }
+        std::sort(colors.begin(), colors.end());
+        return colors;
+    }
+}
+
+void RunColorQuantizerTests(TestRunner& runner)
+{
+    runner.Run("ColorQuantizer/KeepsColorsThatFit", []()
+        {
+            std::mt19937 random(6);
+            for (auto&& [algorithm, algorithmName] : Algorithms)
+            {
+                for (uint32_t maxColors : { 16u, 256u })
+                {
+                    QuantizerOptions options = {};
+                    options.Algorithm = algorithm;
+                    options.MaxColors = maxColors;
+                    ColorQuantizer quantizer(options);
+                    for (auto colorCount : { 1u, 2u, maxColors / 2, maxColors })
+                    {
+                        const uint32_t width = 40;
+                        const uint32_t height = 30;
+                        auto colors = RandomColors(colorCount, random);
+                        auto pixels = FrameOf(colors, width * height, random);
+                        auto palette = quantizer.BuildPalette(reinterpret_cast<uint8_t const*>(pixels.data()), static_cast<size_t>(width) * 4, width, height);
+
+                        std::vector<GifColor> expected;
+                        for (auto color : colors)
+                        {
+                            expected.push_back(GifColor{ static_cast<uint8_t>(color >> 16), static_cast<uint8_t>(color >> 8), static_cast<uint8_t>(color) });
+                        }
+                        if (Sorted(palette) != Sorted(expected))
+                        {
+                            throw TestFailure(std::string(algorithmName) + " doesn't keep " + std::to_string(colorCount) + " colors of " + std::to_string(maxColors));
+                        }
+                    }
+                }
+            }
+        });
+
+    runner.Run("ColorQuantizer/NeverExceedsMaxColors", []()
+        {
+            std::mt19937 random(60);
+            const uint32_t width = 128;
+            const uint32_t height = 96;
+            std::vector<uint32_t> pixels(static_cast<size_t>(width) * height);
+            for (auto&& pixel : pixels)
+            {
+                pixel = static_cast<uint32_t>(random()) | 0xFF000000;
+            }
+            for (auto&& [algorithm, algorithmName] : Algorithms)
+            {
+                // Out of range limits are clamped to 2-256
+                for (uint32_t maxColors : { 0u, 2u, 3u, 16u, 63u, 255u, 256u, 1000u })
+                {
+                    QuantizerOptions options = {};
+                    options.Algorithm = algorithm;
+                    options.MaxColors = maxColors;
+                    ColorQuantizer quantizer(options);
+                    auto palette = quantizer.BuildPalette(reinterpret_cast<uint8_t const*>(pixels.data()), static_cast<size_t>(width) * 4, width, height);
+                    auto limit = std::min(std::max(maxColors, 2u), 256u);
+                    if (palette.empty() || palette.size() > limit)
+                    {
+                        throw TestFailure(std::string(algorithmName) + " built " + std::to_string(palette.size()) + " colors for a limit of " + std::to_string(maxColors));
+                    }
+                }
+            }
+        });
+}
@@ -0,0 +1,320 @@
+#include "Test.h"
+#include "DiffCorpus.h"
+#include "CpuTextureDiffer.h"
+#include "ThreadPool.h"
+#include <cstdlib>
+#include <cstring>
+#include <random>
+
+namespace
+{
+    // Random opaque pixels, tightly packed
+    std::vector<uint32_t> RandomFrame(uint32_t width, uint32_t height, std::mt19937& random)
+    {
+        std::vector<uint32_t> pixels(static_cast<size_t>(width) * height);
+        for (auto&& pixel : pixels)
+        {
+            pixel = static_cast<uint32_t>(random()) | 0xFF000000;
+        }
+        return pixels;
+    }
+
+    // Moves every channel but alpha by up to maxStep either way
+    uint32_t Nudge(uint32_t pixel, int32_t maxStep, std::mt19937& random)
+    {
+        std::uniform_int_distribution<int32_t> step(-maxStep, maxStep);
+        for (uint32_t shift = 0; shift < 24; shift += 8)
+        {
+            auto channel = std::clamp(static_cast<int32_t>((pixel >> shift) & 0xFF) + step(random), 0, 255);
+            pixel = (pixel & ~(0xFFu << shift)) | (static_cast<uint32_t>(channel) << shift);
+        }
+        return pixel;
+    }
+
+    // How many pixels of the dispatched region the tolerance counts as
+    // changed, one pixel at a time
+    uint32_t CountChangedPixels(std::vector<uint32_t> const& current, std::vector<uint32_t> const& previous, uint32_t width, uint32_t height, DiffTolerance const& tolerance)
+    {
+        auto luma = [](uint32_t pixel)
+        {
+            return static_cast<int32_t>((((pixel >> 16) & 0xFF) * LumaWeights::Red) + (((pixel >> 8) & 0xFF) * LumaWeights::Green) + ((pixel & 0xFF) * LumaWeights::Blue));
+        };
+
+        uint32_t changed = 0;
+        for (uint32_t y = 0; y < (height / 2) * 2; y++)
+        {
+            for (uint32_t x = 0; x < (width / 2) * 2; x++)
+            {
+                auto a = current[(static_cast<size_t>(y) * width) + x];
+                auto b = previous[(static_cast<size_t>(y) * width) + x];
+                if (tolerance.Mode == ToleranceMode::Luma)
+                {
+                    changed += static_cast<uint32_t>(std::abs(luma(a) - luma(b))) > tolerance.Threshold * LumaWeights::Scale ? 1 : 0;
+                    continue;
+                }
+                for (uint32_t shift = 0; shift < 32; shift += 8)
+                {
+                    if (static_cast<uint32_t>(std::abs(static_cast<int32_t>((a >> shift) & 0xFF) - static_cast<int32_t>((b >> shift) & 0xFF))) > tolerance.Threshold)
+                    {
+                        changed++;
+                        break;
+                    }
+                }
+            }
+        }
+        return changed;
+    }
+
+    std::optional<DiffRect> ProcessFrame(CpuTextureDiffer& differ, std::vector<uint32_t> const& pixels, uint32_t width)
+    {
+        return differ.ProcessFrame(reinterpret_cast<uint8_t const*>(pixels.data()), static_cast<size_t>(width) * 4);
+    }
+}
+
+void RunCpuTextureDifferTests(TestRunner& runner)
+{
+    // Run once per instruction set by ctest, see GIFSNIP_CPU in Simd.h
+    auto prefix = std::string("CpuTextureDiffer/") + InstructionSetName() + "/";
+
+    runner.Run(prefix + "MatchesShaderCorpus", []()
+        {
+            for (auto&& diffCase : LoadCorpus())
+            {
+                auto rect = CpuTextureDiffer::DiffBuffers(
+                    diffCase.Current.data(), diffCase.Stride,
+                    diffCase.Previous.data(), diffCase.Stride,
+                    diffCase.Width, diffCase.Height);
+                CheckRect(diffCase, rect, "without tiles");
+
+                DirtyTileMap tiles(diffCase.Width, diffCase.Height);
+                rect = CpuTextureDiffer::DiffBuffers(
+                    diffCase.Current.data(), diffCase.Stride,
+                    diffCase.Previous.data(), diffCase.Stride,
+                    diffCase.Width, diffCase.Height, nullptr, &tiles);
+                CheckRect(diffCase, rect, "with tiles");
+                // Like the rect, tiles leave out the trailing odd column and row
+                CheckTiles(diffCase, tiles, (diffCase.Width / 2) * 2, (diffCase.Height / 2) * 2);
+            }
+        });
+
+    runner.Run(prefix + "MatchesShaderCorpusInBands", []()
+        {
+            // Enough threads that the tall frames are split into several
+            // bands, whatever the machine
+            ThreadPool threadPool(4);
+            for (auto&& diffCase : LoadCorpus())
+            {
+                auto rect = CpuTextureDiffer::DiffBuffers(
+                    diffCase.Current.data(), diffCase.Stride,
+                    diffCase.Previous.data(), diffCase.Stride,
+                    diffCase.Width, diffCase.Height, &threadPool);
+                CheckRect(diffCase, rect, "in bands without tiles");
+
+                for (uint32_t tileSize : { 16, 32 })
+                {
+                    DirtyTileMap tiles(diffCase.Width, diffCase.Height, tileSize);
+                    rect = CpuTextureDiffer::DiffBuffers(
+                        diffCase.Current.data(), diffCase.Stride,
+                        diffCase.Previous.data(), diffCase.Stride,
+                        diffCase.Width, diffCase.Height, &threadPool, &tiles);
+                    CheckRect(diffCase, rect, "in bands with tiles");
+                    CheckTiles(diffCase, tiles, (diffCase.Width / 2) * 2, (diffCase.Height / 2) * 2);
+                }
+            }
+        });
+
+    runner.Run(prefix + "ProcessFrameMatchesShaderCorpus", []()
+        {
+            ThreadPool threadPool(4);
+            for (auto&& diffCase : LoadCorpus())
+            {
+                for (auto pool : { static_cast<ThreadPool*>(nullptr), &threadPool })
+                {
+                    CpuTextureDiffer differ(diffCase.Width, diffCase.Height, pool);
+                    auto first = differ.ProcessFrame(diffCase.Previous.data(), diffCase.Stride);
+                    CHECK(first.has_value());
+                    CHECK_EQUAL(diffCase.Width, first->Right - first->Left);
+                    CHECK_EQUAL(diffCase.Height, first->Bottom - first->Top);
+
+                    CheckRect(diffCase, differ.ProcessFrame(diffCase.Current.data(), diffCase.Stride), "after a frame");
+                    CheckTiles(diffCase, differ.DirtyTiles(), (diffCase.Width / 2) * 2, (diffCase.Height / 2) * 2);
+                }
+            }
+        });
+
+    runner.Run(prefix + "TilesSkipTheTrailingOddColumnAndRow", []()
+        {
+            // Tiles of 16 on a 33x33 frame, so the last column and row of
+            // tiles hold nothing but pixels the shader never compares
+            const uint32_t size = 33;
+            std::mt19937 random(3);
+            auto previous = RandomFrame(size, size, random);
+            CpuTextureDiffer differ(size, size);
+            differ.ProcessFrame(reinterpret_cast<uint8_t const*>(previous.data()), size * 4);
+
+            auto current = previous;
+            current[(5 * size) + 32] ^= 0xFF;
+            current[(32 * size) + 5] ^= 0xFF;
+            current[(32 * size) + 32] ^= 0xFF;
+            CHECK(!differ.ProcessFrame(reinterpret_cast<uint8_t const*>(current.data()), size * 4).has_value());
+            CHECK_EQUAL(0u, differ.DirtyTiles().DirtyCount());
+
+            // Next to them is compared as usual
+            current[(31 * size) + 31] ^= 0xFF;
+            auto rect = differ.ProcessFrame(reinterpret_cast<uint8_t const*>(current.data()), size * 4);
+            CHECK(rect.has_value());
+            CHECK_EQUAL(31u, rect->Left);
+            CHECK_EQUAL(31u, rect->Bottom);
+            CHECK_EQUAL(1u, differ.DirtyTiles().DirtyCount());
+            CHECK(differ.DirtyTiles().IsDirty(1, 1));
+        });
+
+    runner.Run(prefix + "ToleranceDropsNoise", []()
+        {
+            // Every pixel moves, but never by more than the threshold
+            const uint32_t width = 96;
+            const uint32_t height = 80;
+            std::mt19937 random(1);
+            auto frame = RandomFrame(width, height, random);
+            ThreadPool threadPool(4);
+            for (auto mode : { ToleranceMode::Channel, ToleranceMode::Luma })
+            {
+                for (auto pool : { static_cast<ThreadPool*>(nullptr), &threadPool })
+                {
+                    DiffTolerance tolerance = {};
+                    tolerance.Mode = mode;
+                    tolerance.Threshold = 3;
+                    CpuTextureDiffer differ(width, height, pool, 16, ChangeDetection::Exact, tolerance);
+                    CHECK(ProcessFrame(differ, frame, width).has_value());
+                    for (int i = 0; i < 4; i++)
+                    {
+                        auto noisy = frame;
+                        for (auto&& pixel : noisy)
+                        {
+                            pixel = Nudge(pixel, 3, random);
+                        }
+                        CHECK(!ProcessFrame(differ, noisy, width).has_value());
+                        CHECK(!differ.DirtyTiles().Any());
+                    }
+                }
+            }
+        });
+
+    runner.Run(prefix + "ToleranceReportsChangesPastTheThreshold", []()
+        {
+            const uint32_t width = 96;
+            const uint32_t height = 80;
+            std::mt19937 random(2);
+            auto frame = RandomFrame(width, height, random);
+            for (auto mode : { ToleranceMode::Channel, ToleranceMode::Luma })
+            {
+                DiffTolerance tolerance = {};
+                tolerance.Mode = mode;
+                tolerance.Threshold = 3;
+                CpuTextureDiffer differ(width, height, nullptr, 16, ChangeDetection::Exact, tolerance);
+                ProcessFrame(differ, frame, width);
+
+                // Noise everywhere, and two pixels that turn black or white,
+                // whichever is further, which no small threshold can miss
+                auto changed = frame;
+                for (auto&& pixel : changed)
+                {
+                    pixel = Nudge(pixel, 3, random);
+                }
+                changed[(20 * width) + 40] = (frame[(20 * width) + 40] & 0x80) != 0 ? 0xFF000000 : 0xFFFFFFFF;
+                changed[(70 * width) + 90] = (frame[(70 * width) + 90] & 0x80) != 0 ? 0xFF000000 : 0xFFFFFFFF;
+                auto rect = ProcessFrame(differ, changed, width);
+
+                // Rounded out to whole tiles, the way the hash differ does
+                CHECK(rect.has_value());
+                CHECK_EQUAL(32u, rect->Left);
+                CHECK_EQUAL(16u, rect->Top);
+                CHECK_EQUAL(95u, rect->Right);
+                CHECK_EQUAL(79u, rect->Bottom);
+                CHECK_EQUAL(2u, differ.DirtyTiles().DirtyCount());
+                CHECK(differ.DirtyTiles().IsDirty(2, 1));
+                CHECK(differ.DirtyTiles().IsDirty(5, 4));
+            }
+        });
+
+    runner.Run(prefix + "ToleranceReportsDriftOnceItAddsUp", []()
+        {
+            // A fade one step per frame is compared against the frame that
+            // was last reported, not the one before it
+            const uint32_t width = 64;
+            const uint32_t height = 64;
+            for (auto mode : { ToleranceMode::Channel, ToleranceMode::Luma })
+            {
+                DiffTolerance tolerance = {};
+                tolerance.Mode = mode;
+                tolerance.Threshold = 3;
+                CpuTextureDiffer differ(width, height, nullptr, 16, ChangeDetection::Exact, tolerance);
+                std::vector<uint32_t> frame(static_cast<size_t>(width) * height, 0xFF404040);
+                ProcessFrame(differ, frame, width);
+                std::vector<bool> reported;
+                for (uint32_t step = 1; step <= 8; step++)
+                {
+                    for (uint32_t y = 8; y < 24; y++)
+                    {
+                        for (uint32_t x = 40; x < 56; x++)
+                        {
+                            frame[(static_cast<size_t>(y) * width) + x] = 0xFF000000 | (0x010101u * (0x40 + step));
+                        }
+                    }
+                    auto rect = ProcessFrame(differ, frame, width);
+                    reported.push_back(rect.has_value());
+                    if (rect.has_value())
+                    {
+                        CHECK_EQUAL(32u, rect->Left);
+                        CHECK_EQUAL(0u, rect->Top);
+                        CHECK_EQUAL(63u, rect->Right);
+                        CHECK_EQUAL(31u, rect->Bottom);
+                    }
+                }
+                const std::vector<bool> expected = { false, false, false, true, false, false, false, true };
+                CHECK(reported == expected);
+            }
+        });
+
+    runner.Run(prefix + "ToleranceCountsMatchPixelByPixel", []()
+        {
+            // MinDirtyPixels lets the exact count through, so a kernel
+            // that's off by one either way fails. The odd size leaves
+            // the vector paths a tail, and the last column and row
+            // aren't compared.
+            const uint32_t width = 67;
+            const uint32_t height = 45;
+            std::mt19937 random(3);
+            ThreadPool threadPool(4);
+            for (auto mode : { ToleranceMode::Channel, ToleranceMode::Luma })
+            {
+                for (uint32_t threshold : { 0, 2, 5 })
+                {
+                    auto previous = RandomFrame(width, height, random);
+                    auto current = previous;
+                    for (auto&& pixel : current)
+                    {
+                        pixel = Nudge(pixel, 6, random);
+                    }
+                    // Alpha counts for the channel mode, but not for luma
+                    current[5] ^= 0x7F000000;
+
+                    DiffTolerance tolerance = {};
+                    tolerance.Mode = mode;
+                    tolerance.Threshold = threshold;
+                    auto expectedCount = CountChangedPixels(current, previous, width, height, tolerance);
+                    CHECK(expectedCount > 0);
+                    for (auto minDirtyPixels : { expectedCount, expectedCount + 1 })
+                    {
+                        tolerance.MinDirtyPixels = minDirtyPixels;
+                        for (auto pool : { static_cast<ThreadPool*>(nullptr), &threadPool })
+                        {
+                            CpuTextureDiffer differ(width, height, pool, 16, ChangeDetection::Exact, tolerance);
+                            ProcessFrame(differ, previous, width);
+                            CHECK_EQUAL(minDirtyPixels == expectedCount, ProcessFrame(differ, current, width).has_value());
+                        }
+                    }
+                }
+            }
+        });
+}
@@ -0,0 +1,171 @@
+#include "DiffCorpus.h"
+#include "Test.h"
+#include "Simd.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+namespace
+{
+    void XorPixel(DiffCase& diffCase, uint32_t x, uint32_t y, uint32_t mask)
+    {
+        CHECK(x < diffCase.Width && y < diffCase.Height);
+        auto pixel = diffCase.Current.data() + (static_cast<size_t>(y) * diffCase.Stride) + (static_cast<size_t>(x) * 4);
+        for (uint32_t channel = 0; channel < 4; channel++)
+        {
+            pixel[channel] ^= static_cast<uint8_t>(mask >> (channel * 8));
+        }
+    }
+}
+
+std::vector<DiffCase> LoadCorpus()
+{
+    auto path = std::string(GIFSNIP_TEST_DATA) + "/DiffCorpus.txt";
+    std::ifstream file(path);
+    if (!file.is_open())
+    {
+        throw std::runtime_error("Couldn't open " + path);
+    }
+
+    std::vector<DiffCase> cases;
+    std::string line;
+    while (std::getline(file, line))
+    {
+        std::istringstream fields(line);
+        std::string command;
+        if (!(fields >> command) || command[0] == '#')
+        {
+            continue;
+        }
+        if (command == "frame")
+        {
+            DiffCase diffCase;
+            size_t padding = 0;
+            uint32_t state = 0;
+            fields >> diffCase.Name >> diffCase.Width >> diffCase.Height >> padding >> state;
+            diffCase.Stride = (static_cast<size_t>(diffCase.Width) * 4) + padding;
+            diffCase.Previous.assign(diffCase.Stride * diffCase.Height, 0x00);
+            diffCase.Current.assign(diffCase.Stride * diffCase.Height, 0xFF);
+            for (uint32_t y = 0; y < diffCase.Height; y++)
+            {
+                for (uint32_t x = 0; x < diffCase.Width; x++)
+                {
+                    state ^= state << 13;
+                    state ^= state >> 17;
+                    state ^= state << 5;
+                    auto offset = (static_cast<size_t>(y) * diffCase.Stride) + (static_cast<size_t>(x) * 4);
+                    memcpy(diffCase.Previous.data() + offset, &state, sizeof(state));
+                    memcpy(diffCase.Current.data() + offset, &state, sizeof(state));
+                }
+            }
+            cases.push_back(std::move(diffCase));
+            continue;
+        }
+
+        CHECK(!cases.empty());
+        auto&& diffCase = cases.back();
+        std::vector<std::string> values;
+        std::string value;
+        while (fields >> value)
+        {
+            values.push_back(value);
+        }
+        if (command == "xor" && values.size() == 3)
+        {
+            XorPixel(diffCase, static_cast<uint32_t>(std::stoul(values[0])), static_cast<uint32_t>(std::stoul(values[1])), static_cast<uint32_t>(std::stoul(values[2], nullptr, 16)));
+        }
+        else if (command == "xor" && values.size() == 5)
+        {
+            auto mask = static_cast<uint32_t>(std::stoul(values[4], nullptr, 16));
+            for (auto y = std::stoul(values[1]); y <= std::stoul(values[3]); y++)
+            {
+                for (auto x = std::stoul(values[0]); x <= std::stoul(values[2]); x++)
+                {
+                    XorPixel(diffCase, static_cast<uint32_t>(x), static_cast<uint32_t>(y), mask);
+                }
+            }
+        }
+        else if (command == "expect" && values.size() == 1 && values[0] == "none")
+        {
+            diffCase.Expected.reset();
+        }
+        else if (command == "expect" && values.size() == 4)
+        {
+            auto value = [&](size_t i) { return static_cast<uint32_t>(std::stoul(values[i])); };
+            diffCase.Expected = DiffRect{ value(0), value(1), value(2), value(3) };
+        }
+        else
+        {
+            throw std::runtime_error("Can't parse \"" + line + "\" in " + path);
+        }
+    }
+    CHECK(!cases.empty());
+    return cases;
+}
+
+void CheckRect(DiffCase const& diffCase, std::optional<DiffRect> const& actual, char const* how)
+{
+    auto expected = diffCase.Expected;
+    auto matches = expected.has_value() == actual.has_value();
+    if (matches && expected.has_value())
+    {
+        matches = expected->Left == actual->Left && expected->Top == actual->Top &&
+            expected->Right == actual->Right && expected->Bottom == actual->Bottom;
+    }
+    if (!matches)
+    {
+        std::ostringstream message;
+        message << diffCase.Name << " " << how << ": got ";
+        if (actual.has_value())
+        {
+            message << actual->Left << " " << actual->Top << " " << actual->Right << " " << actual->Bottom;
+        }
+        else
+        {
+            message << "none";
+        }
+        throw TestFailure(message.str());
+    }
+}
+
+void CheckTiles(DiffCase const& diffCase, DirtyTileMap const& tiles, uint32_t width, uint32_t height)
+{
+    auto tileSize = tiles.TileSize();
+    for (uint32_t row = 0; row < tiles.RowCount(); row++)
+    {
+        for (uint32_t column = 0; column < tiles.ColumnCount(); column++)
+        {
+            auto changed = false;
+            auto left = column * tileSize;
+            auto right = std::min((column + 1) * tileSize, width);
+            for (auto y = row * tileSize; y < std::min((row + 1) * tileSize, height) && left < right; y++)
+            {
+                auto offset = (static_cast<size_t>(y) * diffCase.Stride) + (static_cast<size_t>(left) * 4);
+                auto bytes = static_cast<size_t>(right - left) * 4;
+                changed |= memcmp(diffCase.Previous.data() + offset, diffCase.Current.data() + offset, bytes) != 0;
+            }
+            if (changed != tiles.IsDirty(column, row))
+            {
+                throw TestFailure(diffCase.Name + ": tile " + std::to_string(column) + ", " + std::to_string(row) + " is wrong");
+            }
+        }
+    }
+}
+
+char const* InstructionSetName()
+{
+    auto&& features = CpuFeatures::Current();
+    if (features.Avx2)
+    {
+        return "Avx2";
+    }
+    if (features.Sse41)
+    {
+        return "Sse41";
+    }
+    if (features.Neon)
+    {
+        return "Neon";
+    }
+    return "Scalar";
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include "DiffRect.h"
+#include "DirtyTileMap.h"
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+// A pair of frames from DiffCorpus.txt, see there for the format
+struct DiffCase
+{
+    std::string Name;
+    uint32_t Width = 0;
+    uint32_t Height = 0;
+    size_t Stride = 0;
+    std::vector<uint8_t> Previous;
+    std::vector<uint8_t> Current;
+    std::optional<DiffRect> Expected;
+};
+
+std::vector<DiffCase> LoadCorpus();
+
+// Throws a TestFailure naming the case unless the rect is the expected one
+void CheckRect(DiffCase const& diffCase, std::optional<DiffRect> const& actual, char const* how);
+// Checks that exactly the tiles with a changed pixel in the top left
+// width x height part of the frame are dirty
+void CheckTiles(DiffCase const& diffCase, DirtyTileMap const& tiles, uint32_t width, uint32_t height);
+
+// The instruction set the differs run with, see GIFSNIP_CPU in Simd.h
+char const* InstructionSetName();
@@ -0,0 +1,128 @@
+#include "Test.h"
+#include "ColorQuantizer.h"
+#include "DiffRect.h"
+#include "Ditherer.h"
+#include <algorithm>
+#include <random>
+
+namespace
+{
+    // A gradient with some noise on top, which no palette fits exactly
+    std::vector<uint32_t> NoisyGradient(uint32_t width, uint32_t height, std::mt19937& random)
+    {
+        std::uniform_int_distribution<uint32_t> noise(0, 15);
+        std::vector<uint32_t> pixels(static_cast<size_t>(width) * height);
+        for (uint32_t y = 0; y < height; y++)
+        {
+            for (uint32_t x = 0; x < width; x++)
+            {
+                auto r = (x * 255) / width;
+                auto g = 100 + noise(random);
+                auto b = (y * 255) / height;
+                pixels[(static_cast<size_t>(y) * width) + x] = 0xFF000000 | (r << 16) | (g << 8) | b;
+            }
+        }
+        return pixels;
+    }
+
+    std::vector<GifColor> BuildPalette(std::vector<uint32_t> const& pixels, uint32_t width, uint32_t height, uint32_t maxColors)
+    {
+        QuantizerOptions options = {};
+        options.MaxColors = maxColors;
+        ColorQuantizer quantizer(options);
+        return quantizer.BuildPalette(reinterpret_cast<uint8_t const*>(pixels.data()), static_cast<size_t>(width) * 4, width, height);
+    }
+
+    // Maps an exclusive rect of the frame as a region of its own
+    std::vector<uint8_t> MapRect(Ditherer& ditherer, PaletteMapper& mapper, std::vector<uint32_t> const& pixels, uint32_t frameWidth, DiffRect const& rect)
+    {
+        auto width = rect.Right - rect.Left;
+        auto height = rect.Bottom - rect.Top;
+        std::vector<uint8_t> indices(static_cast<size_t>(width) * height);
+        auto first = pixels.data() + (static_cast<size_t>(rect.Top) * frameWidth) + rect.Left;
+        ditherer.MapPixels(mapper, reinterpret_cast<uint8_t const*>(first), static_cast<size_t>(frameWidth) * 4, width, height, rect.Left, rect.Top, indices.data());
+        return indices;
+    }
+}
+
+void RunDithererTests(TestRunner& runner)
+{
+    runner.Run("Ditherer/OrderedPatternFollowsTheFrame", []()
+        {
+            // Regions at every offset from the pattern's 8x8 grid map each
+            // pixel the same as the whole frame does, so pixels that don't
+            // change still come out transparent
+            const uint32_t width = 80;
+            const uint32_t height = 60;
+            std::mt19937 random(22);
+            auto pixels = NoisyGradient(width, height, random);
+            PaletteMapper mapper;
+            mapper.SetPalette(BuildPalette(pixels, width, height, 63));
+            Ditherer ditherer(DitherMode::Ordered, 63);
+            auto frameIndices = MapRect(ditherer, mapper, pixels, width, DiffRect{ 0, 0, width, height });
+
+            const DiffRect rects[] = { { 3, 5, 40, 33 }, { 8, 8, 16, 16 }, { 13, 1, 80, 60 }, { 0, 7, 1, 8 }, { 77, 58, 80, 60 } };
+            for (auto&& rect : rects)
+            {
+                auto indices = MapRect(ditherer, mapper, pixels, width, rect);
+                auto rectWidth = rect.Right - rect.Left;
+                for (auto y = rect.Top; y < rect.Bottom; y++)
+                {
+                    for (auto x = rect.Left; x < rect.Right; x++)
+                    {
+                        CHECK_EQUAL(frameIndices[(static_cast<size_t>(y) * width) + x], indices[(static_cast<size_t>(y - rect.Top) * rectWidth) + (x - rect.Left)]);
+                    }
+                }
+            }
+
+            // And the pattern does change some of them
+            Ditherer plain(DitherMode::None);
+            CHECK(frameIndices != MapRect(plain, mapper, pixels, width, DiffRect{ 0, 0, width, height }));
+        });
+
+    runner.Run("Ditherer/OrderedPatternIgnoresThePaletteSize", []()
+        {
+            // Entries that are nowhere near the region's colors are never
+            // picked, and mustn't move any other pixel either
+            const uint32_t width = 64;
+            const uint32_t height = 64;
+            std::mt19937 random(7);
+            auto pixels = NoisyGradient(width, height, random);
+            auto palette = BuildPalette(pixels, width, height, 63);
+            PaletteMapper mapper;
+            mapper.SetPalette(palette);
+            Ditherer ditherer(DitherMode::Ordered, 63);
+            auto indices = MapRect(ditherer, mapper, pixels, width, DiffRect{ 0, 0, width, height });
+
+            for (uint32_t i = 0; i < 64; i++)
+            {
+                palette.push_back(GifColor{ static_cast<uint8_t>(i * 4), static_cast<uint8_t>(i % 2 == 0 ? 0 : 255), static_cast<uint8_t>(255 - (i * 4)) });
+            }
+            mapper.SetPalette(palette);
+            CHECK(indices == MapRect(ditherer, mapper, pixels, width, DiffRect{ 0, 0, width, height }));
+        });
+
+    runner.Run("Ditherer/FloydSteinbergIsDeterministic", []()
+        {
+            const uint32_t width = 97;
+            const uint32_t height = 41;
+            std::mt19937 random(3);
+            auto pixels = NoisyGradient(width, height, random);
+            auto otherPixels = pixels;
+            std::reverse(otherPixels.begin(), otherPixels.end());
+            PaletteMapper mapper;
+            mapper.SetPalette(BuildPalette(pixels, width, height, 31));
+            const DiffRect rect = { 0, 0, width, height };
+
+            Ditherer ditherer(DitherMode::FloydSteinberg);
+            auto indices = MapRect(ditherer, mapper, pixels, width, rect);
+            CHECK(indices != MapRect(ditherer, mapper, otherPixels, width, rect));
+            // Nothing carries over from one call to the next
+            CHECK(indices == MapRect(ditherer, mapper, pixels, width, rect));
+            Ditherer otherDitherer(DitherMode::FloydSteinberg);
+            CHECK(indices == MapRect(otherDitherer, mapper, pixels, width, rect));
+
+            Ditherer plain(DitherMode::None);
+            CHECK(indices != MapRect(plain, mapper, pixels, width, rect));
+        });
+}
@@ -0,0 +1,63 @@
+#include "Test.h"
+#include "FrameBufferPool.h"
+#include <deque>
+
+void RunFrameBufferPoolTests(TestRunner& runner)
+{
+    runner.Run("FrameBufferPool/RowsAreAligned", []()
+        {
+            FrameBufferPool pool;
+            for (uint32_t width : { 1u, 15u, 16u, 17u, 333u })
+            {
+                auto buffer = pool.Acquire(width, 3);
+                CHECK_EQUAL(width, buffer.Width());
+                CHECK_EQUAL(3u, buffer.Height());
+                CHECK(buffer.Stride() >= static_cast<size_t>(width) * 4);
+                CHECK_EQUAL(0u, buffer.Stride() % FrameBufferPool::RowAlignment);
+                CHECK_EQUAL(0u, reinterpret_cast<uintptr_t>(buffer.Data()) % FrameBufferPool::RowAlignment);
+            }
+            CHECK_THROWS(std::invalid_argument, pool.Acquire(0, 3));
+        });
+
+    runner.Run("FrameBufferPool/StopsAllocatingOnceWarm", []()
+        {
+            // Regions of a few sizes, with a few frames' worth in flight at
+            // once, like the queue between capture and the encoder
+            FrameBufferPool pool;
+            std::deque<std::vector<FrameBuffer>> inFlight;
+            auto recordFrame = [&](uint32_t frame)
+            {
+                std::vector<FrameBuffer> regions;
+                regions.push_back(pool.Acquire(640, 480));
+                regions.push_back(pool.Acquire(16 + (frame % 7), 16 + (frame % 5)));
+                if (frame % 3 == 0)
+                {
+                    regions.push_back(pool.Acquire(200 + (frame % 20), 100));
+                }
+                inFlight.push_back(std::move(regions));
+                if (inFlight.size() > 4)
+                {
+                    inFlight.pop_front();
+                }
+            };
+
+            for (uint32_t frame = 0; frame < 30; frame++)
+            {
+                recordFrame(frame);
+            }
+            auto allocationCount = pool.AllocationCount();
+            auto reservedBytes = pool.ReservedBytes();
+            CHECK(allocationCount > 0);
+            for (uint32_t frame = 30; frame < 300; frame++)
+            {
+                recordFrame(frame);
+            }
+            CHECK_EQUAL(allocationCount, pool.AllocationCount());
+            CHECK_EQUAL(reservedBytes, pool.ReservedBytes());
+
+            // Smaller buffers in the same size class reuse the memory too
+            inFlight.clear();
+            auto buffer = pool.Acquire(600, 460);
+            CHECK_EQUAL(allocationCount, pool.AllocationCount());
+        });
+}
@@ -0,0 +1,121 @@
+#include "Test.h"
+#include "FrameRateGovernor.h"
+#include <utility>
+#include <vector>
+
+namespace
+{
+    FrameTime Milliseconds(int64_t milliseconds)
+    {
+        // Capture time stamps never start at zero
+        return std::chrono::seconds(1) + std::chrono::duration_cast<FrameTime>(std::chrono::milliseconds(milliseconds));
+    }
+
+    // Offers a frame every 10ms for a second and returns how far apart
+    // the sampled ones were
+    std::vector<int64_t> SampleIntervals(FrameRateGovernor& governor, size_t queueDepth, size_t queueCapacity)
+    {
+        std::vector<int64_t> intervals;
+        int64_t lastSample = -1;
+        for (int64_t time = 0; time <= 1000; time += 10)
+        {
+            if (governor.ShouldSample(Milliseconds(time), queueDepth, queueCapacity))
+            {
+                if (lastSample >= 0)
+                {
+                    intervals.push_back(time - lastSample);
+                }
+                lastSample = time;
+            }
+        }
+        return intervals;
+    }
+}
+
+void RunFrameRateGovernorTests(TestRunner& runner)
+{
+    runner.Run("FrameRateGovernor/IntervalsAreWholeCentiseconds", []()
+        {
+            CHECK_EQUAL(30, FrameRateGovernor(10, 30).CurrentInterval().count());
+            CHECK_EQUAL(10, FrameRateGovernor(10, 60).CurrentInterval().count());
+            // Nothing shorter than one GIF delay unit
+            CHECK_EQUAL(10, FrameRateGovernor(10, 1000).CurrentInterval().count());
+
+            // The minimum rate rounds the same way
+            FrameRateGovernor governor(7, 30);
+            for (int i = 0; i < 8; i++)
+            {
+                governor.ReportChange(0.0);
+            }
+            CHECK_EQUAL(140, governor.CurrentInterval().count());
+
+            CHECK_THROWS(std::invalid_argument, FrameRateGovernor(0, 30));
+            CHECK_THROWS(std::invalid_argument, FrameRateGovernor(30, 10));
+        });
+
+    runner.Run("FrameRateGovernor/BacklogStretchesTheInterval", []()
+        {
+            // Up to half full, the queue doesn't matter
+            {
+                FrameRateGovernor governor(10, 30);
+                for (auto interval : SampleIntervals(governor, 4, 8))
+                {
+                    CHECK_EQUAL(30, interval);
+                }
+                CHECK_EQUAL(0u, governor.Statistics().BacklogSkippedFrames);
+            }
+
+            // Three quarters full stretches it twofold, a full queue threefold
+            const std::pair<size_t, int64_t> backlogs[] = { { 6, 60 }, { 8, 90 } };
+            for (auto&& [queueDepth, expectedInterval] : backlogs)
+            {
+                FrameRateGovernor governor(10, 30);
+                auto intervals = SampleIntervals(governor, queueDepth, 8);
+                CHECK(!intervals.empty());
+                for (auto interval : intervals)
+                {
+                    CHECK_EQUAL(expectedInterval, interval);
+                }
+                CHECK(governor.Statistics().BacklogSkippedFrames > 0);
+                CHECK_EQUAL(0u, governor.Statistics().IdleSkippedFrames);
+                CHECK_EQUAL(expectedInterval, governor.Statistics().LongestInterval.count());
+                // Only the sampling is stretched
+                CHECK_EQUAL(30, governor.CurrentInterval().count());
+            }
+
+            // Never past the minimum frame rate
+            FrameRateGovernor governor(20, 30);
+            for (auto interval : SampleIntervals(governor, 8, 8))
+            {
+                CHECK_EQUAL(50, interval);
+            }
+        });
+
+    runner.Run("FrameRateGovernor/BacksOffWhileIdleAndSnapsBack", []()
+        {
+            FrameRateGovernor governor(10, 30);
+            const int64_t quietIntervals[] = { 60, 100, 100 };
+            for (auto expected : quietIntervals)
+            {
+                governor.ReportChange(0.0);
+                CHECK_EQUAL(expected, governor.CurrentInterval().count());
+            }
+            auto intervals = SampleIntervals(governor, 0, 8);
+            CHECK(!intervals.empty());
+            for (auto interval : intervals)
+            {
+                CHECK_EQUAL(100, interval);
+            }
+            CHECK(governor.Statistics().IdleSkippedFrames > 0);
+            CHECK_EQUAL(0u, governor.Statistics().BacklogSkippedFrames);
+
+            // Typing is sampled at half the maximum rate, anything bigger
+            // at the full rate right away
+            governor.ReportChange(0.005);
+            CHECK_EQUAL(60, governor.CurrentInterval().count());
+            governor.ReportChange(0.0);
+            governor.ReportChange(0.0);
+            governor.ReportChange(0.5);
+            CHECK_EQUAL(30, governor.CurrentInterval().count());
+        });
+}
@@ -0,0 +1,368 @@
+#include "Test.h"
+#include "TestGifs.h"
+#include "GifFrameEncoder.h"
+#include "ThreadPool.h"
+#include <cstring>
+
+namespace
+{
+    // A region filled with a checkerboard of two colors
+    GifFrameRegion MakeRegion(FrameBufferPool& bufferPool, DiffRect const& rect, uint32_t color, uint32_t otherColor)
+    {
+        GifFrameRegion region = {};
+        region.Rect = rect;
+        region.Pixels = bufferPool.Acquire(rect.Right - rect.Left, rect.Bottom - rect.Top);
+        auto&& view = region.Pixels.View();
+        for (uint32_t y = 0; y < view.Height; y++)
+        {
+            for (uint32_t x = 0; x < view.Width; x++)
+            {
+                auto pixel = ((x + y) % 2 == 0 ? color : otherColor) | 0xFF000000;
+                memcpy(view.Row(y) + (static_cast<size_t>(x) * 4), &pixel, sizeof(pixel));
+            }
+        }
+        return region;
+    }
+
+    std::vector<uint8_t> FinishFile(GifFrameEncoder& encoder, std::vector<uint8_t>& bytes)
+    {
+        auto globalColorTable = encoder.Finish();
+        if (globalColorTable.has_value())
+        {
+            std::copy(globalColorTable->begin(), globalColorTable->end(), bytes.begin() + GifWriter::GlobalColorTableOffset);
+        }
+        return bytes;
+    }
+
+    // Copies an exclusive rect of a test frame into a region
+    GifFrameRegion CutRegion(FrameBufferPool& bufferPool, TestFrame const& frame, uint32_t frameWidth, DiffRect const& rect)
+    {
+        GifFrameRegion region = {};
+        region.Rect = rect;
+        region.Pixels = bufferPool.Acquire(rect.Right - rect.Left, rect.Bottom - rect.Top);
+        auto&& view = region.Pixels.View();
+        for (uint32_t y = 0; y < view.Height; y++)
+        {
+            auto source = frame.Pixels.data() + ((static_cast<size_t>(rect.Top + y) * frameWidth) + rect.Left) * 4;
+            memcpy(view.Row(y), source, static_cast<size_t>(view.Width) * 4);
+        }
+        return region;
+    }
+
+    // Encodes one region per frame, 10ms apart
+    std::vector<uint8_t> EncodeFrames(
+        std::vector<TestFrame> const& frames,
+        std::vector<DiffRect> const& rects,
+        uint32_t width,
+        uint32_t height,
+        GifEncoderOptions const& options,
+        GifEncoderStatistics* statistics = nullptr)
+    {
+        ThreadPool threadPool(2);
+        FrameBufferPool bufferPool;
+        std::vector<uint8_t> bytes;
+        GifFrameEncoder encoder(width, height, options, threadPool, [&](std::vector<uint8_t> const& frameBytes)
+            {
+                bytes.insert(bytes.end(), frameBytes.begin(), frameBytes.end());
+            });
+        std::vector<GifFrameRegion> regions;
+        for (size_t i = 0; i < frames.size(); i++)
+        {
+            regions.push_back(CutRegion(bufferPool, frames[i], width, rects[i]));
+            encoder.EncodeFrame(regions, 10);
+        }
+        FinishFile(encoder, bytes);
+        if (statistics != nullptr)
+        {
+            *statistics = encoder.Statistics();
+        }
+        return bytes;
+    }
+
+    // What the GIF shows at each of these times, in milliseconds
+    std::vector<TestFrame> PlayBack(std::vector<uint8_t> const& bytes, uint32_t width, uint32_t height, std::vector<int64_t> const& times)
+    {
+        GifDecoder decoder(bytes);
+        GifCanvas canvas(width, height);
+        GifDecodedFrame decodedFrame;
+        int64_t frameEnd = 0;
+        std::vector<TestFrame> frames;
+        for (auto time : times)
+        {
+            while (time >= frameEnd * 10 && decoder.ReadFrame(decodedFrame))
+            {
+                canvas.DrawFrame(decodedFrame);
+                frameEnd += decodedFrame.Description.Delay;
+            }
+            TestFrame frame;
+            frame.Pixels.assign(canvas.Pixels(), canvas.Pixels() + (canvas.Stride() * height));
+            frame.Time = time;
+            frames.push_back(std::move(frame));
+        }
+        return frames;
+    }
+}
+
+void RunGifFrameEncoderTests(TestRunner& runner)
+{
+    runner.Run("GifFrameEncoder/OnlyTheLastRegionCarriesTheDelay", []()
+        {
+            ThreadPool threadPool(2);
+            FrameBufferPool bufferPool;
+            std::vector<uint8_t> bytes;
+            GifEncoderOptions options = {};
+            GifFrameEncoder encoder(64, 48, options, threadPool, [&](std::vector<uint8_t> const& frameBytes)
+                {
+                    bytes.insert(bytes.end(), frameBytes.begin(), frameBytes.end());
+                });
+
+            // A full first frame, then frames of two and three regions
+            const std::vector<std::vector<DiffRect>> frames =
+            {
+                { DiffRect{ 0, 0, 64, 48 } },
+                { DiffRect{ 0, 0, 8, 8 }, DiffRect{ 56, 40, 64, 48 } },
+                { DiffRect{ 2, 2, 6, 6 }, DiffRect{ 56, 40, 64, 48 } },
+                { DiffRect{ 0, 0, 8, 8 }, DiffRect{ 30, 20, 34, 24 }, DiffRect{ 60, 44, 64, 48 } },
+            };
+            const uint16_t delays[] = { 10, 4, 5, 6 };
+            std::vector<GifFrameRegion> regions;
+            for (size_t i = 0; i < frames.size(); i++)
+            {
+                for (auto&& rect : frames[i])
+                {
+                    regions.push_back(MakeRegion(bufferPool, rect, 0x102030u * static_cast<uint32_t>(i + 1), 0xFFFFFF));
+                }
+                encoder.EncodeFrame(regions, delays[i]);
+                CHECK(regions.empty());
+            }
+            auto decodedFrames = DecodeFrames(FinishFile(encoder, bytes));
+
+            size_t block = 0;
+            for (size_t i = 0; i < frames.size(); i++)
+            {
+                for (size_t j = 0; j < frames[i].size(); j++, block++)
+                {
+                    CHECK(block < decodedFrames.size());
+                    auto&& description = decodedFrames[block].Description;
+                    auto&& rect = frames[i][j];
+                    CHECK_EQUAL(rect.Left, description.Left);
+                    CHECK_EQUAL(rect.Top, description.Top);
+                    CHECK_EQUAL(rect.Right - rect.Left, description.Width);
+                    CHECK_EQUAL(rect.Bottom - rect.Top, description.Height);
+                    auto isLast = j + 1 == frames[i].size();
+                    CHECK_EQUAL(isLast ? delays[i] : 0, description.Delay);
+                }
+            }
+            CHECK_EQUAL(block, decodedFrames.size());
+            CHECK_EQUAL(block, encoder.Statistics().RegionsEncoded);
+        });
+    runner.Run("GifFrameEncoder/SplitsChangesIntoRegions", []()
+        {
+            // A caret and a clock changing in opposite corners, which one
+            // rect would have to span the whole frame to cover
+            const uint32_t width = 256;
+            const uint32_t height = 192;
+            std::vector<TestFrame> frames;
+            frames.push_back(SolidFrame(width, height, 0x336699, 0));
+            for (int64_t i = 1; i < 8; i++)
+            {
+                auto frame = frames.back();
+                frame.Time = i * 100;
+                FillRect(frame, width, 4, 4, 6, 20, i % 2 == 0 ? 0x000000 : 0x336699);
+                FillRect(frame, width, 230, 176, 250, 186, 0x101010u * static_cast<uint32_t>(i));
+                frames.push_back(std::move(frame));
+            }
+
+            GifEncoderOptions options = {};
+            options.MaxRegionsPerFrame = 4;
+            GifEncoderStatistics statistics = {};
+            auto bytes = RecordFrames(frames, width, height, options, &statistics);
+            CheckTimeline(bytes, frames, width, height);
+
+            // The last frame has nothing after it to time it by
+            auto decodedFrames = DecodeFrames(bytes);
+            CHECK_EQUAL(decodedFrames.size(), statistics.RegionsEncoded);
+            CHECK(statistics.RegionsEncoded > statistics.FramesEncoded);
+            size_t zeroDelayCount = 0;
+            for (size_t i = 0; i + 1 < decodedFrames.size(); i++)
+            {
+                zeroDelayCount += decodedFrames[i].Description.Delay == 0 ? 1 : 0;
+            }
+            CHECK_EQUAL(statistics.RegionsEncoded - statistics.FramesEncoded, zeroDelayCount);
+
+            options.MaxRegionsPerFrame = 1;
+            CHECK(bytes.size() < RecordFrames(frames, width, height, options).size());
+        });
+    runner.Run("GifFrameEncoder/PromotesAReusedPalette", []()
+        {
+            ThreadPool threadPool(2);
+            FrameBufferPool bufferPool;
+            std::vector<uint8_t> bytes;
+            GifEncoderOptions options = {};
+            GifFrameEncoder encoder(32, 32, options, threadPool, [&](std::vector<uint8_t> const& frameBytes)
+                {
+                    bytes.insert(bytes.end(), frameBytes.begin(), frameBytes.end());
+                });
+
+            // The same two colors over and over, then a third one
+            const uint32_t frameCount = GifFrameEncoder::PalettePromotionReuseCount + 4;
+            std::vector<GifFrameRegion> regions;
+            for (uint32_t i = 0; i < frameCount; i++)
+            {
+                auto even = i % 2 == 0;
+                regions.push_back(MakeRegion(bufferPool, DiffRect{ 0, 0, 32, 32 }, even ? 0x3366CC : 0xCC6633, even ? 0xCC6633 : 0x3366CC));
+                encoder.EncodeFrame(regions, 10);
+            }
+            regions.push_back(MakeRegion(bufferPool, DiffRect{ 0, 0, 8, 8 }, 0x00FF00, 0x00FF00));
+            encoder.EncodeFrame(regions, 10);
+            auto statistics = encoder.Statistics();
+            FinishFile(encoder, bytes);
+
+            // The frame whose reuse promotes the palette still carries it
+            // as its local table, only the ones after it go without
+            auto decodedFrames = DecodeFrames(bytes);
+            CHECK_EQUAL(static_cast<size_t>(frameCount) + 1, decodedFrames.size());
+            for (uint32_t i = 0; i < frameCount; i++)
+            {
+                auto&& frame = decodedFrames[i];
+                CHECK_EQUAL(i <= GifFrameEncoder::PalettePromotionReuseCount, frame.HasLocalPalette);
+                // Drawn in the right colors either way
+                auto pixel = frame.Palette[frame.Indices[0]];
+                auto expected = i % 2 == 0 ? GifColor{ 0x33, 0x66, 0xCC } : GifColor{ 0xCC, 0x66, 0x33 };
+                CHECK_EQUAL(expected.R, pixel.R);
+                CHECK_EQUAL(expected.G, pixel.G);
+                CHECK_EQUAL(expected.B, pixel.B);
+            }
+            CHECK(decodedFrames.back().HasLocalPalette);
+            CHECK_EQUAL(2u, statistics.ExactPaletteRegions);
+            CHECK_EQUAL(GifFrameEncoder::PalettePromotionReuseCount, statistics.ReusedPaletteRegions);
+            CHECK_EQUAL(frameCount - GifFrameEncoder::PalettePromotionReuseCount - 1, statistics.GlobalPaletteRegions);
+        });
+    runner.Run("GifFrameEncoder/RejectsBadFramesWithoutChangingState", []()
+        {
+            for (auto dropInvisibleChanges : { false, true })
+            {
+                ThreadPool threadPool(2);
+                FrameBufferPool bufferPool;
+                std::vector<uint8_t> bytes;
+                GifEncoderOptions options = {};
+                options.DropInvisibleChanges = dropInvisibleChanges;
+                GifFrameEncoder encoder(32, 32, options, threadPool, [&](std::vector<uint8_t> const& frameBytes)
+                    {
+                        bytes.insert(bytes.end(), frameBytes.begin(), frameBytes.end());
+                    });
+
+                // Nothing to stretch yet
+                std::vector<GifFrameRegion> regions;
+                CHECK_THROWS(std::invalid_argument, encoder.EncodeFrame(regions, 3));
+
+                regions.push_back(MakeRegion(bufferPool, DiffRect{ 0, 0, 32, 32 }, 0x000000, 0x000000));
+                encoder.EncodeFrame(regions, 3);
+
+                // A good region followed by a bad one
+                regions.push_back(MakeRegion(bufferPool, DiffRect{ 0, 0, 8, 8 }, 0xFFFFFF, 0xFFFFFF));
+                auto badRegion = MakeRegion(bufferPool, DiffRect{ 8, 8, 16, 16 }, 0xFF0000, 0xFF0000);
+                badRegion.Rect.Right++;
+                regions.push_back(std::move(badRegion));
+                CHECK_THROWS(std::invalid_argument, encoder.EncodeFrame(regions, 4));
+                CHECK_EQUAL(2u, regions.size());
+                regions.back().Rect = DiffRect{ 24, 24, 40, 40 };
+                CHECK_THROWS(std::invalid_argument, encoder.EncodeFrame(regions, 4));
+                regions.clear();
+
+                // The white square never reached the canvas, so this one
+                // can't be written as transparent
+                regions.push_back(MakeRegion(bufferPool, DiffRect{ 0, 0, 8, 8 }, 0xFFFFFF, 0xFFFFFF));
+                encoder.EncodeFrame(regions, 5);
+                if (dropInvisibleChanges)
+                {
+                    // Stretches the frame being held back
+                    encoder.EncodeFrame(regions, 6);
+                }
+                auto decodedFrames = DecodeFrames(FinishFile(encoder, bytes));
+                CHECK_EQUAL(2u, decodedFrames.size());
+                CHECK_EQUAL(3, decodedFrames[0].Description.Delay);
+                CHECK_EQUAL(dropInvisibleChanges ? 11 : 5, decodedFrames[1].Description.Delay);
+                CHECK(!decodedFrames[1].Description.TransparentIndex.has_value());
+            }
+        });
+    runner.Run("GifFrameEncoder/DropsChangesThatDontShow", []()
+        {
+            // A gradient with far more colors than the palette, where
+            // nudging a channel within the same 6-6-6 cell flickers the
+            // pixels without changing their palette entry
+            const uint32_t width = 64;
+            const uint32_t height = 48;
+            auto nudge = [&](TestFrame& frame, uint32_t left, uint32_t top, uint32_t right, uint32_t bottom)
+            {
+                for (auto y = top; y < bottom; y++)
+                {
+                    for (auto x = left; x < right; x++)
+                    {
+                        frame.Pixels[(((static_cast<size_t>(y) * width) + x) * 4)] = 130;
+                    }
+                }
+            };
+            std::vector<TestFrame> frames;
+            frames.push_back(SolidFrame(width, height, 0, 0));
+            for (uint32_t y = 0; y < height; y++)
+            {
+                for (uint32_t x = 0; x < width; x++)
+                {
+                    FillRect(frames[0], width, x, y, x + 1, y + 1, (((x * 4) + 1) << 16) | (((y * 4) + 1) << 8) | 129);
+                }
+            }
+            std::vector<DiffRect> rects = { DiffRect{ 0, 0, width, height } };
+
+            // Nothing but flicker
+            frames.push_back(frames.back());
+            nudge(frames.back(), 8, 8, 24, 24);
+            rects.push_back(DiffRect{ 8, 8, 24, 24 });
+            // Flicker around a square that does show
+            frames.push_back(frames.back());
+            nudge(frames.back(), 0, 0, 32, 32);
+            FillRect(frames.back(), width, 20, 4, 28, 12, 0x000000);
+            rects.push_back(DiffRect{ 0, 0, 32, 32 });
+            // And one more to take the held frame's place
+            frames.push_back(frames.back());
+            FillRect(frames.back(), width, 40, 30, 48, 38, 0xFFFFFF);
+            rects.push_back(DiffRect{ 40, 30, 48, 38 });
+            for (size_t i = 0; i < frames.size(); i++)
+            {
+                frames[i].Time = static_cast<int64_t>(i) * 100;
+            }
+
+            // Always map onto the first frame's palette, so the square
+            // doesn't bring a new one along
+            GifEncoderOptions options = {};
+            options.PaletteReuseMaxError = 1000.0;
+            options.UseGlobalPalette = false;
+            auto allBytes = EncodeFrames(frames, rects, width, height, options);
+            CHECK_EQUAL(frames.size(), DecodeFrames(allBytes).size());
+
+            options.DropInvisibleChanges = true;
+            GifEncoderStatistics statistics = {};
+            auto bytes = EncodeFrames(frames, rects, width, height, options, &statistics);
+            CHECK_EQUAL(1u, statistics.InvisibleFrames);
+            auto decodedFrames = DecodeFrames(bytes);
+            CHECK_EQUAL(3u, decodedFrames.size());
+            // The first frame stays up for the flicker's delay too
+            CHECK_EQUAL(20, decodedFrames[0].Description.Delay);
+            // Only the square is left of the second region
+            auto&& square = decodedFrames[1].Description;
+            CHECK_EQUAL(20, square.Left);
+            CHECK_EQUAL(4, square.Top);
+            CHECK_EQUAL(8, square.Width);
+            CHECK_EQUAL(8, square.Height);
+            CHECK_EQUAL(10, square.Delay);
+            CHECK_EQUAL(10, decodedFrames[2].Description.Delay);
+
+            // Plays back the same as writing every change
+            std::vector<int64_t> times;
+            for (auto&& frame : frames)
+            {
+                times.push_back(frame.Time);
+            }
+            CheckTimeline(bytes, PlayBack(allBytes, width, height, times), width, height);
+        });
+}
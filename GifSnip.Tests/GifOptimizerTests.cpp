@@ -0,0 +1,148 @@
+#include "Test.h"
+#include "TestGifs.h"
+#include "GifDecoder.h"
+#include "GifOptimizer.h"
+#include "GifWriter.h"
+#include <filesystem>
+#include <fstream>
+#include <optional>
+
+namespace
+{
+    // Writes every frame whole with a table of its own, the way naive
+    // encoders do, and returns what each frame shows
+    std::vector<TestFrame> WriteBloatedGif(
+        std::filesystem::path const& path,
+        uint16_t width,
+        uint16_t height,
+        std::optional<uint16_t> loopCount = 0)
+    {
+        const std::vector<GifColor> palette = { { 240, 240, 240 }, { 32, 80, 160 }, { 200, 40, 30 }, { 20, 20, 20 } };
+        GifWriter writer(width, height, {}, loopCount);
+        std::vector<TestFrame> frames;
+        std::vector<uint8_t> indices(static_cast<size_t>(width) * height);
+        for (int64_t i = 0; i < 12; i++)
+        {
+            // A bar across the top and a square that moves, but stands
+            // still every third frame
+            auto left = static_cast<uint32_t>((i - (i / 3)) * 3);
+            for (uint32_t y = 0; y < height; y++)
+            {
+                for (uint32_t x = 0; x < width; x++)
+                {
+                    uint8_t index = y < 6 ? 1 : 0;
+                    if (x >= left && x < left + 8 && y >= 12 && y < 20)
+                    {
+                        index = (x + y) % 2 == 0 ? 2 : 3;
+                    }
+                    indices[(static_cast<size_t>(y) * width) + x] = index;
+                }
+            }
+
+            GifFrameDescription description = {};
+            description.Width = width;
+            description.Height = height;
+            description.Delay = 10;
+            writer.WriteFrame(description, palette, indices.data());
+
+            TestFrame frame;
+            frame.Time = i * 100;
+            frame.Pixels.resize(indices.size() * 4);
+            for (size_t p = 0; p < indices.size(); p++)
+            {
+                auto&& color = palette[indices[p]];
+                frame.Pixels[(p * 4) + 0] = color.B;
+                frame.Pixels[(p * 4) + 1] = color.G;
+                frame.Pixels[(p * 4) + 2] = color.R;
+                frame.Pixels[(p * 4) + 3] = 0xFF;
+            }
+            frames.push_back(std::move(frame));
+        }
+        writer.WriteTrailer();
+
+        std::vector<uint8_t> bytes;
+        writer.TakeOutput(bytes);
+        std::ofstream file(path, std::ios::binary);
+        file.write(reinterpret_cast<char const*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+        CHECK(file.good());
+        return frames;
+    }
+
+    std::vector<uint8_t> ReadFile(std::filesystem::path const& path)
+    {
+        std::ifstream file(path, std::ios::binary);
+        CHECK(file.is_open());
+        return std::vector<uint8_t>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+}
+
+void RunGifOptimizerTests(TestRunner& runner)
+{
+    runner.Run("GifOptimizer/ShrinksBloatedGifWithTheSameTimeline", []()
+        {
+            auto directory = std::filesystem::temp_directory_path() / "GifSnip.Tests.Optimizer";
+            std::filesystem::remove_all(directory);
+            std::filesystem::create_directories(directory);
+            auto input = directory / "Bloated.gif";
+            auto output = directory / "Optimized.gif";
+            auto frames = WriteBloatedGif(input, 64, 40);
+            auto inputBytes = ReadFile(input);
+            CheckTimeline(inputBytes, frames, 64, 40);
+
+            GifOptimizer optimizer(GifOptimizer::OfflineOptions({}), 1);
+            auto result = optimizer.Optimize(input, output);
+            auto outputBytes = ReadFile(output);
+            CHECK(!result.KeptOriginal);
+            CHECK_EQUAL(inputBytes.size(), result.InputBytes);
+            CHECK_EQUAL(outputBytes.size(), result.OutputBytes);
+            CHECK(outputBytes.size() < inputBytes.size());
+            CheckTimeline(outputBytes, frames, 64, 40);
+
+            // The frames that stood still were merged into the ones before
+            CHECK_EQUAL(12u, result.FramesRead);
+            CHECK_EQUAL(3u, result.MergedFrames);
+            std::filesystem::remove_all(directory);
+        });
+
+    runner.Run("GifOptimizer/KeepsTheLoopCount", []()
+        {
+            auto directory = std::filesystem::temp_directory_path() / "GifSnip.Tests.Loop";
+            std::filesystem::remove_all(directory);
+            std::filesystem::create_directories(directory);
+            auto input = directory / "Bloated.gif";
+            auto output = directory / "Optimized.gif";
+            GifOptimizer optimizer(GifOptimizer::OfflineOptions({}), 1);
+
+            // Without a looping extension the GIF plays once, and adding
+            // one would make it loop forever
+            for (auto loopCount : { std::optional<uint16_t>(), std::optional<uint16_t>(0), std::optional<uint16_t>(3) })
+            {
+                WriteBloatedGif(input, 64, 40, loopCount);
+                CHECK(GifDecoder(input).LoopCount() == loopCount);
+                auto result = optimizer.Optimize(input, output);
+                CHECK(!result.KeptOriginal);
+                CHECK(GifDecoder(output).LoopCount() == loopCount);
+            }
+            std::filesystem::remove_all(directory);
+        });
+
+    runner.Run("GifOptimizer/ListsGifsUnderADirectory", []()
+        {
+            auto directory = std::filesystem::temp_directory_path() / "GifSnip.Tests.List";
+            std::filesystem::remove_all(directory);
+            std::filesystem::create_directories(directory / "In" / "Nested");
+            for (auto name : { "In/A.gif", "In/Nested/B.GIF", "In/Notes.txt" })
+            {
+                std::ofstream(directory / name).put('x');
+            }
+
+            auto files = GifOptimizer::ListFiles(directory / "In", directory / "Out");
+            CHECK_EQUAL(2u, files.size());
+            CHECK(files[0].first == directory / "In" / "A.gif");
+            CHECK(files[0].second == directory / "Out" / "A.gif");
+            CHECK(files[1].first == directory / "In" / "Nested" / "B.GIF");
+            CHECK(files[1].second == directory / "Out" / "Nested" / "B.GIF");
+            CHECK(std::filesystem::is_directory(directory / "Out" / "Nested"));
+            std::filesystem::remove_all(directory);
+        });
+}
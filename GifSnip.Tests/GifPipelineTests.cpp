@@ -0,0 +1,100 @@
+#include "Test.h"
+#include "TestGifs.h"
+#include <cstdio>
+#include <filesystem>
+#include <random>
+
+namespace
+{
+    // A directory of its own under the temporary one, so that test runs
+    // side by side don't share files, removed with whatever is left in
+    // it even when a check fails
+    struct TemporaryDirectory
+    {
+        std::filesystem::path Path;
+
+        TemporaryDirectory(char const* name)
+        {
+            std::random_device random;
+            auto suffix = (static_cast<uint64_t>(random()) << 32) | random();
+            char hex[17] = {};
+            snprintf(hex, sizeof(hex), "%016llx", static_cast<unsigned long long>(suffix));
+            Path = std::filesystem::temp_directory_path() / (std::string(name) + "." + hex);
+            std::filesystem::create_directories(Path);
+        }
+        ~TemporaryDirectory()
+        {
+            std::error_code error;
+            std::filesystem::remove_all(Path, error);
+        }
+
+        TemporaryDirectory(TemporaryDirectory const&) = delete;
+        TemporaryDirectory& operator=(TemporaryDirectory const&) = delete;
+    };
+}
+
+void RunGifPipelineTests(TestRunner& runner)
+{
+    runner.Run("GifPipeline/RecordingPaletteKeepsTheSmallerFile", []()
+        {
+            // A few colors that stay on screen the whole time, so one
+            // palette fits the whole recording
+            const uint32_t width = 96;
+            const uint32_t height = 64;
+            std::vector<TestFrame> frames;
+            frames.push_back(SolidFrame(width, height, 0xF0F0F0, 0));
+            FillRect(frames.back(), width, 0, 0, width, 8, 0x2050A0);
+            for (int64_t i = 1; i < 12; i++)
+            {
+                auto frame = frames.back();
+                frame.Time = i * 100;
+                auto left = static_cast<uint32_t>(i * 7);
+                FillRect(frame, width, left, 20, left + 6, 40, i % 3 == 0 ? 0xC03020 : 0x303030);
+                frames.push_back(std::move(frame));
+            }
+
+            TemporaryDirectory directory("GifSnip.Tests.Pipeline");
+            auto spoolFile = directory.Path / "Recording.spool";
+            GifEncoderOptions options = {};
+            options.UseGlobalPalette = true;
+            options.UseRecordingPalette = true;
+            options.SpoolFile = spoolFile;
+            GifEncoderStatistics statistics = {};
+            auto bytes = RecordFrames(frames, width, height, options, &statistics);
+            CheckTimeline(bytes, frames, width, height);
+
+            CHECK(statistics.LocalPaletteBytes > 0);
+            CHECK(statistics.RecordingPaletteBytes > 0);
+            CHECK_EQUAL(std::min(statistics.LocalPaletteBytes, statistics.RecordingPaletteBytes), bytes.size());
+
+            // Neither the spool nor the files encoded next to it are left
+            CHECK(std::filesystem::is_empty(directory.Path));
+        });
+
+    runner.Run("GifPipeline/DelaysDontDrift", []()
+        {
+            // Every other frame of a 60Hz source, which is 33.3ms apart
+            const uint32_t width = 64;
+            const uint32_t height = 48;
+            std::vector<TestFrame> frames;
+            for (int64_t i = 0; i <= 30; i++)
+            {
+                frames.push_back(SolidFrame(width, height, i % 2 == 0 ? 0x204060 : 0x604020, ((i * 1000) + 15) / 30));
+            }
+            GifEncoderOptions options = {};
+            auto bytes = RecordFrames(frames, width, height, options);
+            CheckTimeline(bytes, frames, width, height);
+
+            // Rounding each delay on its own would make them all 30ms
+            auto decodedFrames = DecodeFrames(bytes);
+            CHECK(decodedFrames.size() >= frames.size());
+            int64_t elapsed = 0;
+            for (size_t i = 0; i + 1 < frames.size(); i++)
+            {
+                auto delay = decodedFrames[i].Description.Delay;
+                CHECK(delay == 3 || delay == 4);
+                elapsed += delay;
+            }
+            CHECK_EQUAL(100, elapsed);
+        });
+}
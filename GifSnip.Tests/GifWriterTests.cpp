@@ -0,0 +1,284 @@
+#include "Test.h"
+#include "GifDecoder.h"
+#include "GifWriter.h"
+#include <cstring>
+#include <utility>
+
+namespace
+{
+    std::vector<uint8_t> Finish(GifWriter& writer)
+    {
+        writer.WriteTrailer();
+        std::vector<uint8_t> bytes;
+        writer.TakeOutput(bytes);
+        return bytes;
+    }
+
+    std::vector<uint8_t> Gradient(uint16_t width, uint16_t height, uint32_t colorCount)
+    {
+        std::vector<uint8_t> indices(static_cast<size_t>(width) * height);
+        for (size_t i = 0; i < indices.size(); i++)
+        {
+            indices[i] = static_cast<uint8_t>((i / 3) % colorCount);
+        }
+        return indices;
+    }
+
+    std::vector<GifColor> Palette(uint32_t colorCount, uint8_t seed)
+    {
+        std::vector<GifColor> palette(colorCount);
+        for (uint32_t i = 0; i < colorCount; i++)
+        {
+            palette[i] = GifColor{ static_cast<uint8_t>(i * 7 + seed), static_cast<uint8_t>(i * 13), static_cast<uint8_t>(255 - i) };
+        }
+        return palette;
+    }
+
+    // Tables are padded with black up to a power of two
+    void CheckPalette(std::vector<GifColor> const& expected, std::vector<GifColor> const& actual)
+    {
+        CHECK_EQUAL(static_cast<size_t>(1) << GifWriter::ColorTableBits(expected.size()), actual.size());
+        for (size_t i = 0; i < actual.size(); i++)
+        {
+            auto color = i < expected.size() ? expected[i] : GifColor{ 0, 0, 0 };
+            CHECK_EQUAL(color.R, actual[i].R);
+            CHECK_EQUAL(color.G, actual[i].G);
+            CHECK_EQUAL(color.B, actual[i].B);
+        }
+    }
+
+    GifFrameDescription Describe(uint16_t left, uint16_t top, uint16_t width, uint16_t height)
+    {
+        GifFrameDescription description = {};
+        description.Left = left;
+        description.Top = top;
+        description.Width = width;
+        description.Height = height;
+        return description;
+    }
+}
+
+void RunGifWriterTests(TestRunner& runner)
+{
+    runner.Run("GifWriter/HeaderAndLogicalScreen", []()
+        {
+            auto palette = Palette(5, 1);
+            GifWriter writer(300, 200, palette);
+            writer.WriteFrame(Describe(0, 0, 300, 200), {}, Gradient(300, 200, 5).data());
+            auto bytes = Finish(writer);
+
+            CHECK(memcmp(bytes.data(), "GIF89a", 6) == 0);
+            CHECK_EQUAL(300, bytes[6] | (bytes[7] << 8));
+            CHECK_EQUAL(200, bytes[8] | (bytes[9] << 8));
+            // Global table, 8 bits of color resolution, 2^3 entries
+            CHECK_EQUAL(0xF2, bytes[10]);
+            CHECK_EQUAL(0, bytes[11]);
+            CHECK_EQUAL(0, bytes[12]);
+            CHECK_EQUAL(0x3B, bytes.back());
+
+            GifDecoder decoder(bytes);
+            CHECK_EQUAL(300, decoder.Width());
+            CHECK_EQUAL(200, decoder.Height());
+            CheckPalette(palette, decoder.GlobalPalette());
+        });
+
+    runner.Run("GifWriter/NoGlobalColorTable", []()
+        {
+            GifWriter writer(16, 16);
+            CHECK_THROWS(std::invalid_argument, writer.WriteFrame(Describe(0, 0, 16, 16), {}, Gradient(16, 16, 2).data()));
+            auto palette = Palette(2, 3);
+            writer.WriteFrame(Describe(0, 0, 16, 16), palette, Gradient(16, 16, 2).data());
+            auto bytes = Finish(writer);
+            CHECK_EQUAL(0, bytes[10]);
+
+            GifDecoder decoder(bytes);
+            CHECK(decoder.GlobalPalette().empty());
+            GifDecodedFrame frame;
+            CHECK(decoder.ReadFrame(frame));
+            CHECK(frame.HasLocalPalette);
+            CheckPalette(palette, frame.Palette);
+        });
+
+    runner.Run("GifWriter/GlobalAndLocalColorTables", []()
+        {
+            auto globalPalette = Palette(4, 0);
+            auto localPalette = Palette(3, 100);
+            auto fullPalette = Palette(256, 50);
+            GifWriter writer(64, 48, globalPalette);
+            auto first = Gradient(64, 48, 4);
+            auto second = Gradient(10, 20, 3);
+            auto third = Gradient(64, 48, 256);
+            writer.WriteFrame(Describe(0, 0, 64, 48), {}, first.data());
+            writer.WriteFrame(Describe(30, 12, 10, 20), localPalette, second.data());
+            writer.WriteFrame(Describe(0, 0, 64, 48), fullPalette, third.data());
+            auto bytes = Finish(writer);
+
+            GifDecoder decoder(bytes);
+            GifDecodedFrame frame;
+            CHECK(decoder.ReadFrame(frame));
+            CHECK(!frame.HasLocalPalette);
+            CheckPalette(globalPalette, frame.Palette);
+            CHECK(frame.Indices == first);
+
+            CHECK(decoder.ReadFrame(frame));
+            CHECK(frame.HasLocalPalette);
+            CheckPalette(localPalette, frame.Palette);
+            CHECK_EQUAL(30, frame.Description.Left);
+            CHECK_EQUAL(12, frame.Description.Top);
+            CHECK_EQUAL(10, frame.Description.Width);
+            CHECK_EQUAL(20, frame.Description.Height);
+            CHECK(frame.Indices == second);
+
+            CHECK(decoder.ReadFrame(frame));
+            CHECK(frame.HasLocalPalette);
+            CheckPalette(fullPalette, frame.Palette);
+            CHECK(frame.Indices == third);
+            CHECK(!decoder.ReadFrame(frame));
+        });
+
+    runner.Run("GifWriter/GraphicControlExtension", []()
+        {
+            auto palette = Palette(4, 0);
+            GifWriter writer(8, 8, palette);
+            auto indices = Gradient(8, 8, 4);
+
+            const GifDisposalMethod disposals[] = { GifDisposalMethod::DoNotDispose, GifDisposalMethod::RestoreToBackground, GifDisposalMethod::Unspecified };
+            const uint16_t delays[] = { 0, 7, UINT16_MAX };
+            const std::optional<uint8_t> transparentIndices[] = { std::nullopt, 3, 0 };
+            for (size_t i = 0; i < 3; i++)
+            {
+                auto description = Describe(0, 0, 8, 8);
+                description.Disposal = disposals[i];
+                description.Delay = delays[i];
+                description.TransparentIndex = transparentIndices[i];
+                writer.WriteFrame(description, {}, indices.data());
+            }
+            auto bytes = Finish(writer);
+
+            GifDecoder decoder(bytes);
+            GifDecodedFrame frame;
+            for (size_t i = 0; i < 3; i++)
+            {
+                CHECK(decoder.ReadFrame(frame));
+                CHECK(frame.Description.Disposal == disposals[i]);
+                CHECK_EQUAL(delays[i], frame.Description.Delay);
+                CHECK(frame.Description.TransparentIndex == transparentIndices[i]);
+            }
+        });
+
+    runner.Run("GifWriter/TransparentPixelsKeepWhatsShown", []()
+        {
+            auto palette = Palette(4, 0);
+            GifWriter writer(4, 1, palette);
+            const uint8_t first[] = { 0, 1, 2, 3 };
+            const uint8_t second[] = { 3, 3, 1, 3 };
+            writer.WriteFrame(Describe(0, 0, 4, 1), {}, first);
+            auto description = Describe(0, 0, 4, 1);
+            description.TransparentIndex = 3;
+            writer.WriteFrame(description, {}, second);
+            auto bytes = Finish(writer);
+
+            GifDecoder decoder(bytes);
+            GifCanvas canvas(4, 1);
+            GifDecodedFrame frame;
+            while (decoder.ReadFrame(frame))
+            {
+                canvas.DrawFrame(frame);
+            }
+            const uint8_t expected[] = { 0, 1, 1, 3 };
+            for (uint32_t x = 0; x < 4; x++)
+            {
+                auto pixel = canvas.Pixels() + (x * 4);
+                auto color = palette[expected[x]];
+                CHECK_EQUAL(color.B, pixel[0]);
+                CHECK_EQUAL(color.G, pixel[1]);
+                CHECK_EQUAL(color.R, pixel[2]);
+                CHECK_EQUAL(255, pixel[3]);
+            }
+        });
+
+    runner.Run("GifWriter/NetscapeLoopingBlock", []()
+        {
+            for (uint16_t loopCount : { 0, 1, 42, UINT16_MAX })
+            {
+                GifWriter writer(2, 2, Palette(2, 0), loopCount);
+                auto bytes = Finish(writer);
+
+                // Right after the global color table
+                const uint8_t expected[] = { 0x21, 0xFF, 11, 'N', 'E', 'T', 'S', 'C', 'A', 'P', 'E', '2', '.', '0', 3, 1,
+                    static_cast<uint8_t>(loopCount & 0xFF), static_cast<uint8_t>(loopCount >> 8), 0 };
+                CHECK(bytes.size() >= 19 + sizeof(expected));
+                CHECK(memcmp(bytes.data() + 19, expected, sizeof(expected)) == 0);
+
+                // Known before the first frame is read
+                GifDecoder decoder(bytes);
+                CHECK(decoder.LoopCount().has_value());
+                CHECK_EQUAL(loopCount, decoder.LoopCount().value());
+                GifDecodedFrame frame;
+                CHECK(!decoder.ReadFrame(frame));
+                CHECK_EQUAL(loopCount, decoder.LoopCount().value());
+            }
+
+            // Without a loop count the trailer follows the color table
+            GifWriter writer(2, 2, Palette(2, 0), std::nullopt);
+            auto bytes = Finish(writer);
+            CHECK_EQUAL(20u, bytes.size());
+            CHECK_EQUAL(0x3B, bytes[19]);
+            GifDecoder decoder(bytes);
+            CHECK(!decoder.LoopCount().has_value());
+        });
+
+    runner.Run("GifWriter/EncodedFramesMatchWrittenFrames", []()
+        {
+            auto palette = Palette(16, 0);
+            auto localPalette = Palette(7, 9);
+            auto indices = Gradient(40, 30, 7);
+            auto description = Describe(5, 5, 40, 30);
+            description.Delay = 3;
+
+            GifWriter written(64, 64, palette);
+            written.WriteFrame(description, {}, indices.data());
+            written.WriteFrame(description, localPalette, indices.data());
+
+            GifWriter encoded(64, 64, palette);
+            LzwEncoder lzwEncoder;
+            std::vector<uint8_t> frameBytes;
+            encoded.EncodeFrame(description, {}, indices.data(), lzwEncoder, frameBytes);
+            encoded.EncodeFrame(description, localPalette, indices.data(), lzwEncoder, frameBytes);
+            encoded.WriteEncodedFrame(frameBytes.data(), frameBytes.size());
+
+            CHECK(Finish(written) == Finish(encoded));
+            CHECK_EQUAL(written.TotalBytesWritten(), encoded.TotalBytesWritten());
+        });
+
+    runner.Run("GifWriter/PatchedGlobalColorTable", []()
+        {
+            // Reserved with placeholders, then filled in once known
+            GifWriter writer(8, 8, std::vector<GifColor>(16, GifColor{ 0, 0, 0 }));
+            writer.WriteFrame(Describe(0, 0, 8, 8), {}, Gradient(8, 8, 10).data());
+            auto bytes = Finish(writer);
+            auto palette = Palette(10, 20);
+            auto tableBytes = writer.GlobalColorTableBytes(palette);
+            CHECK_EQUAL(static_cast<size_t>(16 * 3), tableBytes.size());
+            std::copy(tableBytes.begin(), tableBytes.end(), bytes.begin() + GifWriter::GlobalColorTableOffset);
+
+            GifDecoder decoder(bytes);
+            CheckPalette(palette, decoder.GlobalPalette());
+            CHECK_THROWS(std::invalid_argument, writer.GlobalColorTableBytes(Palette(17, 0)));
+            GifWriter withoutTable(8, 8);
+            CHECK_THROWS(std::logic_error, withoutTable.GlobalColorTableBytes(palette));
+        });
+
+    runner.Run("GifWriter/RejectsInvalidFrames", []()
+        {
+            CHECK_THROWS(std::invalid_argument, GifWriter(8, 8, Palette(257, 0)));
+
+            GifWriter writer(8, 8, Palette(4, 0));
+            auto indices = Gradient(8, 8, 4);
+            CHECK_THROWS(std::invalid_argument, writer.WriteFrame(Describe(0, 0, 8, 8), Palette(257, 0), indices.data()));
+            CHECK_THROWS(std::invalid_argument, writer.WriteFrame(Describe(1, 0, 8, 8), {}, indices.data()));
+            CHECK_THROWS(std::invalid_argument, writer.WriteFrame(Describe(0, 0, 0, 8), {}, indices.data()));
+            writer.WriteTrailer();
+            CHECK_THROWS(std::logic_error, writer.WriteFrame(Describe(0, 0, 8, 8), {}, indices.data()));
+        });
+}
@@ -0,0 +1,301 @@
+#include "Test.h"
+#include "GifDecoder.h"
+#include "LzwEncoder.h"
+#include <algorithm>
+#include <random>
+#include <utility>
+
+namespace
+{
+    constexpr uint32_t MaxCodeSize = 12;
+    constexpr uint32_t MaxCodes = 1u << MaxCodeSize;
+
+    std::vector<uint8_t> RandomIndices(size_t count, uint8_t minimumCodeSize, uint32_t seed)
+    {
+        std::mt19937 random(seed);
+        std::uniform_int_distribution<uint32_t> distribution(0, (1u << minimumCodeSize) - 1);
+        std::vector<uint8_t> indices(count);
+        for (auto&& index : indices)
+        {
+            index = static_cast<uint8_t>(distribution(random));
+        }
+        return indices;
+    }
+
+    // Wraps the encoder's output in the smallest GIF that shows it as a
+    // single frame, so it can be read back by GifDecoder
+    std::vector<uint8_t> DecodeLzw(uint8_t minimumCodeSize, std::vector<uint8_t> const& data, uint16_t width, uint16_t height)
+    {
+        std::vector<uint8_t> bytes = { 'G', 'I', 'F', '8', '9', 'a' };
+        auto writeUInt16 = [&bytes](uint16_t value)
+        {
+            bytes.push_back(static_cast<uint8_t>(value & 0xFF));
+            bytes.push_back(static_cast<uint8_t>(value >> 8));
+        };
+        writeUInt16(width);
+        writeUInt16(height);
+        bytes.push_back(static_cast<uint8_t>(0x80 | 0x70 | (minimumCodeSize - 1)));
+        bytes.push_back(0);
+        bytes.push_back(0);
+        bytes.resize(bytes.size() + ((static_cast<size_t>(1) << minimumCodeSize) * 3), 0);
+        bytes.push_back(0x2C);
+        writeUInt16(0);
+        writeUInt16(0);
+        writeUInt16(width);
+        writeUInt16(height);
+        bytes.push_back(0);
+        bytes.insert(bytes.end(), data.begin(), data.end());
+        bytes.push_back(0x3B);
+
+        GifDecoder decoder(std::move(bytes));
+        GifDecodedFrame frame;
+        CHECK(decoder.ReadFrame(frame));
+        CHECK(!decoder.ReadFrame(frame));
+        return frame.Indices;
+    }
+
+    void CheckRoundTrip(LzwResetPolicy policy, uint8_t minimumCodeSize, std::vector<uint8_t> const& indices, uint16_t width, uint16_t height)
+    {
+        LzwEncoder encoder(policy);
+        std::vector<uint8_t> data;
+        encoder.Encode(minimumCodeSize, indices.data(), indices.size(), data);
+        CHECK(DecodeLzw(minimumCodeSize, data, width, height) == indices);
+    }
+
+    void CheckRoundTrip(LzwResetPolicy policy, uint8_t minimumCodeSize, std::vector<uint8_t> const& indices)
+    {
+        CheckRoundTrip(policy, minimumCodeSize, indices, static_cast<uint16_t>(indices.size()), 1);
+    }
+
+    // The codes in an encoder's output and how wide each one was,
+    // tracked the same way a decoder would
+    struct CodeStream
+    {
+        std::vector<uint32_t> Codes;
+        std::vector<uint32_t> Widths;
+    };
+
+    CodeStream ReadCodes(std::vector<uint8_t> const& data)
+    {
+        auto minimumCodeSize = data[0];
+        std::vector<uint8_t> bytes;
+        size_t position = 1;
+        while (data[position] != 0)
+        {
+            auto size = data[position];
+            bytes.insert(bytes.end(), data.begin() + position + 1, data.begin() + position + 1 + size);
+            position += size + 1;
+        }
+        CHECK_EQUAL(data.size() - 1, position);
+
+        auto clearCode = 1u << minimumCodeSize;
+        auto endCode = clearCode + 1;
+        uint32_t codeSize = minimumCodeSize + 1;
+        auto nextCode = endCode + 1;
+        auto afterClear = true;
+        CodeStream stream;
+        uint64_t bitPosition = 0;
+        while (true)
+        {
+            CHECK(bitPosition + codeSize <= bytes.size() * 8);
+            uint32_t code = 0;
+            for (uint32_t bit = 0; bit < codeSize; bit++, bitPosition++)
+            {
+                code |= ((bytes[bitPosition / 8] >> (bitPosition % 8)) & 1u) << bit;
+            }
+            stream.Codes.push_back(code);
+            stream.Widths.push_back(codeSize);
+            if (code == clearCode)
+            {
+                codeSize = minimumCodeSize + 1;
+                nextCode = endCode + 1;
+                afterClear = true;
+                continue;
+            }
+            if (code == endCode)
+            {
+                break;
+            }
+            // Every code but the first after a clear adds an entry
+            if (!afterClear && nextCode < MaxCodes)
+            {
+                nextCode++;
+                if (nextCode == (1u << codeSize) && codeSize < MaxCodeSize)
+                {
+                    codeSize++;
+                }
+            }
+            afterClear = false;
+        }
+        // Whatever is left over only pads the last byte
+        CHECK(bytes.size() * 8 - bitPosition < 8);
+        return stream;
+    }
+
+    // The shortest prefix of the indices whose code stream matches. Longer
+    // prefixes always match as well.
+    size_t ShortestPrefix(LzwResetPolicy policy, uint8_t minimumCodeSize, std::vector<uint8_t> const& indices, std::function<bool(CodeStream const&)> const& matches)
+    {
+        LzwEncoder encoder(policy);
+        std::vector<uint8_t> data;
+        auto prefixMatches = [&](size_t count)
+        {
+            data.clear();
+            encoder.Encode(minimumCodeSize, indices.data(), count, data);
+            return matches(ReadCodes(data));
+        };
+        CHECK(prefixMatches(indices.size()));
+
+        size_t low = 1;
+        auto high = indices.size();
+        while (low < high)
+        {
+            auto middle = low + ((high - low) / 2);
+            if (prefixMatches(middle))
+            {
+                high = middle;
+            }
+            else
+            {
+                low = middle + 1;
+            }
+        }
+        return low;
+    }
+}
+
+void RunLzwEncoderTests(TestRunner& runner)
+{
+    const std::pair<LzwResetPolicy, char const*> policies[] = { { LzwResetPolicy::WhenFull, "WhenFull" }, { LzwResetPolicy::Adaptive, "Adaptive" } };
+
+    for (auto&& [policy, policyName] : policies)
+    {
+        auto prefix = std::string("LzwEncoder/") + policyName + "/";
+
+        runner.Run(prefix + "RoundTripsEveryMinimumCodeSize", [policy = policy]()
+            {
+                for (uint8_t minimumCodeSize = 2; minimumCodeSize <= 8; minimumCodeSize++)
+                {
+                    // Long enough for the table to fill several times over
+                    for (size_t count : { 1, 2, 3, 255, 4096, 65535 })
+                    {
+                        CheckRoundTrip(policy, minimumCodeSize, RandomIndices(count, minimumCodeSize, minimumCodeSize));
+                    }
+                }
+            });
+
+        runner.Run(prefix + "RoundTripsRunsAcrossRows", [policy = policy]()
+            {
+                // Long runs make long strings, and a table that stays
+                // useful after it fills
+                const uint16_t width = 1920;
+                const uint16_t height = 64;
+                std::mt19937 random(7);
+                std::vector<uint8_t> indices(static_cast<size_t>(width) * height);
+                size_t i = 0;
+                while (i < indices.size())
+                {
+                    auto run = std::min<size_t>(1 + (random() % 300), indices.size() - i);
+                    std::fill_n(indices.begin() + i, run, static_cast<uint8_t>(random() % 16));
+                    i += run;
+                }
+                CheckRoundTrip(policy, 4, indices, width, height);
+            });
+
+        runner.Run(prefix + "RoundTripsAroundEveryCodeSizeChange", [policy = policy]()
+            {
+                // The encoder widens its codes one entry before the
+                // decoder does. Streams that end right where that
+                // happens have to agree on the width of their last codes.
+                for (uint8_t minimumCodeSize : { 2, 5, 8 })
+                {
+                    auto indices = RandomIndices(65535, minimumCodeSize, 11);
+                    for (uint32_t width = minimumCodeSize + 2u; width <= MaxCodeSize; width++)
+                    {
+                        auto count = ShortestPrefix(policy, minimumCodeSize, indices, [width](CodeStream const& stream)
+                            {
+                                return *std::max_element(stream.Widths.begin(), stream.Widths.end()) >= width;
+                            });
+                        for (auto length = std::max<size_t>(count, 3) - 2; length <= count + 2; length++)
+                        {
+                            CheckRoundTrip(policy, minimumCodeSize, std::vector<uint8_t>(indices.begin(), indices.begin() + length));
+                        }
+                    }
+                }
+            });
+    }
+
+    runner.Run("LzwEncoder/WhenFull/ClearsOnceCode4095IsAssigned", []()
+        {
+            for (uint8_t minimumCodeSize : { 2, 8 })
+            {
+                auto indices = RandomIndices(65535, minimumCodeSize, 3);
+                LzwEncoder encoder(LzwResetPolicy::WhenFull);
+                std::vector<uint8_t> data;
+                encoder.Encode(minimumCodeSize, indices.data(), indices.size(), data);
+                auto stream = ReadCodes(data);
+
+                // One code per entry from the first free one up to 4095,
+                // the code that made the last entry, then a 12-bit clear
+                auto clearCode = 1u << minimumCodeSize;
+                auto codesPerTable = static_cast<size_t>(MaxCodes - (clearCode + 2) + 1);
+                size_t segmentStart = 1;
+                size_t fullSegments = 0;
+                for (size_t i = 1; i < stream.Codes.size(); i++)
+                {
+                    if (stream.Codes[i] == clearCode)
+                    {
+                        CHECK_EQUAL(codesPerTable, i - segmentStart);
+                        CHECK_EQUAL(MaxCodeSize, stream.Widths[i]);
+                        CHECK_EQUAL(MaxCodeSize, stream.Widths[i - 1]);
+                        segmentStart = i + 1;
+                        fullSegments++;
+                    }
+                }
+                CHECK(fullSegments >= 2);
+                CHECK_EQUAL(clearCode, stream.Codes[0]);
+                CHECK_EQUAL(clearCode + 1, stream.Codes.back());
+
+                // Ending the stream right around the clear
+                auto count = ShortestPrefix(LzwResetPolicy::WhenFull, minimumCodeSize, indices, [clearCode](CodeStream const& stream)
+                    {
+                        return std::count(stream.Codes.begin(), stream.Codes.end(), clearCode) >= 2;
+                    });
+                for (auto length = std::max<size_t>(count, 3) - 2; length <= count + 2; length++)
+                {
+                    CheckRoundTrip(LzwResetPolicy::WhenFull, minimumCodeSize, std::vector<uint8_t>(indices.begin(), indices.begin() + length));
+                }
+            }
+        });
+
+    runner.Run("LzwEncoder/Adaptive/KeepsUsingAFullTable", []()
+        {
+            // Random data compresses as well with a full table as it did
+            // while filling it, so the table is never cleared
+            const uint8_t minimumCodeSize = 2;
+            auto indices = RandomIndices(65535, minimumCodeSize, 5);
+            LzwEncoder encoder(LzwResetPolicy::Adaptive);
+            std::vector<uint8_t> data;
+            encoder.Encode(minimumCodeSize, indices.data(), indices.size(), data);
+            auto stream = ReadCodes(data);
+
+            auto clearCode = 1u << minimumCodeSize;
+            auto codesPerTable = static_cast<size_t>(MaxCodes - (clearCode + 2) + 1);
+            CHECK_EQUAL(1, std::count(stream.Codes.begin(), stream.Codes.end(), clearCode));
+            CHECK(stream.Codes.size() > codesPerTable * 2);
+            for (auto&& code : stream.Codes)
+            {
+                CHECK(code < MaxCodes);
+            }
+            CheckRoundTrip(LzwResetPolicy::Adaptive, minimumCodeSize, indices);
+        });
+
+    runner.Run("LzwEncoder/RejectsInvalidMinimumCodeSizes", []()
+        {
+            LzwEncoder encoder;
+            uint8_t index = 0;
+            std::vector<uint8_t> data;
+            CHECK_THROWS(std::invalid_argument, encoder.Encode(1, &index, 1, data));
+            CHECK_THROWS(std::invalid_argument, encoder.Encode(9, &index, 1, data));
+        });
+}
@@ -0,0 +1,138 @@
+#include "Test.h"
+#include "ColorQuantizer.h"
+#include "PaletteMapper.h"
+#include <cmath>
+#include <random>
+#include <string>
+
+namespace
+{
+    std::vector<GifColor> RandomPalette(size_t size, std::mt19937& random)
+    {
+        std::vector<GifColor> palette(size);
+        for (auto&& color : palette)
+        {
+            color = GifColor{ static_cast<uint8_t>(random()), static_cast<uint8_t>(random()), static_cast<uint8_t>(random()) };
+        }
+        return palette;
+    }
+
+    int32_t SquaredDistance(GifColor const& color, uint32_t pixel)
+    {
+        auto dr = static_cast<int32_t>(color.R) - static_cast<int32_t>((pixel >> 16) & 0xFF);
+        auto dg = static_cast<int32_t>(color.G) - static_cast<int32_t>((pixel >> 8) & 0xFF);
+        auto db = static_cast<int32_t>(color.B) - static_cast<int32_t>(pixel & 0xFF);
+        return (dr * dr) + (dg * dg) + (db * db);
+    }
+
+    // Maps the pixels through the mapper and checks every index against
+    // a brute force search: palette colors map to their first entry,
+    // anything else to the entry nearest to its cube cell's center,
+    // which is never more than a cell's diagonal further off than the
+    // nearest entry.
+    void CheckMapping(PaletteMapper& mapper, std::vector<GifColor> const& palette, std::vector<uint32_t> const& pixels, std::string const& name)
+    {
+        mapper.SetPalette(palette);
+        std::vector<uint8_t> indices(pixels.size());
+        mapper.MapPixels(reinterpret_cast<uint8_t const*>(pixels.data()), pixels.size() * 4, static_cast<uint32_t>(pixels.size()), 1, indices.data());
+
+        constexpr uint32_t shift = 8 - PaletteMapper::BitsPerChannel;
+        constexpr uint32_t half = 1u << (shift - 1);
+        auto slack = 2.0 * std::sqrt(3.0 * half * half);
+        for (size_t i = 0; i < pixels.size(); i++)
+        {
+            auto pixel = pixels[i] & 0x00FFFFFF;
+            auto r = static_cast<uint8_t>(pixel >> 16);
+            auto g = static_cast<uint8_t>(pixel >> 8);
+            auto b = static_cast<uint8_t>(pixel);
+            auto nearest = FindNearestColor(palette, r, g, b);
+            uint8_t expected = 0;
+            if (SquaredDistance(palette[nearest], pixel) == 0)
+            {
+                expected = nearest;
+            }
+            else
+            {
+                auto center = [&](uint8_t channel) { return static_cast<uint8_t>(((channel >> shift) << shift) | half); };
+                expected = FindNearestColor(palette, center(r), center(g), center(b));
+            }
+            if (indices[i] != expected || mapper.MapColor(r, g, b) != expected)
+            {
+                throw TestFailure(name + ": pixel " + std::to_string(i) + " maps to " + std::to_string(indices[i]) + " rather than " + std::to_string(expected));
+            }
+            auto mappedDistance = std::sqrt(static_cast<double>(SquaredDistance(palette[indices[i]], pixel)));
+            auto nearestDistance = std::sqrt(static_cast<double>(SquaredDistance(palette[nearest], pixel)));
+            CHECK(mappedDistance <= nearestDistance + slack);
+        }
+    }
+}
+
+void RunPaletteMapperTests(TestRunner& runner)
+{
+    runner.Run("PaletteMapper/MatchesBruteForce", []()
+        {
+            std::mt19937 random(7);
+            std::vector<uint32_t> pixels(20000);
+            for (auto&& pixel : pixels)
+            {
+                pixel = static_cast<uint32_t>(random()) | 0xFF000000;
+            }
+
+            std::vector<GifColor> grays;
+            for (uint32_t i = 0; i < 256; i += 17)
+            {
+                grays.push_back(GifColor{ static_cast<uint8_t>(i), static_cast<uint8_t>(i), static_cast<uint8_t>(i) });
+            }
+            auto duplicates = RandomPalette(32, random);
+            duplicates.insert(duplicates.end(), duplicates.begin(), duplicates.end());
+            const std::pair<std::vector<GifColor>, char const*> palettes[] =
+            {
+                { RandomPalette(256, random), "Random256" },
+                { RandomPalette(16, random), "Random16" },
+                { grays, "Grays" },
+                { duplicates, "Duplicates" },
+                { { GifColor{ 10, 20, 30 } }, "Single" },
+            };
+
+            // One mapper for all of them, so each palette change has to
+            // leave nothing of the previous palette's cells behind
+            PaletteMapper mapper;
+            for (auto&& [palette, name] : palettes)
+            {
+                // Some pixels that are exactly palette colors too
+                auto mixed = pixels;
+                for (size_t i = 0; i < palette.size(); i++)
+                {
+                    auto&& color = palette[i];
+                    mixed[i * 7] = 0xFF000000 | (static_cast<uint32_t>(color.R) << 16) | (static_cast<uint32_t>(color.G) << 8) | color.B;
+                }
+                CheckMapping(mapper, palette, mixed, name);
+            }
+            // And back to the first one
+            CheckMapping(mapper, palettes[0].first, pixels, palettes[0].second);
+            CHECK_EQUAL(6u, mapper.PaletteChangeCount());
+
+            // The same palette again keeps the cells
+            mapper.SetPalette(palettes[0].first);
+            CHECK_EQUAL(6u, mapper.PaletteChangeCount());
+        });
+
+    runner.Run("PaletteMapper/SurvivesManyPaletteChanges", []()
+        {
+            // Enough palettes for the cube's generation to wrap around,
+            // with a few pixels mapped through each so cells get filled
+            std::mt19937 random(77);
+            std::vector<uint32_t> pixels(64);
+            for (auto&& pixel : pixels)
+            {
+                pixel = static_cast<uint32_t>(random()) | 0xFF000000;
+            }
+            PaletteMapper mapper;
+            for (int i = 0; i < 600; i++)
+            {
+                CheckMapping(mapper, RandomPalette(8, random), pixels, "Palette " + std::to_string(i));
+            }
+            CHECK_EQUAL(600u, mapper.PaletteChangeCount());
+            CHECK_THROWS(std::invalid_argument, mapper.SetPalette({}));
+        });
+}
@@ -0,0 +1,182 @@
+#include "Test.h"
+#include "FrameReadback.h"
+#include "SoftwareFrameReadback.h"
+#include "TestGifs.h"
+#include <cstring>
+
+namespace
+{
+    const uint32_t Width = 8;
+    const uint32_t Height = 4;
+
+    // Submits a frame whose pixels and diff both carry its number
+    template <typename Callback>
+    void SubmitFrame(ReadbackRing<int>& ring, SoftwareFrameReadback& readback, int number, Callback&& consume)
+    {
+        std::vector<uint8_t> pixels(static_cast<size_t>(Width) * Height * 4, static_cast<uint8_t>(number));
+        DirtyTileMap tiles(Width, Height);
+        auto slot = ring.BeginFrame(consume);
+        auto coordinate = static_cast<uint32_t>(number);
+        readback.Fill(slot, pixels.data(), static_cast<size_t>(Width) * 4, DiffRect{ coordinate, 0, coordinate, 0 }, tiles);
+        ring.EndFrame(std::move(number), consume);
+    }
+
+    // Records the frames read back, checking each came back with its own
+    // slot's contents
+    struct Consumer
+    {
+        std::vector<int> Numbers;
+
+        void operator()(ReadbackData const& data, int& number)
+        {
+            CHECK(data.Diff.has_value());
+            CHECK_EQUAL(static_cast<uint32_t>(number), data.Diff->Left);
+            CHECK_EQUAL(static_cast<uint8_t>(number), data.Pixels.Data[0]);
+            CHECK_EQUAL(static_cast<uint8_t>(number), data.Pixels.Row(Height - 1)[(Width * 4) - 1]);
+            Numbers.push_back(number);
+        }
+    };
+}
+
+void RunReadbackRingTests(TestRunner& runner)
+{
+    runner.Run("ReadbackRing/ComesBackLatencyFramesLateInOrder", []()
+        {
+            // Copies land as soon as the ring would read them
+            const uint32_t slotCount = 4;
+            SoftwareFrameReadback readback(Width, Height, slotCount, slotCount - 1);
+            ReadbackRing<int> ring(readback, slotCount - 1);
+            CHECK_EQUAL(slotCount - 1, ring.Latency());
+
+            Consumer consumer;
+            for (int i = 0; i < 10; i++)
+            {
+                SubmitFrame(ring, readback, i, consumer);
+                auto expectedCount = std::max(i + 1 - static_cast<int>(ring.Latency()), 0);
+                CHECK_EQUAL(static_cast<size_t>(expectedCount), consumer.Numbers.size());
+                CHECK_EQUAL(std::min<uint32_t>(i + 1, ring.Latency()), ring.PendingCount());
+            }
+            for (size_t i = 0; i < consumer.Numbers.size(); i++)
+            {
+                CHECK_EQUAL(static_cast<int>(i), consumer.Numbers[i]);
+            }
+            CHECK_EQUAL(0u, ring.StallCount());
+        });
+
+    runner.Run("ReadbackRing/LatencyIsCappedBySlots", []()
+        {
+            SoftwareFrameReadback readback(Width, Height, 3);
+            ReadbackRing<int> ring(readback, 10);
+            CHECK_EQUAL(2u, ring.Latency());
+        });
+
+    runner.Run("ReadbackRing/StallsWhenCopiesAreSlow", []()
+        {
+            // Each copy takes two more frames to land than the ring waits
+            SoftwareFrameReadback readback(Width, Height, 4, 3);
+            ReadbackRing<int> ring(readback, 1);
+            Consumer consumer;
+            for (int i = 0; i < 6; i++)
+            {
+                SubmitFrame(ring, readback, i, consumer);
+            }
+            ring.Flush(consumer);
+            CHECK_EQUAL(6u, consumer.Numbers.size());
+            CHECK_EQUAL(ring.StallCount(), readback.WaitCount());
+            CHECK_EQUAL(6u, ring.StallCount());
+        });
+
+    runner.Run("ReadbackRing/FlushDrainsEverySlot", []()
+        {
+            const uint32_t slotCount = 3;
+            SoftwareFrameReadback readback(Width, Height, slotCount);
+            ReadbackRing<int> ring(readback, slotCount - 1);
+            Consumer consumer;
+            for (int i = 0; i < 5; i++)
+            {
+                SubmitFrame(ring, readback, i, consumer);
+            }
+            CHECK_EQUAL(3u, consumer.Numbers.size());
+            CHECK_EQUAL(2u, ring.PendingCount());
+
+            ring.Flush(consumer);
+            CHECK_EQUAL(0u, ring.PendingCount());
+            CHECK_EQUAL(5u, consumer.Numbers.size());
+            for (int i = 0; i < 5; i++)
+            {
+                CHECK_EQUAL(i, consumer.Numbers[i]);
+            }
+
+            // Every slot has been unmapped and can be filled again
+            std::vector<uint8_t> pixels(static_cast<size_t>(Width) * Height * 4);
+            DirtyTileMap tiles(Width, Height);
+            for (uint32_t slot = 0; slot < slotCount; slot++)
+            {
+                readback.Fill(slot, pixels.data(), static_cast<size_t>(Width) * 4, std::nullopt, tiles);
+            }
+
+            // Flushing again has nothing left to read
+            ring.Flush(consumer);
+            CHECK_EQUAL(5u, consumer.Numbers.size());
+        });
+
+    runner.Run("ReadbackRing/OneSlotIsSynchronous", []()
+        {
+            // Behaves like copying and mapping right away, waiting if the
+            // copy hasn't landed
+            for (uint32_t framesUntilReady : { 0, 1 })
+            {
+                SoftwareFrameReadback readback(Width, Height, 1, framesUntilReady);
+                ReadbackRing<int> ring(readback, 2);
+                CHECK_EQUAL(0u, ring.Latency());
+                Consumer consumer;
+                for (int i = 0; i < 4; i++)
+                {
+                    SubmitFrame(ring, readback, i, consumer);
+                    CHECK_EQUAL(static_cast<size_t>(i + 1), consumer.Numbers.size());
+                    CHECK_EQUAL(i, consumer.Numbers.back());
+                    CHECK_EQUAL(0u, ring.PendingCount());
+                }
+                ring.Flush(consumer);
+                CHECK_EQUAL(4u, consumer.Numbers.size());
+                CHECK_EQUAL(framesUntilReady == 0 ? 0u : 4u, ring.StallCount());
+            }
+        });
+
+    runner.Run("ReadbackRing/UnmapsWhenConsumeThrows", []()
+        {
+            SoftwareFrameReadback readback(Width, Height, 2);
+            ReadbackRing<int> ring(readback, 1);
+            Consumer consumer;
+            SubmitFrame(ring, readback, 0, consumer);
+            auto failing = [](ReadbackData const&, int&) { throw std::runtime_error("Consume failed"); };
+            CHECK_THROWS(std::runtime_error, SubmitFrame(ring, readback, 1, failing));
+            CHECK_EQUAL(1u, ring.PendingCount());
+
+            // The slot that was being read can be filled again
+            SubmitFrame(ring, readback, 2, consumer);
+            ring.Flush(consumer);
+            CHECK_EQUAL(2u, consumer.Numbers.size());
+            CHECK_EQUAL(1, consumer.Numbers[0]);
+            CHECK_EQUAL(2, consumer.Numbers[1]);
+        });
+    runner.Run("ReadbackRing/StopFlushesFramesInFlight", []()
+        {
+            // Fewer frames than the latency never leave the ring on their
+            // own, so they're only written if stopping flushes it
+            for (uint32_t slots : { 1, 3, 5 })
+            {
+                GifEncoderOptions options = {};
+                options.ReadbackSlots = slots;
+                options.ReadbackLatency = slots - 1;
+                std::vector<TestFrame> frames;
+                for (uint32_t i = 0; i < slots; i++)
+                {
+                    frames.push_back(SolidFrame(16, 16, 0x202020u * (i + 1), 100 * i));
+                }
+                auto bytes = RecordFrames(frames, 16, 16, options);
+                CHECK_EQUAL(frames.size(), DecodeFrames(bytes).size());
+                CheckTimeline(bytes, frames, 16, 16);
+            }
+        });
+}
@@ -0,0 +1,41 @@
+#include "Test.h"
+#include "SpscQueue.h"
+#include <thread>
+
+void RunSpscQueueTests(TestRunner& runner)
+{
+    runner.Run("SpscQueue/ProducerWaitsForRoom", []()
+        {
+            // A slow consumer and a queue of one keep the producer waiting
+            // on almost every item
+            const int itemCount = 2000;
+            SpscQueue<int> queue(1);
+            std::vector<int> popped;
+            std::thread consumer([&]()
+                {
+                    while (auto item = queue.Pop())
+                    {
+                        popped.push_back(item.value());
+                        if (item.value() % 100 == 0)
+                        {
+                            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                        }
+                    }
+                });
+            for (int i = 0; i < itemCount; i++)
+            {
+                queue.WaitForRoom();
+                auto item = i;
+                CHECK(queue.TryPush(std::move(item)));
+            }
+            queue.Close();
+            consumer.join();
+
+            CHECK_EQUAL(static_cast<size_t>(itemCount), popped.size());
+            for (int i = 0; i < itemCount; i++)
+            {
+                CHECK_EQUAL(i, popped[i]);
+            }
+            CHECK_EQUAL(1u, queue.HighWaterMark());
+        });
+}
@@ -0,0 +1,110 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+// Thrown when a check fails. Anything else a test throws fails it too.
+class TestFailure : public std::runtime_error
+{
+public:
+    using std::runtime_error::runtime_error;
+};
+
+#define CHECK(condition) \
+    CheckTrue((condition), #condition, __FILE__, __LINE__)
+#define CHECK_EQUAL(expected, actual) \
+    CheckEqual((expected), (actual), #actual, __FILE__, __LINE__)
+#define CHECK_THROWS(exceptionType, expression) \
+    do \
+    { \
+        auto threw = false; \
+        try \
+        { \
+            expression; \
+        } \
+        catch (exceptionType const&) \
+        { \
+            threw = true; \
+        } \
+        CheckTrue(threw, #expression " throws " #exceptionType, __FILE__, __LINE__); \
+    } while (false)
+
+inline void CheckTrue(bool condition, char const* expression, char const* file, int line)
+{
+    if (!condition)
+    {
+        std::ostringstream message;
+        message << file << ":" << line << ": " << expression;
+        throw TestFailure(message.str());
+    }
+}
+
+template <typename Expected, typename Actual>
+void CheckEqual(Expected const& expected, Actual const& actual, char const* expression, char const* file, int line)
+{
+    if (!(expected == actual))
+    {
+        // Bytes would print as characters
+        std::ostringstream message;
+        message << file << ":" << line << ": " << expression << " is " << +actual << ", expected " << +expected;
+        throw TestFailure(message.str());
+    }
+}
+
+class TestRunner
+{
+public:
+    TestRunner(std::string const& filter)
+    {
+        m_filter = filter;
+    }
+
+    void Run(std::string const& name, std::function<void()> const& function)
+    {
+        if (!m_filter.empty() && name.find(m_filter) == std::string::npos)
+        {
+            return;
+        }
+
+        m_runCount++;
+        try
+        {
+            function();
+            printf("PASS %s\n", name.c_str());
+        }
+        catch (std::exception const& error)
+        {
+            m_failedCount++;
+            printf("FAIL %s\n    %s\n", name.c_str(), error.what());
+        }
+        fflush(stdout);
+    }
+
+    uint32_t RunCount() const { return m_runCount; }
+    uint32_t FailedCount() const { return m_failedCount; }
+
+private:
+    std::string m_filter;
+    uint32_t m_runCount = 0;
+    uint32_t m_failedCount = 0;
+};
+
+void RunFrameRateGovernorTests(TestRunner& runner);
+void RunCpuTextureDifferTests(TestRunner& runner);
+void RunTileHashTests(TestRunner& runner);
+void RunReadbackRingTests(TestRunner& runner);
+void RunFrameBufferPoolTests(TestRunner& runner);
+void RunSpscQueueTests(TestRunner& runner);
+void RunThreadPoolTests(TestRunner& runner);
+void RunUniqueColorSetTests(TestRunner& runner);
+void RunColorQuantizerTests(TestRunner& runner);
+void RunPaletteMapperTests(TestRunner& runner);
+void RunDithererTests(TestRunner& runner);
+void RunLzwEncoderTests(TestRunner& runner);
+void RunGifWriterTests(TestRunner& runner);
+void RunGifFrameEncoderTests(TestRunner& runner);
+void RunGifPipelineTests(TestRunner& runner);
+void RunGifOptimizerTests(TestRunner& runner);
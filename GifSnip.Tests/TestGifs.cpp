@@ -0,0 +1,118 @@
+#include "TestGifs.h"
+#include "Test.h"
+#include "HeadlessGifEncoder.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+void MemoryGifOutputStream::Write(uint8_t const* data, size_t size)
+{
+    CHECK(!m_finished);
+    m_bytes.insert(m_bytes.end(), data, data + size);
+}
+
+void MemoryGifOutputStream::WriteAt(uint64_t offset, uint8_t const* data, size_t size)
+{
+    CHECK(offset + size <= m_bytes.size());
+    std::copy_n(data, size, m_bytes.begin() + static_cast<ptrdiff_t>(offset));
+}
+
+void MemoryGifOutputStream::Finish()
+{
+    CHECK(!m_finished);
+    m_finished = true;
+}
+
+TestFrame SolidFrame(uint32_t width, uint32_t height, uint32_t color, int64_t time)
+{
+    TestFrame frame;
+    frame.Pixels.resize(static_cast<size_t>(width) * height * 4);
+    frame.Time = time;
+    FillRect(frame, width, 0, 0, width, height, color);
+    return frame;
+}
+
+void FillRect(TestFrame& frame, uint32_t width, uint32_t left, uint32_t top, uint32_t right, uint32_t bottom, uint32_t color)
+{
+    // Always opaque, like captured frames
+    color |= 0xFF000000;
+    for (auto y = top; y < bottom; y++)
+    {
+        for (auto x = left; x < right; x++)
+        {
+            memcpy(frame.Pixels.data() + (((static_cast<size_t>(y) * width) + x) * 4), &color, sizeof(color));
+        }
+    }
+}
+
+std::vector<uint8_t> RecordFrames(
+    std::vector<TestFrame> const& frames,
+    uint32_t width,
+    uint32_t height,
+    GifEncoderOptions const& options,
+    GifEncoderStatistics* statistics)
+{
+    MemoryGifOutputStream output;
+    HeadlessGifEncoder encoder(output, DiffRect{ 0, 0, width, height }, options);
+    for (auto&& testFrame : frames)
+    {
+        SourceFrame frame = {};
+        frame.Surface.Data = const_cast<uint8_t*>(testFrame.Pixels.data());
+        frame.Surface.Width = width;
+        frame.Surface.Height = height;
+        frame.Surface.Stride = static_cast<size_t>(width) * 4;
+        // Capture time stamps never start at zero
+        frame.SystemRelativeTime = std::chrono::seconds(1) + std::chrono::duration_cast<FrameTime>(std::chrono::milliseconds(testFrame.Time));
+        CHECK(encoder.ProcessFrame(frame));
+    }
+    encoder.Stop();
+    if (statistics != nullptr)
+    {
+        *statistics = encoder.Statistics();
+    }
+    return output.Bytes();
+}
+
+std::vector<GifDecodedFrame> DecodeFrames(std::vector<uint8_t> const& bytes)
+{
+    GifDecoder decoder(bytes);
+    std::vector<GifDecodedFrame> frames;
+    GifDecodedFrame frame;
+    while (decoder.ReadFrame(frame))
+    {
+        frames.push_back(frame);
+    }
+    return frames;
+}
+
+void CheckTimeline(std::vector<uint8_t> const& bytes, std::vector<TestFrame> const& frames, uint32_t width, uint32_t height)
+{
+    GifDecoder decoder(bytes);
+    CHECK_EQUAL(width, decoder.Width());
+    CHECK_EQUAL(height, decoder.Height());
+    GifCanvas canvas(width, height);
+    GifDecodedFrame decodedFrame;
+    CHECK(decoder.ReadFrame(decodedFrame));
+    canvas.DrawFrame(decodedFrame);
+    int64_t frameEnd = decodedFrame.Description.Delay;
+    auto decoderDone = false;
+    for (size_t i = 0; i < frames.size(); i++)
+    {
+        using Centiseconds = std::chrono::duration<int64_t, std::centi>;
+        auto time = std::chrono::round<Centiseconds>(std::chrono::milliseconds(frames[i].Time)).count();
+        while (!decoderDone && time >= frameEnd)
+        {
+            if (!decoder.ReadFrame(decodedFrame))
+            {
+                decoderDone = true;
+                break;
+            }
+            canvas.DrawFrame(decodedFrame);
+            frameEnd += decodedFrame.Description.Delay;
+        }
+        if (memcmp(canvas.Pixels(), frames[i].Pixels.data(), frames[i].Pixels.size()) != 0)
+        {
+            throw TestFailure("Frame " + std::to_string(i) + " at " + std::to_string(frames[i].Time) + "ms doesn't show what was recorded");
+        }
+    }
+}
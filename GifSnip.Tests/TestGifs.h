@@ -0,0 +1,49 @@
+#pragma once
+#include "GifDecoder.h"
+#include "GifEncoderOptions.h"
+#include "GifEncoderStatistics.h"
+#include "GifOutputStream.h"
+#include <cstdint>
+#include <vector>
+
+// Keeps everything written in memory
+class MemoryGifOutputStream : public GifOutputStream
+{
+public:
+    void Write(uint8_t const* data, size_t size) override;
+    void WriteAt(uint64_t offset, uint8_t const* data, size_t size) override;
+    void Finish() override;
+
+    std::vector<uint8_t> const& Bytes() const { return m_bytes; }
+
+private:
+    std::vector<uint8_t> m_bytes;
+    bool m_finished = false;
+};
+
+// A tightly packed BGRA8 frame and when it was captured, in milliseconds
+// from the first frame
+struct TestFrame
+{
+    std::vector<uint8_t> Pixels;
+    int64_t Time = 0;
+};
+
+TestFrame SolidFrame(uint32_t width, uint32_t height, uint32_t color, int64_t time);
+// Fills an exclusive rect of the frame
+void FillRect(TestFrame& frame, uint32_t width, uint32_t left, uint32_t top, uint32_t right, uint32_t bottom, uint32_t color);
+
+// Records the frames through HeadlessGifEncoder and returns the file
+std::vector<uint8_t> RecordFrames(
+    std::vector<TestFrame> const& frames,
+    uint32_t width,
+    uint32_t height,
+    GifEncoderOptions const& options,
+    GifEncoderStatistics* statistics = nullptr);
+
+std::vector<GifDecodedFrame> DecodeFrames(std::vector<uint8_t> const& bytes);
+
+// Plays the GIF back and checks that every frame shows exactly what was
+// recorded at its time, the way the corpus harness does. Times are
+// rounded to the 10ms units of GIF delays first.
+void CheckTimeline(std::vector<uint8_t> const& bytes, std::vector<TestFrame> const& frames, uint32_t width, uint32_t height);
@@ -0,0 +1,118 @@
+#include "Test.h"
+#include "ThreadPool.h"
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace
+{
+    // Returns once every worker has picked up a task queued behind
+    // everything that's pending, so all of that is done
+    void WaitForEveryWorker(ThreadPool& threadPool)
+    {
+        std::mutex lock;
+        std::condition_variable changed;
+        uint32_t arrivedCount = 0;
+        uint32_t leftCount = 0;
+        for (uint32_t i = 0; i < threadPool.ThreadCount(); i++)
+        {
+            threadPool.Submit([&]()
+                {
+                    std::unique_lock<std::mutex> guard(lock);
+                    arrivedCount++;
+                    changed.notify_all();
+                    changed.wait(guard, [&]() { return arrivedCount == threadPool.ThreadCount(); });
+                    leftCount++;
+                    changed.notify_all();
+                });
+        }
+        std::unique_lock<std::mutex> guard(lock);
+        changed.wait(guard, [&]() { return leftCount == threadPool.ThreadCount(); });
+    }
+}
+
+void RunThreadPoolTests(TestRunner& runner)
+{
+    runner.Run("ThreadPool/ParallelForCallsEveryIndexOnce", []()
+        {
+            ThreadPool threadPool(4);
+            for (size_t count : { 0, 1, 2, 5, 100 })
+            {
+                std::vector<std::atomic<uint32_t>> calls(count);
+                threadPool.ParallelFor(count, [&](size_t i) { calls[i]++; });
+                for (auto&& callCount : calls)
+                {
+                    CHECK_EQUAL(1u, callCount.load());
+                }
+            }
+
+            // From within a task on the pool, with every worker busy
+            std::atomic<uint32_t> total = 0;
+            threadPool.ParallelFor(4, [&](size_t)
+                {
+                    threadPool.ParallelFor(10, [&](size_t i) { total += static_cast<uint32_t>(i); });
+                });
+            CHECK_EQUAL(180u, total.load());
+        });
+
+    runner.Run("ThreadPool/ParallelForStopsAllocatingOnceWarm", []()
+        {
+            ThreadPool threadPool(4);
+            std::atomic<size_t> total = 0;
+            auto function = [&](size_t i) { total += i; };
+            threadPool.ParallelFor(64, function);
+            WaitForEveryWorker(threadPool);
+            auto allocationCount = threadPool.AllocationCount();
+            CHECK(allocationCount > 0);
+
+            for (int i = 0; i < 200; i++)
+            {
+                threadPool.ParallelFor(64, function);
+                // Helpers that haven't let go of the state yet would make
+                // the next call take another one
+                WaitForEveryWorker(threadPool);
+                CHECK_EQUAL(allocationCount, threadPool.AllocationCount());
+            }
+            CHECK_EQUAL(201u * 2016u, total.load());
+        });
+
+    runner.Run("ThreadPool/ParallelForRethrowsTheFirstException", []()
+        {
+            ThreadPool threadPool(4);
+            for (int attempt = 0; attempt < 20; attempt++)
+            {
+                std::atomic<uint32_t> running = 0;
+                std::atomic<uint32_t> runningWhenDone = 0;
+                auto threw = false;
+                try
+                {
+                    threadPool.ParallelFor(50, [&](size_t i)
+                        {
+                            running++;
+                            std::this_thread::sleep_for(std::chrono::microseconds(100));
+                            running--;
+                            if (i % 7 == 3)
+                            {
+                                throw std::runtime_error("Index " + std::to_string(i));
+                            }
+                        });
+                }
+                catch (std::runtime_error const&)
+                {
+                    threw = true;
+                    runningWhenDone = running.load();
+                }
+                CHECK(threw);
+                // Nothing is still running once the exception comes out
+                CHECK_EQUAL(0u, runningWhenDone.load());
+            }
+
+            // Every worker is still there
+            WaitForEveryWorker(threadPool);
+            std::atomic<uint32_t> calls = 0;
+            threadPool.ParallelFor(100, [&](size_t) { calls++; });
+            CHECK_EQUAL(100u, calls.load());
+        });
+}
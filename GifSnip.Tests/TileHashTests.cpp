@@ -0,0 +1,137 @@
+#include "Test.h"
+#include "DiffCorpus.h"
+#include "TileHash.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    // TextureHash.hlsl, one pixel at a time
+    uint64_t ShaderTileHash(DiffCase const& diffCase, uint8_t const* pixels, uint32_t tileSize, uint32_t column, uint32_t row)
+    {
+        auto mix = [](uint32_t value)
+        {
+            value ^= value >> 16;
+            value *= 0x85EBCA6B;
+            value ^= value >> 13;
+            value *= 0xC2B2AE35;
+            value ^= value >> 16;
+            return value;
+        };
+
+        uint32_t laneA = 0;
+        uint32_t laneB = 0;
+        for (uint32_t y = 0; y < tileSize; y++)
+        {
+            for (uint32_t x = 0; x < tileSize; x++)
+            {
+                auto positionX = (column * tileSize) + x;
+                auto positionY = (row * tileSize) + y;
+                if (positionX < diffCase.Width && positionY < diffCase.Height)
+                {
+                    uint32_t pixel = 0;
+                    memcpy(&pixel, pixels + (static_cast<size_t>(positionY) * diffCase.Stride) + (static_cast<size_t>(positionX) * 4), sizeof(pixel));
+                    auto index = (y * tileSize) + x;
+                    laneA += mix(pixel ^ (index * 0x9E3779B1));
+                    laneB += mix(pixel ^ ((index * 0x85EBCA77) + 0xC2B2AE3D));
+                }
+            }
+        }
+        return TileHash::Pack(laneA, laneB);
+    }
+}
+
+void RunTileHashTests(TestRunner& runner)
+{
+    // Run once per instruction set by ctest, see GIFSNIP_CPU in Simd.h.
+    // Every one of them has to match the shader, and so each other.
+    auto prefix = std::string("TileHash/") + InstructionSetName() + "/";
+
+    runner.Run(prefix + "MatchesShaderHash", []()
+        {
+            // Odd tile sizes leave every vector path a tail in each tile
+            for (auto&& diffCase : LoadCorpus())
+            {
+                for (uint32_t tileSize : { 7, 16, 32 })
+                {
+                    auto columnCount = (diffCase.Width + tileSize - 1) / tileSize;
+                    auto rowCount = (diffCase.Height + tileSize - 1) / tileSize;
+                    std::vector<uint64_t> hashes(static_cast<size_t>(columnCount) * rowCount);
+                    std::vector<uint32_t> slots(TileHash::SlotCount(diffCase.Width, tileSize));
+                    for (auto pixels : { diffCase.Previous.data(), diffCase.Current.data() })
+                    {
+                        // A row of tiles at a time, the way bands are hashed
+                        std::fill(slots.begin(), slots.end(), 0xCDCDCDCD);
+                        for (uint32_t row = 0; row < rowCount; row++)
+                        {
+                            TileHash::HashTileRows(pixels, diffCase.Stride, diffCase.Width, diffCase.Height, tileSize, row, row + 1, hashes.data(), slots.data());
+                        }
+                        for (uint32_t row = 0; row < rowCount; row++)
+                        {
+                            for (uint32_t column = 0; column < columnCount; column++)
+                            {
+                                if (hashes[(static_cast<size_t>(row) * columnCount) + column] != ShaderTileHash(diffCase, pixels, tileSize, column, row))
+                                {
+                                    throw TestFailure(diffCase.Name + ": tile " + std::to_string(column) + ", " + std::to_string(row) +
+                                        " of " + std::to_string(tileSize) + " doesn't hash like the shader");
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        });
+
+    runner.Run(prefix + "FindsDirtyTilesInCorpus", []()
+        {
+            // Hashes cover every pixel, trailing odd columns and rows too,
+            // and the rect is the dirty tiles' bounding box
+            ThreadPool threadPool(4);
+            for (auto&& diffCase : LoadCorpus())
+            {
+                for (uint32_t tileSize : { 16, 32 })
+                {
+                    for (auto pool : { static_cast<ThreadPool*>(nullptr), &threadPool })
+                    {
+                        TileHashDiffer differ(diffCase.Width, diffCase.Height, pool, tileSize);
+                        DirtyTileMap tiles(diffCase.Width, diffCase.Height, tileSize);
+                        auto first = differ.ProcessFrame(diffCase.Previous.data(), diffCase.Stride, tiles);
+                        CHECK(first.has_value());
+                        CHECK_EQUAL(diffCase.Width, first->Right - first->Left);
+                        CHECK_EQUAL(diffCase.Height, first->Bottom - first->Top);
+                        CHECK_EQUAL(tiles.ColumnCount() * tiles.RowCount(), tiles.DirtyCount());
+
+                        auto rect = differ.ProcessFrame(diffCase.Current.data(), diffCase.Stride, tiles);
+                        CheckTiles(diffCase, tiles, diffCase.Width, diffCase.Height);
+                        CHECK_EQUAL(tiles.DirtyCount() > 0, rect.has_value());
+                        if (rect.has_value())
+                        {
+                            DiffRect bounds = { diffCase.Width, diffCase.Height, 0, 0 };
+                            for (uint32_t row = 0; row < tiles.RowCount(); row++)
+                            {
+                                for (uint32_t column = 0; column < tiles.ColumnCount(); column++)
+                                {
+                                    if (tiles.IsDirty(column, row))
+                                    {
+                                        bounds.Left = std::min(bounds.Left, column * tileSize);
+                                        bounds.Top = std::min(bounds.Top, row * tileSize);
+                                        bounds.Right = std::max(bounds.Right, std::min((column + 1) * tileSize, diffCase.Width) - 1);
+                                        bounds.Bottom = std::max(bounds.Bottom, std::min((row + 1) * tileSize, diffCase.Height) - 1);
+                                    }
+                                }
+                            }
+                            CHECK_EQUAL(bounds.Left, rect->Left);
+                            CHECK_EQUAL(bounds.Top, rect->Top);
+                            CHECK_EQUAL(bounds.Right, rect->Right);
+                            CHECK_EQUAL(bounds.Bottom, rect->Bottom);
+                        }
+
+                        // The same frame again changes nothing
+                        CHECK(!differ.ProcessFrame(diffCase.Current.data(), diffCase.Stride, tiles).has_value());
+                        CHECK_EQUAL(0u, tiles.DirtyCount());
+                    }
+                }
+            }
+        });
+}
@@ -0,0 +1,117 @@
+#include "Test.h"
+#include "UniqueColorSet.h"
+#include <algorithm>
+#include <random>
+
+namespace
+{
+    // Distinct colors, with alpha that varies since it's ignored
+    std::vector<uint32_t> DistinctColors(uint32_t count, std::mt19937& random)
+    {
+        std::vector<uint32_t> colors;
+        while (colors.size() < count)
+        {
+            auto color = static_cast<uint32_t>(random()) & 0x00FFFFFF;
+            if (std::find(colors.begin(), colors.end(), color) == colors.end())
+            {
+                colors.push_back(color);
+            }
+        }
+        return colors;
+    }
+
+    // Rows of width pixels picked from the colors, runs included, in a
+    // buffer with a few pixels of padding at the end of every row
+    std::vector<uint32_t> PaddedFrame(std::vector<uint32_t> const& colors, uint32_t width, uint32_t height, std::mt19937& random)
+    {
+        std::vector<uint32_t> pixels(static_cast<size_t>(width + 3) * height, 0x00ABCDEF);
+        std::uniform_int_distribution<size_t> pick(0, colors.size() - 1);
+        for (uint32_t y = 0; y < height; y++)
+        {
+            for (uint32_t x = 0; x < width; x++)
+            {
+                auto color = x > 0 && random() % 3 == 0 ? pixels[(static_cast<size_t>(y) * (width + 3)) + x - 1] : colors[pick(random)];
+                pixels[(static_cast<size_t>(y) * (width + 3)) + x] = (color & 0x00FFFFFF) | ((static_cast<uint32_t>(random()) & 0xFF) << 24);
+            }
+        }
+        return pixels;
+    }
+}
+
+void RunUniqueColorSetTests(TestRunner& runner)
+{
+    runner.Run("UniqueColorSet/CountsUniqueColors", []()
+        {
+            std::mt19937 random(8);
+            const uint32_t width = 61;
+            const uint32_t height = 17;
+            UniqueColorSet colorSet;
+            for (uint32_t colorCount : { 1u, 2u, 5u, 100u, 256u })
+            {
+                auto colors = DistinctColors(colorCount, random);
+                auto pixels = PaddedFrame(colors, width, height, random);
+                // Every color shows up at least once
+                for (uint32_t i = 0; i < colorCount; i++)
+                {
+                    pixels[(static_cast<size_t>(i / width) * (width + 3)) + (i % width)] = colors[i];
+                }
+
+                colorSet.Clear();
+                CHECK(colorSet.AddPixels(reinterpret_cast<uint8_t const*>(pixels.data()), static_cast<size_t>(width + 3) * 4, width, height));
+                CHECK_EQUAL(static_cast<size_t>(colorCount), colorSet.Count());
+
+                // In the order they were first seen
+                std::vector<uint32_t> firstSeen;
+                for (uint32_t y = 0; y < height; y++)
+                {
+                    for (uint32_t x = 0; x < width; x++)
+                    {
+                        auto color = pixels[(static_cast<size_t>(y) * (width + 3)) + x] & 0x00FFFFFF;
+                        if (std::find(firstSeen.begin(), firstSeen.end(), color) == firstSeen.end())
+                        {
+                            firstSeen.push_back(color);
+                        }
+                    }
+                }
+                std::vector<GifColor> palette;
+                colorSet.Colors(palette);
+                CHECK_EQUAL(firstSeen.size(), palette.size());
+                for (size_t i = 0; i < palette.size(); i++)
+                {
+                    CHECK_EQUAL(firstSeen[i], (static_cast<uint32_t>(palette[i].R) << 16) | (static_cast<uint32_t>(palette[i].G) << 8) | palette[i].B);
+                }
+
+                // Adding the same pixels again finds nothing new
+                CHECK(colorSet.AddPixels(reinterpret_cast<uint8_t const*>(pixels.data()), static_cast<size_t>(width + 3) * 4, width, height));
+                CHECK_EQUAL(static_cast<size_t>(colorCount), colorSet.Count());
+            }
+        });
+
+    runner.Run("UniqueColorSet/StopsPastTheLimit", []()
+        {
+            std::mt19937 random(88);
+            // A row of new colors, one per pixel
+            auto colors = DistinctColors(1000, random);
+            auto pixels = reinterpret_cast<uint8_t const*>(colors.data());
+            UniqueColorSet colorSet;
+            for (uint32_t maxColors : { 1u, 16u, 255u, 256u, 1000u })
+            {
+                // Gives up on the first color past the limit, which is
+                // never more than a GIF palette
+                auto limit = std::min(maxColors, UniqueColorSet::MaxColors);
+                colorSet.Clear();
+                CHECK(!colorSet.AddPixels(pixels, colors.size() * 4, static_cast<uint32_t>(colors.size()), 1, maxColors));
+                CHECK_EQUAL(static_cast<size_t>(limit) + 1, colorSet.Count());
+                // And from then on right away
+                CHECK(!colorSet.AddPixels(pixels, colors.size() * 4, 1, 1, maxColors));
+                CHECK_EQUAL(static_cast<size_t>(limit) + 1, colorSet.Count());
+
+                // Exactly the limit fits, across calls too
+                colorSet.Clear();
+                CHECK(colorSet.AddPixels(pixels, colors.size() * 4, limit - 1, 1, maxColors));
+                CHECK(colorSet.AddPixels(pixels + ((static_cast<size_t>(limit) - 1) * 4), colors.size() * 4, 1, 1, maxColors));
+                CHECK_EQUAL(static_cast<size_t>(limit), colorSet.Count());
+                CHECK(!colorSet.AddPixels(pixels + (static_cast<size_t>(limit) * 4), colors.size() * 4, 1, 1, maxColors));
+            }
+        });
+}
@@ -0,0 +1,34 @@
+#include "Test.h"
+
+int main(int argc, char** argv)
+{
+    // An optional argument only runs tests whose name contains it
+    std::string filter = argc > 1 ? argv[1] : "";
+    TestRunner runner(filter);
+
+    // In pipeline order
+    RunFrameRateGovernorTests(runner);
+    RunCpuTextureDifferTests(runner);
+    RunTileHashTests(runner);
+    RunReadbackRingTests(runner);
+    RunFrameBufferPoolTests(runner);
+    RunSpscQueueTests(runner);
+    RunThreadPoolTests(runner);
+    RunUniqueColorSetTests(runner);
+    RunColorQuantizerTests(runner);
+    RunPaletteMapperTests(runner);
+    RunDithererTests(runner);
+    RunLzwEncoderTests(runner);
+    RunGifWriterTests(runner);
+    RunGifFrameEncoderTests(runner);
+    RunGifPipelineTests(runner);
+    RunGifOptimizerTests(runner);
+
+    printf("%u of %u tests passed\n", runner.RunCount() - runner.FailedCount(), runner.RunCount());
+    if (runner.RunCount() == 0)
+    {
+        printf("No tests match \"%s\"\n", filter.c_str());
+        return 1;
+    }
+    return runner.FailedCount() == 0 ? 0 : 1;
+}
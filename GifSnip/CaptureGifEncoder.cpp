@@ -12,9 +12,10 @@ namespace winrt
 	using namespace Windows::Storage::Streams;
 }
 
-CaptureGifEncoder::CaptureGifEncoder(winrt::com_ptr<ID3D11Device> const& d3dDevice)
+CaptureGifEncoder::CaptureGifEncoder(winrt::com_ptr<ID3D11Device> const& d3dDevice, GifEncoderOptions const& options)
 {
 	m_d3dDevice = d3dDevice;
+	m_options = options;
 }
 
 void CaptureGifEncoder::Start(winrt::GraphicsCaptureItem const& item, RECT const& rect, winrt::StorageFile const& file)
@@ -30,7 +31,7 @@ void CaptureGifEncoder::Start(winrt::GraphicsCaptureItem const& item, RECT const
 		auto stream = file.OpenAsync(winrt::FileAccessMode::ReadWrite).get();
 
 		// Setup our gif encoder
-		m_encoder = std::make_shared<GifEncoder>(m_d3dDevice, d3dContext, stream, rect);
+		m_encoder = std::make_shared<GifEncoder>(m_d3dDevice, d3dContext, stream, rect, m_options);
 
 		// Setup Windows.Graphics.Capture
 		m_framePool = winrt::Direct3D11CaptureFramePool::CreateFreeThreaded(
@@ -59,12 +60,14 @@ void CaptureGifEncoder::Stop()
 		m_framePool = nullptr;
 		
 		m_encoder->StopEncodingAsync().get();
+		m_statistics = m_encoder->Statistics();
 		m_encoder.reset();
 	}
 }
 
 void CaptureGifEncoder::OnFrameArrived(winrt::Direct3D11CaptureFramePool const&, winrt::IInspectable const&)
 {
+	TraceSpan span("OnFrameArrived");
 	auto lock = m_lock.lock_exclusive();
 
 	if (m_framePool != nullptr)
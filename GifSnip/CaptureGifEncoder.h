@@ -4,7 +4,7 @@
 class CaptureGifEncoder
 {
 public:
-	CaptureGifEncoder(winrt::com_ptr<ID3D11Device> const& d3dDevice);
+	CaptureGifEncoder(winrt::com_ptr<ID3D11Device> const& d3dDevice, GifEncoderOptions const& options = {});
 
 	void Start(
 		winrt::Windows::Graphics::Capture::GraphicsCaptureItem const& item,
@@ -12,6 +12,9 @@ public:
 		winrt::Windows::Storage::StorageFile const& file);
 	void Stop();
 
+	// Counters from the last recording, valid after Stop()
+	GifEncoderStatistics const& Statistics() const { return m_statistics; }
+
 private:
 	void OnFrameArrived(
 		winrt::Windows::Graphics::Capture::Direct3D11CaptureFramePool const& sender,
@@ -19,7 +22,9 @@ private:
 
 private:
 	winrt::com_ptr<ID3D11Device> m_d3dDevice;
+	GifEncoderOptions m_options = {};
 	std::shared_ptr<GifEncoder> m_encoder;
+	GifEncoderStatistics m_statistics = {};
 	winrt::Windows::Graphics::Capture::Direct3D11CaptureFramePool m_framePool{ nullptr };
 	winrt::Windows::Graphics::Capture::GraphicsCaptureSession m_session{ nullptr };
 	winrt::event_token m_frameArrivedToken = {};
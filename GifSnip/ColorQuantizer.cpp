@@ -0,0 +1,623 @@
+#include "ColorQuantizer.h"
+#include "ThreadPool.h"
+#include "Simd.h"
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    // Regions smaller than this are counted on the calling thread.
+    constexpr size_t MinPixelsForParallelHistogram = 256 * 1024;
+    // Depth of the octree, matching the resolution of the histogram.
+    constexpr uint32_t OctreeDepth = ColorHistogram::BitsPerChannel;
+
+    // A histogram bin reduced to its average color
+    struct ColorEntry
+    {
+        double R;
+        double G;
+        double B;
+        uint64_t Count;
+    };
+
+    std::vector<ColorEntry> GatherEntries(ColorHistogram const& histogram)
+    {
+        std::vector<ColorEntry> entries;
+        entries.reserve(histogram.UsedBins().size());
+        for (auto index : histogram.UsedBins())
+        {
+            auto&& bin = histogram[index];
+            auto count = static_cast<double>(bin.Count);
+            entries.push_back(ColorEntry{ static_cast<double>(bin.R) / count, static_cast<double>(bin.G) / count, static_cast<double>(bin.B) / count, bin.Count });
+        }
+        return entries;
+    }
+
+    GifColor ToColor(double r, double g, double b)
+    {
+        auto clamp = [](double value)
+        {
+            return static_cast<uint8_t>(std::min(std::max(value + 0.5, 0.0), 255.0));
+        };
+        return GifColor{ clamp(r), clamp(g), clamp(b) };
+    }
+
+    // Computes the histogram bin of four (or eight) pixels at a time:
+    // ((r >> 3) << 10) | ((g >> 3) << 5) | (b >> 3) on packed BGRA.
+    void ComputeBinIndicesScalar(uint32_t const* pixels, size_t count, uint32_t* indices)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            auto pixel = pixels[i];
+            indices[i] = ((pixel & 0xF8) >> 3) | ((pixel >> 6) & 0x3E0) | ((pixel >> 9) & 0x7C00);
+        }
+    }
+
+#if defined(GIFSNIP_X64)
+    GIFSNIP_TARGET_AVX2 void ComputeBinIndicesAvx2(uint32_t const* pixels, size_t count, uint32_t* indices)
+    {
+        auto blueMask = _mm256_set1_epi32(0xF8);
+        auto greenMask = _mm256_set1_epi32(0x3E0);
+        auto redMask = _mm256_set1_epi32(0x7C00);
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            auto pixel = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(pixels + i));
+            auto blue = _mm256_srli_epi32(_mm256_and_si256(pixel, blueMask), 3);
+            auto green = _mm256_and_si256(_mm256_srli_epi32(pixel, 6), greenMask);
+            auto red = _mm256_and_si256(_mm256_srli_epi32(pixel, 9), redMask);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(indices + i), _mm256_or_si256(blue, _mm256_or_si256(green, red)));
+        }
+        ComputeBinIndicesScalar(pixels + i, count - i, indices + i);
+    }
+
+    void ComputeBinIndicesSse2(uint32_t const* pixels, size_t count, uint32_t* indices)
+    {
+        auto blueMask = _mm_set1_epi32(0xF8);
+        auto greenMask = _mm_set1_epi32(0x3E0);
+        auto redMask = _mm_set1_epi32(0x7C00);
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4)
+        {
+            auto pixel = _mm_loadu_si128(reinterpret_cast<__m128i const*>(pixels + i));
+            auto blue = _mm_srli_epi32(_mm_and_si128(pixel, blueMask), 3);
+            auto green = _mm_and_si128(_mm_srli_epi32(pixel, 6), greenMask);
+            auto red = _mm_and_si128(_mm_srli_epi32(pixel, 9), redMask);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(indices + i), _mm_or_si128(blue, _mm_or_si128(green, red)));
+        }
+        ComputeBinIndicesScalar(pixels + i, count - i, indices + i);
+    }
+#elif defined(GIFSNIP_ARM64)
+    void ComputeBinIndicesNeon(uint32_t const* pixels, size_t count, uint32_t* indices)
+    {
+        auto blueMask = vdupq_n_u32(0xF8);
+        auto greenMask = vdupq_n_u32(0x3E0);
+        auto redMask = vdupq_n_u32(0x7C00);
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4)
+        {
+            auto pixel = vld1q_u32(pixels + i);
+            auto blue = vshrq_n_u32(vandq_u32(pixel, blueMask), 3);
+            auto green = vandq_u32(vshrq_n_u32(pixel, 6), greenMask);
+            auto red = vandq_u32(vshrq_n_u32(pixel, 9), redMask);
+            vst1q_u32(indices + i, vorrq_u32(blue, vorrq_u32(green, red)));
+        }
+        ComputeBinIndicesScalar(pixels + i, count - i, indices + i);
+    }
+#endif
+
+    using ComputeBinIndicesFunction = void(*)(uint32_t const* pixels, size_t count, uint32_t* indices);
+
+    ComputeBinIndicesFunction SelectBinIndicesKernel()
+    {
+        static const ComputeBinIndicesFunction kernel = []()
+        {
+#if defined(GIFSNIP_X64)
+            if (CpuFeatures::Current().Avx2)
+            {
+                return ComputeBinIndicesAvx2;
+            }
+            return ComputeBinIndicesSse2;
+#elif defined(GIFSNIP_ARM64)
+            return ComputeBinIndicesNeon;
+#else
+            return ComputeBinIndicesScalar;
+#endif
+        }();
+        return kernel;
+    }
+
+    std::vector<GifColor> BuildOctreePalette(std::vector<ColorEntry> const& entries, uint32_t maxColors)
+    {
+        struct OctreeNode
+        {
+            int32_t Children[8];
+            double R;
+            double G;
+            double B;
+            uint64_t Count;
+            bool IsLeaf;
+        };
+
+        std::vector<OctreeNode> nodes;
+        nodes.reserve(entries.size() * 2 + 1);
+        nodes.push_back(OctreeNode{ { -1, -1, -1, -1, -1, -1, -1, -1 }, 0, 0, 0, 0, false });
+        // Nodes with children at each level, candidates for folding
+        std::vector<std::vector<int32_t>> reducible(OctreeDepth);
+        uint32_t leafCount = 0;
+
+        for (auto&& entry : entries)
+        {
+            auto color = ToColor(entry.R, entry.G, entry.B);
+            int32_t node = 0;
+            for (uint32_t level = 0; level < OctreeDepth; level++)
+            {
+                auto shift = 7 - level;
+                auto child = (((color.R >> shift) & 1) << 2) | (((color.G >> shift) & 1) << 1) | ((color.B >> shift) & 1);
+                if (nodes[node].Children[child] < 0)
+                {
+                    if (nodes[node].Children[0] < 0 && nodes[node].Children[1] < 0 && nodes[node].Children[2] < 0 && nodes[node].Children[3] < 0 &&
+                        nodes[node].Children[4] < 0 && nodes[node].Children[5] < 0 && nodes[node].Children[6] < 0 && nodes[node].Children[7] < 0)
+                    {
+                        reducible[level].push_back(node);
+                    }
+                    auto isLeaf = level + 1 == OctreeDepth;
+                    nodes[node].Children[child] = static_cast<int32_t>(nodes.size());
+                    nodes.push_back(OctreeNode{ { -1, -1, -1, -1, -1, -1, -1, -1 }, 0, 0, 0, 0, isLeaf });
+                    if (isLeaf)
+                    {
+                        leafCount++;
+                    }
+                }
+                node = nodes[node].Children[child];
+            }
+            auto weight = static_cast<double>(entry.Count);
+            nodes[node].R += entry.R * weight;
+            nodes[node].G += entry.G * weight;
+            nodes[node].B += entry.B * weight;
+            nodes[node].Count += entry.Count;
+        }
+
+        // Fold the least popular of the deepest nodes into their parents
+        // until we have few enough leaves.
+        auto level = static_cast<int32_t>(OctreeDepth) - 1;
+        while (leafCount > maxColors && level >= 0)
+        {
+            auto&& candidates = reducible[level];
+            if (candidates.empty())
+            {
+                level--;
+                continue;
+            }
+
+            // Sort once per level, least popular at the back
+            auto subtreeCount = [&](int32_t node)
+            {
+                uint64_t count = 0;
+                for (auto child : nodes[node].Children)
+                {
+                    if (child >= 0)
+                    {
+                        count += nodes[child].Count;
+                    }
+                }
+                return count;
+            };
+            std::sort(candidates.begin(), candidates.end(), [&](int32_t first, int32_t second) { return subtreeCount(first) > subtreeCount(second); });
+            while (leafCount > maxColors && !candidates.empty())
+            {
+                auto node = candidates.back();
+                candidates.pop_back();
+                auto&& parent = nodes[node];
+                uint32_t childCount = 0;
+                for (auto& child : parent.Children)
+                {
+                    if (child >= 0)
+                    {
+                        parent.R += nodes[child].R;
+                        parent.G += nodes[child].G;
+                        parent.B += nodes[child].B;
+                        parent.Count += nodes[child].Count;
+                        nodes[child].IsLeaf = false;
+                        child = -1;
+                        childCount++;
+                    }
+                }
+                parent.IsLeaf = true;
+                leafCount = leafCount - childCount + 1;
+            }
+            level--;
+        }
+
+        std::vector<GifColor> palette;
+        palette.reserve(leafCount);
+        for (auto&& node : nodes)
+        {
+            if (node.IsLeaf && node.Count > 0)
+            {
+                auto count = static_cast<double>(node.Count);
+                palette.push_back(ToColor(node.R / count, node.G / count, node.B / count));
+            }
+        }
+        return palette;
+    }
+
+    std::vector<GifColor> BuildMedianCutPalette(std::vector<ColorEntry> entries, uint32_t maxColors)
+    {
+        struct Box
+        {
+            size_t Begin;
+            size_t End;
+            uint64_t Count;
+            double Range[3];
+        };
+
+        auto channel = [](ColorEntry const& entry, uint32_t index)
+        {
+            return index == 0 ? entry.R : (index == 1 ? entry.G : entry.B);
+        };
+        auto measure = [&](Box& box)
+        {
+            double minimum[3] = { 255.0, 255.0, 255.0 };
+            double maximum[3] = { 0.0, 0.0, 0.0 };
+            box.Count = 0;
+            for (auto i = box.Begin; i < box.End; i++)
+            {
+                for (uint32_t c = 0; c < 3; c++)
+                {
+                    minimum[c] = std::min(minimum[c], channel(entries[i], c));
+                    maximum[c] = std::max(maximum[c], channel(entries[i], c));
+                }
+                box.Count += entries[i].Count;
+            }
+            for (uint32_t c = 0; c < 3; c++)
+            {
+                box.Range[c] = maximum[c] - minimum[c];
+            }
+        };
+
+        std::vector<Box> boxes;
+        Box initial = { 0, entries.size(), 0, {} };
+        measure(initial);
+        boxes.push_back(initial);
+
+        while (boxes.size() < maxColors)
+        {
+            // Split the box with the most pixels spread over the widest range
+            auto bestScore = 0.0;
+            size_t bestBox = boxes.size();
+            for (size_t i = 0; i < boxes.size(); i++)
+            {
+                auto&& box = boxes[i];
+                if (box.End - box.Begin < 2)
+                {
+                    continue;
+                }
+                auto range = std::max(box.Range[0], std::max(box.Range[1], box.Range[2]));
+                auto score = range * static_cast<double>(box.Count);
+                if (score > bestScore)
+                {
+                    bestScore = score;
+                    bestBox = i;
+                }
+            }
+            if (bestBox == boxes.size())
+            {
+                break;
+            }
+
+            auto box = boxes[bestBox];
+            uint32_t axis = 0;
+            if (box.Range[1] >= box.Range[axis])
+            {
+                axis = 1;
+            }
+            if (box.Range[2] > box.Range[axis])
+            {
+                axis = 2;
+            }
+            std::sort(entries.begin() + box.Begin, entries.begin() + box.End, [&](ColorEntry const& first, ColorEntry const& second)
+                {
+                    return channel(first, axis) < channel(second, axis);
+                });
+
+            // Split at the weighted median, keeping both halves non-empty
+            uint64_t accumulated = 0;
+            auto split = box.Begin + 1;
+            for (auto i = box.Begin; i < box.End - 1; i++)
+            {
+                accumulated += entries[i].Count;
+                split = i + 1;
+                if (accumulated * 2 >= box.Count)
+                {
+                    break;
+                }
+            }
+
+            Box first = { box.Begin, split, 0, {} };
+            Box second = { split, box.End, 0, {} };
+            measure(first);
+            measure(second);
+            boxes[bestBox] = first;
+            boxes.push_back(second);
+        }
+
+        std::vector<GifColor> palette;
+        palette.reserve(boxes.size());
+        for (auto&& box : boxes)
+        {
+            double r = 0;
+            double g = 0;
+            double b = 0;
+            for (auto i = box.Begin; i < box.End; i++)
+            {
+                auto weight = static_cast<double>(entries[i].Count);
+                r += entries[i].R * weight;
+                g += entries[i].G * weight;
+                b += entries[i].B * weight;
+            }
+            auto count = static_cast<double>(box.Count);
+            palette.push_back(ToColor(r / count, g / count, b / count));
+        }
+        return palette;
+    }
+
+    void RefineWithKMeans(std::vector<ColorEntry> const& entries, std::vector<GifColor>& palette, uint32_t iterations)
+    {
+        struct Centroid
+        {
+            double R;
+            double G;
+            double B;
+            double Count;
+        };
+
+        std::vector<double> centers(palette.size() * 3);
+        for (size_t i = 0; i < palette.size(); i++)
+        {
+            centers[i * 3] = palette[i].R;
+            centers[i * 3 + 1] = palette[i].G;
+            centers[i * 3 + 2] = palette[i].B;
+        }
+
+        std::vector<Centroid> sums(palette.size());
+        for (uint32_t iteration = 0; iteration < iterations; iteration++)
+        {
+            std::fill(sums.begin(), sums.end(), Centroid{ 0, 0, 0, 0 });
+            for (auto&& entry : entries)
+            {
+                size_t nearest = 0;
+                auto nearestDistance = 1e30;
+                for (size_t i = 0; i < palette.size(); i++)
+                {
+                    auto dr = entry.R - centers[i * 3];
+                    auto dg = entry.G - centers[i * 3 + 1];
+                    auto db = entry.B - centers[i * 3 + 2];
+                    auto distance = dr * dr + dg * dg + db * db;
+                    if (distance < nearestDistance)
+                    {
+                        nearestDistance = distance;
+                        nearest = i;
+                    }
+                }
+                auto weight = static_cast<double>(entry.Count);
+                sums[nearest].R += entry.R * weight;
+                sums[nearest].G += entry.G * weight;
+                sums[nearest].B += entry.B * weight;
+                sums[nearest].Count += weight;
+            }
+
+            for (size_t i = 0; i < palette.size(); i++)
+            {
+                // Empty clusters keep their previous center
+                if (sums[i].Count > 0)
+                {
+                    centers[i * 3] = sums[i].R / sums[i].Count;
+                    centers[i * 3 + 1] = sums[i].G / sums[i].Count;
+                    centers[i * 3 + 2] = sums[i].B / sums[i].Count;
+                }
+            }
+        }
+
+        for (size_t i = 0; i < palette.size(); i++)
+        {
+            palette[i] = ToColor(centers[i * 3], centers[i * 3 + 1], centers[i * 3 + 2]);
+        }
+    }
+}
+
+ColorHistogram::ColorHistogram()
+{
+    m_bins.resize(BinCount, Bin{ 0, 0, 0, 0 });
+}
+
+void ColorHistogram::Clear()
+{
+    for (auto index : m_usedBins)
+    {
+        m_bins[index] = Bin{ 0, 0, 0, 0 };
+    }
+    m_usedBins.clear();
+    m_totalCount = 0;
+}
+
+void ColorHistogram::AddToBin(uint32_t index, uint32_t pixel, uint64_t count)
+{
+    auto&& bin = m_bins[index];
+    if (bin.Count == 0)
+    {
+        m_usedBins.push_back(index);
+    }
+    bin.B += static_cast<uint64_t>(pixel & 0xFF) * count;
+    bin.G += static_cast<uint64_t>((pixel >> 8) & 0xFF) * count;
+    bin.R += static_cast<uint64_t>((pixel >> 16) & 0xFF) * count;
+    bin.Count += count;
+    m_totalCount += count;
+}
+
+void ColorHistogram::AddColor(uint32_t pixel, uint64_t count)
+{
+    auto b = static_cast<uint8_t>(pixel);
+    auto g = static_cast<uint8_t>(pixel >> 8);
+    auto r = static_cast<uint8_t>(pixel >> 16);
+    AddToBin(BinIndex(r, g, b), pixel, count);
+}
+
+void ColorHistogram::AddRows(uint8_t const* pixels, size_t stride, uint32_t width, uint32_t height)
+{
+    auto computeBinIndices = SelectBinIndicesKernel();
+    std::vector<uint32_t> rowPixels(width);
+    std::vector<uint32_t> binIndices(width);
+    for (uint32_t y = 0; y < height; y++)
+    {
+        memcpy(rowPixels.data(), pixels + (static_cast<size_t>(y) * stride), static_cast<size_t>(width) * 4);
+        computeBinIndices(rowPixels.data(), width, binIndices.data());
+
+        // Screen content is full of runs of the same color, so only
+        // touch the bin once per run.
+        uint32_t x = 0;
+        while (x < width)
+        {
+            auto pixel = rowPixels[x];
+            auto runStart = x;
+            while (x < width && rowPixels[x] == pixel)
+            {
+                x++;
+            }
+            AddToBin(binIndices[runStart], pixel, x - runStart);
+        }
+    }
+}
+
+void ColorHistogram::AddPixels(uint8_t const* pixels, size_t stride, uint32_t width, uint32_t height, ThreadPool* threadPool)
+{
+    auto pixelCount = static_cast<size_t>(width) * height;
+    if (threadPool == nullptr || pixelCount < MinPixelsForParallelHistogram || height < 2)
+    {
+        AddRows(pixels, stride, width, height);
+        return;
+    }
+
+    auto bandCount = std::min<uint32_t>(threadPool->ThreadCount(), height);
+    while (m_bandHistograms.size() < bandCount)
+    {
+        m_bandHistograms.push_back(std::make_unique<ColorHistogram>());
+    }
+    auto rowsPerBand = (height + bandCount - 1) / bandCount;
+    threadPool->ParallelFor(bandCount, [&](size_t band)
+        {
+            auto firstRow = std::min(static_cast<uint32_t>(band) * rowsPerBand, height);
+            auto lastRow = std::min(firstRow + rowsPerBand, height);
+            auto&& histogram = m_bandHistograms[band];
+            histogram->Clear();
+            histogram->AddRows(pixels + (static_cast<size_t>(firstRow) * stride), stride, width, lastRow - firstRow);
+        });
+    for (uint32_t band = 0; band < bandCount; band++)
+    {
+        Merge(*m_bandHistograms[band]);
+    }
+}
+
+void ColorHistogram::Merge(ColorHistogram const& other, uint64_t weight)
+{
+    for (auto index : other.m_usedBins)
+    {
+        auto&& source = other.m_bins[index];
+        auto&& bin = m_bins[index];
+        if (bin.Count == 0)
+        {
+            m_usedBins.push_back(index);
+        }
+        bin.R += source.R * weight;
+        bin.G += source.G * weight;
+        bin.B += source.B * weight;
+        bin.Count += source.Count * weight;
+        m_totalCount += source.Count * weight;
+    }
+}
+
+ColorQuantizer::ColorQuantizer(QuantizerOptions const& options, ThreadPool* threadPool)
+{
+    m_options = options;
+    m_options.MaxColors = std::min(std::max(m_options.MaxColors, 2u), 256u);
+    m_threadPool = threadPool;
+}
+
+ColorHistogram const& ColorQuantizer::CountColors(uint8_t const* pixels, size_t stride, uint32_t width, uint32_t height)
+{
+    m_histogram.Clear();
+    m_histogram.AddPixels(pixels, stride, width, height, m_threadPool);
+    return m_histogram;
+}
+
+std::vector<GifColor> ColorQuantizer::BuildPalette(uint8_t const* pixels, size_t stride, uint32_t width, uint32_t height)
+{
+    return BuildPalette(CountColors(pixels, stride, width, height));
+}
+
+std::vector<GifColor> ColorQuantizer::BuildPalette(ColorHistogram const& histogram) const
+{
+    auto entries = GatherEntries(histogram);
+    if (entries.empty())
+    {
+        return { GifColor{ 0, 0, 0 } };
+    }
+
+    switch (m_options.Algorithm)
+    {
+    case QuantizerAlgorithm::Octree:
+        return BuildOctreePalette(entries, m_options.MaxColors);
+    case QuantizerAlgorithm::MedianCut:
+        return BuildMedianCutPalette(entries, m_options.MaxColors);
+    case QuantizerAlgorithm::KMeans:
+    {
+        auto palette = BuildMedianCutPalette(entries, m_options.MaxColors);
+        RefineWithKMeans(entries, palette, m_options.KMeansIterations);
+        return palette;
+    }
+    default:
+        return BuildOctreePalette(entries, m_options.MaxColors);
+    }
+}
+
+uint8_t FindNearestColor(std::vector<GifColor> const& palette, uint8_t r, uint8_t g, uint8_t b)
+{
+    uint8_t nearest = 0;
+    auto nearestDistance = INT32_MAX;
+    for (size_t i = 0; i < palette.size(); i++)
+    {
+        auto dr = static_cast<int32_t>(palette[i].R) - r;
+        auto dg = static_cast<int32_t>(palette[i].G) - g;
+        auto db = static_cast<int32_t>(palette[i].B) - b;
+        auto distance = dr * dr + dg * dg + db * db;
+        if (distance < nearestDistance)
+        {
+            nearestDistance = distance;
+            nearest = static_cast<uint8_t>(i);
+        }
+    }
+    return nearest;
+}
+
+void MapToPalette(std::vector<GifColor> const& palette, uint8_t const* pixels, size_t stride, uint32_t width, uint32_t height, uint8_t* indices)
+{
+    uint32_t previousPixel = 0;
+    uint8_t previousIndex = FindNearestColor(palette, 0, 0, 0);
+    for (uint32_t y = 0; y < height; y++)
+    {
+        auto row = pixels + (static_cast<size_t>(y) * stride);
+        for (uint32_t x = 0; x < width; x++)
+        {
+            uint32_t pixel = 0;
+            memcpy(&pixel, row + (static_cast<size_t>(x) * 4), sizeof(pixel));
+            // Ignore alpha
+            pixel &= 0x00FFFFFF;
+            if (pixel != previousPixel)
+            {
+                previousPixel = pixel;
+                previousIndex = FindNearestColor(palette, static_cast<uint8_t>(pixel >> 16), static_cast<uint8_t>(pixel >> 8), static_cast<uint8_t>(pixel));
+            }
+            *indices++ = previousIndex;
+        }
+    }
+}
@@ -0,0 +1,100 @@
+#pragma once
+#include "GifWriter.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+class ThreadPool;
+
+// Counts BGRA8 pixels in 5-5-5 bins. Each bin also keeps the sum of the
+// exact colors that landed in it, so palettes built from the histogram
+// aren't limited to bin centers.
+class ColorHistogram
+{
+public:
+    static constexpr uint32_t BitsPerChannel = 5;
+    static constexpr uint32_t BinCount = 1u << (BitsPerChannel * 3);
+
+    struct Bin
+    {
+        uint64_t R;
+        uint64_t G;
+        uint64_t B;
+        uint64_t Count;
+    };
+
+    ColorHistogram();
+
+    void Clear();
+    // Large regions are split into row bands that are counted in
+    // parallel and merged afterwards.
+    void AddPixels(uint8_t const* pixels, size_t stride, uint32_t width, uint32_t height, ThreadPool* threadPool = nullptr);
+    // Adds a single BGRA8 pixel as if it had been seen count times
+    void AddColor(uint32_t pixel, uint64_t count);
+    // Adds every bin of another histogram, multiplying its counts by
+    // the provided weight.
+    void Merge(ColorHistogram const& other, uint64_t weight = 1);
+
+    Bin const& operator[](uint32_t index) const { return m_bins[index]; }
+    // Indices of the bins that have a non-zero count
+    std::vector<uint32_t> const& UsedBins() const { return m_usedBins; }
+    uint64_t TotalCount() const { return m_totalCount; }
+
+    static uint32_t BinIndex(uint8_t r, uint8_t g, uint8_t b)
+    {
+        return (static_cast<uint32_t>(r >> 3) << 10) | (static_cast<uint32_t>(g >> 3) << 5) | static_cast<uint32_t>(b >> 3);
+    }
+
+private:
+    void AddRows(uint8_t const* pixels, size_t stride, uint32_t width, uint32_t height);
+    void AddToBin(uint32_t index, uint32_t pixel, uint64_t count);
+
+private:
+    std::vector<Bin> m_bins;
+    std::vector<uint32_t> m_usedBins;
+    uint64_t m_totalCount = 0;
+    std::vector<std::unique_ptr<ColorHistogram>> m_bandHistograms;
+};
+
+enum class QuantizerAlgorithm
+{
+    // Fast enough for the live path
+    Octree,
+    // Better balanced palettes at a slightly higher cost
+    MedianCut,
+    // Median cut followed by a few rounds of k-means, for offline encodes
+    KMeans,
+};
+
+struct QuantizerOptions
+{
+    QuantizerAlgorithm Algorithm = QuantizerAlgorithm::Octree;
+    // Smaller palettes are faster to build and map to and compress better
+    uint32_t MaxColors = 256;
+    uint32_t KMeansIterations = 3;
+};
+
+class ColorQuantizer
+{
+public:
+    ColorQuantizer(QuantizerOptions const& options = {}, ThreadPool* threadPool = nullptr);
+
+    QuantizerOptions const& Options() const { return m_options; }
+
+    // Counts the colors of a region into the quantizer's own histogram.
+    ColorHistogram const& CountColors(uint8_t const* pixels, size_t stride, uint32_t width, uint32_t height);
+    std::vector<GifColor> BuildPalette(uint8_t const* pixels, size_t stride, uint32_t width, uint32_t height);
+    std::vector<GifColor> BuildPalette(ColorHistogram const& histogram) const;
+
+private:
+    QuantizerOptions m_options = {};
+    ThreadPool* m_threadPool = nullptr;
+    ColorHistogram m_histogram;
+};
+
+// Finds the closest palette entry by squared RGB distance.
+uint8_t FindNearestColor(std::vector<GifColor> const& palette, uint8_t r, uint8_t g, uint8_t b);
+// Maps BGRA8 pixels to their nearest palette entries. The indices are
+// tightly packed.
+void MapToPalette(std::vector<GifColor> const& palette, uint8_t const* pixels, size_t stride, uint32_t width, uint32_t height, uint8_t* indices);
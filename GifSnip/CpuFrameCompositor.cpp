@@ -0,0 +1,50 @@
+#include "CpuFrameCompositor.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace
+{
+    constexpr uint32_t ClearColor = 0xFF000000; // BGRA
+}
+
+CpuFrameCompositor::CpuFrameCompositor(DiffRect const& rect)
+{
+    if (rect.Right <= rect.Left || rect.Bottom <= rect.Top)
+    {
+        throw std::invalid_argument("Invalid crop rect");
+    }
+    m_rect = rect;
+    m_view.Width = rect.Right - rect.Left;
+    m_view.Height = rect.Bottom - rect.Top;
+    m_view.Stride = static_cast<size_t>(m_view.Width) * 4;
+    m_pixels.resize(m_view.Stride * m_view.Height);
+    m_view.Data = m_pixels.data();
+}
+
+FrameBufferView const& CpuFrameCompositor::ProcessFrame(SourceFrame const& frame)
+{
+    auto&& surface = frame.Surface;
+    auto right = std::min(m_rect.Right, surface.Width);
+    auto bottom = std::min(m_rect.Bottom, surface.Height);
+    auto covered = right > m_rect.Left && bottom > m_rect.Top;
+    auto coveredWidth = covered ? right - m_rect.Left : 0;
+    auto coveredHeight = covered ? bottom - m_rect.Top : 0;
+
+    for (uint32_t y = 0; y < m_view.Height; y++)
+    {
+        auto dest = m_view.Row(y);
+        uint32_t x = 0;
+        if (y < coveredHeight)
+        {
+            auto source = surface.Row(m_rect.Top + y) + (static_cast<size_t>(m_rect.Left) * 4);
+            memcpy(dest, source, static_cast<size_t>(coveredWidth) * 4);
+            x = coveredWidth;
+        }
+        for (; x < m_view.Width; x++)
+        {
+            memcpy(dest + (static_cast<size_t>(x) * 4), &ClearColor, sizeof(ClearColor));
+        }
+    }
+    return m_view;
+}
@@ -0,0 +1,26 @@
+#pragma once
+#include "FrameSource.h"
+#include "DiffRect.h"
+#include <vector>
+
+// CPU counterpart to FrameCompositor. Crops the recorded rect out of
+// each source frame into a frame of its own, filling whatever the
+// source doesn't cover with opaque black.
+class CpuFrameCompositor
+{
+public:
+    // The rect uses exclusive Right/Bottom.
+    CpuFrameCompositor(DiffRect const& rect);
+
+    uint32_t Width() const { return m_view.Width; }
+    uint32_t Height() const { return m_view.Height; }
+
+    // The composed frame is only valid until the next call.
+    FrameBufferView const& ProcessFrame(SourceFrame const& frame);
+    FrameBufferView const& RepeatFrame() const { return m_view; }
+
+private:
+    DiffRect m_rect = {};
+    std::vector<uint8_t> m_pixels;
+    FrameBufferView m_view = {};
+};
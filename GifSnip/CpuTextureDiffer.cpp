@@ -0,0 +1,644 @@
+#include "CpuTextureDiffer.h"
+#include "ThreadPool.h"
+#include "Simd.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+namespace
+{
+    // Bands smaller than this aren't worth the hand off to another thread.
+    constexpr uint32_t MinRowsPerBand = 64;
+
+    // Both return values are in pixels. FindFirstDifference returns the
+    // index of the first differing pixel (or count), FindLastDifference
+    // returns one past the last differing pixel (or 0).
+    using FindDifferenceFunction = size_t(*)(uint32_t const* current, uint32_t const* previous, size_t count);
+
+    size_t FindFirstDifferenceScalar(uint32_t const* current, uint32_t const* previous, size_t count)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            if (current[i] != previous[i])
+            {
+                return i;
+            }
+        }
+        return count;
+    }
+
+    size_t FindLastDifferenceScalar(uint32_t const* current, uint32_t const* previous, size_t count)
+    {
+        for (size_t i = count; i > 0; i--)
+        {
+            if (current[i - 1] != previous[i - 1])
+            {
+                return i;
+            }
+        }
+        return 0;
+    }
+
+#if defined(GIFSNIP_X64)
+    GIFSNIP_TARGET_SSE41 size_t FindFirstDifferenceSse41(uint32_t const* current, uint32_t const* previous, size_t count)
+    {
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4)
+        {
+            auto a = _mm_loadu_si128(reinterpret_cast<__m128i const*>(current + i));
+            auto b = _mm_loadu_si128(reinterpret_cast<__m128i const*>(previous + i));
+            auto difference = _mm_xor_si128(a, b);
+            if (!_mm_testz_si128(difference, difference))
+            {
+                auto equalMask = static_cast<uint32_t>(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(a, b))));
+                return i + CountTrailingZeros(~equalMask & 0xF);
+            }
+        }
+        return i + FindFirstDifferenceScalar(current + i, previous + i, count - i);
+    }
+
+    GIFSNIP_TARGET_SSE41 size_t FindLastDifferenceSse41(uint32_t const* current, uint32_t const* previous, size_t count)
+    {
+        auto i = count;
+        for (; i >= 4; i -= 4)
+        {
+            auto a = _mm_loadu_si128(reinterpret_cast<__m128i const*>(current + i - 4));
+            auto b = _mm_loadu_si128(reinterpret_cast<__m128i const*>(previous + i - 4));
+            auto difference = _mm_xor_si128(a, b);
+            if (!_mm_testz_si128(difference, difference))
+            {
+                auto equalMask = static_cast<uint32_t>(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(a, b))));
+                return i - 4 + HighestSetBit(~equalMask & 0xF) + 1;
+            }
+        }
+        return FindLastDifferenceScalar(current, previous, i);
+    }
+
+    GIFSNIP_TARGET_AVX2 size_t FindFirstDifferenceAvx2(uint32_t const* current, uint32_t const* previous, size_t count)
+    {
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            auto a = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(current + i));
+            auto b = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(previous + i));
+            auto difference = _mm256_xor_si256(a, b);
+            if (!_mm256_testz_si256(difference, difference))
+            {
+                auto equalMask = static_cast<uint32_t>(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(a, b))));
+                return i + CountTrailingZeros(~equalMask & 0xFF);
+            }
+        }
+        return i + FindFirstDifferenceScalar(current + i, previous + i, count - i);
+    }
+
+    GIFSNIP_TARGET_AVX2 size_t FindLastDifferenceAvx2(uint32_t const* current, uint32_t const* previous, size_t count)
+    {
+        auto i = count;
+        for (; i >= 8; i -= 8)
+        {
+            auto a = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(current + i - 8));
+            auto b = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(previous + i - 8));
+            auto difference = _mm256_xor_si256(a, b);
+            if (!_mm256_testz_si256(difference, difference))
+            {
+                auto equalMask = static_cast<uint32_t>(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(a, b))));
+                return i - 8 + HighestSetBit(~equalMask & 0xFF) + 1;
+            }
+        }
+        return FindLastDifferenceScalar(current, previous, i);
+    }
+#elif defined(GIFSNIP_ARM64)
+    size_t FindFirstDifferenceNeon(uint32_t const* current, uint32_t const* previous, size_t count)
+    {
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4)
+        {
+            auto equal = vceqq_u32(vld1q_u32(current + i), vld1q_u32(previous + i));
+            if (vminvq_u32(equal) == 0)
+            {
+                return i + FindFirstDifferenceScalar(current + i, previous + i, 4);
+            }
+        }
+        return i + FindFirstDifferenceScalar(current + i, previous + i, count - i);
+    }
+
+    size_t FindLastDifferenceNeon(uint32_t const* current, uint32_t const* previous, size_t count)
+    {
+        auto i = count;
+        for (; i >= 4; i -= 4)
+        {
+            auto equal = vceqq_u32(vld1q_u32(current + i - 4), vld1q_u32(previous + i - 4));
+            if (vminvq_u32(equal) == 0)
+            {
+                return i - 4 + FindLastDifferenceScalar(current + i - 4, previous + i - 4, 4);
+            }
+        }
+        return FindLastDifferenceScalar(current, previous, i);
+    }
+#endif
+
+    struct DiffKernels
+    {
+        FindDifferenceFunction FindFirstDifference;
+        FindDifferenceFunction FindLastDifference;
+    };
+
+    DiffKernels const& SelectKernels()
+    {
+        static const DiffKernels kernels = []()
+        {
+            DiffKernels result = { FindFirstDifferenceScalar, FindLastDifferenceScalar };
+#if defined(GIFSNIP_X64)
+            auto&& features = CpuFeatures::Current();
+            if (features.Avx2)
+            {
+                result = { FindFirstDifferenceAvx2, FindLastDifferenceAvx2 };
+            }
+            else if (features.Sse41)
+            {
+                result = { FindFirstDifferenceSse41, FindLastDifferenceSse41 };
+            }
+#elif defined(GIFSNIP_ARM64)
+            result = { FindFirstDifferenceNeon, FindLastDifferenceNeon };
+#endif
+            return result;
+        }();
+        return kernels;
+    }
+
+    // Counts the pixels that moved by more than the threshold, per
+    // channel or in luma depending on the kernel.
+    using CountChangedFunction = uint32_t(*)(uint32_t const* current, uint32_t const* previous, uint32_t count, uint32_t threshold);
+
+    uint32_t CountChangedChannelScalar(uint32_t const* current, uint32_t const* previous, uint32_t count, uint32_t threshold)
+    {
+        uint32_t changed = 0;
+        for (uint32_t i = 0; i < count; i++)
+        {
+            auto a = current[i];
+            auto b = previous[i];
+            for (uint32_t shift = 0; shift < 32; shift += 8)
+            {
+                auto channelA = static_cast<int32_t>((a >> shift) & 0xFF);
+                auto channelB = static_cast<int32_t>((b >> shift) & 0xFF);
+                if (static_cast<uint32_t>(std::abs(channelA - channelB)) > threshold)
+                {
+                    changed++;
+                    break;
+                }
+            }
+        }
+        return changed;
+    }
+
+    inline int32_t WeightedLuma(uint32_t pixel)
+    {
+        return static_cast<int32_t>(
+            (((pixel >> 16) & 0xFF) * LumaWeights::Red) +
+            (((pixel >> 8) & 0xFF) * LumaWeights::Green) +
+            ((pixel & 0xFF) * LumaWeights::Blue));
+    }
+
+    uint32_t CountChangedLumaScalar(uint32_t const* current, uint32_t const* previous, uint32_t count, uint32_t threshold)
+    {
+        auto scaledThreshold = threshold * LumaWeights::Scale;
+        uint32_t changed = 0;
+        for (uint32_t i = 0; i < count; i++)
+        {
+            if (static_cast<uint32_t>(std::abs(WeightedLuma(current[i]) - WeightedLuma(previous[i]))) > scaledThreshold)
+            {
+                changed++;
+            }
+        }
+        return changed;
+    }
+
+#if defined(GIFSNIP_X64)
+    GIFSNIP_TARGET_AVX2 uint32_t CountChangedChannelAvx2(uint32_t const* current, uint32_t const* previous, uint32_t count, uint32_t threshold)
+    {
+        auto limit = _mm256_set1_epi8(static_cast<char>(std::min(threshold, 255u)));
+        auto zero = _mm256_setzero_si256();
+        uint32_t changed = 0;
+        uint32_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            auto a = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(current + i));
+            auto b = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(previous + i));
+            auto difference = _mm256_or_si256(_mm256_subs_epu8(a, b), _mm256_subs_epu8(b, a));
+            // Non-zero wherever a channel is past the threshold
+            auto over = _mm256_subs_epu8(difference, limit);
+            auto unchangedMask = static_cast<uint32_t>(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(over, zero))));
+            changed += 8 - PopCount(unchangedMask);
+        }
+        return changed + CountChangedChannelScalar(current + i, previous + i, count - i, threshold);
+    }
+
+    GIFSNIP_TARGET_AVX2 inline __m256i WeightedLumaAvx2(__m256i pixels)
+    {
+        // B, G, R, A weights for each pixel, summed in pairs and then
+        // pairs of pairs
+        auto weights = _mm256_set1_epi32(static_cast<int>(LumaWeights::Blue | (LumaWeights::Green << 8) | (LumaWeights::Red << 16)));
+        auto pairs = _mm256_maddubs_epi16(pixels, weights);
+        return _mm256_madd_epi16(pairs, _mm256_set1_epi16(1));
+    }
+
+    GIFSNIP_TARGET_AVX2 uint32_t CountChangedLumaAvx2(uint32_t const* current, uint32_t const* previous, uint32_t count, uint32_t threshold)
+    {
+        auto limit = _mm256_set1_epi32(static_cast<int>(threshold * LumaWeights::Scale));
+        uint32_t changed = 0;
+        uint32_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            auto a = WeightedLumaAvx2(_mm256_loadu_si256(reinterpret_cast<__m256i const*>(current + i)));
+            auto b = WeightedLumaAvx2(_mm256_loadu_si256(reinterpret_cast<__m256i const*>(previous + i)));
+            auto difference = _mm256_abs_epi32(_mm256_sub_epi32(a, b));
+            auto changedMask = static_cast<uint32_t>(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(difference, limit))));
+            changed += PopCount(changedMask);
+        }
+        return changed + CountChangedLumaScalar(current + i, previous + i, count - i, threshold);
+    }
+#endif
+
+    struct ToleranceKernels
+    {
+        CountChangedFunction CountChangedChannel;
+        CountChangedFunction CountChangedLuma;
+    };
+
+    ToleranceKernels const& SelectToleranceKernels()
+    {
+        static const ToleranceKernels kernels = []()
+        {
+            ToleranceKernels result = { CountChangedChannelScalar, CountChangedLumaScalar };
+#if defined(GIFSNIP_X64)
+            if (CpuFeatures::Current().Avx2)
+            {
+                result = { CountChangedChannelAvx2, CountChangedLumaAvx2 };
+            }
+#endif
+            return result;
+        }();
+        return kernels;
+    }
+
+    // Same layout and initial values as the shader's diff buffer.
+    struct BandResult
+    {
+        uint32_t Left;
+        uint32_t Top;
+        uint32_t Right;
+        uint32_t Bottom;
+    };
+
+    // One byte per tile so that bands can write to it without racing.
+    struct TileFlags
+    {
+        std::vector<uint8_t> Flags;
+        uint32_t TileSize;
+        uint32_t ColumnCount;
+    };
+
+    void DiffRows(
+        uint8_t const* current,
+        size_t currentStride,
+        uint8_t const* previous,
+        size_t previousStride,
+        uint32_t diffWidth,
+        uint32_t diffHeight,
+        uint32_t firstRow,
+        uint32_t lastRow,
+        BandResult& result,
+        TileFlags* tiles)
+    {
+        auto&& kernels = SelectKernels();
+        auto rowBytes = static_cast<size_t>(diffWidth) * 4;
+        for (auto y = firstRow; y < std::min(lastRow, diffHeight); y++)
+        {
+            auto currentRow = current + (static_cast<size_t>(y) * currentStride);
+            auto previousRow = previous + (static_cast<size_t>(y) * previousStride);
+
+            // Most rows don't change at all, so check the whole row first.
+            if (memcmp(currentRow, previousRow, rowBytes) == 0)
+            {
+                continue;
+            }
+
+            auto currentPixels = reinterpret_cast<uint32_t const*>(currentRow);
+            auto previousPixels = reinterpret_cast<uint32_t const*>(previousRow);
+
+            // Like the shader, tiles only see the pixels it compares
+            if (tiles != nullptr)
+            {
+                auto tileRow = tiles->Flags.data() + (static_cast<size_t>(y / tiles->TileSize) * tiles->ColumnCount);
+                for (uint32_t column = 0; column < tiles->ColumnCount; column++)
+                {
+                    auto tileLeft = column * tiles->TileSize;
+                    if (tileRow[column] || tileLeft >= diffWidth)
+                    {
+                        continue;
+                    }
+                    auto tileWidth = std::min(tiles->TileSize, diffWidth - tileLeft);
+                    if (memcmp(currentPixels + tileLeft, previousPixels + tileLeft, static_cast<size_t>(tileWidth) * 4) != 0)
+                    {
+                        tileRow[column] = 1;
+                    }
+                }
+            }
+
+            auto left = kernels.FindFirstDifference(currentPixels, previousPixels, diffWidth);
+            result.Left = std::min(result.Left, static_cast<uint32_t>(left));
+
+            // Only look for changes that would widen what we already have.
+            auto rightStart = std::max(result.Right + 1, static_cast<uint32_t>(left));
+            if (result.Top > result.Bottom)
+            {
+                // Nothing found yet in this band
+                rightStart = static_cast<uint32_t>(left);
+            }
+            if (rightStart < diffWidth)
+            {
+                auto right = kernels.FindLastDifference(currentPixels + rightStart, previousPixels + rightStart, diffWidth - rightStart);
+                if (right > 0)
+                {
+                    result.Right = static_cast<uint32_t>(rightStart + right - 1);
+                }
+            }
+
+            result.Top = std::min(result.Top, y);
+            result.Bottom = y;
+        }
+    }
+
+    // Counts changed pixels per tile over a band of rows. Like DiffRows,
+    // only the region the shader is dispatched over gets compared.
+    void CountChangedRows(
+        uint8_t const* current,
+        size_t currentStride,
+        uint8_t const* previous,
+        size_t previousStride,
+        uint32_t diffWidth,
+        uint32_t diffHeight,
+        uint32_t firstRow,
+        uint32_t lastRow,
+        DiffTolerance const& tolerance,
+        uint32_t tileSize,
+        uint32_t columnCount,
+        uint32_t* tileCounts)
+    {
+        auto&& kernels = SelectToleranceKernels();
+        auto countChanged = tolerance.Mode == ToleranceMode::Luma ? kernels.CountChangedLuma : kernels.CountChangedChannel;
+        auto threshold = tolerance.Mode == ToleranceMode::Exact ? 0 : tolerance.Threshold;
+        auto rowBytes = static_cast<size_t>(diffWidth) * 4;
+        for (auto y = firstRow; y < std::min(lastRow, diffHeight); y++)
+        {
+            auto currentRow = current + (static_cast<size_t>(y) * currentStride);
+            auto previousRow = previous + (static_cast<size_t>(y) * previousStride);
+            if (memcmp(currentRow, previousRow, rowBytes) == 0)
+            {
+                continue;
+            }
+
+            auto currentPixels = reinterpret_cast<uint32_t const*>(currentRow);
+            auto previousPixels = reinterpret_cast<uint32_t const*>(previousRow);
+            auto tileRow = tileCounts + (static_cast<size_t>(y / tileSize) * columnCount);
+            for (uint32_t column = 0; column < columnCount; column++)
+            {
+                auto tileLeft = column * tileSize;
+                if (tileLeft >= diffWidth)
+                {
+                    break;
+                }
+                auto tileWidth = std::min(tileSize, diffWidth - tileLeft);
+                if (memcmp(currentPixels + tileLeft, previousPixels + tileLeft, static_cast<size_t>(tileWidth) * 4) != 0)
+                {
+                    tileRow[column] += countChanged(currentPixels + tileLeft, previousPixels + tileLeft, tileWidth, threshold);
+                }
+            }
+        }
+    }
+}
+
+CpuTextureDiffer::CpuTextureDiffer(uint32_t width, uint32_t height, ThreadPool* threadPool, uint32_t tileSize, ChangeDetection detection, DiffTolerance const& tolerance)
+{
+    m_width = width;
+    m_height = height;
+    m_threadPool = threadPool;
+    m_tolerance = tolerance;
+    m_dirtyTiles = DirtyTileMap(width, height, tileSize);
+    if (detection == ChangeDetection::TileHash)
+    {
+        m_hashDiffer = std::make_unique<TileHashDiffer>(width, height, threadPool, tileSize);
+    }
+    else
+    {
+        m_previousFrame.resize(static_cast<size_t>(width) * height * 4);
+        if (!tolerance.IsExact())
+        {
+            m_tileCounts.resize(static_cast<size_t>(m_dirtyTiles.ColumnCount()) * m_dirtyTiles.RowCount());
+        }
+    }
+}
+
+std::optional<DiffRect> CpuTextureDiffer::ProcessFrame(uint8_t const* pixels, size_t stride)
+{
+    if (m_hashDiffer)
+    {
+        return m_hashDiffer->ProcessFrame(pixels, stride, m_dirtyTiles);
+    }
+
+    auto previousStride = static_cast<size_t>(m_width) * 4;
+    auto copyRows = [&](uint32_t firstRow, uint32_t lastRow)
+    {
+        for (auto y = firstRow; y < lastRow; y++)
+        {
+            memcpy(m_previousFrame.data() + (static_cast<size_t>(y) * previousStride), pixels + (static_cast<size_t>(y) * stride), previousStride);
+        }
+    };
+
+    if (m_firstFrame)
+    {
+        m_firstFrame = false;
+        copyRows(0, m_height);
+        m_dirtyTiles.MarkAll();
+        return std::optional<DiffRect>(DiffRect{ 0, 0, m_width, m_height });
+    }
+
+    if (!m_tolerance.IsExact())
+    {
+        return ProcessFrameWithTolerance(pixels, stride);
+    }
+
+    auto diffRect = DiffBuffers(pixels, stride, m_previousFrame.data(), previousStride, m_width, m_height, m_threadPool, &m_dirtyTiles);
+
+    // Tiles cover every changed pixel that gets compared, so only the
+    // rows they span need to be carried over.
+    auto tileSize = m_dirtyTiles.TileSize();
+    for (uint32_t row = 0; row < m_dirtyTiles.RowCount(); row++)
+    {
+        for (uint32_t column = 0; column < m_dirtyTiles.ColumnCount(); column++)
+        {
+            if (m_dirtyTiles.IsDirty(column, row))
+            {
+                copyRows(row * tileSize, std::min((row + 1) * tileSize, m_height));
+                break;
+            }
+        }
+    }
+    return diffRect;
+}
+
+std::optional<DiffRect> CpuTextureDiffer::ProcessFrameWithTolerance(uint8_t const* pixels, size_t stride)
+{
+    auto previousStride = static_cast<size_t>(m_width) * 4;
+    auto diffWidth = (m_width / 2) * 2;
+    auto diffHeight = (m_height / 2) * 2;
+    auto tileSize = m_dirtyTiles.TileSize();
+    auto columnCount = m_dirtyTiles.ColumnCount();
+    auto rowCount = m_dirtyTiles.RowCount();
+
+    // Bands start on a tile boundary so that they never share a tile
+    auto&& tileCounts = m_tileCounts;
+    std::fill(tileCounts.begin(), tileCounts.end(), 0);
+    auto bandCount = m_threadPool != nullptr ? std::min(m_height / MinRowsPerBand, m_threadPool->ThreadCount() * 2) : 1u;
+    if (bandCount <= 1)
+    {
+        CountChangedRows(pixels, stride, m_previousFrame.data(), previousStride, diffWidth, diffHeight, 0, m_height, m_tolerance, tileSize, columnCount, tileCounts.data());
+    }
+    else
+    {
+        auto rowsPerBand = (m_height + bandCount - 1) / bandCount;
+        rowsPerBand = ((rowsPerBand + tileSize - 1) / tileSize) * tileSize;
+        m_threadPool->ParallelFor(bandCount, [&](size_t band)
+            {
+                auto firstRow = std::min(static_cast<uint32_t>(band) * rowsPerBand, m_height);
+                auto lastRow = std::min(firstRow + rowsPerBand, m_height);
+                CountChangedRows(pixels, stride, m_previousFrame.data(), previousStride, diffWidth, diffHeight, firstRow, lastRow, m_tolerance, tileSize, columnCount, tileCounts.data());
+            });
+    }
+
+    // Too little changed to be worth a frame. Nothing is carried over,
+    // so the same changes get compared again next time.
+    uint64_t changedCount = 0;
+    for (auto count : tileCounts)
+    {
+        changedCount += count;
+    }
+    m_dirtyTiles.Clear();
+    if (changedCount == 0 || changedCount < m_tolerance.MinDirtyPixels)
+    {
+        return std::nullopt;
+    }
+
+    // Report whole tiles, and only carry over the tiles we report, so
+    // that what's left behind keeps building up.
+    DiffRect result = { m_width, m_height, 0, 0 };
+    for (uint32_t row = 0; row < rowCount; row++)
+    {
+        for (uint32_t column = 0; column < columnCount; column++)
+        {
+            if (tileCounts[(static_cast<size_t>(row) * columnCount) + column] == 0)
+            {
+                continue;
+            }
+            m_dirtyTiles.Mark(column, row);
+
+            auto left = column * tileSize;
+            auto top = row * tileSize;
+            auto right = std::min(left + tileSize, m_width);
+            auto bottom = std::min(top + tileSize, m_height);
+            for (auto y = top; y < bottom; y++)
+            {
+                memcpy(
+                    m_previousFrame.data() + (static_cast<size_t>(y) * previousStride) + (static_cast<size_t>(left) * 4),
+                    pixels + (static_cast<size_t>(y) * stride) + (static_cast<size_t>(left) * 4),
+                    static_cast<size_t>(right - left) * 4);
+            }
+
+            result.Left = std::min(result.Left, left);
+            result.Top = std::min(result.Top, top);
+            result.Right = std::max(result.Right, right - 1);
+            result.Bottom = std::max(result.Bottom, bottom - 1);
+        }
+    }
+    return std::optional(result);
+}
+
+std::optional<DiffRect> CpuTextureDiffer::DiffBuffers(
+    uint8_t const* current,
+    size_t currentStride,
+    uint8_t const* previous,
+    size_t previousStride,
+    uint32_t width,
+    uint32_t height,
+    ThreadPool* threadPool,
+    DirtyTileMap* dirtyTiles)
+{
+    // The shader is dispatched with (width / 2, height / 2) groups of
+    // 2x2 threads, so only this region is ever compared.
+    auto diffWidth = (width / 2) * 2;
+    auto diffHeight = (height / 2) * 2;
+
+    std::optional<TileFlags> tiles;
+    auto bandAlignment = 1u;
+    if (dirtyTiles != nullptr)
+    {
+        tiles = TileFlags{ std::vector<uint8_t>(static_cast<size_t>(dirtyTiles->ColumnCount()) * dirtyTiles->RowCount(), 0), dirtyTiles->TileSize(), dirtyTiles->ColumnCount() };
+        bandAlignment = dirtyTiles->TileSize();
+    }
+    auto tilesPointer = tiles.has_value() ? &tiles.value() : nullptr;
+
+    BandResult result = { width, height, 0, 0 };
+    auto bandCount = threadPool != nullptr ? std::min(height / MinRowsPerBand, threadPool->ThreadCount() * 2) : 1u;
+    if (bandCount <= 1)
+    {
+        DiffRows(current, currentStride, previous, previousStride, diffWidth, diffHeight, 0, height, result, tilesPointer);
+    }
+    else
+    {
+        std::vector<BandResult> bands(bandCount, result);
+        // Bands start on a tile boundary so that they never share a tile
+        auto rowsPerBand = (height + bandCount - 1) / bandCount;
+        rowsPerBand = ((rowsPerBand + bandAlignment - 1) / bandAlignment) * bandAlignment;
+        threadPool->ParallelFor(bandCount, [&](size_t band)
+            {
+                auto firstRow = std::min(static_cast<uint32_t>(band) * rowsPerBand, height);
+                auto lastRow = std::min(firstRow + rowsPerBand, height);
+                DiffRows(current, currentStride, previous, previousStride, diffWidth, diffHeight, firstRow, lastRow, bands[band], tilesPointer);
+            });
+        for (auto&& band : bands)
+        {
+            if (band.Top <= band.Bottom)
+            {
+                result.Left = std::min(result.Left, band.Left);
+                result.Top = std::min(result.Top, band.Top);
+                result.Right = std::max(result.Right, band.Right);
+                result.Bottom = std::max(result.Bottom, band.Bottom);
+            }
+        }
+    }
+
+    if (dirtyTiles != nullptr)
+    {
+        dirtyTiles->Clear();
+        for (uint32_t row = 0; row < dirtyTiles->RowCount(); row++)
+        {
+            for (uint32_t column = 0; column < dirtyTiles->ColumnCount(); column++)
+            {
+                if (tiles->Flags[(static_cast<size_t>(row) * tiles->ColumnCount) + column])
+                {
+                    dirtyTiles->Mark(column, row);
+                }
+            }
+        }
+    }
+
+    DiffRect diffRect = { result.Left, result.Top, result.Right, result.Bottom };
+    if (diffRect.IsValid())
+    {
+        return std::optional(diffRect);
+    }
+    else
+    {
+        return std::nullopt;
+    }
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include "DiffRect.h"
+#include "DirtyTileMap.h"
+#include "DiffTolerance.h"
+#include "TileHash.h"
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <vector>
+
+class ThreadPool;
+
+// CPU counterpart to TextureDiffer that works on row-pitched BGRA8
+// buffers. Results match TextureDiff.hlsl exactly, including its quirks:
+// Right and Bottom are the last changed column and row (inclusive), and
+// since the shader is dispatched in 2x2 groups, a trailing odd column or
+// row is never compared.
+//
+// With ChangeDetection::TileHash it keeps tile hashes instead of the
+// previous frame, and matches TextureHash.hlsl instead. With a tolerance
+// that isn't exact, the rect is rounded out to whole tiles, and only
+// the tiles it reports are carried over as the previous frame.
+class CpuTextureDiffer
+{
+public:
+    CpuTextureDiffer(
+        uint32_t width,
+        uint32_t height,
+        ThreadPool* threadPool = nullptr,
+        uint32_t tileSize = DirtyTileMap::DefaultTileSize,
+        ChangeDetection detection = ChangeDetection::Exact,
+        DiffTolerance const& tolerance = {});
+
+    // Returns the full frame for the first frame, the changed region
+    // for subsequent frames, or nothing if no pixels changed.
+    std::optional<DiffRect> ProcessFrame(uint8_t const* pixels, size_t stride);
+    // Tiles that changed in the last call to ProcessFrame. Like the
+    // rect, they leave out a trailing odd column or row.
+    DirtyTileMap const& DirtyTiles() const { return m_dirtyTiles; }
+
+    // Compares two frames without touching any state. If a tile map is
+    // provided, it gets filled in as well.
+    static std::optional<DiffRect> DiffBuffers(
+        uint8_t const* current,
+        size_t currentStride,
+        uint8_t const* previous,
+        size_t previousStride,
+        uint32_t width,
+        uint32_t height,
+        ThreadPool* threadPool = nullptr,
+        DirtyTileMap* dirtyTiles = nullptr);
+
+private:
+    std::optional<DiffRect> ProcessFrameWithTolerance(uint8_t const* pixels, size_t stride);
+
+private:
+    uint32_t m_width = 0;
+    uint32_t m_height = 0;
+    ThreadPool* m_threadPool = nullptr;
+    DirtyTileMap m_dirtyTiles;
+    std::vector<uint8_t> m_previousFrame;
+    std::unique_ptr<TileHashDiffer> m_hashDiffer;
+    DiffTolerance m_tolerance = {};
+    // Changed pixels per tile, when there's a tolerance
+    std::vector<uint32_t> m_tileCounts;
+    bool m_firstFrame = true;
+};
@@ -0,0 +1,126 @@
+#include "pch.h"
+#include "D3D11FrameReadback.h"
+
+namespace winrt
+{
+    using namespace Windows::Graphics;
+}
+
+D3D11FrameReadback::D3D11FrameReadback(
+    winrt::com_ptr<ID3D11Device> const& d3dDevice,
+    winrt::com_ptr<ID3D11DeviceContext> const& d3dContext,
+    winrt::SizeInt32 textureSize,
+    uint32_t tileWordCount,
+    uint32_t slotCount)
+{
+    m_d3dContext = d3dContext;
+    m_textureSize = textureSize;
+    m_tileWordCount = tileWordCount;
+
+    D3D11_TEXTURE2D_DESC textureDesc = {};
+    textureDesc.Width = static_cast<uint32_t>(textureSize.Width);
+    textureDesc.Height = static_cast<uint32_t>(textureSize.Height);
+    textureDesc.MipLevels = 1;
+    textureDesc.ArraySize = 1;
+    textureDesc.Format = DXGI_FORMAT_B8G8R8A8_UNORM;
+    textureDesc.SampleDesc.Count = 1;
+    textureDesc.SampleDesc.Quality = 0;
+    textureDesc.Usage = D3D11_USAGE_STAGING;
+    textureDesc.BindFlags = 0;
+    textureDesc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+
+    D3D11_BUFFER_DESC diffBufferDesc = {};
+    diffBufferDesc.ByteWidth = static_cast<uint32_t>(sizeof(DiffRect));
+    diffBufferDesc.Usage = D3D11_USAGE_STAGING;
+    diffBufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+
+    D3D11_BUFFER_DESC tileBufferDesc = {};
+    tileBufferDesc.ByteWidth = static_cast<uint32_t>(tileWordCount * sizeof(uint32_t));
+    tileBufferDesc.Usage = D3D11_USAGE_STAGING;
+    tileBufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+
+    m_slots.resize(std::max(slotCount, 1u));
+    for (auto&& slot : m_slots)
+    {
+        winrt::check_hresult(d3dDevice->CreateTexture2D(&textureDesc, nullptr, slot.Texture.put()));
+        winrt::check_hresult(d3dDevice->CreateBuffer(&diffBufferDesc, nullptr, slot.DiffBuffer.put()));
+        winrt::check_hresult(d3dDevice->CreateBuffer(&tileBufferDesc, nullptr, slot.TileBuffer.put()));
+    }
+}
+
+void D3D11FrameReadback::CopyFrame(
+    uint32_t index,
+    winrt::com_ptr<ID3D11Texture2D> const& frameTexture,
+    winrt::com_ptr<ID3D11Buffer> const& diffBuffer,
+    winrt::com_ptr<ID3D11Buffer> const& tileBuffer)
+{
+    auto&& slot = m_slots.at(index);
+    // The whole frame is copied even when only a few tiles changed.
+    // Which ones did is only known once the diff has run on the GPU, and
+    // finding out here would stall capture until it has.
+    m_d3dContext->CopyResource(slot.DiffBuffer.get(), diffBuffer.get());
+    m_d3dContext->CopyResource(slot.TileBuffer.get(), tileBuffer.get());
+    m_d3dContext->CopyResource(slot.Texture.get(), frameTexture.get());
+}
+
+bool D3D11FrameReadback::Map(uint32_t index, bool wait, ReadbackData& data)
+{
+    auto&& slot = m_slots.at(index);
+
+    // The texture is copied last, so once it's ready the buffers are too
+    D3D11_MAPPED_SUBRESOURCE mappedTexture = {};
+    if (!MapResource(slot.Texture.get(), wait, mappedTexture))
+    {
+        return false;
+    }
+    D3D11_MAPPED_SUBRESOURCE mappedDiff = {};
+    D3D11_MAPPED_SUBRESOURCE mappedTiles = {};
+    auto mappedCount = 1;
+    try
+    {
+        MapResource(slot.DiffBuffer.get(), true, mappedDiff);
+        mappedCount++;
+        MapResource(slot.TileBuffer.get(), true, mappedTiles);
+    }
+    catch (...)
+    {
+        if (mappedCount > 1)
+        {
+            m_d3dContext->Unmap(slot.DiffBuffer.get(), 0);
+        }
+        m_d3dContext->Unmap(slot.Texture.get(), 0);
+        throw;
+    }
+
+    data.Pixels.Data = reinterpret_cast<uint8_t*>(mappedTexture.pData);
+    data.Pixels.Width = static_cast<uint32_t>(m_textureSize.Width);
+    data.Pixels.Height = static_cast<uint32_t>(m_textureSize.Height);
+    data.Pixels.Stride = mappedTexture.RowPitch;
+
+    auto diffRect = *reinterpret_cast<DiffRect const*>(mappedDiff.pData);
+    data.Diff = diffRect.IsValid() ? std::optional(diffRect) : std::nullopt;
+
+    data.TileWords = reinterpret_cast<uint32_t const*>(mappedTiles.pData);
+    data.TileWordCount = m_tileWordCount;
+    return true;
+}
+
+void D3D11FrameReadback::Unmap(uint32_t index)
+{
+    auto&& slot = m_slots.at(index);
+    m_d3dContext->Unmap(slot.TileBuffer.get(), 0);
+    m_d3dContext->Unmap(slot.DiffBuffer.get(), 0);
+    m_d3dContext->Unmap(slot.Texture.get(), 0);
+}
+
+bool D3D11FrameReadback::MapResource(ID3D11Resource* resource, bool wait, D3D11_MAPPED_SUBRESOURCE& mapped)
+{
+    auto flags = wait ? 0u : static_cast<uint32_t>(D3D11_MAP_FLAG_DO_NOT_WAIT);
+    auto hr = m_d3dContext->Map(resource, 0, D3D11_MAP_READ, flags, &mapped);
+    if (hr == DXGI_ERROR_WAS_STILL_DRAWING)
+    {
+        return false;
+    }
+    winrt::check_hresult(hr);
+    return true;
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include "FrameReadback.h"
+
+// FrameReadback on top of D3D11 staging resources. Each slot holds a
+// staging copy of the whole frame, along with the differ's rect and
+// tile buffers.
+class D3D11FrameReadback : public FrameReadback
+{
+public:
+    D3D11FrameReadback(
+        winrt::com_ptr<ID3D11Device> const& d3dDevice,
+        winrt::com_ptr<ID3D11DeviceContext> const& d3dContext,
+        winrt::Windows::Graphics::SizeInt32 textureSize,
+        uint32_t tileWordCount,
+        uint32_t slotCount);
+
+    uint32_t SlotCount() const override { return static_cast<uint32_t>(m_slots.size()); }
+    bool Map(uint32_t slot, bool wait, ReadbackData& data) override;
+    void Unmap(uint32_t slot) override;
+
+    // Queues copies of the frame and the differ's results into a slot.
+    // Nothing waits on the GPU here.
+    void CopyFrame(
+        uint32_t slot,
+        winrt::com_ptr<ID3D11Texture2D> const& frameTexture,
+        winrt::com_ptr<ID3D11Buffer> const& diffBuffer,
+        winrt::com_ptr<ID3D11Buffer> const& tileBuffer);
+
+private:
+    struct Slot
+    {
+        winrt::com_ptr<ID3D11Texture2D> Texture;
+        winrt::com_ptr<ID3D11Buffer> DiffBuffer;
+        winrt::com_ptr<ID3D11Buffer> TileBuffer;
+    };
+
+    bool MapResource(ID3D11Resource* resource, bool wait, D3D11_MAPPED_SUBRESOURCE& mapped);
+
+private:
+    winrt::com_ptr<ID3D11DeviceContext> m_d3dContext;
+    winrt::Windows::Graphics::SizeInt32 m_textureSize = {};
+    uint32_t m_tileWordCount = 0;
+    std::vector<Slot> m_slots;
+};
@@ -0,0 +1,25 @@
+#pragma once
+#include <cstdint>
+
+struct DiffRect
+{
+    uint32_t Left;
+    uint32_t Top;
+    uint32_t Right;
+    uint32_t Bottom;
+
+    uint32_t Width()
+    {
+        return Right - Left;
+    }
+
+    uint32_t Height()
+    {
+        return Bottom - Top;
+    }
+
+    bool IsValid()
+    {
+        return Right >= Left && Bottom >= Top;
+    }
+};
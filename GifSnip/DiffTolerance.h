@@ -0,0 +1,46 @@
+#pragma once
+#include <cstdint>
+
+enum class ToleranceMode
+{
+    // Any change to any channel counts
+    Exact,
+    // A pixel counts as changed once any channel moves by more than
+    // the threshold
+    Channel,
+    // A pixel counts as changed once its luma moves by more than the
+    // threshold. Changes in hue alone are never picked up.
+    Luma,
+};
+
+// Lets the differs ignore changes too small to be worth a frame, like
+// video compression noise, subpixel text rendering or a tiny spinner.
+// Ignored changes aren't lost: the differ keeps comparing against what
+// it last reported, so they build up until they cross the threshold or
+// ride along with the next change that does.
+struct DiffTolerance
+{
+    ToleranceMode Mode = ToleranceMode::Exact;
+    // 0-255, in channel or luma steps
+    uint32_t Threshold = 0;
+    // Frames with fewer changed pixels than this are reported unchanged
+    uint32_t MinDirtyPixels = 0;
+
+    // Whether this is the plain pixel for pixel comparison
+    bool IsExact() const
+    {
+        auto exactPixels = Mode == ToleranceMode::Exact || (Mode == ToleranceMode::Channel && Threshold == 0);
+        return exactPixels && MinDirtyPixels <= 1;
+    }
+};
+
+// Luma as 38R + 75G + 15B, which is BT.601 scaled to sum to 128 so that
+// it fits the vector paths. A pixel's luma has moved by more than the
+// threshold when this sum moves by more than Threshold * Scale.
+namespace LumaWeights
+{
+    constexpr uint32_t Red = 38;
+    constexpr uint32_t Green = 75;
+    constexpr uint32_t Blue = 15;
+    constexpr uint32_t Scale = 128;
+}
@@ -0,0 +1,211 @@
+#include "DirtyTileMap.h"
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+namespace
+{
+    // Clustering a noisy frame isn't worth it, past this many clusters
+    // we just use the bounding box of everything.
+    constexpr size_t MaxClusters = 64;
+    // Merging two clusters is free if it adds at most this many clean
+    // tiles, since every image block has its own header and LZW reset.
+    constexpr uint32_t MergeSlackTiles = 1;
+
+    // Inclusive bounds in tiles
+    struct TileBox
+    {
+        uint32_t Left;
+        uint32_t Top;
+        uint32_t Right;
+        uint32_t Bottom;
+
+        uint32_t Area() const
+        {
+            return (Right - Left + 1) * (Bottom - Top + 1);
+        }
+
+        TileBox Union(TileBox const& other) const
+        {
+            return
+            {
+                std::min(Left, other.Left),
+                std::min(Top, other.Top),
+                std::max(Right, other.Right),
+                std::max(Bottom, other.Bottom),
+            };
+        }
+    };
+}
+
+DirtyTileMap::DirtyTileMap(uint32_t width, uint32_t height, uint32_t tileSize)
+{
+    if (tileSize == 0)
+    {
+        throw std::invalid_argument("Tile size must be non-zero");
+    }
+
+    m_width = width;
+    m_height = height;
+    m_tileSize = tileSize;
+    m_columnCount = (width + tileSize - 1) / tileSize;
+    m_rowCount = (height + tileSize - 1) / tileSize;
+    m_words.resize(((static_cast<size_t>(m_columnCount) * m_rowCount) + 31) / 32, 0);
+}
+
+void DirtyTileMap::Clear()
+{
+    std::fill(m_words.begin(), m_words.end(), 0);
+}
+
+void DirtyTileMap::MarkAll()
+{
+    for (uint32_t row = 0; row < m_rowCount; row++)
+    {
+        for (uint32_t column = 0; column < m_columnCount; column++)
+        {
+            Mark(column, row);
+        }
+    }
+}
+
+void DirtyTileMap::Mark(uint32_t column, uint32_t row)
+{
+    auto index = (static_cast<size_t>(row) * m_columnCount) + column;
+    m_words[index / 32] |= 1u << (index % 32);
+}
+
+bool DirtyTileMap::IsDirty(uint32_t column, uint32_t row) const
+{
+    auto index = (static_cast<size_t>(row) * m_columnCount) + column;
+    return (m_words[index / 32] & (1u << (index % 32))) != 0;
+}
+
+bool DirtyTileMap::Any() const
+{
+    return std::any_of(m_words.begin(), m_words.end(), [](uint32_t word) { return word != 0; });
+}
+
+uint32_t DirtyTileMap::DirtyCount() const
+{
+    uint32_t count = 0;
+    for (auto word : m_words)
+    {
+        while (word != 0)
+        {
+            word &= word - 1;
+            count++;
+        }
+    }
+    return count;
+}
+
+std::vector<DiffRect> DirtyTileMap::Cluster(uint32_t maxRects) const
+{
+    maxRects = std::max(maxRects, 1u);
+
+    // Find the bounding box of each 8-connected group of dirty tiles
+    std::vector<TileBox> boxes;
+    std::vector<uint8_t> visited(static_cast<size_t>(m_columnCount) * m_rowCount, 0);
+    std::vector<std::pair<uint32_t, uint32_t>> stack;
+    auto overflowed = false;
+    TileBox everything = { m_columnCount, m_rowCount, 0, 0 };
+    for (uint32_t row = 0; row < m_rowCount; row++)
+    {
+        for (uint32_t column = 0; column < m_columnCount; column++)
+        {
+            auto index = (static_cast<size_t>(row) * m_columnCount) + column;
+            if (visited[index] || !IsDirty(column, row))
+            {
+                continue;
+            }
+
+            TileBox box = { column, row, column, row };
+            visited[index] = 1;
+            stack.push_back({ column, row });
+            while (!stack.empty())
+            {
+                auto [x, y] = stack.back();
+                stack.pop_back();
+                box = box.Union({ x, y, x, y });
+                auto top = y > 0 ? y - 1 : y;
+                auto bottom = std::min(y + 1, m_rowCount - 1);
+                auto left = x > 0 ? x - 1 : x;
+                auto right = std::min(x + 1, m_columnCount - 1);
+                for (auto neighbourY = top; neighbourY <= bottom; neighbourY++)
+                {
+                    for (auto neighbourX = left; neighbourX <= right; neighbourX++)
+                    {
+                        auto neighbourIndex = (static_cast<size_t>(neighbourY) * m_columnCount) + neighbourX;
+                        if (!visited[neighbourIndex] && IsDirty(neighbourX, neighbourY))
+                        {
+                            visited[neighbourIndex] = 1;
+                            stack.push_back({ neighbourX, neighbourY });
+                        }
+                    }
+                }
+            }
+
+            everything = everything.Union(box);
+            if (boxes.size() < MaxClusters)
+            {
+                boxes.push_back(box);
+            }
+            else
+            {
+                overflowed = true;
+            }
+        }
+    }
+
+    if (overflowed)
+    {
+        boxes = { everything };
+    }
+
+    // Greedily merge the pair of boxes that wastes the fewest tiles until
+    // we're within budget and no merge is free anymore. Overlapping boxes
+    // have a negative cost, so they always get merged.
+    while (boxes.size() > 1)
+    {
+        auto bestCost = INT64_MAX;
+        size_t bestFirst = 0;
+        size_t bestSecond = 0;
+        for (size_t i = 0; i < boxes.size(); i++)
+        {
+            for (size_t j = i + 1; j < boxes.size(); j++)
+            {
+                auto cost = static_cast<int64_t>(boxes[i].Union(boxes[j]).Area()) -
+                    static_cast<int64_t>(boxes[i].Area()) -
+                    static_cast<int64_t>(boxes[j].Area());
+                if (cost < bestCost)
+                {
+                    bestCost = cost;
+                    bestFirst = i;
+                    bestSecond = j;
+                }
+            }
+        }
+
+        if (boxes.size() <= maxRects && bestCost > static_cast<int64_t>(MergeSlackTiles))
+        {
+            break;
+        }
+        boxes[bestFirst] = boxes[bestFirst].Union(boxes[bestSecond]);
+        boxes.erase(boxes.begin() + bestSecond);
+    }
+
+    std::vector<DiffRect> rects;
+    rects.reserve(boxes.size());
+    for (auto&& box : boxes)
+    {
+        rects.push_back(DiffRect
+            {
+                box.Left * m_tileSize,
+                box.Top * m_tileSize,
+                std::min((box.Right + 1) * m_tileSize, m_width) - 1,
+                std::min((box.Bottom + 1) * m_tileSize, m_height) - 1,
+            });
+    }
+    return rects;
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include "DiffRect.h"
+#include <cstddef>
+#include <vector>
+
+// One bit per tile of a frame, row-major with 32 tiles per word. This is
+// the same layout TextureDiff.hlsl writes its tile buffer in.
+class DirtyTileMap
+{
+public:
+    static constexpr uint32_t DefaultTileSize = 16;
+
+    DirtyTileMap() = default;
+    DirtyTileMap(uint32_t width, uint32_t height, uint32_t tileSize = DefaultTileSize);
+
+    uint32_t Width() const { return m_width; }
+    uint32_t Height() const { return m_height; }
+    uint32_t TileSize() const { return m_tileSize; }
+    uint32_t ColumnCount() const { return m_columnCount; }
+    uint32_t RowCount() const { return m_rowCount; }
+
+    void Clear();
+    void MarkAll();
+    void Mark(uint32_t column, uint32_t row);
+    bool IsDirty(uint32_t column, uint32_t row) const;
+    bool Any() const;
+    uint32_t DirtyCount() const;
+
+    std::vector<uint32_t>& Words() { return m_words; }
+    std::vector<uint32_t> const& Words() const { return m_words; }
+
+    // Groups the dirty tiles into at most maxRects rectangles, merging
+    // neighbouring clusters when that costs (almost) nothing. Like the
+    // rects produced by the differs, Right and Bottom are inclusive.
+    std::vector<DiffRect> Cluster(uint32_t maxRects) const;
+
+private:
+    uint32_t m_width = 0;
+    uint32_t m_height = 0;
+    uint32_t m_tileSize = DefaultTileSize;
+    uint32_t m_columnCount = 0;
+    uint32_t m_rowCount = 0;
+    std::vector<uint32_t> m_words;
+};
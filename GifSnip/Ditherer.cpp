@@ -0,0 +1,235 @@
+#include "Ditherer.h"
+#include "Simd.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+    constexpr uint32_t PatternSize = 8;
+    constexpr uint32_t PatternRowBytes = PatternSize * 4;
+
+    constexpr uint8_t BayerMatrix[PatternSize][PatternSize] =
+    {
+        {  0, 32,  8, 40,  2, 34, 10, 42 },
+        { 48, 16, 56, 24, 50, 18, 58, 26 },
+        { 12, 44,  4, 36, 14, 46,  6, 38 },
+        { 60, 28, 52, 20, 62, 30, 54, 22 },
+        {  3, 35, 11, 43,  1, 33,  9, 41 },
+        { 51, 19, 59, 27, 49, 17, 57, 25 },
+        { 15, 47,  7, 39, 13, 45,  5, 37 },
+        { 63, 31, 55, 23, 61, 29, 53, 21 },
+    };
+
+    // The pattern spans this fraction of the average distance between
+    // palette colors along a channel. Adaptive palettes are denser than
+    // an even grid where the colors are, so a full step is too noisy.
+    constexpr double OrderedSpread = 0.25;
+
+    // Adds and then subtracts a row's pattern with saturation, which
+    // applies a signed offset to every channel without widening.
+    using ApplyPatternFunction = void(*)(uint8_t const* source, uint8_t const* raise, uint8_t const* lower, uint32_t width, uint8_t* destination);
+
+    void ApplyPatternScalar(uint8_t const* source, uint8_t const* raise, uint8_t const* lower, uint32_t width, uint8_t* destination)
+    {
+        auto byteCount = static_cast<size_t>(width) * 4;
+        for (size_t i = 0; i < byteCount; i++)
+        {
+            auto patternByte = i % PatternRowBytes;
+            auto value = std::min(source[i] + raise[patternByte], 255);
+            destination[i] = static_cast<uint8_t>(std::max(value - lower[patternByte], 0));
+        }
+    }
+
+#if defined(GIFSNIP_X64)
+    // SSE2 is part of x64, so this one needs no check
+    void ApplyPatternSse2(uint8_t const* source, uint8_t const* raise, uint8_t const* lower, uint32_t width, uint8_t* destination)
+    {
+        auto raiseLow = _mm_loadu_si128(reinterpret_cast<__m128i const*>(raise));
+        auto raiseHigh = _mm_loadu_si128(reinterpret_cast<__m128i const*>(raise + 16));
+        auto lowerLow = _mm_loadu_si128(reinterpret_cast<__m128i const*>(lower));
+        auto lowerHigh = _mm_loadu_si128(reinterpret_cast<__m128i const*>(lower + 16));
+        uint32_t x = 0;
+        for (; x + PatternSize <= width; x += PatternSize)
+        {
+            auto offset = static_cast<size_t>(x) * 4;
+            auto low = _mm_loadu_si128(reinterpret_cast<__m128i const*>(source + offset));
+            auto high = _mm_loadu_si128(reinterpret_cast<__m128i const*>(source + offset + 16));
+            low = _mm_subs_epu8(_mm_adds_epu8(low, raiseLow), lowerLow);
+            high = _mm_subs_epu8(_mm_adds_epu8(high, raiseHigh), lowerHigh);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + offset), low);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + offset + 16), high);
+        }
+        if (x < width)
+        {
+            auto offset = static_cast<size_t>(x) * 4;
+            ApplyPatternScalar(source + offset, raise, lower, width - x, destination + offset);
+        }
+    }
+#elif defined(GIFSNIP_ARM64)
+    void ApplyPatternNeon(uint8_t const* source, uint8_t const* raise, uint8_t const* lower, uint32_t width, uint8_t* destination)
+    {
+        auto raiseLow = vld1q_u8(raise);
+        auto raiseHigh = vld1q_u8(raise + 16);
+        auto lowerLow = vld1q_u8(lower);
+        auto lowerHigh = vld1q_u8(lower + 16);
+        uint32_t x = 0;
+        for (; x + PatternSize <= width; x += PatternSize)
+        {
+            auto offset = static_cast<size_t>(x) * 4;
+            auto low = vqsubq_u8(vqaddq_u8(vld1q_u8(source + offset), raiseLow), lowerLow);
+            auto high = vqsubq_u8(vqaddq_u8(vld1q_u8(source + offset + 16), raiseHigh), lowerHigh);
+            vst1q_u8(destination + offset, low);
+            vst1q_u8(destination + offset + 16, high);
+        }
+        if (x < width)
+        {
+            auto offset = static_cast<size_t>(x) * 4;
+            ApplyPatternScalar(source + offset, raise, lower, width - x, destination + offset);
+        }
+    }
+#endif
+
+    ApplyPatternFunction SelectApplyPattern()
+    {
+#if defined(GIFSNIP_X64)
+        return ApplyPatternSse2;
+#elif defined(GIFSNIP_ARM64)
+        return ApplyPatternNeon;
+#else
+        return ApplyPatternScalar;
+#endif
+    }
+
+    uint8_t ClampChannel(int32_t value)
+    {
+        return static_cast<uint8_t>(std::clamp(value, 0, 255));
+    }
+}
+
+Ditherer::Ditherer(DitherMode mode, uint32_t maxColors)
+{
+    m_mode = mode;
+    if (m_mode != DitherMode::Ordered)
+    {
+        return;
+    }
+
+    // The offsets only depend on how far apart the palette's colors are
+    // on average, which comes down to how many there are.
+    m_raise.assign(PatternSize * PatternRowBytes, 0);
+    m_lower.assign(PatternSize * PatternRowBytes, 0);
+    auto step = 256.0 / std::cbrt(static_cast<double>(std::max(maxColors, 2u)));
+    for (uint32_t y = 0; y < PatternSize; y++)
+    {
+        for (uint32_t x = 0; x < PatternSize; x++)
+        {
+            auto threshold = ((BayerMatrix[y][x] + 0.5) / 64.0) - 0.5;
+            auto offset = static_cast<int32_t>(std::lround(threshold * step * OrderedSpread));
+            auto byte = (y * PatternRowBytes) + (x * 4);
+            for (uint32_t channel = 0; channel < 3; channel++)
+            {
+                m_raise[byte + channel] = static_cast<uint8_t>(std::max(offset, 0));
+                m_lower[byte + channel] = static_cast<uint8_t>(std::max(-offset, 0));
+            }
+        }
+    }
+}
+
+void Ditherer::MapPixels(
+    PaletteMapper& mapper,
+    uint8_t const* pixels,
+    size_t stride,
+    uint32_t width,
+    uint32_t height,
+    uint32_t left,
+    uint32_t top,
+    uint8_t* indices)
+{
+    switch (m_mode)
+    {
+    case DitherMode::Ordered:
+        MapOrdered(mapper, pixels, stride, width, height, left, top, indices);
+        break;
+    case DitherMode::FloydSteinberg:
+        MapFloydSteinberg(mapper, pixels, stride, width, height, indices);
+        break;
+    default:
+        mapper.MapPixels(pixels, stride, width, height, indices);
+        break;
+    }
+}
+
+void Ditherer::MapOrdered(PaletteMapper& mapper, uint8_t const* pixels, size_t stride, uint32_t width, uint32_t height, uint32_t left, uint32_t top, uint8_t* indices)
+{
+    // Line the pattern up with the frame rather than the region
+    uint8_t raise[PatternSize][PatternRowBytes] = {};
+    uint8_t lower[PatternSize][PatternRowBytes] = {};
+    auto shift = (left % PatternSize) * 4;
+    for (uint32_t y = 0; y < PatternSize; y++)
+    {
+        auto patternRow = ((top + y) % PatternSize) * PatternRowBytes;
+        for (uint32_t byte = 0; byte < PatternRowBytes; byte++)
+        {
+            raise[y][byte] = m_raise[patternRow + ((shift + byte) % PatternRowBytes)];
+            lower[y][byte] = m_lower[patternRow + ((shift + byte) % PatternRowBytes)];
+        }
+    }
+
+    static const ApplyPatternFunction applyPattern = SelectApplyPattern();
+    m_row.resize(static_cast<size_t>(width) * 4);
+    for (uint32_t y = 0; y < height; y++)
+    {
+        auto phase = y % PatternSize;
+        applyPattern(pixels + (static_cast<size_t>(y) * stride), raise[phase], lower[phase], width, m_row.data());
+        mapper.MapPixels(m_row.data(), m_row.size(), width, 1, indices + (static_cast<size_t>(y) * width));
+    }
+}
+
+void Ditherer::MapFloydSteinberg(PaletteMapper& mapper, uint8_t const* pixels, size_t stride, uint32_t width, uint32_t height, uint8_t* indices)
+{
+    auto&& palette = mapper.Palette();
+    auto rowLength = (static_cast<size_t>(width) + 2) * 3;
+    m_errors.assign(rowLength * 2, 0);
+    auto current = m_errors.data();
+    auto next = m_errors.data() + rowLength;
+
+    for (uint32_t y = 0; y < height; y++)
+    {
+        auto row = pixels + (static_cast<size_t>(y) * stride);
+        auto rowIndices = indices + (static_cast<size_t>(y) * width);
+        // Serpentine, so error doesn't keep drifting the same way
+        auto reverse = (y % 2) == 1;
+        int32_t direction = reverse ? -1 : 1;
+        for (uint32_t i = 0; i < width; i++)
+        {
+            auto x = reverse ? width - 1 - i : i;
+            auto pixel = row + (static_cast<size_t>(x) * 4);
+            // Padded by a pixel on the left
+            auto error = current + ((static_cast<size_t>(x) + 1) * 3);
+            auto b = ClampChannel(pixel[0] + ((error[0] + 8) >> 4));
+            auto g = ClampChannel(pixel[1] + ((error[1] + 8) >> 4));
+            auto r = ClampChannel(pixel[2] + ((error[2] + 8) >> 4));
+            auto index = mapper.MapColor(r, g, b);
+            rowIndices[x] = index;
+
+            auto&& color = palette[index];
+            int32_t const channelErrors[3] = { b - color.B, g - color.G, r - color.R };
+            auto ahead = error + (direction * 3);
+            auto below = next + ((static_cast<size_t>(x) + 1) * 3);
+            auto belowAhead = below + (direction * 3);
+            auto belowBehind = below - (direction * 3);
+            for (uint32_t channel = 0; channel < 3; channel++)
+            {
+                auto channelError = channelErrors[channel];
+                ahead[channel] = static_cast<int16_t>(ahead[channel] + (channelError * 7));
+                belowBehind[channel] = static_cast<int16_t>(belowBehind[channel] + (channelError * 3));
+                below[channel] = static_cast<int16_t>(below[channel] + (channelError * 5));
+                belowAhead[channel] = static_cast<int16_t>(belowAhead[channel] + channelError);
+            }
+        }
+
+        std::swap(current, next);
+        std::fill(next, next + rowLength, static_cast<int16_t>(0));
+    }
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include "PaletteMapper.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+enum class DitherMode
+{
+    // Every pixel maps to its nearest palette color
+    None,
+    // Adds an 8x8 Bayer pattern before mapping. The pattern is tied to
+    // where pixels are in the frame, so a pixel that doesn't change
+    // keeps its index for as long as the palette doesn't change either.
+    Ordered,
+    // Spreads each pixel's error over its neighbors, alternating
+    // direction from row to row. Smoother than Ordered, but a change
+    // anywhere can ripple into every pixel after it.
+    FloydSteinberg,
+};
+
+// Maps BGRA8 pixels to a PaletteMapper's palette, dithering as it goes.
+// Holds scratch rows, so every thread needs its own.
+class Ditherer
+{
+public:
+    // The ordered pattern is scaled to palettes of up to maxColors, the
+    // quantizer's limit rather than the size of each palette: a region
+    // that quantizes to a few colors less than the last one must not
+    // move every pixel's offset with it.
+    explicit Ditherer(DitherMode mode = DitherMode::None, uint32_t maxColors = 256);
+
+    DitherMode Mode() const { return m_mode; }
+
+    // Like PaletteMapper::MapPixels. Left and top are where the pixels
+    // are in the frame, which anchors the ordered pattern. Error from
+    // Floyd–Steinberg doesn't carry over from one call to the next, so
+    // bands of a region can be mapped on separate threads.
+    void MapPixels(
+        PaletteMapper& mapper,
+        uint8_t const* pixels,
+        size_t stride,
+        uint32_t width,
+        uint32_t height,
+        uint32_t left,
+        uint32_t top,
+        uint8_t* indices);
+
+private:
+    void MapOrdered(PaletteMapper& mapper, uint8_t const* pixels, size_t stride, uint32_t width, uint32_t height, uint32_t left, uint32_t top, uint8_t* indices);
+    void MapFloydSteinberg(PaletteMapper& mapper, uint8_t const* pixels, size_t stride, uint32_t width, uint32_t height, uint8_t* indices);
+
+private:
+    DitherMode m_mode = DitherMode::None;
+    // Ordered: the pattern as bytes to add and subtract with saturation,
+    // 8 pixels per row of the matrix.
+    std::vector<uint8_t> m_raise;
+    std::vector<uint8_t> m_lower;
+    std::vector<uint8_t> m_row;
+    // Floyd–Steinberg: error for this row and the next, in 16ths, with
+    // a pixel of padding at both ends.
+    std::vector<int16_t> m_errors;
+};
@@ -0,0 +1,41 @@
+#include "FileGifOutputStream.h"
+#include <stdexcept>
+
+FileGifOutputStream::FileGifOutputStream(std::filesystem::path const& path)
+{
+    m_file.open(path, std::ios::binary | std::ios::trunc);
+    if (!m_file.is_open())
+    {
+        throw std::runtime_error("Couldn't open " + path.string() + " for writing");
+    }
+}
+
+void FileGifOutputStream::Write(uint8_t const* data, size_t size)
+{
+    m_file.write(reinterpret_cast<char const*>(data), static_cast<std::streamsize>(size));
+    CheckStream();
+}
+
+void FileGifOutputStream::WriteAt(uint64_t offset, uint8_t const* data, size_t size)
+{
+    auto position = m_file.tellp();
+    m_file.seekp(static_cast<std::streamoff>(offset));
+    m_file.write(reinterpret_cast<char const*>(data), static_cast<std::streamsize>(size));
+    m_file.seekp(position);
+    CheckStream();
+}
+
+void FileGifOutputStream::Finish()
+{
+    m_file.flush();
+    CheckStream();
+    m_file.close();
+}
+
+void FileGifOutputStream::CheckStream()
+{
+    if (!m_file.good())
+    {
+        throw std::runtime_error("Failed to write GIF file");
+    }
+}
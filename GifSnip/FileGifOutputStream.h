@@ -0,0 +1,21 @@
+#pragma once
+#include "GifOutputStream.h"
+#include <filesystem>
+#include <fstream>
+
+// Writes a GIF to a file on disk.
+class FileGifOutputStream : public GifOutputStream
+{
+public:
+    FileGifOutputStream(std::filesystem::path const& path);
+
+    void Write(uint8_t const* data, size_t size) override;
+    void WriteAt(uint64_t offset, uint8_t const* data, size_t size) override;
+    void Finish() override;
+
+private:
+    void CheckStream();
+
+private:
+    std::ofstream m_file;
+};
@@ -0,0 +1,117 @@
+#include "FrameBufferPool.h"
+#include <stdexcept>
+
+namespace
+{
+    // The smallest size class
+    constexpr size_t MinBlockSize = 4096;
+
+    uint32_t SizeClassFor(size_t size)
+    {
+        uint32_t sizeClass = 0;
+        while ((MinBlockSize << sizeClass) < size)
+        {
+            sizeClass++;
+        }
+        return sizeClass;
+    }
+
+    uint8_t* AlignUp(uint8_t* pointer, size_t alignment)
+    {
+        auto address = reinterpret_cast<uintptr_t>(pointer);
+        address = (address + alignment - 1) & ~static_cast<uintptr_t>(alignment - 1);
+        return reinterpret_cast<uint8_t*>(address);
+    }
+}
+
+FrameBuffer::FrameBuffer(FrameBuffer&& other) noexcept
+{
+    *this = std::move(other);
+}
+
+FrameBuffer& FrameBuffer::operator=(FrameBuffer&& other) noexcept
+{
+    if (this != &other)
+    {
+        Release();
+        m_pool = other.m_pool;
+        m_storage = std::move(other.m_storage);
+        m_sizeClass = other.m_sizeClass;
+        m_view = other.m_view;
+        other.m_pool = nullptr;
+        other.m_view = {};
+    }
+    return *this;
+}
+
+void FrameBuffer::Release()
+{
+    if (m_storage != nullptr)
+    {
+        m_pool->Return(std::move(m_storage), m_sizeClass);
+    }
+    m_pool = nullptr;
+    m_view = {};
+}
+
+FrameBuffer FrameBufferPool::Acquire(uint32_t width, uint32_t height)
+{
+    if (width == 0 || height == 0)
+    {
+        throw std::invalid_argument("Frame buffers can't be empty");
+    }
+
+    auto stride = ((static_cast<size_t>(width) * 4) + RowAlignment - 1) & ~(RowAlignment - 1);
+    auto size = stride * height;
+    auto sizeClass = SizeClassFor(size);
+
+    FrameBuffer buffer;
+    {
+        std::lock_guard lock(m_lock);
+        if (sizeClass < m_freeBlocks.size() && !m_freeBlocks[sizeClass].empty())
+        {
+            buffer.m_storage = std::move(m_freeBlocks[sizeClass].back());
+            m_freeBlocks[sizeClass].pop_back();
+        }
+        else
+        {
+            m_allocationCount++;
+            m_reservedBytes += MinBlockSize << sizeClass;
+        }
+    }
+    if (buffer.m_storage == nullptr)
+    {
+        // Deliberately not value-initialized, readback overwrites it all
+        buffer.m_storage.reset(new uint8_t[(MinBlockSize << sizeClass) + RowAlignment - 1]);
+    }
+
+    buffer.m_pool = this;
+    buffer.m_sizeClass = sizeClass;
+    buffer.m_view.Data = AlignUp(buffer.m_storage.get(), RowAlignment);
+    buffer.m_view.Width = width;
+    buffer.m_view.Height = height;
+    buffer.m_view.Stride = stride;
+    return buffer;
+}
+
+uint64_t FrameBufferPool::AllocationCount() const
+{
+    std::lock_guard lock(m_lock);
+    return m_allocationCount;
+}
+
+uint64_t FrameBufferPool::ReservedBytes() const
+{
+    std::lock_guard lock(m_lock);
+    return m_reservedBytes;
+}
+
+void FrameBufferPool::Return(std::unique_ptr<uint8_t[]> storage, uint32_t sizeClass)
+{
+    std::lock_guard lock(m_lock);
+    if (sizeClass >= m_freeBlocks.size())
+    {
+        m_freeBlocks.resize(sizeClass + 1);
+    }
+    m_freeBlocks[sizeClass].push_back(std::move(storage));
+}
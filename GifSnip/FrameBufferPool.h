@@ -0,0 +1,90 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Where a BGRA8 image lives in memory. Rows are Stride bytes apart,
+// which can be more than Width * 4.
+struct FrameBufferView
+{
+    uint8_t* Data = nullptr;
+    uint32_t Width = 0;
+    uint32_t Height = 0;
+    size_t Stride = 0;
+
+    uint8_t* Row(uint32_t y) const { return Data + (static_cast<size_t>(y) * Stride); }
+};
+
+class FrameBufferPool;
+
+// A BGRA8 image borrowed from a FrameBufferPool. The memory goes back to
+// the pool when the buffer is destroyed. Its contents start out
+// undefined.
+class FrameBuffer
+{
+public:
+    FrameBuffer() = default;
+    ~FrameBuffer() { Release(); }
+
+    FrameBuffer(FrameBuffer&& other) noexcept;
+    FrameBuffer& operator=(FrameBuffer&& other) noexcept;
+    FrameBuffer(FrameBuffer const&) = delete;
+    FrameBuffer& operator=(FrameBuffer const&) = delete;
+
+    bool IsEmpty() const { return m_view.Data == nullptr; }
+    FrameBufferView const& View() const { return m_view; }
+    uint8_t* Data() const { return m_view.Data; }
+    uint32_t Width() const { return m_view.Width; }
+    uint32_t Height() const { return m_view.Height; }
+    size_t Stride() const { return m_view.Stride; }
+
+    void Release();
+
+private:
+    friend class FrameBufferPool;
+
+    FrameBufferPool* m_pool = nullptr;
+    std::unique_ptr<uint8_t[]> m_storage;
+    uint32_t m_sizeClass = 0;
+    FrameBufferView m_view = {};
+};
+
+// Hands out frame buffers and takes them back for reuse. Buffers are
+// grouped into power of two size classes so a slightly smaller or
+// larger region can reuse memory from an earlier one. Once the pool has
+// seen the largest frames a recording produces, acquiring a buffer no
+// longer allocates.
+//
+// Safe to use from any thread. The pool must outlive every buffer it
+// hands out.
+class FrameBufferPool
+{
+public:
+    // Rows start on this boundary
+    static constexpr size_t RowAlignment = 64;
+
+    FrameBufferPool() = default;
+    FrameBufferPool(FrameBufferPool const&) = delete;
+    FrameBufferPool& operator=(FrameBufferPool const&) = delete;
+
+    FrameBuffer Acquire(uint32_t width, uint32_t height);
+
+    // How many times the pool had to go to the heap
+    uint64_t AllocationCount() const;
+    // Memory currently owned by the pool, in use or not
+    uint64_t ReservedBytes() const;
+
+private:
+    friend class FrameBuffer;
+
+    void Return(std::unique_ptr<uint8_t[]> storage, uint32_t sizeClass);
+
+private:
+    mutable std::mutex m_lock;
+    // Free blocks, indexed by size class
+    std::vector<std::vector<std::unique_ptr<uint8_t[]>>> m_freeBlocks;
+    uint64_t m_allocationCount = 0;
+    uint64_t m_reservedBytes = 0;
+};
@@ -0,0 +1,127 @@
+#include "FrameCanvas.h"
+#include <algorithm>
+#include <cstring>
+
+FrameCanvas::FrameCanvas(uint32_t width, uint32_t height)
+{
+    m_width = width;
+    m_pixels.resize(static_cast<size_t>(width) * height * 4, 0);
+}
+
+size_t FrameCanvas::MarkUnchanged(
+    DiffRect const& rect,
+    uint8_t const* pixels,
+    size_t stride,
+    uint8_t* mask) const
+{
+    auto width = rect.Right - rect.Left;
+    auto height = rect.Bottom - rect.Top;
+    if (!m_initialized)
+    {
+        memset(mask, 0, static_cast<size_t>(width) * height);
+        return 0;
+    }
+
+    size_t unchangedCount = 0;
+    auto canvasStride = static_cast<size_t>(m_width) * 4;
+    for (uint32_t y = 0; y < height; y++)
+    {
+        auto source = pixels + (static_cast<size_t>(y) * stride);
+        auto canvas = m_pixels.data() + (static_cast<size_t>(rect.Top + y) * canvasStride) + (static_cast<size_t>(rect.Left) * 4);
+        auto rowMask = mask + (static_cast<size_t>(y) * width);
+        for (uint32_t x = 0; x < width; x++)
+        {
+            uint32_t sourcePixel = 0;
+            uint32_t canvasPixel = 0;
+            memcpy(&sourcePixel, source + (static_cast<size_t>(x) * 4), sizeof(sourcePixel));
+            memcpy(&canvasPixel, canvas + (static_cast<size_t>(x) * 4), sizeof(canvasPixel));
+            auto unchanged = sourcePixel == canvasPixel ? 1 : 0;
+            rowMask[x] = static_cast<uint8_t>(unchanged);
+            unchangedCount += unchanged;
+        }
+    }
+    return unchangedCount;
+}
+
+void FrameCanvas::Update(DiffRect const& rect, uint8_t const* pixels, size_t stride)
+{
+    auto rowBytes = static_cast<size_t>(rect.Right - rect.Left) * 4;
+    auto canvasStride = static_cast<size_t>(m_width) * 4;
+    for (auto y = rect.Top; y < rect.Bottom; y++)
+    {
+        auto source = pixels + (static_cast<size_t>(y - rect.Top) * stride);
+        auto canvas = m_pixels.data() + (static_cast<size_t>(y) * canvasStride) + (static_cast<size_t>(rect.Left) * 4);
+        memcpy(canvas, source, rowBytes);
+    }
+    m_initialized = true;
+}
+
+size_t FrameCanvas::MarkUnchanged(
+    DiffRect const& rect,
+    uint8_t const* indices,
+    std::vector<GifColor> const& palette,
+    uint8_t* mask) const
+{
+    auto width = rect.Right - rect.Left;
+    auto height = rect.Bottom - rect.Top;
+    auto pixelCount = static_cast<size_t>(width) * height;
+    if (!m_initialized)
+    {
+        return static_cast<size_t>(std::count(mask, mask + pixelCount, static_cast<uint8_t>(1)));
+    }
+
+    uint32_t colors[256] = {};
+    ExpandPalette(palette, colors);
+    size_t unchangedCount = 0;
+    auto canvasStride = static_cast<size_t>(m_width) * 4;
+    for (uint32_t y = 0; y < height; y++)
+    {
+        auto canvas = m_pixels.data() + (static_cast<size_t>(rect.Top + y) * canvasStride) + (static_cast<size_t>(rect.Left) * 4);
+        auto rowIndices = indices + (static_cast<size_t>(y) * width);
+        auto rowMask = mask + (static_cast<size_t>(y) * width);
+        for (uint32_t x = 0; x < width; x++)
+        {
+            uint32_t canvasPixel = 0;
+            memcpy(&canvasPixel, canvas + (static_cast<size_t>(x) * 4), sizeof(canvasPixel));
+            auto unchanged = rowMask[x] != 0 || colors[rowIndices[x]] == canvasPixel ? 1 : 0;
+            rowMask[x] = static_cast<uint8_t>(unchanged);
+            unchangedCount += unchanged;
+        }
+    }
+    return unchangedCount;
+}
+
+void FrameCanvas::Update(
+    DiffRect const& rect,
+    uint8_t const* indices,
+    std::vector<GifColor> const& palette,
+    uint8_t const* mask)
+{
+    uint32_t colors[256] = {};
+    ExpandPalette(palette, colors);
+    auto width = rect.Right - rect.Left;
+    auto canvasStride = static_cast<size_t>(m_width) * 4;
+    for (auto y = rect.Top; y < rect.Bottom; y++)
+    {
+        auto canvas = m_pixels.data() + (static_cast<size_t>(y) * canvasStride) + (static_cast<size_t>(rect.Left) * 4);
+        auto offset = static_cast<size_t>(y - rect.Top) * width;
+        for (uint32_t x = 0; x < width; x++)
+        {
+            if (mask == nullptr || mask[offset + x] == 0)
+            {
+                memcpy(canvas + (static_cast<size_t>(x) * 4), &colors[indices[offset + x]], sizeof(uint32_t));
+            }
+        }
+    }
+    m_initialized = true;
+}
+
+void FrameCanvas::ExpandPalette(std::vector<GifColor> const& palette, uint32_t* pixels)
+{
+    auto count = std::min<size_t>(palette.size(), 256);
+    for (size_t i = 0; i < count; i++)
+    {
+        auto&& color = palette[i];
+        pixels[i] = static_cast<uint32_t>(color.B) | (static_cast<uint32_t>(color.G) << 8) | (static_cast<uint32_t>(color.R) << 16) | 0xFF000000u;
+    }
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include "DiffRect.h"
+#include "GifWriter.h"
+#include <cstddef>
+#include <vector>
+
+// Keeps a BGRA8 copy of what a decoder will be showing after every
+// frame we've written so far, so that pixels that didn't change can be
+// written as transparent.
+class FrameCanvas
+{
+public:
+    FrameCanvas(uint32_t width, uint32_t height);
+
+    // False until the first region has been written. Until then there's
+    // nothing underneath for transparent pixels to show.
+    bool IsInitialized() const { return m_initialized; }
+
+    // Sets the mask byte of every pixel in the region that already
+    // matches the canvas to 1, and the rest to 0. The rect uses
+    // exclusive Right/Bottom, the mask is tightly packed. Returns the
+    // number of unchanged pixels.
+    size_t MarkUnchanged(
+        DiffRect const& rect,
+        uint8_t const* pixels,
+        size_t stride,
+        uint8_t* mask) const;
+
+    // Copies the region into the canvas.
+    void Update(DiffRect const& rect, uint8_t const* pixels, size_t stride);
+
+    // The same two for pixels given as tightly packed indices into a
+    // palette, for keeping track of the colors actually shown. Pixels
+    // already set in the mask are skipped by both. MarkUnchanged returns
+    // the number of pixels set in the mask afterwards.
+    size_t MarkUnchanged(
+        DiffRect const& rect,
+        uint8_t const* indices,
+        std::vector<GifColor> const& palette,
+        uint8_t* mask) const;
+    void Update(
+        DiffRect const& rect,
+        uint8_t const* indices,
+        std::vector<GifColor> const& palette,
+        uint8_t const* mask);
+
+private:
+    // Palette entries as the BGRA8 pixels they're shown as
+    static void ExpandPalette(std::vector<GifColor> const& palette, uint32_t* pixels);
+
+private:
+    uint32_t m_width = 0;
+    std::vector<uint8_t> m_pixels;
+    bool m_initialized = false;
+};
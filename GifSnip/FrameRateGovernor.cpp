@@ -0,0 +1,101 @@
+#include "FrameRateGovernor.h"
+#include "Trace.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace
+{
+    // Changes smaller than this share of the frame, like a blinking
+    // caret or typing, are sampled at half the maximum rate.
+    constexpr double SmallChangeFraction = 0.01;
+    // The queue has to be this full before the interval stretches. A
+    // full queue stretches it threefold.
+    constexpr double BacklogThreshold = 0.5;
+    constexpr double FullBacklogScale = 3.0;
+
+    // GIF delays are in 10ms units, so sampling any finer than that
+    // can't be shown. Rounding down means a 60Hz source still hits
+    // 30fps exactly despite a little jitter.
+    std::chrono::milliseconds WholeCentiseconds(int64_t milliseconds)
+    {
+        return std::chrono::milliseconds(std::max<int64_t>((milliseconds / 10) * 10, 10));
+    }
+}
+
+FrameRateGovernor::FrameRateGovernor(uint32_t minFrameRate, uint32_t maxFrameRate)
+{
+    if (minFrameRate == 0 || maxFrameRate < minFrameRate)
+    {
+        throw std::invalid_argument("Frame rate range must be non-empty and above zero");
+    }
+    m_minInterval = WholeCentiseconds(1000 / maxFrameRate);
+    m_maxInterval = WholeCentiseconds(1000 / minFrameRate);
+    m_interval = m_minInterval;
+}
+
+bool FrameRateGovernor::ShouldSample(FrameTime timeStamp, size_t queueDepth, size_t queueCapacity)
+{
+    if (m_firstFrame)
+    {
+        m_firstFrame = false;
+        m_lastSampleTime = timeStamp;
+        return true;
+    }
+
+    auto elapsed = timeStamp - m_lastSampleTime;
+    if (elapsed < m_minInterval)
+    {
+        m_statistics.RateLimitedFrames++;
+        return false;
+    }
+
+    // Stretch the interval while frames pile up waiting for the encoder
+    auto interval = m_interval;
+    auto backlog = queueCapacity > 0 ? static_cast<double>(queueDepth) / static_cast<double>(queueCapacity) : 0.0;
+    if (backlog > BacklogThreshold)
+    {
+        auto scale = 1.0 + ((FullBacklogScale - 1.0) * (backlog - BacklogThreshold) / (1.0 - BacklogThreshold));
+        interval = WholeCentiseconds(static_cast<int64_t>(static_cast<double>(m_interval.count()) * scale));
+        interval = std::min(interval, m_maxInterval);
+    }
+
+    if (elapsed < interval)
+    {
+        if (elapsed < m_interval)
+        {
+            m_statistics.IdleSkippedFrames++;
+        }
+        else
+        {
+            m_statistics.BacklogSkippedFrames++;
+        }
+        return false;
+    }
+
+    m_statistics.LongestInterval = std::max(m_statistics.LongestInterval, std::chrono::duration_cast<std::chrono::milliseconds>(elapsed));
+    m_lastSampleTime = timeStamp;
+    return true;
+}
+
+void FrameRateGovernor::ReportChange(double dirtyFraction)
+{
+    auto previousInterval = m_interval;
+    if (dirtyFraction <= 0.0)
+    {
+        // Back off while the screen stays quiet
+        m_interval = std::min(m_interval * 2, m_maxInterval);
+    }
+    else if (dirtyFraction < SmallChangeFraction)
+    {
+        m_interval = std::min(m_minInterval * 2, m_maxInterval);
+    }
+    else
+    {
+        m_interval = m_minInterval;
+    }
+
+    if (m_interval != previousInterval)
+    {
+        Trace::Counter("SampleInterval", m_interval.count());
+    }
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include "FrameSource.h"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+// Decisions the governor made over a recording
+struct FrameRateGovernorStatistics
+{
+    // Frames that arrived sooner than the maximum frame rate allows
+    uint64_t RateLimitedFrames = 0;
+    // Frames that would have been sampled at the maximum rate, but were
+    // skipped because the screen had been quiet
+    uint64_t IdleSkippedFrames = 0;
+    // The same, but because the encoder was behind
+    uint64_t BacklogSkippedFrames = 0;
+    // The longest gap between two sampled frames
+    std::chrono::milliseconds LongestInterval = {};
+};
+
+// Picks which captured frames get sampled. The interval starts at the
+// one for the maximum frame rate, backs off towards the one for the
+// minimum rate while nothing or very little changes, and snaps back as
+// soon as a real change shows up. A backlog in the encoder queue
+// stretches it further, so frames that couldn't be encoded in time
+// aren't diffed and read back in the first place. Intervals are whole
+// centiseconds, the unit GIF delays are written in.
+class FrameRateGovernor
+{
+public:
+    FrameRateGovernor(uint32_t minFrameRate, uint32_t maxFrameRate);
+
+    // Decides whether to sample a frame that arrived at the given time.
+    // The first frame is always sampled.
+    bool ShouldSample(FrameTime timeStamp, size_t queueDepth, size_t queueCapacity);
+    // Reports what the differ found in a sampled frame, as the share of
+    // the frame's tiles that changed (0 if nothing did). Results arrive
+    // a few frames late because of readback, which is fine for pacing.
+    void ReportChange(double dirtyFraction);
+
+    std::chrono::milliseconds CurrentInterval() const { return m_interval; }
+    FrameRateGovernorStatistics const& Statistics() const { return m_statistics; }
+
+private:
+    std::chrono::milliseconds m_minInterval = {};
+    std::chrono::milliseconds m_maxInterval = {};
+    // The interval picked from how much the screen changes, before the
+    // backlog is taken into account
+    std::chrono::milliseconds m_interval = {};
+    FrameTime m_lastSampleTime = {};
+    bool m_firstFrame = true;
+    FrameRateGovernorStatistics m_statistics = {};
+};
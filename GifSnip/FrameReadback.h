@@ -0,0 +1,160 @@
+#pragma once
+#include "DiffRect.h"
+#include "FrameBufferPool.h"
+#include "Trace.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <stdexcept>
+#include <vector>
+
+// A readback slot's contents once its copy has landed: the whole frame,
+// and what the differ found in it. The diff rect is as the differ
+// reported it, with inclusive Right/Bottom.
+struct ReadbackData
+{
+    FrameBufferView Pixels = {};
+    std::optional<DiffRect> Diff;
+    uint32_t const* TileWords = nullptr;
+    size_t TileWordCount = 0;
+};
+
+// A fixed set of slots that frames get copied into and are read from
+// later. How a slot gets filled depends on the implementation (a GPU
+// copy, a memcpy, ...), reading one back doesn't.
+class FrameReadback
+{
+public:
+    virtual ~FrameReadback() = default;
+
+    virtual uint32_t SlotCount() const = 0;
+    // Maps a slot that was filled earlier. If wait is false and the copy
+    // hasn't landed yet, returns false instead of blocking.
+    virtual bool Map(uint32_t slot, bool wait, ReadbackData& data) = 0;
+    virtual void Unmap(uint32_t slot) = 0;
+};
+
+// Cycles through the slots of a FrameReadback so that a frame is only
+// read back once a few newer frames have been submitted after it. By
+// then the copy has usually landed and mapping doesn't stall. Frames
+// always come back out in the order they went in, along with the tag
+// they were submitted with.
+//
+// The consume callback is called as consume(ReadbackData const&, T&),
+// with the slot mapped for the duration of the call.
+template <typename T>
+class ReadbackRing
+{
+public:
+    // The latency is how many frames stay in flight after each submit.
+    // It's capped at one less than the number of slots.
+    ReadbackRing(FrameReadback& readback, uint32_t latency) :
+        m_readback(readback)
+    {
+        auto slotCount = m_readback.SlotCount();
+        if (slotCount == 0)
+        {
+            throw std::invalid_argument("Readback needs at least one slot");
+        }
+        m_latency = std::min(latency, slotCount - 1);
+        m_tags.resize(slotCount);
+    }
+
+    ReadbackRing(ReadbackRing const&) = delete;
+    ReadbackRing& operator=(ReadbackRing const&) = delete;
+
+    uint32_t Latency() const { return m_latency; }
+    uint32_t PendingCount() const { return m_pendingCount; }
+    // Times we had to wait for a copy to land
+    uint64_t StallCount() const { return m_stallCount; }
+
+    // Returns the slot the next frame should be copied into. If every
+    // slot still holds an unread frame, the oldest is read first.
+    template <typename Callback>
+    uint32_t BeginFrame(Callback&& consume)
+    {
+        if (m_frameStarted)
+        {
+            throw std::logic_error("BeginFrame called twice");
+        }
+        while (m_pendingCount == m_tags.size())
+        {
+            ConsumeOldest(consume);
+        }
+        m_frameStarted = true;
+        return NextSlot();
+    }
+
+    // Marks the slot returned by BeginFrame as filled, then reads back
+    // every frame older than the latency.
+    template <typename Callback>
+    void EndFrame(T&& tag, Callback&& consume)
+    {
+        if (!m_frameStarted)
+        {
+            throw std::logic_error("EndFrame called without BeginFrame");
+        }
+        m_frameStarted = false;
+        m_tags[NextSlot()] = std::move(tag);
+        m_pendingCount++;
+        while (m_pendingCount > m_latency)
+        {
+            ConsumeOldest(consume);
+        }
+    }
+
+    // Reads back every frame still in flight.
+    template <typename Callback>
+    void Flush(Callback&& consume)
+    {
+        while (m_pendingCount > 0)
+        {
+            ConsumeOldest(consume);
+        }
+    }
+
+private:
+    uint32_t NextSlot() const
+    {
+        return static_cast<uint32_t>((m_oldest + m_pendingCount) % m_tags.size());
+    }
+
+    template <typename Callback>
+    void ConsumeOldest(Callback& consume)
+    {
+        auto slot = m_oldest;
+        ReadbackData data = {};
+        if (!m_readback.Map(slot, false, data))
+        {
+            m_stallCount++;
+            TraceSpan span("ReadbackStall");
+            m_readback.Map(slot, true, data);
+        }
+
+        // The slot is done with whether or not consume succeeds
+        m_oldest = static_cast<uint32_t>((m_oldest + 1) % m_tags.size());
+        m_pendingCount--;
+        auto tag = std::move(m_tags[slot].value());
+        m_tags[slot].reset();
+        try
+        {
+            consume(static_cast<ReadbackData const&>(data), tag);
+        }
+        catch (...)
+        {
+            m_readback.Unmap(slot);
+            throw;
+        }
+        m_readback.Unmap(slot);
+    }
+
+private:
+    FrameReadback& m_readback;
+    uint32_t m_latency = 0;
+    std::vector<std::optional<T>> m_tags;
+    uint32_t m_oldest = 0;
+    uint32_t m_pendingCount = 0;
+    bool m_frameStarted = false;
+    uint64_t m_stallCount = 0;
+};
@@ -0,0 +1,27 @@
+#pragma once
+#include "FrameBufferPool.h"
+#include <chrono>
+#include <cstdint>
+
+// Frame time stamps, in the same 100ns units as
+// Windows::Foundation::TimeSpan (which this is identical to).
+using FrameTime = std::chrono::duration<int64_t, std::ratio<1, 10'000'000>>;
+
+// A captured frame, before it has been cropped. The pixels are BGRA8
+// and only valid until the next frame is requested from the source.
+struct SourceFrame
+{
+    FrameBufferView Surface = {};
+    FrameTime SystemRelativeTime = {};
+};
+
+// Something that produces frames one after another, like a recording
+// on disk.
+class FrameSource
+{
+public:
+    virtual ~FrameSource() = default;
+
+    // Returns false once there are no more frames.
+    virtual bool TryGetNextFrame(SourceFrame& frame) = 0;
+};
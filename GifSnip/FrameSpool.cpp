@@ -0,0 +1,217 @@
+#include "FrameSpool.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    struct FrameHeader
+    {
+        int64_t TimeStamp;
+        int64_t CurrentTime;
+        uint32_t RegionCount;
+        uint32_t Reserved;
+    };
+
+    // Views have to start on a multiple of this on Windows, which is
+    // also a multiple of the page size everywhere else.
+    constexpr size_t ChunkAlignment = 64 * 1024;
+
+    size_t RegionBytes(DiffRect const& rect)
+    {
+        return sizeof(DiffRect) + (static_cast<size_t>(rect.Right - rect.Left) * (rect.Bottom - rect.Top) * 4);
+    }
+}
+
+FrameSpool::FrameSpool(std::filesystem::path const& path, size_t chunkSize)
+{
+    m_path = path;
+    m_chunkSize = ((std::max(chunkSize, ChunkAlignment) + ChunkAlignment - 1) / ChunkAlignment) * ChunkAlignment;
+#ifdef _WIN32
+    auto file = CreateFileW(
+        path.c_str(),
+        GENERIC_READ | GENERIC_WRITE,
+        0,
+        nullptr,
+        CREATE_ALWAYS,
+        FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE,
+        nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        throw std::runtime_error("Couldn't create the spool file");
+    }
+    m_file = file;
+#else
+    m_file = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+    if (m_file < 0)
+    {
+        throw std::runtime_error("Couldn't create the spool file");
+    }
+#endif
+}
+
+FrameSpool::~FrameSpool()
+{
+    UnmapChunk();
+#ifdef _WIN32
+    // Deletes the file as well
+    CloseHandle(static_cast<HANDLE>(m_file));
+#else
+    close(m_file);
+    unlink(m_path.c_str());
+#endif
+}
+
+void FrameSpool::AppendFrame(FrameTime timeStamp, FrameTime currentTime, std::vector<DiffRect> const& rects, FrameBufferView const& frame)
+{
+    auto frameBytes = sizeof(FrameHeader);
+    for (auto&& rect : rects)
+    {
+        if (rect.Right > frame.Width || rect.Bottom > frame.Height || rect.Left > rect.Right || rect.Top > rect.Bottom)
+        {
+            throw std::invalid_argument("Spooled rects must lie within the frame");
+        }
+        frameBytes += RegionBytes(rect);
+    }
+
+    // Frames that don't fit in what's left start a new chunk, which is
+    // made bigger for frames that wouldn't fit in an empty one either.
+    if (m_chunks.empty() || m_chunks.back().Size - m_chunkUsed < frameBytes)
+    {
+        AddChunk(std::max(m_chunkSize, ((frameBytes + ChunkAlignment - 1) / ChunkAlignment) * ChunkAlignment));
+    }
+
+    m_frames.push_back(Location{ m_chunks.size() - 1, m_chunkUsed });
+    auto destination = MapChunk(m_chunks.size() - 1) + m_chunkUsed;
+
+    FrameHeader header = {};
+    header.TimeStamp = timeStamp.count();
+    header.CurrentTime = currentTime.count();
+    header.RegionCount = static_cast<uint32_t>(rects.size());
+    memcpy(destination, &header, sizeof(header));
+    destination += sizeof(header);
+    for (auto&& rect : rects)
+    {
+        memcpy(destination, &rect, sizeof(rect));
+        destination += sizeof(rect);
+        auto rowBytes = static_cast<size_t>(rect.Right - rect.Left) * 4;
+        for (auto y = rect.Top; y < rect.Bottom; y++)
+        {
+            memcpy(destination, frame.Row(y) + (static_cast<size_t>(rect.Left) * 4), rowBytes);
+            destination += rowBytes;
+        }
+    }
+    m_chunkUsed += frameBytes;
+    m_size += frameBytes;
+}
+
+void FrameSpool::ReadFrame(uint64_t index, Frame& frame)
+{
+    auto&& location = m_frames.at(index);
+    auto source = MapChunk(location.Chunk) + location.Offset;
+
+    FrameHeader header = {};
+    memcpy(&header, source, sizeof(header));
+    source += sizeof(header);
+    frame.TimeStamp = FrameTime(header.TimeStamp);
+    frame.CurrentTime = FrameTime(header.CurrentTime);
+    frame.Regions.resize(header.RegionCount);
+    for (auto&& region : frame.Regions)
+    {
+        memcpy(&region.Rect, source, sizeof(region.Rect));
+        source += sizeof(region.Rect);
+        auto&& rect = region.Rect;
+        region.Pixels.Data = source;
+        region.Pixels.Width = rect.Right - rect.Left;
+        region.Pixels.Height = rect.Bottom - rect.Top;
+        region.Pixels.Stride = static_cast<size_t>(region.Pixels.Width) * 4;
+        source += region.Pixels.Stride * region.Pixels.Height;
+    }
+}
+
+void FrameSpool::AddChunk(size_t size)
+{
+    // Growing the file doesn't touch the disk until pages get written
+    auto newFileSize = m_fileSize + size;
+#ifdef _WIN32
+    LARGE_INTEGER end = {};
+    end.QuadPart = static_cast<LONGLONG>(newFileSize);
+    if (!SetFilePointerEx(static_cast<HANDLE>(m_file), end, nullptr, FILE_BEGIN) || !SetEndOfFile(static_cast<HANDLE>(m_file)))
+    {
+        throw std::runtime_error("Couldn't grow the spool file");
+    }
+#else
+    if (ftruncate(m_file, static_cast<off_t>(newFileSize)) != 0)
+    {
+        throw std::runtime_error("Couldn't grow the spool file");
+    }
+#endif
+    m_chunks.push_back(Chunk{ m_fileSize, size });
+    m_chunkUsed = 0;
+    m_fileSize = newFileSize;
+}
+
+uint8_t* FrameSpool::MapChunk(size_t index)
+{
+    if (m_mappedData != nullptr && m_mappedChunk == index)
+    {
+        return m_mappedData;
+    }
+    // Whatever was written to the last one is left for the OS to flush
+    UnmapChunk();
+
+    auto&& chunk = m_chunks[index];
+    void* data = nullptr;
+#ifdef _WIN32
+    auto mapping = CreateFileMappingW(static_cast<HANDLE>(m_file), nullptr, PAGE_READWRITE, 0, 0, nullptr);
+    if (mapping == nullptr)
+    {
+        throw std::runtime_error("Couldn't map the spool file");
+    }
+    data = MapViewOfFile(
+        mapping,
+        FILE_MAP_READ | FILE_MAP_WRITE,
+        static_cast<DWORD>(chunk.Offset >> 32),
+        static_cast<DWORD>(chunk.Offset),
+        chunk.Size);
+    // The view keeps the mapping alive
+    CloseHandle(mapping);
+    if (data == nullptr)
+    {
+        throw std::runtime_error("Couldn't map the spool file");
+    }
+#else
+    data = mmap(nullptr, chunk.Size, PROT_READ | PROT_WRITE, MAP_SHARED, m_file, static_cast<off_t>(chunk.Offset));
+    if (data == MAP_FAILED)
+    {
+        throw std::runtime_error("Couldn't map the spool file");
+    }
+#endif
+    m_mappedChunk = index;
+    m_mappedData = static_cast<uint8_t*>(data);
+    return m_mappedData;
+}
+
+void FrameSpool::UnmapChunk()
+{
+    if (m_mappedData == nullptr)
+    {
+        return;
+    }
+#ifdef _WIN32
+    UnmapViewOfFile(m_mappedData);
+#else
+    munmap(m_mappedData, m_chunks[m_mappedChunk].Size);
+#endif
+    m_mappedData = nullptr;
+}
@@ -0,0 +1,98 @@
+#pragma once
+#include "DiffRect.h"
+#include "FrameBufferPool.h"
+#include "FrameSource.h"
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+// The changed regions of every frame of a recording, kept on disk so
+// they can be encoded after it stops. The file only ever grows and is
+// memory mapped a chunk at a time, so appending a frame is a copy into
+// memory and the OS writes it out when it gets around to it. Only one
+// chunk is mapped at once, so a long recording doesn't stay resident.
+// The file is deleted along with the spool.
+//
+// Each frame is laid out as, in native byte order:
+//
+//   int64 TimeStamp, CurrentTime   100ns units
+//   uint32 region count, reserved
+//   then for every region:
+//     DiffRect                     exclusive Right/Bottom
+//     width * height * 4 bytes     BGRA8, tightly packed rows
+//
+// Frames never straddle two chunks.
+class FrameSpool
+{
+public:
+    static constexpr size_t DefaultChunkSize = 64 * 1024 * 1024;
+
+    struct Region
+    {
+        DiffRect Rect = {};
+        // Points into the spool, valid until the next ReadFrame or
+        // AppendFrame
+        FrameBufferView Pixels = {};
+    };
+
+    struct Frame
+    {
+        FrameTime TimeStamp = {};
+        // When the frame before this one ends
+        FrameTime CurrentTime = {};
+        std::vector<Region> Regions;
+    };
+
+    FrameSpool(std::filesystem::path const& path, size_t chunkSize = DefaultChunkSize);
+    ~FrameSpool();
+
+    FrameSpool(FrameSpool const&) = delete;
+    FrameSpool& operator=(FrameSpool const&) = delete;
+
+    // Copies the rects out of a whole frame. They use exclusive
+    // Right/Bottom and must lie within the frame.
+    void AppendFrame(FrameTime timeStamp, FrameTime currentTime, std::vector<DiffRect> const& rects, FrameBufferView const& frame);
+
+    // Frames can be read in any order, but reading them in order only
+    // maps each chunk once.
+    uint64_t FrameCount() const { return m_frames.size(); }
+    void ReadFrame(uint64_t index, Frame& frame);
+
+    // Bytes of frames appended so far
+    uint64_t Size() const { return m_size; }
+
+private:
+    struct Chunk
+    {
+        uint64_t Offset = 0;
+        size_t Size = 0;
+    };
+
+    struct Location
+    {
+        size_t Chunk = 0;
+        size_t Offset = 0;
+    };
+
+    void AddChunk(size_t size);
+    uint8_t* MapChunk(size_t index);
+    void UnmapChunk();
+
+private:
+    std::filesystem::path m_path;
+    size_t m_chunkSize = 0;
+    std::vector<Chunk> m_chunks;
+    // Used bytes of the last chunk
+    size_t m_chunkUsed = 0;
+    size_t m_mappedChunk = 0;
+    uint8_t* m_mappedData = nullptr;
+    uint64_t m_fileSize = 0;
+    uint64_t m_size = 0;
+    std::vector<Location> m_frames;
+#ifdef _WIN32
+    void* m_file = nullptr;
+#else
+    int m_file = -1;
+#endif
+};
@@ -0,0 +1,417 @@
+#include "GifDecoder.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+namespace
+{
+    constexpr uint8_t ExtensionIntroducer = 0x21;
+    constexpr uint8_t GraphicControlLabel = 0xF9;
+    constexpr uint8_t ApplicationExtensionLabel = 0xFF;
+    constexpr uint8_t ImageSeparator = 0x2C;
+    constexpr uint8_t Trailer = 0x3B;
+
+    constexpr uint32_t MaxCodeSize = 12;
+    constexpr uint32_t MaxCodes = 1u << MaxCodeSize;
+
+    std::vector<uint8_t> ReadFileBytes(std::filesystem::path const& path)
+    {
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        if (!file.is_open())
+        {
+            throw std::runtime_error("Couldn't open " + path.string());
+        }
+        std::vector<uint8_t> bytes(static_cast<size_t>(file.tellg()));
+        file.seekg(0);
+        if (!file.read(reinterpret_cast<char*>(bytes.data()), static_cast<std::streamsize>(bytes.size())))
+        {
+            throw std::runtime_error("Couldn't read " + path.string());
+        }
+        return bytes;
+    }
+}
+
+GifDecoder::GifDecoder(std::filesystem::path const& path) :
+    GifDecoder(ReadFileBytes(path))
+{
+}
+
+GifDecoder::GifDecoder(std::vector<uint8_t> bytes)
+{
+    m_bytes = std::move(bytes);
+    m_prefixes.resize(MaxCodes);
+    m_suffixes.resize(MaxCodes);
+    m_stack.reserve(MaxCodes);
+    ReadHeader();
+}
+
+void GifDecoder::ReadHeader()
+{
+    if (m_bytes.size() < 13 ||
+        (memcmp(m_bytes.data(), "GIF89a", 6) != 0 && memcmp(m_bytes.data(), "GIF87a", 6) != 0))
+    {
+        throw std::runtime_error("Not a GIF file");
+    }
+    m_position = 6;
+
+    // Logical screen descriptor
+    m_width = ReadUInt16();
+    m_height = ReadUInt16();
+    auto packed = ReadByte();
+    m_backgroundIndex = ReadByte();
+    ReadByte(); // Pixel aspect ratio
+    if (packed & 0x80)
+    {
+        ReadColorTable((packed & 0x07) + 1, m_globalPalette);
+    }
+
+    // Graphic control extensions belong to the first frame, so they're
+    // left for ReadFrame along with everything after them.
+    while (m_position + 1 < m_bytes.size() &&
+        m_bytes[m_position] == ExtensionIntroducer &&
+        m_bytes[m_position + 1] != GraphicControlLabel)
+    {
+        m_position++;
+        auto label = ReadByte();
+        if (label == ApplicationExtensionLabel)
+        {
+            ReadApplicationExtension();
+        }
+        else
+        {
+            ReadSubBlocks(nullptr);
+        }
+    }
+}
+
+bool GifDecoder::ReadFrame(GifDecodedFrame& frame)
+{
+    // Graphic control extensions apply to the next image
+    frame.Description = {};
+    frame.Description.Disposal = GifDisposalMethod::Unspecified;
+    while (m_position < m_bytes.size())
+    {
+        auto blockType = ReadByte();
+        if (blockType == Trailer)
+        {
+            return false;
+        }
+        else if (blockType == ExtensionIntroducer)
+        {
+            auto label = ReadByte();
+            if (label == GraphicControlLabel)
+            {
+                auto size = ReadByte();
+                if (size < 4)
+                {
+                    throw std::runtime_error("Graphic control extension is too small");
+                }
+                auto packed = ReadByte();
+                frame.Description.Disposal = static_cast<GifDisposalMethod>((packed >> 2) & 0x07);
+                frame.Description.Delay = ReadUInt16();
+                auto transparentIndex = ReadByte();
+                frame.Description.TransparentIndex.reset();
+                if (packed & 0x01)
+                {
+                    frame.Description.TransparentIndex = transparentIndex;
+                }
+                m_position += size - 4;
+                ReadSubBlocks(nullptr);
+            }
+            else if (label == ApplicationExtensionLabel)
+            {
+                ReadApplicationExtension();
+            }
+            else
+            {
+                ReadSubBlocks(nullptr);
+            }
+        }
+        else if (blockType == ImageSeparator)
+        {
+            auto&& description = frame.Description;
+            description.Left = ReadUInt16();
+            description.Top = ReadUInt16();
+            description.Width = ReadUInt16();
+            description.Height = ReadUInt16();
+            auto packed = ReadByte();
+            if (description.Width == 0 || description.Height == 0 ||
+                static_cast<uint32_t>(description.Left) + description.Width > m_width ||
+                static_cast<uint32_t>(description.Top) + description.Height > m_height)
+            {
+                throw std::runtime_error("Frame doesn't fit within the logical screen");
+            }
+
+            frame.HasLocalPalette = (packed & 0x80) != 0;
+            if (frame.HasLocalPalette)
+            {
+                ReadColorTable((packed & 0x07) + 1, frame.Palette);
+            }
+            else if (!m_globalPalette.empty())
+            {
+                frame.Palette = m_globalPalette;
+            }
+            else
+            {
+                throw std::runtime_error("Frame has no color table");
+            }
+
+            auto minimumCodeSize = ReadByte();
+            DecodeImageData(minimumCodeSize, frame);
+
+            if (packed & 0x40)
+            {
+                // Rows are stored in four passes: every 8th row from 0,
+                // every 8th from 4, every 4th from 2, every 2nd from 1.
+                auto rowBytes = static_cast<size_t>(description.Width);
+                std::vector<uint8_t> interlaced(frame.Indices);
+                const uint32_t starts[] = { 0, 4, 2, 1 };
+                const uint32_t steps[] = { 8, 8, 4, 2 };
+                size_t sourceRow = 0;
+                for (uint32_t pass = 0; pass < 4; pass++)
+                {
+                    for (uint32_t y = starts[pass]; y < description.Height; y += steps[pass])
+                    {
+                        std::copy_n(interlaced.data() + (sourceRow * rowBytes), rowBytes, frame.Indices.data() + (y * rowBytes));
+                        sourceRow++;
+                    }
+                }
+            }
+            return true;
+        }
+        else
+        {
+            throw std::runtime_error("Unknown GIF block");
+        }
+    }
+    return false;
+}
+
+uint8_t GifDecoder::ReadByte()
+{
+    if (m_position >= m_bytes.size())
+    {
+        throw std::runtime_error("GIF file ends unexpectedly");
+    }
+    return m_bytes[m_position++];
+}
+
+uint16_t GifDecoder::ReadUInt16()
+{
+    auto low = ReadByte();
+    auto high = ReadByte();
+    return static_cast<uint16_t>(low | (high << 8));
+}
+
+void GifDecoder::ReadColorTable(uint32_t bits, std::vector<GifColor>& palette)
+{
+    auto count = 1u << bits;
+    if (m_position + (count * 3) > m_bytes.size())
+    {
+        throw std::runtime_error("GIF file ends unexpectedly");
+    }
+    palette.resize(count);
+    for (auto&& color : palette)
+    {
+        color.R = m_bytes[m_position++];
+        color.G = m_bytes[m_position++];
+        color.B = m_bytes[m_position++];
+    }
+}
+
+void GifDecoder::ReadSubBlocks(std::vector<uint8_t>* output)
+{
+    while (true)
+    {
+        auto size = ReadByte();
+        if (size == 0)
+        {
+            return;
+        }
+        if (m_position + size > m_bytes.size())
+        {
+            throw std::runtime_error("GIF file ends unexpectedly");
+        }
+        if (output != nullptr)
+        {
+            output->insert(output->end(), m_bytes.begin() + m_position, m_bytes.begin() + m_position + size);
+        }
+        m_position += size;
+    }
+}
+
+void GifDecoder::ReadApplicationExtension()
+{
+    std::vector<uint8_t> data;
+    ReadSubBlocks(&data);
+    // The identifier block is followed by the looping block
+    if (data.size() >= 14 && memcmp(data.data(), "NETSCAPE2.0", 11) == 0 && data[11] == 1)
+    {
+        m_loopCount = static_cast<uint16_t>(data[12] | (data[13] << 8));
+    }
+}
+
+void GifDecoder::DecodeImageData(uint8_t minimumCodeSize, GifDecodedFrame& frame)
+{
+    if (minimumCodeSize < 2 || minimumCodeSize > 8)
+    {
+        throw std::runtime_error("Invalid LZW minimum code size");
+    }
+    m_imageData.clear();
+    ReadSubBlocks(&m_imageData);
+
+    auto pixelCount = static_cast<size_t>(frame.Description.Width) * frame.Description.Height;
+    frame.Indices.resize(pixelCount);
+
+    const uint32_t clearCode = 1u << minimumCodeSize;
+    const uint32_t endCode = clearCode + 1;
+    for (uint32_t code = 0; code < clearCode; code++)
+    {
+        m_prefixes[code] = 0;
+        m_suffixes[code] = static_cast<uint8_t>(code);
+    }
+
+    uint32_t codeSize = minimumCodeSize + 1;
+    uint32_t nextCode = endCode + 1;
+    uint32_t previousCode = MaxCodes;
+    uint8_t firstIndex = 0;
+    uint32_t bitBuffer = 0;
+    uint32_t bitCount = 0;
+    size_t bytePosition = 0;
+    size_t written = 0;
+    while (written < pixelCount)
+    {
+        while (bitCount < codeSize && bytePosition < m_imageData.size())
+        {
+            bitBuffer |= static_cast<uint32_t>(m_imageData[bytePosition++]) << bitCount;
+            bitCount += 8;
+        }
+        if (bitCount < codeSize)
+        {
+            throw std::runtime_error("LZW data ends before the frame is complete");
+        }
+        auto code = bitBuffer & ((1u << codeSize) - 1);
+        bitBuffer >>= codeSize;
+        bitCount -= codeSize;
+
+        if (code == clearCode)
+        {
+            codeSize = minimumCodeSize + 1;
+            nextCode = endCode + 1;
+            previousCode = MaxCodes;
+            continue;
+        }
+        if (code == endCode)
+        {
+            throw std::runtime_error("LZW data ends before the frame is complete");
+        }
+        if (previousCode == MaxCodes)
+        {
+            if (code >= clearCode)
+            {
+                throw std::runtime_error("Invalid LZW code");
+            }
+            firstIndex = static_cast<uint8_t>(code);
+            frame.Indices[written++] = firstIndex;
+            previousCode = code;
+            continue;
+        }
+
+        // Walk the string backwards onto the stack. A code that isn't in
+        // the table yet is the previous string plus its own first index.
+        m_stack.clear();
+        auto current = code;
+        if (code == nextCode)
+        {
+            m_stack.push_back(firstIndex);
+            current = previousCode;
+        }
+        else if (code > nextCode)
+        {
+            throw std::runtime_error("Invalid LZW code");
+        }
+        while (current >= clearCode)
+        {
+            m_stack.push_back(m_suffixes[current]);
+            current = m_prefixes[current];
+        }
+        firstIndex = static_cast<uint8_t>(current);
+        m_stack.push_back(firstIndex);
+
+        auto count = std::min(m_stack.size(), pixelCount - written);
+        for (size_t i = 0; i < count; i++)
+        {
+            frame.Indices[written++] = m_stack[m_stack.size() - 1 - i];
+        }
+
+        if (nextCode < MaxCodes)
+        {
+            m_prefixes[nextCode] = static_cast<uint16_t>(previousCode);
+            m_suffixes[nextCode] = firstIndex;
+            nextCode++;
+            if (nextCode == (1u << codeSize) && codeSize < MaxCodeSize)
+            {
+                codeSize++;
+            }
+        }
+        previousCode = code;
+    }
+}
+
+GifCanvas::GifCanvas(uint32_t width, uint32_t height)
+{
+    m_width = width;
+    m_height = height;
+    m_pixels.resize(static_cast<size_t>(width) * height * 4);
+}
+
+void GifCanvas::DrawFrame(GifDecodedFrame const& frame)
+{
+    auto stride = Stride();
+    if (m_hasPreviousFrame)
+    {
+        auto&& previous = m_previousFrame;
+        if (previous.Disposal == GifDisposalMethod::RestoreToBackground)
+        {
+            // Viewers treat the background as transparent
+            for (uint32_t y = 0; y < previous.Height; y++)
+            {
+                auto row = m_pixels.data() + ((previous.Top + y) * stride) + (static_cast<size_t>(previous.Left) * 4);
+                std::fill_n(row, static_cast<size_t>(previous.Width) * 4, static_cast<uint8_t>(0));
+            }
+        }
+        else if (previous.Disposal == GifDisposalMethod::RestoreToPrevious)
+        {
+            m_pixels.swap(m_savedPixels);
+        }
+    }
+
+    auto&& description = frame.Description;
+    if (description.Disposal == GifDisposalMethod::RestoreToPrevious)
+    {
+        m_savedPixels = m_pixels;
+    }
+    for (uint32_t y = 0; y < description.Height; y++)
+    {
+        auto indices = frame.Indices.data() + (static_cast<size_t>(y) * description.Width);
+        auto row = m_pixels.data() + ((description.Top + y) * stride) + (static_cast<size_t>(description.Left) * 4);
+        for (uint32_t x = 0; x < description.Width; x++)
+        {
+            auto index = indices[x];
+            if (description.TransparentIndex.has_value() && index == description.TransparentIndex.value())
+            {
+                continue;
+            }
+            // Indices past the end of the table are black, like most viewers
+            auto color = index < frame.Palette.size() ? frame.Palette[index] : GifColor{ 0, 0, 0 };
+            auto pixel = row + (static_cast<size_t>(x) * 4);
+            pixel[0] = color.B;
+            pixel[1] = color.G;
+            pixel[2] = color.R;
+            pixel[3] = 255;
+        }
+    }
+    m_previousFrame = description;
+    m_hasPreviousFrame = true;
+}
@@ -0,0 +1,90 @@
+#pragma once
+#include "GifWriter.h"
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <vector>
+
+// A frame as it's stored in the file, before it's drawn anywhere.
+struct GifDecodedFrame
+{
+    GifFrameDescription Description = {};
+    // The frame's local color table, or the global one if it has none
+    std::vector<GifColor> Palette;
+    bool HasLocalPalette = false;
+    // Width * Height, tightly packed and no longer interlaced
+    std::vector<uint8_t> Indices;
+};
+
+// Reads GIF87a/GIF89a files one frame at a time. Unknown extensions
+// are skipped. Malformed files throw std::runtime_error.
+class GifDecoder
+{
+public:
+    GifDecoder(std::filesystem::path const& path);
+    GifDecoder(std::vector<uint8_t> bytes);
+
+    uint16_t Width() const { return m_width; }
+    uint16_t Height() const { return m_height; }
+    std::vector<GifColor> const& GlobalPalette() const { return m_globalPalette; }
+    uint8_t BackgroundIndex() const { return m_backgroundIndex; }
+    // 0 loops forever. Files without a looping extension have no
+    // loop count, and most viewers play them once.
+    std::optional<uint16_t> LoopCount() const { return m_loopCount; }
+
+    // Returns false once the trailer (or the end of the file) is reached.
+    bool ReadFrame(GifDecodedFrame& frame);
+
+private:
+    // Also reads the extensions in front of the first frame, which is
+    // where the looping extension goes.
+    void ReadHeader();
+    uint8_t ReadByte();
+    uint16_t ReadUInt16();
+    void ReadColorTable(uint32_t bits, std::vector<GifColor>& palette);
+    // Appends the data of a chain of sub-blocks to the output, or skips
+    // them if there isn't one.
+    void ReadSubBlocks(std::vector<uint8_t>* output);
+    void ReadApplicationExtension();
+    void DecodeImageData(uint8_t minimumCodeSize, GifDecodedFrame& frame);
+
+private:
+    std::vector<uint8_t> m_bytes;
+    size_t m_position = 0;
+    uint16_t m_width = 0;
+    uint16_t m_height = 0;
+    std::vector<GifColor> m_globalPalette;
+    uint8_t m_backgroundIndex = 0;
+    std::optional<uint16_t> m_loopCount;
+    std::vector<uint8_t> m_imageData;
+    // LZW string table
+    std::vector<uint16_t> m_prefixes;
+    std::vector<uint8_t> m_suffixes;
+    std::vector<uint8_t> m_stack;
+};
+
+// Draws decoded frames onto a BGRA8 canvas the way a viewer would,
+// honoring transparency and each frame's disposal method. Pixels no
+// frame has drawn to yet are transparent black.
+class GifCanvas
+{
+public:
+    GifCanvas(uint32_t width, uint32_t height);
+
+    // Disposes of the previous frame, then draws this one.
+    void DrawFrame(GifDecodedFrame const& frame);
+
+    uint32_t Width() const { return m_width; }
+    uint32_t Height() const { return m_height; }
+    size_t Stride() const { return static_cast<size_t>(m_width) * 4; }
+    uint8_t const* Pixels() const { return m_pixels.data(); }
+
+private:
+    uint32_t m_width = 0;
+    uint32_t m_height = 0;
+    std::vector<uint8_t> m_pixels;
+    std::vector<uint8_t> m_savedPixels;
+    GifFrameDescription m_previousFrame = {};
+    bool m_hasPreviousFrame = false;
+};
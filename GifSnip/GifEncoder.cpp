@@ -19,205 +19,83 @@ GifEncoder::GifEncoder(
     winrt::com_ptr<ID3D11Device> const& d3dDevice, 
     winrt::com_ptr<ID3D11DeviceContext> const& d3dContext,
     winrt::IRandomAccessStream const& stream,
-    RECT const& rect)
+    RECT const& rect,
+    GifEncoderOptions const& options)
 {
-    m_d3dContext = d3dContext;
+    m_options = options;
     m_rect = rect;
     m_gifSize = { rect.right - rect.left, rect.bottom - rect.top };
 
-    m_encoder = CreateWgiEncoderAsync(stream).get();
-
-    // Create our staging texture
-    D3D11_TEXTURE2D_DESC description = {};
-    description.Width = m_gifSize.Width;
-    description.Height = m_gifSize.Height;
-    description.MipLevels = 1;
-    description.ArraySize = 1;
-    description.Format = DXGI_FORMAT_B8G8R8A8_UNORM;
-    description.SampleDesc.Count = 1;
-    description.SampleDesc.Quality = 0;
-    description.Usage = D3D11_USAGE_STAGING;
-    description.BindFlags = 0;
-    description.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
-    winrt::check_hresult(d3dDevice->CreateTexture2D(&description, nullptr, m_stagingTexture.put()));
+    // Everything after readback is shared with headless encoding
+    m_output = std::make_unique<StreamGifOutputStream>(stream);
+    m_pipeline = std::make_unique<GifPipeline>(
+        static_cast<uint32_t>(m_gifSize.Width),
+        static_cast<uint32_t>(m_gifSize.Height),
+        *m_output,
+        m_options);
 
     // Setup our frame compositor and texture differ
     m_frameCompositor = std::make_unique<FrameCompositor>(d3dDevice, d3dContext, m_rect);
-    m_textureDiffer = std::make_unique<TextureDiffer>(d3dDevice, d3dContext, m_gifSize);
+    m_textureDiffer = std::make_unique<TextureDiffer>(d3dDevice, d3dContext, m_gifSize, m_options.TileSize, m_options.Detection, m_options.Tolerance);
+
+    // Frames and diff results come back off the GPU a few frames late
+    m_readback = std::make_unique<D3D11FrameReadback>(d3dDevice, d3dContext, m_gifSize, m_textureDiffer->TileWordCount(), std::max(m_options.ReadbackSlots, 1u));
+    m_readbackRing = std::make_unique<ReadbackRing<PendingFrame>>(*m_readback, m_options.ReadbackLatency);
 }
 
 bool GifEncoder::ProcessFrame(winrt::Direct3D11CaptureFrame const& frame)
 {
-    auto timeStamp = frame.SystemRelativeTime();
-
-    auto firstFrame = false;
-
-    // Compute frame delta
-    if (m_lastTimeStamp.count() == 0)
+    if (!m_pipeline->AcceptFrame(frame.SystemRelativeTime()))
     {
-        m_lastTimeStamp = timeStamp;
-        firstFrame = true;
+        return false;
     }
-    auto timeStampDelta = timeStamp - m_lastTimeStamp;
 
-    // Throttle frame processing to 30fps
-    if (!firstFrame && timeStampDelta < std::chrono::milliseconds(33))
+    TraceSpan span("ProcessFrame");
+    ComposedFrame composedFrame = {};
     {
-        return false;
+        TraceSpan span("Compose");
+        composedFrame = m_frameCompositor->ProcessFrame(frame);
     }
-    m_lastCandidateTimeStamp = timeStamp;
-
-    auto composedFrame = m_frameCompositor->ProcessFrame(frame);
+    SubmitFrame(composedFrame, false);
 
-    return ProcessFrameAsync(composedFrame, false).get();
+    return true;
 }
 
 winrt::IAsyncAction GifEncoder::StopEncodingAsync()
 {
-    // Repeat the last frame
-    auto composedFrame = m_frameCompositor->RepeatFrame(m_lastCandidateTimeStamp);
-    co_await ProcessFrameAsync(composedFrame, true);
-
-    co_await m_encoder.FlushAsync();
-}
-
-winrt::IAsyncOperation<winrt::BitmapEncoder> GifEncoder::CreateWgiEncoderAsync(
-    winrt::IRandomAccessStream stream)
-{
-    // Setup our encoder
-    auto encoder = co_await winrt::BitmapEncoder::CreateAsync(winrt::BitmapEncoder::GifEncoderId(), stream);
-    auto containerProperties = encoder.BitmapContainerProperties();
-    // Write the application block
-    // http://www.vurdalakov.net/misc/gif/netscape-looping-application-extension
-    std::string text("NETSCAPE2.0");
-    std::vector<uint8_t> chars(text.begin(), text.end());
-    WINRT_VERIFY(chars.size() == 11);
-    co_await containerProperties.SetPropertiesAsync(
+    // Repeat the last frame, then read back everything still in flight
+    auto composedFrame = m_frameCompositor->RepeatFrame(m_pipeline->LastAcceptedTimeStamp());
+    SubmitFrame(composedFrame, true);
+    m_readbackRing->Flush([this](ReadbackData const& data, PendingFrame const& pendingFrame)
         {
-            { L"/appext/application", winrt::BitmapTypedValue(winrt::PropertyValue::CreateUInt8Array(chars), winrt::PropertyType::UInt8Array) },
-            // The first value is the size of the block, which is the fixed value 3.
-            // The second value is the looping extension, which is the fixed value 1.
-            // The third and fourth values comprise an unsigned 2-byte integer (little endian).
-            //     The value of 0 means to loop infinitely.
-            // The final value is the block terminator, which is the fixed value 0.
-            { L"/appext/data", winrt::BitmapTypedValue(winrt::PropertyValue::CreateUInt8Array({ 3, 1, 0, 0, 0 }), winrt::PropertyType::UInt8Array) },
+            m_pipeline->CaptureFrame(data, pendingFrame);
         });
-    co_return encoder;
+
+    m_pipeline->Finish();
+    m_statistics = m_pipeline->Statistics();
+    m_statistics.ReadbackStalls = m_readbackRing->StallCount();
+    co_return;
 }
 
-winrt::IAsyncOperation<bool> GifEncoder::ProcessFrameAsync(ComposedFrame const& composedFrame, bool force)
+void GifEncoder::SubmitFrame(ComposedFrame const& composedFrame, bool force)
 {
-    bool updated = false;
-
-    auto diff = m_textureDiffer->ProcessFrame(composedFrame.Texture);
-    if (force && !diff.has_value())
+    auto consume = [this](ReadbackData const& data, PendingFrame const& pendingFrame)
     {
-        // Since there's no change, pick a small random part of the frame.
-        diff = std::optional(DiffRect{ 0, 0, 5, 5 });
-    }
+        m_pipeline->CaptureFrame(data, pendingFrame);
+    };
 
-    if (auto diffRect = diff)
+    auto slot = m_readbackRing->BeginFrame(consume);
     {
-        auto timeStampDelta = composedFrame.SystemRelativeTime - m_lastTimeStamp;
-        m_lastTimeStamp = composedFrame.SystemRelativeTime;
-
-        // Inflate our rect to eliminate artifacts
-        auto inflateAmount = 1;
-        auto left = static_cast<uint32_t>(std::max(static_cast<int32_t>(diffRect->Left) - inflateAmount, 0));
-        auto top = static_cast<uint32_t>(std::max(static_cast<int32_t>(diffRect->Top) - inflateAmount, 0));
-        auto right = static_cast<uint32_t>(std::min(static_cast<int32_t>(diffRect->Right) + inflateAmount, m_gifSize.Width));
-        auto bottom = static_cast<uint32_t>(std::min(static_cast<int32_t>(diffRect->Bottom) + inflateAmount, m_gifSize.Height));
-
-        auto diffWidth = right - left;
-        auto diffHeight = bottom - top;
-
-        // Copy the relevant portion into our staging texture
-        D3D11_BOX region = {};
-        region.left = left;
-        region.right = right;
-        region.top = top;
-        region.bottom = bottom;
-        region.back = 1;
-        m_d3dContext->CopySubresourceRegion(m_stagingTexture.get(), 0, left, top, 0, composedFrame.Texture.get(), 0, &region);
-
-        // Copy the bytes from the staging texture
-        D3D11_TEXTURE2D_DESC desc = {};
-        m_stagingTexture->GetDesc(&desc);
-        size_t bytesPerPixel = 4; // Assuming BGRA8
-        D3D11_MAPPED_SUBRESOURCE mapped = {};
-        winrt::check_hresult(m_d3dContext->Map(m_stagingTexture.get(), 0, D3D11_MAP_READ, 0, &mapped));
-        // Textures can occupy more space in video memory than you might expect given
-        // their size and pixel format. The RowPitch field in the D3D11_MAPPED_SUBRESOURCE
-        // tells you how many bytes there are per "row".
-        auto destStride = static_cast<size_t>(diffWidth) * bytesPerPixel;
-        std::vector<byte> bytes(destStride * static_cast<size_t>(diffHeight), 0);
-        auto source = reinterpret_cast<byte*>(mapped.pData);
-        auto dest = bytes.data();
-        source += (mapped.RowPitch * static_cast<size_t>(top)) + (static_cast<size_t>(left) * bytesPerPixel);
-        for (auto i = 0; i < (int)diffHeight; i++)
-        {
-            memcpy(dest, source, destStride);
-
-            source += mapped.RowPitch;
-            dest += destStride;
-        }
-        m_d3dContext->Unmap(m_stagingTexture.get(), 0);
-
-        auto frame = std::make_shared<GifFrameImage>(std::move(bytes), DiffRect{left, top, right, bottom}, composedFrame.SystemRelativeTime);
-        //co_await EncodeFrameAsync(frame, composedFrame.SystemRelativeTime + timeStampDelta, force);
-        m_previousFrame.swap(frame);
-        if (frame != nullptr)
-        {
-            auto currentTime = composedFrame.SystemRelativeTime;
-            if (force)
-            {
-                currentTime += timeStampDelta;
-            }
-            co_await EncodeFrameAsync(frame, currentTime, force);
-        }
-        
-        updated = true;
+        TraceSpan span("Diff");
+        m_textureDiffer->ProcessFrame(composedFrame.Texture);
     }
-
-    co_return updated;
-}
-
-winrt::IAsyncAction GifEncoder::EncodeFrameAsync(std::shared_ptr<GifFrameImage> frame, winrt::TimeSpan currentTime, bool force)
-{
-    auto frameWidth = frame->Rect.Right - frame->Rect.Left;
-    auto frameHeight = frame->Rect.Bottom - frame->Rect.Top;
-
-    auto frameDuration = currentTime - frame->TimeStamp;
-    // Compute the frame delay
-    auto millisconds = std::chrono::duration_cast<std::chrono::milliseconds>(frameDuration);
-    // Use 10ms units
-    auto frameDelay = millisconds.count() / 10;
-
-    // Advance to the next frame (we don't do this at the end to avoid empty frames)
-    if (frameCount > 0)
     {
-        co_await m_encoder.GoToNextFrameAsync();
+        TraceSpan span("CopyFrame");
+        m_readback->CopyFrame(slot, composedFrame.Texture, m_textureDiffer->DiffBuffer(), m_textureDiffer->TileBuffer());
     }
 
-    // Write our frame delay
-    co_await m_encoder.BitmapProperties().SetPropertiesAsync(
-        {
-            { L"/grctlext/Delay", winrt::BitmapTypedValue(winrt::PropertyValue::CreateUInt16(static_cast<uint16_t>(frameDelay)), winrt::PropertyType::UInt16) },
-            { L"/imgdesc/Left", winrt::BitmapTypedValue(winrt::PropertyValue::CreateUInt16(static_cast<uint16_t>(frame->Rect.Left)), winrt::PropertyType::UInt16) },
-            { L"/imgdesc/Top", winrt::BitmapTypedValue(winrt::PropertyValue::CreateUInt16(static_cast<uint16_t>(frame->Rect.Top)), winrt::PropertyType::UInt16) },
-        });
-
-    // Write the frame to our image
-    m_encoder.SetPixelData(
-        winrt::BitmapPixelFormat::Bgra8,
-        winrt::BitmapAlphaMode::Premultiplied,
-        frameWidth,
-        frameHeight,
-        1.0,
-        1.0,
-        frame->Bytes);
-
-    frameCount++;
+    PendingFrame pendingFrame = {};
+    pendingFrame.SystemRelativeTime = composedFrame.SystemRelativeTime;
+    pendingFrame.Force = force;
+    m_readbackRing->EndFrame(std::move(pendingFrame), consume);
 }
-
-
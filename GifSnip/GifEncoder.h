@@ -1,6 +1,11 @@
 #pragma once
 #include "FrameCompositor.h"
 #include "TextureDiffer.h"
+#include "D3D11FrameReadback.h"
+#include "StreamGifOutputStream.h"
+#include "GifPipeline.h"
+#include "GifEncoderOptions.h"
+#include "GifEncoderStatistics.h"
 
 class GifEncoder
 {
@@ -9,43 +14,29 @@ public:
         winrt::com_ptr<ID3D11Device> const& d3dDevice,
         winrt::com_ptr<ID3D11DeviceContext> const& d3dContext,
         winrt::Windows::Storage::Streams::IRandomAccessStream const& stream,
-        RECT const& rect);
+        RECT const& rect,
+        GifEncoderOptions const& options = {});
     
+    // Returns true if the frame was handed to the GPU for diffing and
+    // readback. Its pixels are read a few frames later.
     bool ProcessFrame(winrt::Windows::Graphics::Capture::Direct3D11CaptureFrame const& frame);
 
     winrt::Windows::Foundation::IAsyncAction StopEncodingAsync();
 
-private:
-    struct GifFrameImage
-    {
-        std::vector<byte> Bytes;
-        DiffRect Rect = {};
-        winrt::Windows::Foundation::TimeSpan TimeStamp = {};
-
-        GifFrameImage(std::vector<byte>&& bytes, DiffRect const& rect, winrt::Windows::Foundation::TimeSpan const& timeStamp)
-        {
-            Bytes = std::move(bytes);
-            Rect = rect;
-            TimeStamp = timeStamp;
-        }
-    };
+    GifEncoderStatistics const& Statistics() const { return m_statistics; }
 
-    static winrt::Windows::Foundation::IAsyncOperation<winrt::Windows::Graphics::Imaging::BitmapEncoder> CreateWgiEncoderAsync(winrt::Windows::Storage::Streams::IRandomAccessStream stream);
-
-    winrt::Windows::Foundation::IAsyncOperation<bool> ProcessFrameAsync(ComposedFrame const& composedFrame, bool force);
-    winrt::Windows::Foundation::IAsyncAction EncodeFrameAsync(std::shared_ptr<GifFrameImage> frame, winrt::Windows::Foundation::TimeSpan currentTime, bool force);
+private:
+    void SubmitFrame(ComposedFrame const& composedFrame, bool force);
 
 private:
-    winrt::com_ptr<ID3D11DeviceContext> m_d3dContext;
-    winrt::Windows::Graphics::Imaging::BitmapEncoder m_encoder{ nullptr };
-    winrt::com_ptr<ID3D11Texture2D> m_stagingTexture;
+    GifEncoderOptions m_options = {};
+    std::unique_ptr<StreamGifOutputStream> m_output;
+    std::unique_ptr<GifPipeline> m_pipeline;
+    GifEncoderStatistics m_statistics = {};
     std::unique_ptr<FrameCompositor> m_frameCompositor;
     std::unique_ptr<TextureDiffer> m_textureDiffer;
+    std::unique_ptr<D3D11FrameReadback> m_readback;
+    std::unique_ptr<ReadbackRing<PendingFrame>> m_readbackRing;
     winrt::Windows::Graphics::SizeInt32 m_gifSize = {};
-    winrt::Windows::Foundation::TimeSpan m_lastTimeStamp = {};
-    winrt::Windows::Foundation::TimeSpan m_lastCandidateTimeStamp = {};
-    uint64_t frameCount = 0;
     RECT m_rect = {};
-    std::shared_ptr<GifFrameImage> m_previousFrame;
-    bool m_firstSubmittedFrame = true;
-};
\ No newline at end of file
+};
@@ -0,0 +1,107 @@
+#pragma once
+#include "DirtyTileMap.h"
+#include "ColorQuantizer.h"
+#include "DiffTolerance.h"
+#include "Ditherer.h"
+#include "TileHash.h"
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+
+struct GifEncoderOptions
+{
+    // Captured frames are sampled at between these two rates. The rate
+    // drops towards the minimum while the screen is quiet or the encoder
+    // is behind, and goes back up as soon as something changes.
+    uint32_t MinFrameRate = 10;
+    uint32_t MaxFrameRate = 30;
+    // Changes are tracked on a grid of square tiles this many pixels wide.
+    uint32_t TileSize = DirtyTileMap::DefaultTileSize;
+    // How changed tiles are found. TileHash keeps 8 bytes per tile
+    // instead of a copy of the previous frame, which pays off for large
+    // capture regions, especially with a TileSize of 32. Its rects are
+    // whole tiles, but unchanged pixels inside them still come out
+    // transparent.
+    ChangeDetection Detection = ChangeDetection::Exact;
+    // How big a change has to be before it gets a frame, see
+    // DiffTolerance. Only used with ChangeDetection::Exact, and when
+    // it isn't exact, rects are rounded out to whole tiles.
+    DiffTolerance Tolerance = {};
+    // Each frame is written as up to this many image blocks, one per
+    // cluster of dirty tiles. Only the last block carries the frame's
+    // delay, the rest get a delay of zero. Browsers stretch frames with
+    // a delay of 10ms or less to 100ms, so this is opt-in.
+    uint32_t MaxRegionsPerFrame = 1;
+    // Pixels that haven't changed since the previous frame are written
+    // with a reserved transparent index, which LZW compresses far better
+    // than the original colors.
+    bool UseTransparency = true;
+    // Checks each region again once it's been mapped to its palette, and
+    // leaves out pixels that come out the same color as what's already
+    // shown. Regions are cut down to what's left, and a frame with
+    // nothing left isn't written: the frame before it stays up for its
+    // delay too. Catches changes that fall inside a single palette
+    // entry, common in gradients and video, at the cost of mapping on
+    // the encoder thread rather than the pool.
+    bool DropInvisibleChanges = false;
+    // Each region gets its own palette built by this algorithm.
+    QuantizerAlgorithm Quantizer = QuantizerAlgorithm::Octree;
+    // How quantized regions are mapped to their palette, see DitherMode.
+    // Ordered keeps unchanged pixels stable from frame to frame, so they
+    // still come out transparent. Regions with few enough colors for an
+    // exact palette are never dithered.
+    DitherMode Dither = DitherMode::None;
+    // Number of palette entries per region, including the transparent
+    // one. 256, 128 and 64 are the useful values; smaller palettes cost
+    // color fidelity but quantize and compress faster.
+    uint32_t PaletteSize = 256;
+    // The previous palette is reused for a region if mapping the region
+    // onto it costs no more than this root mean square error per channel
+    // (0-255). Regions with few enough colors to skip quantization only
+    // reuse a palette that has all of their colors. 0 disables reuse.
+    double PaletteReuseMaxError = 3.0;
+    // Reserves a global color table in the header. Once a palette has
+    // been reused by enough frames in a row it becomes the global one,
+    // and frames that fit it no longer carry a local color table.
+    bool UseGlobalPalette = true;
+    // How many times viewers repeat the GIF, 0 for forever. Without a
+    // loop count the GIF has no looping extension and plays once.
+    std::optional<uint16_t> LoopCount = 0;
+    // Frames wait for the encoder thread in a queue of this many
+    // entries. When it's full, captured frames are skipped rather than
+    // stalling capture: their changes are carried over and written
+    // with the next frame that fits, and the frame before them stays
+    // up in their place.
+    uint32_t FrameQueueCapacity = 8;
+    // Turning this off makes frames wait for room in the queue instead,
+    // which keeps the output the same from run to run. Replays of
+    // recordings always wait.
+    bool SkipFramesWhenBehind = true;
+    // Frames are copied off the GPU into a ring of this many staging
+    // slots and read back ReadbackLatency frames later, by which time
+    // the copy has normally landed and mapping doesn't stall.
+    uint32_t ReadbackSlots = 3;
+    uint32_t ReadbackLatency = 2;
+    // Palette mapping and LZW compression run on a thread pool, up to
+    // this many frames at a time. 0 allows two frames per thread.
+    uint32_t MaxFramesInFlight = 0;
+    // Caps the memory held by frames being compressed. Once reached, the
+    // encoder waits for the oldest frame before starting another.
+    uint64_t MaxInFlightBytes = 256ull * 1024 * 1024;
+    // If set, every stage of the recording is traced and the trace is
+    // written here in Chrome's trace_event format when it stops.
+    std::filesystem::path TraceFile;
+    // If set, recording only copies the changed regions of each frame
+    // into a spool file here, and encoding starts once it stops, with
+    // the whole recording to work from. Frames are never skipped for
+    // being behind. The file is deleted when the recording is.
+    std::filesystem::path SpoolFile;
+    // With a spool file, also builds a palette for the whole recording,
+    // weighing each color by how many pixels show it and for how long.
+    // The recording gets encoded twice, once starting out with it as
+    // the global palette and once with per-region palettes alone, each
+    // into a file next to the spool, and the smaller file is kept.
+    // Regions it doesn't fit still get their own table. Needs
+    // UseGlobalPalette.
+    bool UseRecordingPalette = false;
+};
@@ -0,0 +1,57 @@
+#pragma once
+#include <cstdint>
+
+// Counters collected over the course of a recording.
+struct GifEncoderStatistics
+{
+    // Frames handed to the encoder by capture
+    uint64_t FramesReceived = 0;
+    // Frames dropped by the frame rate governor before being looked at
+    uint64_t ThrottledFrames = 0;
+    // Throttled frames that the maximum frame rate would have allowed,
+    // skipped because the screen had been quiet or because the encoder
+    // was behind
+    uint64_t IdleThrottledFrames = 0;
+    uint64_t BacklogThrottledFrames = 0;
+    // The longest gap between two sampled frames, in milliseconds
+    uint64_t LongestSampleInterval = 0;
+    // Frames that turned out to be the same as the one before
+    uint64_t UnchangedFrames = 0;
+    // Frames written to the file
+    uint64_t FramesEncoded = 0;
+    // Image blocks written, one or more per frame
+    uint64_t RegionsEncoded = 0;
+    // Frames that looked the same as the one before once mapped to their
+    // palette, left out with their delay added to the frame before
+    uint64_t InvisibleFrames = 0;
+    // Regions cut down to the part that still changed after mapping
+    uint64_t ShrunkRegions = 0;
+    // Regions with few enough colors to use them as the palette as-is,
+    // skipping quantization
+    uint64_t ExactPaletteRegions = 0;
+    // Regions that went through the quantizer
+    uint64_t QuantizedRegions = 0;
+    // Regions written with the previous region's palette
+    uint64_t ReusedPaletteRegions = 0;
+    // Regions written with the global palette, without a local table
+    uint64_t GlobalPaletteRegions = 0;
+    // Frames skipped because the encoder queue was full. Their changes
+    // were folded into the next frame.
+    uint64_t CoalescedFrames = 0;
+    // The most frames that were ever waiting for the encoder at once
+    uint64_t QueueHighWaterMark = 0;
+    // The most frames that were ever being compressed at once
+    uint64_t MaxFramesInFlight = 0;
+    // Times a frame buffer had to be allocated rather than reused. Stops
+    // growing once the recording reaches a steady state.
+    uint64_t FrameBufferAllocations = 0;
+    // Times reading a frame back had to wait for the GPU
+    uint64_t ReadbackStalls = 0;
+    // Bytes written to the spool file, when there is one
+    uint64_t SpoolBytes = 0;
+    // With UseRecordingPalette, how big the file came out when starting
+    // from the recording's palette and with per-region palettes alone.
+    // The smaller one is what got written.
+    uint64_t RecordingPaletteBytes = 0;
+    uint64_t LocalPaletteBytes = 0;
+};
@@ -0,0 +1,11 @@
+#pragma once
+#include "DiffRect.h"
+#include "FrameBufferPool.h"
+
+// Part of a frame that changed. The rect uses exclusive Right/Bottom
+// and the pixels are BGRA8, the same size as the rect.
+struct GifFrameRegion
+{
+    FrameBuffer Pixels;
+    DiffRect Rect = {};
+};
@@ -0,0 +1,632 @@
+#include "GifFrameEncoder.h"
+#include "ThreadPool.h"
+#include "Trace.h"
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+
+namespace
+{
+    // Regions at least this large are mapped to their palette in bands
+    // on several threads.
+    constexpr size_t MinPixelsForBandedMapping = 1024 * 1024;
+    // Floyd–Steinberg is several times slower per pixel, so it's worth
+    // banding sooner. Error doesn't cross from one band to the next.
+    constexpr size_t MinPixelsForBandedDithering = 256 * 1024;
+    constexpr uint32_t MinRowsPerBand = 64;
+}
+
+GifFrameEncoder::GifFrameEncoder(
+    uint32_t width,
+    uint32_t height,
+    GifEncoderOptions const& options,
+    ThreadPool& threadPool,
+    OutputCallback output) :
+    m_threadPool(threadPool),
+    m_canvas(width, height)
+{
+    m_options = options;
+    m_output = std::move(output);
+    m_minPixelsForBands = m_options.Dither == DitherMode::FloydSteinberg ? MinPixelsForBandedDithering : MinPixelsForBandedMapping;
+
+    // Every region gets its own palette. When using transparency, one
+    // entry is held back for the transparent index.
+    auto paletteSize = std::min(std::max(m_options.PaletteSize, 4u), 256u);
+    QuantizerOptions quantizerOptions = {};
+    quantizerOptions.Algorithm = m_options.Quantizer;
+    quantizerOptions.MaxColors = paletteSize;
+    if (m_options.UseTransparency)
+    {
+        quantizerOptions.MaxColors--;
+    }
+    m_quantizer = std::make_unique<ColorQuantizer>(quantizerOptions, &m_threadPool);
+    m_ditherer = Ditherer(m_options.Dither, quantizerOptions.MaxColors);
+
+    // The global color table is filled in when we finish, if a palette
+    // ever gets promoted. Until then it's just placeholder colors.
+    std::vector<GifColor> globalPalette;
+    if (m_options.UseGlobalPalette)
+    {
+        globalPalette.resize(paletteSize, GifColor{ 0, 0, 0 });
+    }
+    m_gifWriter = std::make_unique<GifWriter>(static_cast<uint16_t>(width), static_cast<uint16_t>(height), globalPalette, m_options.LoopCount);
+    if (m_options.DropInvisibleChanges)
+    {
+        m_shownCanvas = std::make_unique<FrameCanvas>(width, height);
+    }
+
+    m_maxFramesInFlight = m_options.MaxFramesInFlight;
+    if (m_maxFramesInFlight == 0)
+    {
+        m_maxFramesInFlight = std::max(m_threadPool.ThreadCount(), 1u) * 2;
+    }
+    m_inFlight.reserve(m_maxFramesInFlight);
+    m_freeJobs.reserve(m_maxFramesInFlight);
+}
+
+GifFrameEncoder::~GifFrameEncoder()
+{
+    // Tasks still point at us
+    for (auto&& job : m_inFlight)
+    {
+        std::unique_lock lock(job->Lock);
+        job->FinishedChanged.wait(lock, [&]() { return job->Finished; });
+    }
+}
+
+void GifFrameEncoder::SetGlobalPalette(std::vector<GifColor> const& palette)
+{
+    if (!m_options.UseGlobalPalette)
+    {
+        throw std::logic_error("There's no global color table to fill");
+    }
+    if (palette.empty() || palette.size() > m_quantizer->Options().MaxColors)
+    {
+        throw std::invalid_argument("Global palette doesn't fit");
+    }
+    if (m_statistics.RegionsEncoded > 0 || !m_inFlight.empty() || m_heldJob != nullptr)
+    {
+        throw std::logic_error("Global palette has to be set before the first frame");
+    }
+    m_globalPalette = palette;
+
+    // Nothing has been written yet, so the global color table can be
+    // made just big enough. Smaller tables mean shorter LZW codes.
+    auto globalTable = palette;
+    if (m_options.UseTransparency)
+    {
+        globalTable.push_back(GifColor{ 0, 0, 0 });
+    }
+    m_gifWriter = std::make_unique<GifWriter>(m_gifWriter->Width(), m_gifWriter->Height(), globalTable, m_options.LoopCount);
+}
+
+void GifFrameEncoder::EncodeFrame(std::vector<GifFrameRegion>& regions, uint16_t delay)
+{
+    // Check everything before touching any state, so a bad frame leaves
+    // the encoder as it was
+    for (auto&& region : regions)
+    {
+        auto rect = region.Rect;
+        if (rect.Left >= rect.Right || rect.Top >= rect.Bottom ||
+            rect.Right > m_gifWriter->Width() || rect.Bottom > m_gifWriter->Height())
+        {
+            throw std::invalid_argument("Region rect is empty or outside the frame");
+        }
+        auto&& view = region.Pixels.View();
+        if (view.Width != rect.Right - rect.Left || view.Height != rect.Bottom - rect.Top)
+        {
+            throw std::invalid_argument("Region buffer doesn't match its rect");
+        }
+    }
+    // An empty frame can only stretch one that's being held back
+    if (regions.empty() && m_heldJob == nullptr)
+    {
+        throw std::invalid_argument("Frames need at least one region");
+    }
+
+    auto job = AcquireJob();
+    if (job->Regions.size() < regions.size())
+    {
+        job->Regions.resize(regions.size());
+    }
+    size_t regionCount = 0;
+    for (auto&& region : regions)
+    {
+        auto&& regionJob = job->Regions[regionCount];
+        regionJob.Region = std::move(region);
+        auto rect = regionJob.Region.Rect;
+        auto width = rect.Right - rect.Left;
+        auto height = rect.Bottom - rect.Top;
+        auto pixelCount = static_cast<size_t>(width) * height;
+        auto&& view = regionJob.Region.Pixels.View();
+
+        // Pick a palette for the region
+        auto usesGlobalPalette = false;
+        {
+            TraceSpan span("ChoosePalette");
+            usesGlobalPalette = ChoosePalette(view.Data, view.Stride, width, height);
+        }
+        regionJob.Palette = m_palette;
+        // Exact palettes map without any error to spread
+        regionJob.Dither = m_options.Dither != DitherMode::None && !m_regionIsExact;
+
+        // Let unchanged pixels show through from the previous frame. The
+        // transparent index comes right after the palette's colors, the
+        // global color table always has room for it.
+        size_t unchangedCount = 0;
+        if (m_options.UseTransparency)
+        {
+            TraceSpan span("MarkUnchanged");
+            regionJob.UnchangedMask.resize(pixelCount);
+            unchangedCount = m_canvas.MarkUnchanged(rect, view.Data, view.Stride, regionJob.UnchangedMask.data());
+        }
+        m_canvas.Update(rect, view.Data, view.Stride);
+
+        // Changes that map to the colors already shown don't need
+        // writing. Drop the region if that's all it has, otherwise cut it
+        // down to the part that does change.
+        regionJob.Indices.clear();
+        if (m_options.DropInvisibleChanges)
+        {
+            auto visibleRect = FindVisibleChange(regionJob, unchangedCount);
+            if (!visibleRect.has_value())
+            {
+                regionJob.Region.Pixels.Release();
+                continue;
+            }
+            rect = visibleRect.value();
+            width = rect.Right - rect.Left;
+            height = rect.Bottom - rect.Top;
+            pixelCount = static_cast<size_t>(width) * height;
+        }
+
+        auto&& description = regionJob.Description;
+        description = {};
+        description.Left = static_cast<uint16_t>(rect.Left);
+        description.Top = static_cast<uint16_t>(rect.Top);
+        description.Width = static_cast<uint16_t>(width);
+        description.Height = static_cast<uint16_t>(height);
+        description.Disposal = GifDisposalMethod::DoNotDispose;
+        if (unchangedCount > 0)
+        {
+            description.TransparentIndex = static_cast<uint8_t>(m_palette.size());
+        }
+        regionJob.LocalPalette.clear();
+        if (!usesGlobalPalette)
+        {
+            regionJob.LocalPalette = m_palette;
+            if (unchangedCount > 0)
+            {
+                regionJob.LocalPalette.push_back(GifColor{ 0, 0, 0 });
+            }
+        }
+
+        // Pixels, mask, indices and output
+        job->MemorySize += pixelCount * 7;
+        m_statistics.RegionsEncoded++;
+        regionCount++;
+    }
+    regions.clear();
+    job->RegionCount = regionCount;
+
+    if (regionCount == 0)
+    {
+        // Nothing the decoder shows would change, so the frame before
+        // this one stays up in its place. Only possible once a frame has
+        // been shown, which is being held back: the frame was either
+        // empty, which was checked above, or lost every region to
+        // DropInvisibleChanges.
+        auto&& lastDescription = m_heldJob->Regions[m_heldJob->RegionCount - 1].Description;
+        lastDescription.Delay = static_cast<uint16_t>(std::min<uint32_t>(lastDescription.Delay + delay, UINT16_MAX));
+        m_statistics.InvisibleFrames++;
+        m_freeJobs.push_back(std::move(job));
+        return;
+    }
+
+    // Only the last region of a frame carries its delay so that they all
+    // show up at once.
+    job->Regions[regionCount - 1].Description.Delay = delay;
+    if (m_options.DropInvisibleChanges)
+    {
+        std::swap(job, m_heldJob);
+        if (job == nullptr)
+        {
+            return;
+        }
+    }
+    SubmitJob(std::move(job));
+}
+
+void GifFrameEncoder::SubmitJob(std::unique_ptr<FrameJob> job)
+{
+    // Make room, then hand the frame to the pool
+    WriteCompletedFrames(false, job->MemorySize);
+
+    auto jobPointer = job.get();
+    m_inFlightMemorySize += job->MemorySize;
+    m_inFlight.push_back(std::move(job));
+    m_statistics.MaxFramesInFlight = std::max<uint64_t>(m_statistics.MaxFramesInFlight, m_inFlight.size());
+    m_threadPool.Submit([this, jobPointer]()
+        {
+            std::exception_ptr error;
+            try
+            {
+                EncodeRegions(*jobPointer);
+            }
+            catch (...)
+            {
+                error = std::current_exception();
+            }
+            std::lock_guard lock(jobPointer->Lock);
+            jobPointer->Error = error;
+            jobPointer->Finished = true;
+            jobPointer->FinishedChanged.notify_all();
+        });
+
+    // Write whatever's already finished
+    WriteCompletedFrames(false, 0);
+}
+
+std::optional<std::vector<uint8_t>> GifFrameEncoder::Finish()
+{
+    if (m_heldJob != nullptr)
+    {
+        SubmitJob(std::move(m_heldJob));
+    }
+    WriteCompletedFrames(true, 0);
+    m_gifWriter->WriteTrailer();
+    m_gifWriter->TakeOutput(m_outputBuffer);
+    m_output(m_outputBuffer);
+
+    if (m_globalPalette.empty())
+    {
+        return std::nullopt;
+    }
+    return m_gifWriter->GlobalColorTableBytes(m_globalPalette);
+}
+
+void GifFrameEncoder::WriteCompletedFrames(bool wait, uint64_t incomingMemorySize)
+{
+    while (!m_inFlight.empty())
+    {
+        auto&& job = m_inFlight.front();
+
+        // Only block on the oldest frame if we have to
+        auto mustWait = wait ||
+            (incomingMemorySize > 0 &&
+                (m_inFlight.size() >= m_maxFramesInFlight || m_inFlightMemorySize + incomingMemorySize > m_options.MaxInFlightBytes));
+        {
+            std::unique_lock lock(job->Lock);
+            if (!mustWait && !job->Finished)
+            {
+                break;
+            }
+            if (!job->Finished)
+            {
+                TraceSpan span("WaitForFrame");
+                job->FinishedChanged.wait(lock, [&]() { return job->Finished; });
+            }
+        }
+
+        // Rethrow anything that went wrong on the pool
+        if (job->Error)
+        {
+            std::rethrow_exception(job->Error);
+        }
+
+        TraceSpan span("WriteFrame");
+        m_gifWriter->WriteEncodedFrame(job->Output.data(), job->Output.size());
+        m_gifWriter->TakeOutput(m_outputBuffer);
+        m_output(m_outputBuffer);
+
+        // Hand the pixels back to their pool right away, the rest of the
+        // job is kept for the next frame.
+        for (size_t i = 0; i < job->RegionCount; i++)
+        {
+            job->Regions[i].Region.Pixels.Release();
+        }
+        m_inFlightMemorySize -= job->MemorySize;
+        m_freeJobs.push_back(std::move(job));
+        m_inFlight.erase(m_inFlight.begin());
+    }
+}
+
+void GifFrameEncoder::EncodeRegions(FrameJob& job)
+{
+    auto context = AcquireContext();
+    for (size_t i = 0; i < job.RegionCount; i++)
+    {
+        auto&& region = job.Regions[i];
+        auto&& description = region.Description;
+        auto pixelCount = static_cast<size_t>(description.Width) * description.Height;
+        context->Indices.resize(pixelCount);
+        auto indices = context->Indices.data();
+        if (!region.Indices.empty())
+        {
+            indices = region.Indices.data();
+        }
+
+        {
+            TraceSpan span("MapPixels");
+            if (!region.Indices.empty())
+            {
+                // Already mapped when the region was checked
+            }
+            else if (pixelCount >= m_minPixelsForBands)
+            {
+                MapRegion(region, indices);
+            }
+            else
+            {
+                MapRows(context->Mapper, context->Dither, region, 0, description.Height, indices);
+            }
+
+            if (description.TransparentIndex.has_value())
+            {
+                auto transparentIndex = description.TransparentIndex.value();
+                auto mask = region.UnchangedMask.data();
+                for (size_t i = 0; i < pixelCount; i++)
+                {
+                    indices[i] = mask[i] != 0 ? transparentIndex : indices[i];
+                }
+            }
+        }
+
+        TraceSpan span("Lzw");
+        m_gifWriter->EncodeFrame(description, region.LocalPalette, indices, context->Lzw, job.Output);
+    }
+    ReleaseContext(std::move(context));
+}
+
+void GifFrameEncoder::MapRegion(RegionJob const& region, uint8_t* indices)
+{
+    auto&& view = region.Region.Pixels.View();
+    auto width = view.Width;
+    auto height = view.Height;
+    auto bandCount = std::max(std::min(m_threadPool.ThreadCount(), height / MinRowsPerBand), 1u);
+    auto rowsPerBand = (height + bandCount - 1) / bandCount;
+    m_threadPool.ParallelFor(bandCount, [&](size_t band)
+        {
+            auto firstRow = std::min(static_cast<uint32_t>(band) * rowsPerBand, height);
+            auto lastRow = std::min(firstRow + rowsPerBand, height);
+            if (firstRow == lastRow)
+            {
+                return;
+            }
+            auto context = AcquireContext();
+            MapRows(context->Mapper, context->Dither, region, firstRow, lastRow, indices + (static_cast<size_t>(firstRow) * width));
+            ReleaseContext(std::move(context));
+        });
+}
+
+void GifFrameEncoder::MapRows(
+    PaletteMapper& mapper,
+    Ditherer& ditherer,
+    RegionJob const& region,
+    uint32_t firstRow,
+    uint32_t lastRow,
+    uint8_t* indices)
+{
+    auto&& view = region.Region.Pixels.View();
+    auto&& rect = region.Region.Rect;
+    mapper.SetPalette(region.Palette);
+    if (region.Dither)
+    {
+        ditherer.MapPixels(mapper, view.Row(firstRow), view.Stride, view.Width, lastRow - firstRow, rect.Left, rect.Top + firstRow, indices);
+    }
+    else
+    {
+        mapper.MapPixels(view.Row(firstRow), view.Stride, view.Width, lastRow - firstRow, indices);
+    }
+}
+
+std::unique_ptr<GifFrameEncoder::FrameJob> GifFrameEncoder::AcquireJob()
+{
+    if (m_freeJobs.empty())
+    {
+        return std::make_unique<FrameJob>();
+    }
+    auto job = std::move(m_freeJobs.back());
+    m_freeJobs.pop_back();
+    job->RegionCount = 0;
+    job->Output.clear();
+    job->MemorySize = 0;
+    job->Finished = false;
+    job->Error = nullptr;
+    return job;
+}
+
+std::unique_ptr<GifFrameEncoder::EncodeContext> GifFrameEncoder::AcquireContext()
+{
+    {
+        std::lock_guard lock(m_contextLock);
+        if (!m_freeContexts.empty())
+        {
+            auto context = std::move(m_freeContexts.back());
+            m_freeContexts.pop_back();
+            return context;
+        }
+    }
+    auto context = std::make_unique<EncodeContext>();
+    context->Dither = Ditherer(m_options.Dither, m_quantizer->Options().MaxColors);
+    context->Lzw.ResetPolicy(m_gifWriter->LzwPolicy());
+    return context;
+}
+
+void GifFrameEncoder::ReleaseContext(std::unique_ptr<EncodeContext> context)
+{
+    std::lock_guard lock(m_contextLock);
+    m_freeContexts.push_back(std::move(context));
+}
+
+std::optional<DiffRect> GifFrameEncoder::FindVisibleChange(RegionJob& region, size_t& unchangedCount)
+{
+    TraceSpan span("FindVisibleChange");
+    auto rect = region.Region.Rect;
+    auto&& view = region.Region.Pixels.View();
+    auto width = view.Width;
+    auto height = view.Height;
+    auto pixelCount = static_cast<size_t>(width) * height;
+
+    // Map the pixels now rather than on the pool, what's shown depends
+    // on every frame before this one.
+    region.Indices.resize(pixelCount);
+    auto indices = region.Indices.data();
+    if (pixelCount >= m_minPixelsForBands)
+    {
+        MapRegion(region, indices);
+    }
+    else
+    {
+        MapRows(m_paletteMapper, m_ditherer, region, 0, height, indices);
+    }
+
+    // Without transparency the mask is only used to find the rect
+    auto&& mask = region.UnchangedMask;
+    if (!m_options.UseTransparency)
+    {
+        mask.assign(pixelCount, 0);
+    }
+    auto firstFrame = !m_shownCanvas->IsInitialized();
+    auto shownCount = m_shownCanvas->MarkUnchanged(rect, indices, region.Palette, mask.data());
+    if (shownCount == pixelCount && !firstFrame)
+    {
+        return std::nullopt;
+    }
+
+    // Find the bounds of what's left
+    uint32_t left = width;
+    uint32_t top = height;
+    uint32_t right = 0;
+    uint32_t bottom = 0;
+    for (uint32_t y = 0; y < height; y++)
+    {
+        auto rowMask = mask.data() + (static_cast<size_t>(y) * width);
+        auto first = std::find(rowMask, rowMask + width, static_cast<uint8_t>(0));
+        if (first == rowMask + width)
+        {
+            continue;
+        }
+        auto last = std::find(std::make_reverse_iterator(rowMask + width), std::make_reverse_iterator(first), static_cast<uint8_t>(0));
+        left = std::min(left, static_cast<uint32_t>(first - rowMask));
+        right = std::max(right, static_cast<uint32_t>(last.base() - rowMask));
+        top = std::min(top, y);
+        bottom = y + 1;
+    }
+    if (bottom == 0)
+    {
+        // The first frame has to be written even if it's a single color
+        left = 0;
+        top = 0;
+        right = width;
+        bottom = height;
+    }
+
+    // Pack the indices and mask of the smaller rect in place. Rows only
+    // ever move towards the start, so nothing gets overwritten before
+    // it's been moved.
+    auto newWidth = right - left;
+    auto newHeight = bottom - top;
+    if (newWidth != width || newHeight != height)
+    {
+        for (uint32_t y = 0; y < newHeight; y++)
+        {
+            auto source = (static_cast<size_t>(top + y) * width) + left;
+            auto destination = static_cast<size_t>(y) * newWidth;
+            memmove(indices + destination, indices + source, newWidth);
+            memmove(mask.data() + destination, mask.data() + source, newWidth);
+        }
+        m_statistics.ShrunkRegions++;
+    }
+    auto newPixelCount = static_cast<size_t>(newWidth) * newHeight;
+    region.Indices.resize(newPixelCount);
+    mask.resize(newPixelCount);
+    rect = DiffRect{ rect.Left + left, rect.Top + top, rect.Left + right, rect.Top + bottom };
+
+    if (m_options.UseTransparency)
+    {
+        unchangedCount = static_cast<size_t>(std::count(mask.begin(), mask.end(), static_cast<uint8_t>(1)));
+        m_shownCanvas->Update(rect, indices, region.Palette, mask.data());
+    }
+    else
+    {
+        // Everything in the rect is written
+        m_shownCanvas->Update(rect, indices, region.Palette, nullptr);
+    }
+    return rect;
+}
+
+bool GifFrameEncoder::ChoosePalette(uint8_t const* pixels, size_t stride, uint32_t width, uint32_t height)
+{
+    // Flat UI often has few enough colors to use them directly
+    m_uniqueColors.Clear();
+    auto isExact = m_uniqueColors.AddPixels(pixels, stride, width, height, m_quantizer->Options().MaxColors);
+    if (isExact)
+    {
+        m_uniqueColors.Colors(m_exactColors);
+    }
+    m_regionIsExact = isExact;
+
+    // Checks whether an existing palette is good enough for the region.
+    // The histogram is only needed if the region isn't exact.
+    ColorHistogram const* histogram = nullptr;
+    auto paletteFits = [&](std::vector<GifColor> const& palette)
+    {
+        if (palette.empty())
+        {
+            return false;
+        }
+        m_paletteMapper.SetPalette(palette);
+        if (isExact)
+        {
+            return m_paletteMapper.ContainsAll(m_exactColors);
+        }
+        if (m_options.PaletteReuseMaxError <= 0.0)
+        {
+            return false;
+        }
+        if (histogram == nullptr)
+        {
+            histogram = &m_quantizer->CountColors(pixels, stride, width, height);
+        }
+        return m_paletteMapper.MeasureError(*histogram) <= m_options.PaletteReuseMaxError;
+    };
+
+    if (paletteFits(m_globalPalette))
+    {
+        m_palette = m_globalPalette;
+        m_statistics.GlobalPaletteRegions++;
+        return true;
+    }
+
+    if (paletteFits(m_previousPalette))
+    {
+        m_palette = m_previousPalette;
+        m_statistics.ReusedPaletteRegions++;
+        m_previousPaletteReuseCount++;
+        if (m_options.UseGlobalPalette && m_globalPalette.empty() && m_previousPaletteReuseCount >= PalettePromotionReuseCount)
+        {
+            m_globalPalette = m_previousPalette;
+        }
+        return false;
+    }
+
+    if (isExact)
+    {
+        m_palette.swap(m_exactColors);
+        m_statistics.ExactPaletteRegions++;
+    }
+    else
+    {
+        if (histogram == nullptr)
+        {
+            histogram = &m_quantizer->CountColors(pixels, stride, width, height);
+        }
+        m_palette = m_quantizer->BuildPalette(*histogram);
+        m_statistics.QuantizedRegions++;
+    }
+    m_previousPalette = m_palette;
+    m_previousPaletteReuseCount = 0;
+    return false;
+}
@@ -0,0 +1,162 @@
+#pragma once
+#include "GifFrame.h"
+#include "GifWriter.h"
+#include "GifEncoderOptions.h"
+#include "GifEncoderStatistics.h"
+#include "FrameCanvas.h"
+#include "ColorQuantizer.h"
+#include "PaletteMapper.h"
+#include "Ditherer.h"
+#include "UniqueColorSet.h"
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+class ThreadPool;
+
+// Turns frames into GIF bytes. Everything that depends on earlier
+// frames (picking palettes, tracking what the decoder shows) happens
+// on the calling thread, in order. Mapping to the palette and LZW
+// compression are fanned out to the thread pool, a frame per task, and
+// the results are written back in order by the calling thread.
+class GifFrameEncoder
+{
+public:
+    // Receives the file's bytes in order, always on the thread calling
+    // into the encoder.
+    using OutputCallback = std::function<void(std::vector<uint8_t> const& bytes)>;
+
+    // Number of regions in a row that have to reuse a palette before it
+    // gets promoted to the global color table.
+    static constexpr uint32_t PalettePromotionReuseCount = 3;
+
+    GifFrameEncoder(
+        uint32_t width,
+        uint32_t height,
+        GifEncoderOptions const& options,
+        ThreadPool& threadPool,
+        OutputCallback output);
+    ~GifFrameEncoder();
+
+    GifFrameEncoder(GifFrameEncoder const&) = delete;
+    GifFrameEncoder& operator=(GifFrameEncoder const&) = delete;
+
+    // Frames must be submitted in the order they're shown. The delay is
+    // in 10ms units and is carried by the last region. The regions are
+    // moved out, leaving the vector empty for the caller to reuse. Their
+    // buffers go back to their pool once the frame has been written.
+    // With DropInvisibleChanges, a frame that looks the same as the one
+    // before it once mapped to its palette isn't written at all, and the
+    // frame before it stays up for its delay as well.
+    void EncodeFrame(std::vector<GifFrameRegion>& regions, uint16_t delay);
+    // Starts out with a global palette rather than waiting for one to be
+    // promoted. Has to come before the first frame, and needs
+    // UseGlobalPalette and room for the transparent index if there is one.
+    void SetGlobalPalette(std::vector<GifColor> const& palette);
+    // Waits for every frame to be written, then writes the trailer. If a
+    // palette was promoted to the global color table, returns the bytes
+    // to write over GifWriter::GlobalColorTableOffset.
+    std::optional<std::vector<uint8_t>> Finish();
+
+    GifEncoderStatistics const& Statistics() const { return m_statistics; }
+
+private:
+    struct EncodeContext
+    {
+        PaletteMapper Mapper;
+        Ditherer Dither;
+        LzwEncoder Lzw;
+        std::vector<uint8_t> Indices;
+    };
+
+    struct RegionJob
+    {
+        GifFrameRegion Region;
+        GifFrameDescription Description = {};
+        // The colors pixels get mapped to, and the table that gets
+        // written (empty when using the global palette).
+        std::vector<GifColor> Palette;
+        std::vector<GifColor> LocalPalette;
+        bool Dither = false;
+        // Pixels that already match what the decoder shows
+        std::vector<uint8_t> UnchangedMask;
+        // Mapped up front when changes are checked after mapping,
+        // otherwise empty and mapped on the pool.
+        std::vector<uint8_t> Indices;
+    };
+
+    // Jobs are reused from frame to frame, along with everything they
+    // hold, so encoding a frame doesn't have to allocate.
+    struct FrameJob
+    {
+        // Only the first RegionCount entries belong to the current frame
+        std::vector<RegionJob> Regions;
+        size_t RegionCount = 0;
+        std::vector<uint8_t> Output;
+        uint64_t MemorySize = 0;
+
+        std::mutex Lock;
+        std::condition_variable FinishedChanged;
+        bool Finished = false;
+        std::exception_ptr Error;
+    };
+
+    bool ChoosePalette(uint8_t const* pixels, size_t stride, uint32_t width, uint32_t height);
+    std::optional<DiffRect> FindVisibleChange(RegionJob& region, size_t& unchangedCount);
+    void SubmitJob(std::unique_ptr<FrameJob> job);
+    void EncodeRegions(FrameJob& job);
+    void MapRegion(RegionJob const& region, uint8_t* indices);
+    void MapRows(
+        PaletteMapper& mapper,
+        Ditherer& ditherer,
+        RegionJob const& region,
+        uint32_t firstRow,
+        uint32_t lastRow,
+        uint8_t* indices);
+    void WriteCompletedFrames(bool wait, uint64_t incomingMemorySize);
+    std::unique_ptr<FrameJob> AcquireJob();
+    std::unique_ptr<EncodeContext> AcquireContext();
+    void ReleaseContext(std::unique_ptr<EncodeContext> context);
+
+private:
+    GifEncoderOptions m_options = {};
+    ThreadPool& m_threadPool;
+    OutputCallback m_output;
+    std::unique_ptr<GifWriter> m_gifWriter;
+    std::vector<uint8_t> m_outputBuffer;
+    FrameCanvas m_canvas;
+    // What the decoder shows in palette colors rather than the colors
+    // they came from. Only kept with DropInvisibleChanges.
+    std::unique_ptr<FrameCanvas> m_shownCanvas;
+    std::unique_ptr<ColorQuantizer> m_quantizer;
+    PaletteMapper m_paletteMapper;
+    Ditherer m_ditherer;
+    size_t m_minPixelsForBands = 0;
+    // Whether the region ChoosePalette last looked at has few enough
+    // colors to be mapped exactly
+    bool m_regionIsExact = false;
+    UniqueColorSet m_uniqueColors;
+    std::vector<GifColor> m_palette;
+    std::vector<GifColor> m_exactColors;
+    std::vector<GifColor> m_previousPalette;
+    uint32_t m_previousPaletteReuseCount = 0;
+    std::vector<GifColor> m_globalPalette;
+    GifEncoderStatistics m_statistics = {};
+
+    // Frames handed to the pool, oldest first. Never more than a few, so
+    // a vector is fine.
+    std::vector<std::unique_ptr<FrameJob>> m_inFlight;
+    uint64_t m_inFlightMemorySize = 0;
+    uint32_t m_maxFramesInFlight = 0;
+    std::vector<std::unique_ptr<FrameJob>> m_freeJobs;
+    // With DropInvisibleChanges, the last frame is held back until we
+    // know whether the next one gets dropped and adds to its delay.
+    std::unique_ptr<FrameJob> m_heldJob;
+
+    std::mutex m_contextLock;
+    std::vector<std::unique_ptr<EncodeContext>> m_freeContexts;
+};
@@ -0,0 +1,295 @@
+#include "GifOptimizer.h"
+#include "FileGifOutputStream.h"
+#include "FrameBufferPool.h"
+#include "GifDecoder.h"
+#include "GifFrameEncoder.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+
+namespace
+{
+    uint32_t LoadPixel(uint8_t const* row, uint32_t x)
+    {
+        uint32_t pixel = 0;
+        memcpy(&pixel, row + (static_cast<size_t>(x) * 4), sizeof(pixel));
+        return pixel;
+    }
+
+    // The smallest rect, with exclusive Right/Bottom, holding every pixel
+    // that differs between two frames of the same size
+    std::optional<DiffRect> FindChange(uint8_t const* previous, uint8_t const* current, size_t stride, uint32_t width, uint32_t height)
+    {
+        auto rowBytes = static_cast<size_t>(width) * 4;
+        auto rowDiffers = [&](uint32_t y)
+        {
+            auto offset = static_cast<size_t>(y) * stride;
+            return memcmp(previous + offset, current + offset, rowBytes) != 0;
+        };
+
+        uint32_t top = 0;
+        while (top < height && !rowDiffers(top))
+        {
+            top++;
+        }
+        if (top == height)
+        {
+            return std::nullopt;
+        }
+        auto bottom = height;
+        while (!rowDiffers(bottom - 1))
+        {
+            bottom--;
+        }
+
+        // Each row only has to be searched up to what's already covered
+        auto left = width;
+        uint32_t right = 0;
+        for (auto y = top; y < bottom; y++)
+        {
+            auto offset = static_cast<size_t>(y) * stride;
+            auto previousRow = previous + offset;
+            auto currentRow = current + offset;
+            for (uint32_t x = 0; x < left; x++)
+            {
+                if (LoadPixel(previousRow, x) != LoadPixel(currentRow, x))
+                {
+                    left = x;
+                    break;
+                }
+            }
+            for (auto x = width; x > std::max(right, left); x--)
+            {
+                if (LoadPixel(previousRow, x - 1) != LoadPixel(currentRow, x - 1))
+                {
+                    right = x;
+                    break;
+                }
+            }
+        }
+        return DiffRect{ left, top, std::max(right, left + 1), bottom };
+    }
+}
+
+GifOptimizer::GifOptimizer(GifEncoderOptions const& options, uint32_t threadCount)
+{
+    m_options = options;
+    m_fileThreadCount = threadCount;
+    if (m_fileThreadCount == 0)
+    {
+        m_fileThreadCount = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+    m_threadPool = std::make_unique<ThreadPool>();
+}
+
+GifOptimizer::~GifOptimizer() = default;
+
+GifOptimizerResult GifOptimizer::Optimize(std::filesystem::path const& input, std::filesystem::path const& output)
+{
+    GifOptimizerResult result = {};
+    result.Input = input;
+    result.Output = output;
+    result.InputBytes = static_cast<uint64_t>(std::filesystem::file_size(input));
+
+    GifDecoder decoder(input);
+    uint32_t width = decoder.Width();
+    uint32_t height = decoder.Height();
+    auto options = m_options;
+    options.LoopCount = decoder.LoopCount();
+
+    // Outlives the encoder, which hands buffers back as frames are written
+    FrameBufferPool bufferPool;
+    std::vector<uint8_t> bytes;
+    GifFrameEncoder encoder(
+        width,
+        height,
+        options,
+        *m_threadPool,
+        [&](std::vector<uint8_t> const& frameBytes)
+        {
+            bytes.insert(bytes.end(), frameBytes.begin(), frameBytes.end());
+        });
+
+    // Frames are written once we know how long they stay up, which is
+    // after every frame that doesn't change them has been added on.
+    GifCanvas canvas(width, height);
+    auto stride = canvas.Stride();
+    std::vector<uint8_t> shownPixels(stride * height, 0);
+    std::vector<GifFrameRegion> regions;
+    uint32_t delay = 0;
+    uint64_t framesSubmitted = 0;
+    GifDecodedFrame frame;
+    while (decoder.ReadFrame(frame))
+    {
+        result.FramesRead++;
+        canvas.DrawFrame(frame);
+        auto frameDelay = frame.Description.Delay;
+
+        auto change = result.FramesRead == 1 ?
+            std::optional(DiffRect{ 0, 0, width, height }) :
+            FindChange(shownPixels.data(), canvas.Pixels(), stride, width, height);
+        if (!change.has_value())
+        {
+            delay = std::min<uint32_t>(delay + frameDelay, UINT16_MAX);
+            result.MergedFrames++;
+            continue;
+        }
+
+        if (!regions.empty())
+        {
+            encoder.EncodeFrame(regions, static_cast<uint16_t>(delay));
+            framesSubmitted++;
+        }
+
+        auto rect = change.value();
+        GifFrameRegion region = {};
+        region.Rect = rect;
+        region.Pixels = bufferPool.Acquire(rect.Right - rect.Left, rect.Bottom - rect.Top);
+        auto&& view = region.Pixels.View();
+        auto rowBytes = static_cast<size_t>(view.Width) * 4;
+        for (uint32_t y = 0; y < view.Height; y++)
+        {
+            auto offset = (static_cast<size_t>(rect.Top + y) * stride) + (static_cast<size_t>(rect.Left) * 4);
+            auto source = canvas.Pixels() + offset;
+            for (size_t alpha = 3; alpha < rowBytes; alpha += 4)
+            {
+                if (source[alpha] != 0xFF)
+                {
+                    throw std::runtime_error("GIFs that show transparent pixels can't be re-encoded");
+                }
+            }
+            memcpy(view.Row(y), source, rowBytes);
+            memcpy(shownPixels.data() + offset, source, rowBytes);
+        }
+        regions.push_back(std::move(region));
+        delay = frameDelay;
+    }
+    if (regions.empty())
+    {
+        throw std::runtime_error("GIF has no frames");
+    }
+    encoder.EncodeFrame(regions, static_cast<uint16_t>(delay));
+    framesSubmitted++;
+
+    auto globalColorTable = encoder.Finish();
+    if (globalColorTable.has_value())
+    {
+        auto&& tableBytes = globalColorTable.value();
+        std::copy(tableBytes.begin(), tableBytes.end(), bytes.begin() + GifWriter::GlobalColorTableOffset);
+    }
+    result.Statistics = encoder.Statistics();
+    result.FramesWritten = framesSubmitted - result.Statistics.InvisibleFrames;
+
+    // Never make a file bigger
+    if (bytes.size() < result.InputBytes)
+    {
+        FileGifOutputStream stream(output);
+        stream.Write(bytes.data(), bytes.size());
+        stream.Finish();
+        result.OutputBytes = bytes.size();
+    }
+    else
+    {
+        result.KeptOriginal = true;
+        result.OutputBytes = result.InputBytes;
+        if (!std::filesystem::exists(output) || !std::filesystem::equivalent(input, output))
+        {
+            std::filesystem::copy_file(input, output, std::filesystem::copy_options::overwrite_existing);
+        }
+    }
+    return result;
+}
+
+std::vector<GifOptimizerResult> GifOptimizer::OptimizeAll(
+    std::vector<std::pair<std::filesystem::path, std::filesystem::path>> const& files,
+    ProgressCallback const& progress)
+{
+    // Files get threads of their own rather than pool tasks. Encoding a
+    // file waits on its frames, which are pool tasks themselves.
+    std::vector<GifOptimizerResult> results(files.size());
+    std::atomic<size_t> nextFile = 0;
+    std::mutex progressLock;
+    auto optimizeFiles = [&]()
+    {
+        for (auto i = nextFile++; i < files.size(); i = nextFile++)
+        {
+            auto&& [input, output] = files[i];
+            auto&& result = results[i];
+            try
+            {
+                result = Optimize(input, output);
+            }
+            catch (std::exception const& error)
+            {
+                result = {};
+                result.Input = input;
+                result.Output = output;
+                result.Error = error.what();
+            }
+            if (progress)
+            {
+                std::lock_guard lock(progressLock);
+                progress(result);
+            }
+        }
+    };
+
+    // The calling thread takes a share as well
+    auto threadCount = std::min<size_t>(m_fileThreadCount, files.size());
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < threadCount; i++)
+    {
+        threads.emplace_back(optimizeFiles);
+    }
+    optimizeFiles();
+    for (auto&& thread : threads)
+    {
+        thread.join();
+    }
+    return results;
+}
+
+GifEncoderOptions GifOptimizer::OfflineOptions(GifEncoderOptions const& options)
+{
+    auto offlineOptions = options;
+    offlineOptions.Quantizer = QuantizerAlgorithm::KMeans;
+    offlineOptions.DropInvisibleChanges = true;
+    return offlineOptions;
+}
+
+std::vector<std::pair<std::filesystem::path, std::filesystem::path>> GifOptimizer::ListFiles(
+    std::filesystem::path const& input,
+    std::filesystem::path const& output)
+{
+    std::vector<std::pair<std::filesystem::path, std::filesystem::path>> files;
+    if (!std::filesystem::is_directory(input))
+    {
+        files.emplace_back(input, output);
+        return files;
+    }
+
+    for (auto&& entry : std::filesystem::recursive_directory_iterator(input))
+    {
+        // Native strings, since names that aren't ASCII can't always be
+        // converted
+        auto extension = entry.path().extension().native();
+        std::transform(extension.begin(), extension.end(), extension.begin(), [](auto c)
+            {
+                return static_cast<decltype(c)>(c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c);
+            });
+        if (entry.is_regular_file() && extension == std::filesystem::path(".gif").native())
+        {
+            auto outputPath = output / std::filesystem::relative(entry.path(), input);
+            std::filesystem::create_directories(outputPath.parent_path());
+            files.emplace_back(entry.path(), outputPath);
+        }
+    }
+    // Directory order isn't stable
+    std::sort(files.begin(), files.end());
+    return files;
+}
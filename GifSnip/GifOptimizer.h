@@ -0,0 +1,79 @@
+#pragma once
+#include "GifEncoderOptions.h"
+#include "GifEncoderStatistics.h"
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+class ThreadPool;
+
+struct GifOptimizerResult
+{
+    std::filesystem::path Input;
+    std::filesystem::path Output;
+    uint64_t InputBytes = 0;
+    uint64_t OutputBytes = 0;
+    uint64_t FramesRead = 0;
+    uint64_t FramesWritten = 0;
+    // Frames that looked the same as the one before, their delays added
+    // to it instead
+    uint64_t MergedFrames = 0;
+    // Re-encoding didn't make the file any smaller, so it was copied
+    bool KeptOriginal = false;
+    // Why the file couldn't be optimized, if it couldn't. Nothing gets
+    // written in that case.
+    std::string Error;
+    GifEncoderStatistics Statistics = {};
+};
+
+// Re-encodes GIFs that already exist. Every frame is drawn the way a
+// viewer would show it, then written again as just the rect that
+// changed from the frame before, with unchanged pixels inside the rect
+// left transparent and new palettes. Frames that don't change anything
+// are merged into the one before. Needs neither a GPU nor Windows.
+//
+// GIFs that show transparent pixels can't be re-encoded, since frames
+// are always opaque.
+class GifOptimizer
+{
+public:
+    // Files are optimized this many at a time, 0 for one per hardware
+    // thread. Each one's palette mapping and compression go to a pool
+    // shared by all of them.
+    GifOptimizer(GifEncoderOptions const& options = {}, uint32_t threadCount = 0);
+    ~GifOptimizer();
+
+    GifOptimizer(GifOptimizer const&) = delete;
+    GifOptimizer& operator=(GifOptimizer const&) = delete;
+
+    // Throws if the input can't be read or re-encoded. Safe to call from
+    // several threads at once.
+    GifOptimizerResult Optimize(std::filesystem::path const& input, std::filesystem::path const& output);
+
+    // Optimizes every input into its output. Errors are caught and
+    // reported per file. Progress is called once per file as it
+    // finishes, one call at a time but from any thread.
+    using ProgressCallback = std::function<void(GifOptimizerResult const& result)>;
+    std::vector<GifOptimizerResult> OptimizeAll(
+        std::vector<std::pair<std::filesystem::path, std::filesystem::path>> const& files,
+        ProgressCallback const& progress = {});
+
+    // Nothing is live, so spend the time: k-means palettes, and changes
+    // that don't survive mapping are dropped.
+    static GifEncoderOptions OfflineOptions(GifEncoderOptions const& options);
+    // Pairs a single file with its output, or every GIF under a
+    // directory with the same place under the output directory, which
+    // gets created as needed.
+    static std::vector<std::pair<std::filesystem::path, std::filesystem::path>> ListFiles(
+        std::filesystem::path const& input,
+        std::filesystem::path const& output);
+
+private:
+    GifEncoderOptions m_options = {};
+    uint32_t m_fileThreadCount = 0;
+    std::unique_ptr<ThreadPool> m_threadPool;
+};
@@ -0,0 +1,17 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Where the bytes of a GIF end up. Everything is written in order,
+// except for WriteAt, which goes back to fill in something written
+// earlier once the rest of the file is done.
+class GifOutputStream
+{
+public:
+    virtual ~GifOutputStream() = default;
+
+    virtual void Write(uint8_t const* data, size_t size) = 0;
+    virtual void WriteAt(uint64_t offset, uint8_t const* data, size_t size) = 0;
+    // Called once, after the last write
+    virtual void Finish() = 0;
+};
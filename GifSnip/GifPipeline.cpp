@@ -0,0 +1,534 @@
+#include "GifPipeline.h"
+#include "FileGifOutputStream.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+namespace
+{
+    // Deletes the file when it goes out of scope
+    struct TemporaryFile
+    {
+        std::filesystem::path Path;
+
+        TemporaryFile(std::filesystem::path path) : Path(std::move(path)) {}
+        ~TemporaryFile()
+        {
+            std::error_code error;
+            std::filesystem::remove(Path, error);
+        }
+
+        TemporaryFile(TemporaryFile const&) = delete;
+        TemporaryFile& operator=(TemporaryFile const&) = delete;
+    };
+}
+
+GifPipeline::GifPipeline(
+    uint32_t width,
+    uint32_t height,
+    GifOutputStream& output,
+    GifEncoderOptions const& options) :
+    m_output(output)
+{
+    m_options = options;
+    m_width = width;
+    m_height = height;
+    m_dirtyTiles = DirtyTileMap(width, height, m_options.TileSize);
+    if (!m_options.TraceFile.empty())
+    {
+        Trace::Enable();
+    }
+
+    // Palette mapping and compression happen on the pool, everything
+    // else on our encoder thread.
+    m_threadPool = std::make_unique<ThreadPool>();
+    m_frameEncoder = CreateFrameEncoder([this](std::vector<uint8_t> const& bytes)
+        {
+            TraceSpan span("WriteFile");
+            m_output.Write(bytes.data(), bytes.size());
+        });
+
+    // Everything after readback happens on our own thread
+    auto queueCapacity = std::max(m_options.FrameQueueCapacity, 1u);
+    m_frameQueue = std::make_unique<SpscQueue<QueuedFrame>>(queueCapacity);
+    m_freeRegionLists = std::make_unique<SpscQueue<std::vector<GifFrameRegion>>>(queueCapacity + 2);
+    m_diffRects.reserve(std::max(m_options.MaxRegionsPerFrame, 1u));
+    if (!m_options.SpoolFile.empty())
+    {
+        m_spool = std::make_unique<FrameSpool>(m_options.SpoolFile);
+    }
+    m_governor = std::make_unique<FrameRateGovernor>(m_options.MinFrameRate, m_options.MaxFrameRate);
+    m_encodeThread = std::thread([this]()
+        {
+            Trace::SetThreadName("Encoder");
+            EncodeLoop();
+        });
+}
+
+GifPipeline::~GifPipeline()
+{
+    if (m_encodeThread.joinable())
+    {
+        m_frameQueue->Close();
+        m_encodeThread.join();
+    }
+    if (!m_options.TraceFile.empty())
+    {
+        Trace::Disable();
+    }
+}
+
+bool GifPipeline::AcceptFrame(FrameTime timeStamp)
+{
+    m_receivedFrameCount++;
+    Trace::Counter("FramesReceived", static_cast<int64_t>(m_receivedFrameCount));
+
+    if (m_lastTimeStamp.count() == 0)
+    {
+        m_lastTimeStamp = timeStamp;
+    }
+    // Whether a frame changed is only known once it has been read back,
+    // so the governor measures from the last frame we accepted. When
+    // frames wait for the encoder instead of being skipped, a backlog
+    // is expected and mustn't change which frames get sampled.
+    auto queueDepth = m_options.SkipFramesWhenBehind ? m_frameQueue->Size() : 0;
+    if (!m_governor->ShouldSample(timeStamp, queueDepth, m_frameQueue->Capacity()))
+    {
+        m_throttledFrameCount++;
+        Trace::Counter("FramesThrottled", static_cast<int64_t>(m_throttledFrameCount));
+        return false;
+    }
+    m_lastAcceptedTimeStamp = timeStamp;
+    return true;
+}
+
+void GifPipeline::Finish()
+{
+    // Let the encoder thread drain the queue and finish the file
+    m_frameQueue->Close();
+    m_encodeThread.join();
+    m_statistics = m_frameEncoder->Statistics();
+    m_statistics.FramesReceived = m_receivedFrameCount;
+    m_statistics.ThrottledFrames = m_throttledFrameCount;
+    auto&& governorStatistics = m_governor->Statistics();
+    m_statistics.IdleThrottledFrames = governorStatistics.IdleSkippedFrames;
+    m_statistics.BacklogThrottledFrames = governorStatistics.BacklogSkippedFrames;
+    m_statistics.LongestSampleInterval = static_cast<uint64_t>(governorStatistics.LongestInterval.count());
+    m_statistics.UnchangedFrames = m_unchangedFrameCount;
+    m_statistics.FramesEncoded = m_encodedFrameCount - m_statistics.InvisibleFrames;
+    m_statistics.CoalescedFrames = m_coalescedFrameCount;
+    m_statistics.QueueHighWaterMark = m_frameQueue->HighWaterMark();
+    m_statistics.FrameBufferAllocations = m_bufferPool.AllocationCount();
+    if (m_spool != nullptr)
+    {
+        m_statistics.SpoolBytes = m_spool->Size();
+        m_statistics.RecordingPaletteBytes = m_recordingPaletteBytes;
+        m_statistics.LocalPaletteBytes = m_localPaletteBytes;
+    }
+    if (!m_options.TraceFile.empty())
+    {
+        Trace::Disable();
+        Trace::WriteChromeTrace(m_options.TraceFile);
+    }
+    if (m_encodeError)
+    {
+        std::rethrow_exception(m_encodeError);
+    }
+}
+
+void GifPipeline::CaptureFrame(ReadbackData const& data, PendingFrame const& pendingFrame)
+{
+    TraceSpan span("CaptureFrame");
+    auto force = pendingFrame.Force;
+    auto diff = data.Diff;
+    if (diff.has_value())
+    {
+        auto&& words = m_dirtyTiles.Words();
+        memcpy(words.data(), data.TileWords, std::min(words.size(), data.TileWordCount) * sizeof(uint32_t));
+    }
+    else
+    {
+        m_dirtyTiles.Clear();
+    }
+    if (!force)
+    {
+        auto tileCount = static_cast<double>(m_dirtyTiles.ColumnCount()) * m_dirtyTiles.RowCount();
+        auto dirtyCount = diff.has_value() ? m_dirtyTiles.DirtyCount() : 0;
+        m_governor->ReportChange(static_cast<double>(dirtyCount) / tileCount);
+    }
+
+    // Fold in whatever we had to skip earlier. The readback slot holds
+    // the whole current frame, so copying out the combined rect catches
+    // us up.
+    auto coalesced = m_coalescedRect.has_value();
+    if (coalesced)
+    {
+        auto&& pending = m_coalescedRect.value();
+        if (diff.has_value())
+        {
+            auto&& current = diff.value();
+            pending.Left = std::min(pending.Left, current.Left);
+            pending.Top = std::min(pending.Top, current.Top);
+            pending.Right = std::max(pending.Right, current.Right);
+            pending.Bottom = std::max(pending.Bottom, current.Bottom);
+        }
+        diff = m_coalescedRect;
+    }
+
+    if (!force && !diff.has_value())
+    {
+        m_unchangedFrameCount++;
+        Trace::Counter("FramesUnchanged", static_cast<int64_t>(m_unchangedFrameCount));
+    }
+    if (force && !diff.has_value())
+    {
+        // Since there's no change, pick a small random part of the frame.
+        diff = std::optional(DiffRect{ 0, 0, 5, 5 });
+    }
+
+    if (diff.has_value())
+    {
+        auto timeStampDelta = pendingFrame.SystemRelativeTime - m_lastTimeStamp;
+        m_lastTimeStamp = pendingFrame.SystemRelativeTime;
+
+        // The frame before this one ends when this one starts. For the
+        // last frame, assume it lasts as long as the gap before it.
+        auto currentTime = pendingFrame.SystemRelativeTime;
+        if (force)
+        {
+            currentTime += timeStampDelta;
+        }
+
+        // Nothing is ever behind when the encoder waits for us to stop
+        if (m_spool != nullptr)
+        {
+            SplitChange(diff.value(), false);
+            TraceSpan spoolSpan("SpoolFrame");
+            m_spool->AppendFrame(pendingFrame.SystemRelativeTime, currentTime, m_diffRects, data.Pixels);
+            return;
+        }
+
+        // If the encoder has fallen behind, skip this frame instead of
+        // waiting. Its changes get written with the next frame that fits,
+        // and the frame before it stays up in its place. The last frame
+        // can't be skipped, so it waits for room.
+        if (m_frameQueue->IsFull())
+        {
+            if (!force && m_options.SkipFramesWhenBehind)
+            {
+                m_coalescedRect = diff;
+                m_coalescedFrameCount++;
+                return;
+            }
+            m_frameQueue->WaitForRoom();
+        }
+        m_coalescedRect = std::nullopt;
+
+        SplitChange(diff.value(), coalesced);
+
+        // Reuse a list the encoder is done with when there is one
+        std::vector<GifFrameRegion> regions;
+        if (auto freeRegions = m_freeRegionLists->TryPop())
+        {
+            regions = std::move(freeRegions.value());
+        }
+        for (auto&& diffRect : m_diffRects)
+        {
+            GifFrameRegion frameRegion = {};
+            frameRegion.Rect = diffRect;
+            frameRegion.Pixels = m_bufferPool.Acquire(diffRect.Right - diffRect.Left, diffRect.Bottom - diffRect.Top);
+            regions.push_back(std::move(frameRegion));
+        }
+
+        // Copy the bytes out of the readback slot
+        size_t bytesPerPixel = 4; // Assuming BGRA8
+        auto&& source = data.Pixels;
+        for (auto&& frameRegion : regions)
+        {
+            // Textures can occupy more space in video memory than you might expect given
+            // their size and pixel format. The stride of the mapped slot tells you how
+            // many bytes there are per "row".
+            auto&& view = frameRegion.Pixels.View();
+            auto rowBytes = static_cast<size_t>(view.Width) * bytesPerPixel;
+            for (uint32_t y = 0; y < view.Height; y++)
+            {
+                memcpy(view.Row(y), source.Row(frameRegion.Rect.Top + y) + (static_cast<size_t>(frameRegion.Rect.Left) * bytesPerPixel), rowBytes);
+            }
+        }
+
+        QueuedFrame queuedFrame = {};
+        queuedFrame.Frame.Regions = std::move(regions);
+        queuedFrame.Frame.TimeStamp = pendingFrame.SystemRelativeTime;
+        queuedFrame.CurrentTime = currentTime;
+        m_frameQueue->TryPush(std::move(queuedFrame));
+        Trace::Counter("QueueDepth", static_cast<int64_t>(m_frameQueue->Size()));
+    }
+}
+
+void GifPipeline::SplitChange(DiffRect const& diff, bool coalesced)
+{
+    // Split the change into separate regions if we're allowed to
+    m_diffRects.clear();
+    if (m_options.MaxRegionsPerFrame > 1 && !coalesced && m_dirtyTiles.Any())
+    {
+        m_diffRects = m_dirtyTiles.Cluster(m_options.MaxRegionsPerFrame);
+    }
+    else
+    {
+        m_diffRects.push_back(diff);
+    }
+
+    for (auto&& diffRect : m_diffRects)
+    {
+        // Inflate our rect to eliminate artifacts
+        auto inflateAmount = 1;
+        auto left = static_cast<uint32_t>(std::max(static_cast<int32_t>(diffRect.Left) - inflateAmount, 0));
+        auto top = static_cast<uint32_t>(std::max(static_cast<int32_t>(diffRect.Top) - inflateAmount, 0));
+        auto right = static_cast<uint32_t>(std::min(static_cast<int32_t>(diffRect.Right) + inflateAmount, static_cast<int32_t>(m_width)));
+        auto bottom = static_cast<uint32_t>(std::min(static_cast<int32_t>(diffRect.Bottom) + inflateAmount, static_cast<int32_t>(m_height)));
+        diffRect = DiffRect{ left, top, right, bottom };
+    }
+}
+
+void GifPipeline::EncodeLoop()
+{
+    while (auto queuedFrame = m_frameQueue->Pop())
+    {
+        // After a failure, keep draining so the capture side never waits
+        // on a full queue. The error is rethrown when we stop.
+        if (m_encodeError)
+        {
+            continue;
+        }
+
+        Trace::Counter("QueueDepth", static_cast<int64_t>(m_frameQueue->Size()));
+        try
+        {
+            EncodeQueuedFrame(queuedFrame.value());
+        }
+        catch (...)
+        {
+            m_encodeError = std::current_exception();
+        }
+    }
+
+    if (!m_encodeError)
+    {
+        try
+        {
+            // The queue only closes once the recording has stopped
+            if (m_spool != nullptr && m_options.UseRecordingPalette && m_options.UseGlobalPalette)
+            {
+                EncodeSpoolWithRecordingPalette();
+            }
+            else
+            {
+                if (m_spool != nullptr)
+                {
+                    EncodeSpool();
+                }
+                FinishEncoding();
+            }
+        }
+        catch (...)
+        {
+            m_encodeError = std::current_exception();
+        }
+    }
+}
+
+void GifPipeline::EncodeQueuedFrame(QueuedFrame& queuedFrame)
+{
+    // We only know how long a frame lasts once the next one shows up
+    if (m_previousFrame.has_value())
+    {
+        auto&& frame = m_previousFrame.value();
+        // Delays are in 10ms units. Rounding each one on its own would
+        // add up, so frame ends are rounded on a clock that starts with
+        // the first frame and each delay is the distance to the last one.
+        using Centiseconds = std::chrono::duration<int64_t, std::centi>;
+        auto frameEnd = std::chrono::round<Centiseconds>(queuedFrame.CurrentTime - m_firstFrameTime).count();
+        auto frameDelay = std::clamp<int64_t>(frameEnd - m_elapsedDelay, 0, UINT16_MAX);
+        m_elapsedDelay += frameDelay;
+        {
+            TraceSpan span("EncodeFrame");
+            m_frameEncoder->EncodeFrame(frame.Regions, static_cast<uint16_t>(frameDelay));
+        }
+        m_encodedFrameCount++;
+        Trace::Counter("FramesEncoded", static_cast<int64_t>(m_encodedFrameCount));
+        m_freeRegionLists->TryPush(std::move(frame.Regions));
+    }
+    else
+    {
+        m_firstFrameTime = queuedFrame.Frame.TimeStamp;
+    }
+    m_previousFrame = std::move(queuedFrame.Frame);
+}
+
+std::unique_ptr<GifFrameEncoder> GifPipeline::CreateFrameEncoder(GifFrameEncoder::OutputCallback output)
+{
+    return std::make_unique<GifFrameEncoder>(m_width, m_height, m_options, *m_threadPool, std::move(output));
+}
+
+void GifPipeline::EncodeSpool()
+{
+    TraceSpan span("EncodeSpool");
+    // The spool can be encoded more than once, starting over each time
+    m_previousFrame = std::nullopt;
+    m_elapsedDelay = 0;
+    m_encodedFrameCount = 0;
+
+    FrameSpool::Frame spooledFrame;
+    for (uint64_t i = 0; i < m_spool->FrameCount(); i++)
+    {
+        m_spool->ReadFrame(i, spooledFrame);
+
+        // Capture is over, so the free lists are all ours
+        QueuedFrame queuedFrame = {};
+        if (auto freeRegions = m_freeRegionLists->TryPop())
+        {
+            queuedFrame.Frame.Regions = std::move(freeRegions.value());
+        }
+        for (auto&& spooledRegion : spooledFrame.Regions)
+        {
+            auto&& source = spooledRegion.Pixels;
+            GifFrameRegion frameRegion = {};
+            frameRegion.Rect = spooledRegion.Rect;
+            frameRegion.Pixels = m_bufferPool.Acquire(source.Width, source.Height);
+            auto&& view = frameRegion.Pixels.View();
+            auto rowBytes = static_cast<size_t>(view.Width) * 4;
+            for (uint32_t y = 0; y < view.Height; y++)
+            {
+                memcpy(view.Row(y), source.Row(y), rowBytes);
+            }
+            queuedFrame.Frame.Regions.push_back(std::move(frameRegion));
+        }
+        queuedFrame.Frame.TimeStamp = spooledFrame.TimeStamp;
+        queuedFrame.CurrentTime = spooledFrame.CurrentTime;
+        EncodeQueuedFrame(queuedFrame);
+    }
+}
+
+void GifPipeline::EncodeSpoolWithRecordingPalette()
+{
+    auto recordingPalette = BuildRecordingPalette();
+    if (recordingPalette.empty())
+    {
+        EncodeSpool();
+        FinishEncoding();
+        return;
+    }
+
+    // Encode the recording both ways, each into a file next to the
+    // spool, then copy over the smaller one. The frame encoder that's
+    // left at the end is the one whose file we keep, so the statistics
+    // are for that one.
+    TemporaryFile localFile(m_options.SpoolFile.string() + ".local.gif");
+    m_localPaletteBytes = EncodeSpoolToFile(localFile.Path, {});
+    auto localEncoder = std::move(m_frameEncoder);
+    auto localFrameCount = m_encodedFrameCount;
+
+    TemporaryFile recordingFile(m_options.SpoolFile.string() + ".recording.gif");
+    m_recordingPaletteBytes = EncodeSpoolToFile(recordingFile.Path, recordingPalette);
+
+    // Ties go to per-region palettes, which don't depend on this pass
+    auto keptPath = recordingFile.Path;
+    if (m_recordingPaletteBytes >= m_localPaletteBytes)
+    {
+        m_frameEncoder = std::move(localEncoder);
+        m_encodedFrameCount = localFrameCount;
+        keptPath = localFile.Path;
+    }
+
+    TraceSpan span("WriteFile");
+    std::ifstream keptFile(keptPath, std::ios::binary);
+    std::vector<uint8_t> buffer(1 << 20);
+    while (keptFile)
+    {
+        keptFile.read(reinterpret_cast<char*>(buffer.data()), static_cast<std::streamsize>(buffer.size()));
+        auto size = static_cast<size_t>(keptFile.gcount());
+        if (size > 0)
+        {
+            m_output.Write(buffer.data(), size);
+        }
+    }
+    if (!keptFile.eof())
+    {
+        throw std::runtime_error("Couldn't read back " + keptPath.string());
+    }
+    m_output.Finish();
+}
+
+uint64_t GifPipeline::EncodeSpoolToFile(std::filesystem::path const& path, std::vector<GifColor> const& globalPalette)
+{
+    FileGifOutputStream file(path);
+    m_frameEncoder = CreateFrameEncoder([&file](std::vector<uint8_t> const& bytes)
+        {
+            file.Write(bytes.data(), bytes.size());
+        });
+    if (!globalPalette.empty())
+    {
+        m_frameEncoder->SetGlobalPalette(globalPalette);
+    }
+    EncodeSpool();
+    auto globalColorTable = m_frameEncoder->Finish();
+    if (globalColorTable.has_value())
+    {
+        auto&& bytes = globalColorTable.value();
+        file.WriteAt(GifWriter::GlobalColorTableOffset, bytes.data(), bytes.size());
+    }
+    file.Finish();
+    return std::filesystem::file_size(path);
+}
+
+std::vector<GifColor> GifPipeline::BuildRecordingPalette()
+{
+    TraceSpan span("BuildRecordingPalette");
+    auto frameCount = m_spool->FrameCount();
+    if (frameCount < 2)
+    {
+        return {};
+    }
+
+    // Regions show up when the frame before them ends, on the same
+    // clock their delays are rounded on. The last frame only marks when
+    // the recording ends.
+    using Centiseconds = std::chrono::duration<int64_t, std::centi>;
+    auto paletteSize = std::min(std::max(m_options.PaletteSize, 4u), 256u);
+    RecordingPalette palette(m_width, m_height, m_options.UseTransparency ? paletteSize - 1 : paletteSize);
+    FrameSpool::Frame spooledFrame;
+    FrameTime firstFrameTime = {};
+    int64_t endTime = 0;
+    for (uint64_t i = 0; i < frameCount; i++)
+    {
+        m_spool->ReadFrame(i, spooledFrame);
+        if (i == 0)
+        {
+            firstFrameTime = spooledFrame.TimeStamp;
+        }
+        auto time = i == 0 ? 0 : std::chrono::round<Centiseconds>(spooledFrame.CurrentTime - firstFrameTime).count();
+        endTime = std::max(endTime, time);
+        if (i + 1 < frameCount)
+        {
+            for (auto&& region : spooledFrame.Regions)
+            {
+                palette.AddRegion(region.Rect, region.Pixels, endTime);
+            }
+        }
+    }
+    return palette.Build(endTime);
+}
+
+void GifPipeline::FinishEncoding()
+{
+    TraceSpan span("FinishEncoding");
+    auto globalColorTable = m_frameEncoder->Finish();
+
+    // Go back and fill in the global color table
+    if (globalColorTable.has_value())
+    {
+        auto&& bytes = globalColorTable.value();
+        m_output.WriteAt(GifWriter::GlobalColorTableOffset, bytes.data(), bytes.size());
+    }
+    m_output.Finish();
+}
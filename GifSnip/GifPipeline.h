@@ -0,0 +1,134 @@
+#pragma once
+#include "FrameSource.h"
+#include "FrameReadback.h"
+#include "FrameBufferPool.h"
+#include "GifFrameEncoder.h"
+#include "GifOutputStream.h"
+#include "GifEncoderOptions.h"
+#include "GifEncoderStatistics.h"
+#include "DirtyTileMap.h"
+#include "FrameRateGovernor.h"
+#include "FrameSpool.h"
+#include "RecordingPalette.h"
+#include "ThreadPool.h"
+#include "SpscQueue.h"
+#include "Trace.h"
+#include <exception>
+#include <memory>
+#include <optional>
+#include <thread>
+#include <vector>
+
+// A frame waiting in a readback ring
+struct PendingFrame
+{
+    FrameTime SystemRelativeTime = {};
+    // The last frame gets written even if nothing changed
+    bool Force = false;
+};
+
+// The platform independent half of a recording. Frames come in once
+// they've been read back along with what the differ found. The changed
+// regions are cut out on the calling thread and encoded on a thread of
+// our own, which writes the file as it goes. With a spool file, they're
+// written to it instead and encoded once the recording stops.
+class GifPipeline
+{
+public:
+    GifPipeline(
+        uint32_t width,
+        uint32_t height,
+        GifOutputStream& output,
+        GifEncoderOptions const& options = {});
+    ~GifPipeline();
+
+    GifPipeline(GifPipeline const&) = delete;
+    GifPipeline& operator=(GifPipeline const&) = delete;
+
+    // Decides whether a frame is worth composing and diffing at all,
+    // see FrameRateGovernor.
+    bool AcceptFrame(FrameTime timeStamp);
+    FrameTime LastAcceptedTimeStamp() const { return m_lastAcceptedTimeStamp; }
+
+    // Takes every accepted frame, in order, once it has been read back.
+    void CaptureFrame(ReadbackData const& data, PendingFrame const& pendingFrame);
+
+    // Waits for the encoder thread to finish the file, rethrowing
+    // anything that went wrong on it. When spooling, this is when the
+    // frames get encoded.
+    void Finish();
+
+    // Valid after Finish()
+    GifEncoderStatistics const& Statistics() const { return m_statistics; }
+
+private:
+    struct GifFrameImage
+    {
+        std::vector<GifFrameRegion> Regions;
+        FrameTime TimeStamp = {};
+    };
+
+    // A frame on its way to the encoder thread, along with the time at
+    // which the frame before it ends.
+    struct QueuedFrame
+    {
+        GifFrameImage Frame;
+        FrameTime CurrentTime = {};
+    };
+
+    // Fills m_diffRects with the regions to cut out of a frame, inflated
+    // and with exclusive Right/Bottom.
+    void SplitChange(DiffRect const& diff, bool coalesced);
+
+    std::unique_ptr<GifFrameEncoder> CreateFrameEncoder(GifFrameEncoder::OutputCallback output);
+
+    // Encoder thread
+    void EncodeLoop();
+    void EncodeQueuedFrame(QueuedFrame& queuedFrame);
+    void EncodeSpool();
+    void EncodeSpoolWithRecordingPalette();
+    // Encodes the spool into a file of its own with a new frame encoder,
+    // starting out with the global palette if there is one. Returns the
+    // size of the file.
+    uint64_t EncodeSpoolToFile(std::filesystem::path const& path, std::vector<GifColor> const& globalPalette);
+    std::vector<GifColor> BuildRecordingPalette();
+    void FinishEncoding();
+
+private:
+    GifEncoderOptions m_options = {};
+    GifOutputStream& m_output;
+    uint32_t m_width = 0;
+    uint32_t m_height = 0;
+    // Outlives everything holding on to its buffers
+    FrameBufferPool m_bufferPool;
+    std::unique_ptr<ThreadPool> m_threadPool;
+    std::unique_ptr<GifFrameEncoder> m_frameEncoder;
+    std::unique_ptr<FrameRateGovernor> m_governor;
+    GifEncoderStatistics m_statistics = {};
+    DirtyTileMap m_dirtyTiles;
+    FrameTime m_lastTimeStamp = {};
+    FrameTime m_lastAcceptedTimeStamp = {};
+    std::optional<GifFrameImage> m_previousFrame;
+    std::unique_ptr<SpscQueue<QueuedFrame>> m_frameQueue;
+    // Emptied region lists handed back by the encoder thread for reuse
+    std::unique_ptr<SpscQueue<std::vector<GifFrameRegion>>> m_freeRegionLists;
+    std::vector<DiffRect> m_diffRects;
+    std::unique_ptr<FrameSpool> m_spool;
+    // Changes from frames that didn't fit in the queue, still waiting to
+    // be written.
+    std::optional<DiffRect> m_coalescedRect;
+    uint64_t m_coalescedFrameCount = 0;
+    uint64_t m_receivedFrameCount = 0;
+    uint64_t m_throttledFrameCount = 0;
+    uint64_t m_unchangedFrameCount = 0;
+    // Encoder thread
+    uint64_t m_encodedFrameCount = 0;
+    // Where the GIF's clock stands, in 10ms units since the first frame
+    FrameTime m_firstFrameTime = {};
+    int64_t m_elapsedDelay = 0;
+    // With UseRecordingPalette, the size of the file each way
+    uint64_t m_recordingPaletteBytes = 0;
+    uint64_t m_localPaletteBytes = 0;
+    std::thread m_encodeThread;
+    std::exception_ptr m_encodeError;
+};
@@ -0,0 +1,236 @@
+#include "GifWriter.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace
+{
+    constexpr uint8_t ExtensionIntroducer = 0x21;
+    constexpr uint8_t GraphicControlLabel = 0xF9;
+    constexpr uint8_t ApplicationExtensionLabel = 0xFF;
+    constexpr uint8_t ImageSeparator = 0x2C;
+    constexpr uint8_t Trailer = 0x3B;
+}
+
+GifWriter::GifWriter(
+    uint16_t width,
+    uint16_t height,
+    std::vector<GifColor> const& globalPalette,
+    std::optional<uint16_t> loopCount)
+{
+    if (globalPalette.size() > 256)
+    {
+        throw std::invalid_argument("GIF color tables can't have more than 256 entries");
+    }
+
+    m_width = width;
+    m_height = height;
+    m_hasGlobalPalette = !globalPalette.empty();
+    m_globalPaletteBits = m_hasGlobalPalette ? ColorTableBits(globalPalette.size()) : 0;
+
+    // Header
+    WriteBytes(reinterpret_cast<uint8_t const*>("GIF89a"), 6);
+
+    // Logical screen descriptor
+    WriteUInt16(width);
+    WriteUInt16(height);
+    uint8_t packed = 0;
+    if (m_hasGlobalPalette)
+    {
+        // Global color table flag, 8 bits of color resolution, table size
+        packed = static_cast<uint8_t>(0x80 | 0x70 | (m_globalPaletteBits - 1));
+    }
+    WriteByte(packed);
+    WriteByte(0); // Background color index
+    WriteByte(0); // Pixel aspect ratio
+    if (m_hasGlobalPalette)
+    {
+        WriteColorTable(globalPalette, m_globalPaletteBits);
+    }
+
+    if (!loopCount.has_value())
+    {
+        return;
+    }
+
+    // Write the application block
+    // http://www.vurdalakov.net/misc/gif/netscape-looping-application-extension
+    WriteByte(ExtensionIntroducer);
+    WriteByte(ApplicationExtensionLabel);
+    WriteByte(11);
+    WriteBytes(reinterpret_cast<uint8_t const*>("NETSCAPE2.0"), 11);
+    // The first value is the size of the block, which is the fixed value 3.
+    // The second value is the looping extension, which is the fixed value 1.
+    // The third and fourth values comprise an unsigned 2-byte integer (little endian).
+    //     The value of 0 means to loop infinitely.
+    // The final value is the block terminator, which is the fixed value 0.
+    WriteByte(3);
+    WriteByte(1);
+    WriteUInt16(loopCount.value());
+    WriteByte(0);
+}
+
+void GifWriter::WriteFrame(
+    GifFrameDescription const& description,
+    std::vector<GifColor> const& localPalette,
+    uint8_t const* indices)
+{
+    auto previousSize = m_output.size();
+    EncodeFrame(description, localPalette, indices, m_lzwEncoder, m_output);
+    m_totalBytesWritten += m_output.size() - previousSize;
+}
+
+void GifWriter::EncodeFrame(
+    GifFrameDescription const& description,
+    std::vector<GifColor> const& localPalette,
+    uint8_t const* indices,
+    LzwEncoder& lzwEncoder,
+    std::vector<uint8_t>& output) const
+{
+    if (m_trailerWritten)
+    {
+        throw std::logic_error("Can't write a frame after the trailer");
+    }
+    if (localPalette.size() > 256)
+    {
+        throw std::invalid_argument("GIF color tables can't have more than 256 entries");
+    }
+    if (localPalette.empty() && !m_hasGlobalPalette)
+    {
+        throw std::invalid_argument("Frames require a local palette when there is no global palette");
+    }
+    if (description.Width == 0 || description.Height == 0 ||
+        static_cast<uint32_t>(description.Left) + description.Width > m_width ||
+        static_cast<uint32_t>(description.Top) + description.Height > m_height)
+    {
+        throw std::invalid_argument("Frame must be non-empty and fit within the logical screen");
+    }
+
+    auto writeUInt16 = [&output](uint16_t value)
+    {
+        output.push_back(static_cast<uint8_t>(value & 0xFF));
+        output.push_back(static_cast<uint8_t>(value >> 8));
+    };
+
+    // Graphic control extension
+    output.push_back(ExtensionIntroducer);
+    output.push_back(GraphicControlLabel);
+    output.push_back(4);
+    auto packed = static_cast<uint8_t>(static_cast<uint8_t>(description.Disposal) << 2);
+    if (description.TransparentIndex.has_value())
+    {
+        packed |= 0x01;
+    }
+    output.push_back(packed);
+    writeUInt16(description.Delay);
+    output.push_back(description.TransparentIndex.value_or(0));
+    output.push_back(0);
+
+    // Image descriptor
+    output.push_back(ImageSeparator);
+    writeUInt16(description.Left);
+    writeUInt16(description.Top);
+    writeUInt16(description.Width);
+    writeUInt16(description.Height);
+    uint8_t paletteBits = m_globalPaletteBits;
+    if (!localPalette.empty())
+    {
+        paletteBits = ColorTableBits(localPalette.size());
+        // Local color table flag, not interlaced, not sorted, table size
+        output.push_back(static_cast<uint8_t>(0x80 | (paletteBits - 1)));
+        AppendColorTable(localPalette, paletteBits, output);
+    }
+    else
+    {
+        output.push_back(0);
+    }
+
+    auto minimumCodeSize = std::max<uint8_t>(paletteBits, 2);
+    lzwEncoder.Encode(minimumCodeSize, indices, static_cast<size_t>(description.Width) * description.Height, output);
+}
+
+void GifWriter::WriteEncodedFrame(uint8_t const* data, size_t size)
+{
+    if (m_trailerWritten)
+    {
+        throw std::logic_error("Can't write a frame after the trailer");
+    }
+    WriteBytes(data, size);
+}
+
+void GifWriter::WriteTrailer()
+{
+    if (!m_trailerWritten)
+    {
+        WriteByte(Trailer);
+        m_trailerWritten = true;
+    }
+}
+
+void GifWriter::TakeOutput(std::vector<uint8_t>& bytes)
+{
+    bytes.clear();
+    bytes.swap(m_output);
+}
+
+std::vector<uint8_t> GifWriter::GlobalColorTableBytes(std::vector<GifColor> const& palette) const
+{
+    if (!m_hasGlobalPalette)
+    {
+        throw std::logic_error("There is no global color table to replace");
+    }
+    if (palette.size() > (static_cast<size_t>(1) << m_globalPaletteBits))
+    {
+        throw std::invalid_argument("The palette doesn't fit in the reserved global color table");
+    }
+
+    std::vector<uint8_t> bytes;
+    AppendColorTable(palette, m_globalPaletteBits, bytes);
+    return bytes;
+}
+
+uint8_t GifWriter::ColorTableBits(size_t paletteSize)
+{
+    uint8_t bits = 1;
+    while ((static_cast<size_t>(1) << bits) < paletteSize)
+    {
+        bits++;
+    }
+    return bits;
+}
+
+void GifWriter::WriteByte(uint8_t value)
+{
+    m_output.push_back(value);
+    m_totalBytesWritten++;
+}
+
+void GifWriter::WriteUInt16(uint16_t value)
+{
+    WriteByte(static_cast<uint8_t>(value & 0xFF));
+    WriteByte(static_cast<uint8_t>(value >> 8));
+}
+
+void GifWriter::WriteBytes(uint8_t const* data, size_t size)
+{
+    m_output.insert(m_output.end(), data, data + size);
+    m_totalBytesWritten += size;
+}
+
+void GifWriter::WriteColorTable(std::vector<GifColor> const& palette, uint8_t bits)
+{
+    auto previousSize = m_output.size();
+    AppendColorTable(palette, bits, m_output);
+    m_totalBytesWritten += m_output.size() - previousSize;
+}
+
+void GifWriter::AppendColorTable(std::vector<GifColor> const& palette, uint8_t bits, std::vector<uint8_t>& output)
+{
+    auto tableSize = static_cast<size_t>(1) << bits;
+    for (size_t i = 0; i < tableSize; i++)
+    {
+        auto color = i < palette.size() ? palette[i] : GifColor{ 0, 0, 0 };
+        output.push_back(color.R);
+        output.push_back(color.G);
+        output.push_back(color.B);
+    }
+}
@@ -0,0 +1,107 @@
+#pragma once
+#include "LzwEncoder.h"
+#include <cstdint>
+#include <cstddef>
+#include <optional>
+#include <vector>
+
+struct GifColor
+{
+    uint8_t R;
+    uint8_t G;
+    uint8_t B;
+};
+
+enum class GifDisposalMethod : uint8_t
+{
+    Unspecified = 0,
+    DoNotDispose = 1,
+    RestoreToBackground = 2,
+    RestoreToPrevious = 3,
+};
+
+struct GifFrameDescription
+{
+    uint16_t Left = 0;
+    uint16_t Top = 0;
+    uint16_t Width = 0;
+    uint16_t Height = 0;
+    // Delay in 10ms units
+    uint16_t Delay = 0;
+    GifDisposalMethod Disposal = GifDisposalMethod::DoNotDispose;
+    std::optional<uint8_t> TransparentIndex;
+};
+
+// Writes a GIF89a container into an in-memory buffer. The owner is
+// responsible for draining the buffer (see TakeOutput) to wherever
+// the file actually lives.
+class GifWriter
+{
+public:
+    // A loop count of 0 loops forever, and no loop count leaves out
+    // the looping extension so viewers play the GIF once. An empty
+    // global palette omits the global color table, in which case
+    // every frame must supply a local one.
+    GifWriter(
+        uint16_t width,
+        uint16_t height,
+        std::vector<GifColor> const& globalPalette = {},
+        std::optional<uint16_t> loopCount = 0);
+
+    // Writes a graphic control extension, an image descriptor, an
+    // optional local color table, and the LZW compressed indices.
+    // The indices are expected to be tightly packed (Width * Height).
+    void WriteFrame(
+        GifFrameDescription const& description,
+        std::vector<GifColor> const& localPalette,
+        uint8_t const* indices);
+    // Encodes a frame exactly like WriteFrame, but appends it to the
+    // provided buffer instead of the output. Frames can be encoded on
+    // any number of threads at once, as long as each has its own LZW
+    // encoder, and then written in order with WriteEncodedFrame.
+    void EncodeFrame(
+        GifFrameDescription const& description,
+        std::vector<GifColor> const& localPalette,
+        uint8_t const* indices,
+        LzwEncoder& lzwEncoder,
+        std::vector<uint8_t>& output) const;
+    void WriteEncodedFrame(uint8_t const* data, size_t size);
+    void WriteTrailer();
+
+    // Moves everything written so far into the provided vector.
+    void TakeOutput(std::vector<uint8_t>& bytes);
+    uint64_t TotalBytesWritten() const { return m_totalBytesWritten; }
+    uint16_t Width() const { return m_width; }
+    uint16_t Height() const { return m_height; }
+    LzwResetPolicy LzwPolicy() const { return m_lzwEncoder.ResetPolicy(); }
+    void LzwPolicy(LzwResetPolicy policy) { m_lzwEncoder.ResetPolicy(policy); }
+
+    // Number of bits needed to describe a color table of the given size (1-8).
+    static uint8_t ColorTableBits(size_t paletteSize);
+
+    // The global color table always starts right after the logical
+    // screen descriptor. Writers that don't know their global palette
+    // up front can reserve one with placeholder colors and later
+    // overwrite it at this offset with the bytes from
+    // GlobalColorTableBytes.
+    static constexpr uint64_t GlobalColorTableOffset = 13;
+    std::vector<uint8_t> GlobalColorTableBytes(std::vector<GifColor> const& palette) const;
+    uint8_t GlobalPaletteBits() const { return m_globalPaletteBits; }
+
+private:
+    void WriteByte(uint8_t value);
+    void WriteUInt16(uint16_t value);
+    void WriteBytes(uint8_t const* data, size_t size);
+    void WriteColorTable(std::vector<GifColor> const& palette, uint8_t bits);
+    static void AppendColorTable(std::vector<GifColor> const& palette, uint8_t bits, std::vector<uint8_t>& output);
+
+private:
+    std::vector<uint8_t> m_output;
+    LzwEncoder m_lzwEncoder;
+    uint64_t m_totalBytesWritten = 0;
+    uint16_t m_width = 0;
+    uint16_t m_height = 0;
+    bool m_hasGlobalPalette = false;
+    uint8_t m_globalPaletteBits = 0;
+    bool m_trailerWritten = false;
+};
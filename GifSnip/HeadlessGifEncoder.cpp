@@ -0,0 +1,95 @@
+#include "HeadlessGifEncoder.h"
+#include <algorithm>
+
+HeadlessGifEncoder::HeadlessGifEncoder(
+    GifOutputStream& output,
+    DiffRect const& rect,
+    GifEncoderOptions const& options)
+{
+    m_options = options;
+    // Nothing is live, so there's no reason to drop frames
+    m_options.SkipFramesWhenBehind = false;
+    m_frameCompositor = std::make_unique<CpuFrameCompositor>(rect);
+    auto width = m_frameCompositor->Width();
+    auto height = m_frameCompositor->Height();
+
+    m_pipeline = std::make_unique<GifPipeline>(width, height, output, m_options);
+
+    // Stands in for the GPU, so give it threads of its own
+    m_threadPool = std::make_unique<ThreadPool>();
+    m_textureDiffer = std::make_unique<CpuTextureDiffer>(width, height, m_threadPool.get(), m_options.TileSize, m_options.Detection, m_options.Tolerance);
+
+    m_readback = std::make_unique<SoftwareFrameReadback>(width, height, std::max(m_options.ReadbackSlots, 1u));
+    m_readbackRing = std::make_unique<ReadbackRing<PendingFrame>>(*m_readback, m_options.ReadbackLatency);
+}
+
+bool HeadlessGifEncoder::ProcessFrame(SourceFrame const& frame)
+{
+    if (!m_pipeline->AcceptFrame(frame.SystemRelativeTime))
+    {
+        return false;
+    }
+
+    TraceSpan span("ProcessFrame");
+    FrameBufferView composedFrame = {};
+    {
+        TraceSpan span("Compose");
+        composedFrame = m_frameCompositor->ProcessFrame(frame);
+    }
+    SubmitFrame(composedFrame, frame.SystemRelativeTime, false);
+
+    return true;
+}
+
+void HeadlessGifEncoder::ProcessFrames(FrameSource& source)
+{
+    SourceFrame frame = {};
+    while (source.TryGetNextFrame(frame))
+    {
+        ProcessFrame(frame);
+    }
+}
+
+void HeadlessGifEncoder::Stop()
+{
+    if (m_stopped)
+    {
+        return;
+    }
+    m_stopped = true;
+
+    // Repeat the last frame, then read back everything still in flight
+    SubmitFrame(m_frameCompositor->RepeatFrame(), m_pipeline->LastAcceptedTimeStamp(), true);
+    m_readbackRing->Flush([this](ReadbackData const& data, PendingFrame const& pendingFrame)
+        {
+            m_pipeline->CaptureFrame(data, pendingFrame);
+        });
+
+    m_pipeline->Finish();
+    m_statistics = m_pipeline->Statistics();
+    m_statistics.ReadbackStalls = m_readbackRing->StallCount();
+}
+
+void HeadlessGifEncoder::SubmitFrame(FrameBufferView const& composedFrame, FrameTime timeStamp, bool force)
+{
+    auto consume = [this](ReadbackData const& data, PendingFrame const& pendingFrame)
+    {
+        m_pipeline->CaptureFrame(data, pendingFrame);
+    };
+
+    auto slot = m_readbackRing->BeginFrame(consume);
+    std::optional<DiffRect> diff;
+    {
+        TraceSpan span("Diff");
+        diff = m_textureDiffer->ProcessFrame(composedFrame.Data, composedFrame.Stride);
+    }
+    {
+        TraceSpan span("CopyFrame");
+        m_readback->Fill(slot, composedFrame.Data, composedFrame.Stride, diff, m_textureDiffer->DirtyTiles());
+    }
+
+    PendingFrame pendingFrame = {};
+    pendingFrame.SystemRelativeTime = timeStamp;
+    pendingFrame.Force = force;
+    m_readbackRing->EndFrame(std::move(pendingFrame), consume);
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include "FrameSource.h"
+#include "CpuFrameCompositor.h"
+#include "CpuTextureDiffer.h"
+#include "SoftwareFrameReadback.h"
+#include "GifPipeline.h"
+#include "GifEncoderOptions.h"
+#include "GifEncoderStatistics.h"
+#include <memory>
+
+// GifEncoder without a GPU or Windows. Frames go through the same steps
+// (crop, diff, readback ring, encode) using the CPU implementations, so
+// recordings can be replayed and profiled anywhere.
+class HeadlessGifEncoder
+{
+public:
+    // The rect is the part of the source frames to record, with
+    // exclusive Right/Bottom.
+    HeadlessGifEncoder(
+        GifOutputStream& output,
+        DiffRect const& rect,
+        GifEncoderOptions const& options = {});
+
+    bool ProcessFrame(SourceFrame const& frame);
+    // Feeds every frame of the source through ProcessFrame.
+    void ProcessFrames(FrameSource& source);
+    void Stop();
+
+    // Valid after Stop()
+    GifEncoderStatistics const& Statistics() const { return m_statistics; }
+
+private:
+    void SubmitFrame(FrameBufferView const& composedFrame, FrameTime timeStamp, bool force);
+
+private:
+    GifEncoderOptions m_options = {};
+    std::unique_ptr<ThreadPool> m_threadPool;
+    std::unique_ptr<GifPipeline> m_pipeline;
+    GifEncoderStatistics m_statistics = {};
+    std::unique_ptr<CpuFrameCompositor> m_frameCompositor;
+    std::unique_ptr<CpuTextureDiffer> m_textureDiffer;
+    std::unique_ptr<SoftwareFrameReadback> m_readback;
+    std::unique_ptr<ReadbackRing<PendingFrame>> m_readbackRing;
+    bool m_stopped = false;
+};
@@ -0,0 +1,202 @@
+#include "LzwEncoder.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace
+{
+    constexpr uint32_t MaxCode = 4095;
+    constexpr uint32_t MaxCodeSize = 12;
+    constexpr uint32_t TableBits = 14;
+    constexpr uint32_t TableSize = 1u << TableBits;
+    constexpr uint32_t TableMask = TableSize - 1;
+    // A key with a prefix of 4095 can never be inserted (the table is
+    // full by the time that code exists), so all ones is free to mark
+    // empty slots.
+    constexpr uint32_t EmptySlot = 0xFFFFFFFF;
+    constexpr size_t MaxSubBlockSize = 255;
+    // How many indices the adaptive policy looks at between ratio checks.
+    constexpr size_t AdaptiveWindow = 4096;
+
+    inline uint32_t HashKey(uint32_t key)
+    {
+        // Fibonacci hashing spreads the (prefix, index) pairs well enough
+        // that linear probing stays short at our load factor (< 25%).
+        return (key * 2654435761u) >> (32 - TableBits);
+    }
+}
+
+LzwEncoder::LzwEncoder(LzwResetPolicy policy)
+{
+    m_policy = policy;
+    m_table.resize(TableSize, EmptySlot);
+}
+
+void LzwEncoder::ClearTable()
+{
+    std::fill(m_table.begin(), m_table.end(), EmptySlot);
+}
+
+void LzwEncoder::Encode(uint8_t minimumCodeSize, uint8_t const* indices, size_t count, std::vector<uint8_t>& output)
+{
+    if (minimumCodeSize < 2 || minimumCodeSize > 8)
+    {
+        throw std::invalid_argument("GIF minimum code size must be between 2 and 8");
+    }
+
+    // Worst case is one 12-bit code per index plus the occasional clear
+    // code, with room for the final partial accumulator flush.
+    auto maxCodes = count + (count / 256) + 4;
+    m_codeStream.resize(((maxCodes * MaxCodeSize) / 8) + 8);
+    auto const streamBase = m_codeStream.data();
+    auto stream = streamBase;
+
+    uint64_t accumulator = 0;
+    uint32_t bitCount = 0;
+    uint32_t codeSize = minimumCodeSize + 1u;
+    auto writeCode = [&](uint32_t code)
+    {
+        accumulator |= static_cast<uint64_t>(code) << bitCount;
+        bitCount += codeSize;
+        if (bitCount >= 32)
+        {
+            stream[0] = static_cast<uint8_t>(accumulator);
+            stream[1] = static_cast<uint8_t>(accumulator >> 8);
+            stream[2] = static_cast<uint8_t>(accumulator >> 16);
+            stream[3] = static_cast<uint8_t>(accumulator >> 24);
+            stream += 4;
+            accumulator >>= 32;
+            bitCount -= 32;
+        }
+    };
+    auto bitsWritten = [&]()
+    {
+        return (static_cast<uint64_t>(stream - streamBase) * 8) + bitCount;
+    };
+
+    auto const clearCode = 1u << minimumCodeSize;
+    auto const endCode = clearCode + 1;
+    auto nextCode = endCode + 1;
+
+    // Bookkeeping for the adaptive policy
+    size_t segmentStartIndex = 0;
+    uint64_t segmentStartBits = 0;
+    uint64_t fullSegmentIndices = 0;
+    uint64_t fullSegmentBits = 0;
+    size_t windowStartIndex = 0;
+    uint64_t windowStartBits = 0;
+
+    ClearTable();
+    writeCode(clearCode);
+    if (count > 0)
+    {
+        uint32_t prefix = indices[0];
+        for (size_t i = 1; i < count; i++)
+        {
+            uint32_t index = indices[i];
+            auto key = (prefix << 8) | index;
+            auto slot = HashKey(key);
+            auto entry = m_table[slot];
+            while (entry != EmptySlot && (entry >> 12) != key)
+            {
+                slot = (slot + 1) & TableMask;
+                entry = m_table[slot];
+            }
+            if (entry != EmptySlot)
+            {
+                prefix = entry & MaxCode;
+                continue;
+            }
+
+            writeCode(prefix);
+            if (nextCode <= MaxCode)
+            {
+                m_table[slot] = (key << 12) | nextCode;
+                // The decoder adds its entry one code later than we do, so
+                // only grow once it would also need the wider code.
+                if (nextCode == (1u << codeSize) && codeSize < MaxCodeSize)
+                {
+                    codeSize++;
+                }
+                nextCode++;
+
+                if (nextCode > MaxCode)
+                {
+                    fullSegmentIndices = i - segmentStartIndex;
+                    fullSegmentBits = bitsWritten() - segmentStartBits;
+                    windowStartIndex = i;
+                    windowStartBits = bitsWritten();
+                }
+            }
+            else
+            {
+                auto shouldClear = true;
+                if (m_policy == LzwResetPolicy::Adaptive)
+                {
+                    shouldClear = false;
+                    auto windowIndices = static_cast<uint64_t>(i - windowStartIndex);
+                    if (windowIndices >= AdaptiveWindow)
+                    {
+                        auto windowBits = bitsWritten() - windowStartBits;
+                        // Reset once the recent ratio falls below 90% of the
+                        // ratio we had while filling the table.
+                        shouldClear = (windowIndices * fullSegmentBits * 10) < (fullSegmentIndices * windowBits * 9);
+                        windowStartIndex = i;
+                        windowStartBits = bitsWritten();
+                    }
+                }
+
+                if (shouldClear)
+                {
+                    writeCode(clearCode);
+                    ClearTable();
+                    codeSize = minimumCodeSize + 1u;
+                    nextCode = endCode + 1;
+                    segmentStartIndex = i;
+                    segmentStartBits = bitsWritten();
+                }
+            }
+            prefix = index;
+        }
+        writeCode(prefix);
+    }
+    // Decoders add an entry for the last code too, and widen their codes
+    // if that fills the current size, so the end code has to follow suit
+    if (nextCode == (1u << codeSize) && codeSize < MaxCodeSize)
+    {
+        codeSize++;
+    }
+    writeCode(endCode);
+
+    while (bitCount > 0)
+    {
+        *stream++ = static_cast<uint8_t>(accumulator);
+        accumulator >>= 8;
+        bitCount = bitCount > 8 ? bitCount - 8 : 0;
+    }
+
+    // Split the code stream into sub-blocks
+    auto streamSize = static_cast<size_t>(stream - streamBase);
+    auto fullBlocks = streamSize / MaxSubBlockSize;
+    auto remainder = streamSize % MaxSubBlockSize;
+    auto outputOffset = output.size();
+    output.resize(outputOffset + 1 + streamSize + fullBlocks + (remainder > 0 ? 1 : 0) + 1);
+    auto dest = output.data() + outputOffset;
+    *dest++ = minimumCodeSize;
+    auto source = streamBase;
+    for (size_t block = 0; block < fullBlocks; block++)
+    {
+        *dest++ = static_cast<uint8_t>(MaxSubBlockSize);
+        memcpy(dest, source, MaxSubBlockSize);
+        dest += MaxSubBlockSize;
+        source += MaxSubBlockSize;
+    }
+    if (remainder > 0)
+    {
+        *dest++ = static_cast<uint8_t>(remainder);
+        memcpy(dest, source, remainder);
+        dest += remainder;
+    }
+    // Block terminator
+    *dest = 0;
+}
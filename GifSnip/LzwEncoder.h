@@ -0,0 +1,38 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+enum class LzwResetPolicy
+{
+    // Emit a clear code as soon as the string table fills up.
+    WhenFull,
+    // Keep using the full table until the compression ratio drops
+    // noticeably below what it was when the table filled up.
+    Adaptive,
+};
+
+// Produces the GIF image data stage (minimum code size, LZW sub-blocks,
+// block terminator) for a buffer of palette indices.
+class LzwEncoder
+{
+public:
+    LzwEncoder(LzwResetPolicy policy = LzwResetPolicy::WhenFull);
+
+    // Appends the encoded image data to the output.
+    void Encode(uint8_t minimumCodeSize, uint8_t const* indices, size_t count, std::vector<uint8_t>& output);
+
+    LzwResetPolicy ResetPolicy() const { return m_policy; }
+    void ResetPolicy(LzwResetPolicy policy) { m_policy = policy; }
+
+private:
+    void ClearTable();
+
+private:
+    LzwResetPolicy m_policy = LzwResetPolicy::WhenFull;
+    // Open addressing table. Each slot packs the 20-bit key (prefix code
+    // and appended index) above the 12-bit code it maps to.
+    std::vector<uint32_t> m_table;
+    // Contiguous code stream before it gets split into sub-blocks.
+    std::vector<uint8_t> m_codeStream;
+};
@@ -0,0 +1,195 @@
+#include "PaletteMapper.h"
+#include "ColorQuantizer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+namespace
+{
+    uint32_t HashColor(uint32_t color)
+    {
+        return (color * 0x9E3779B1u) >> 23;
+    }
+
+    bool PalettesMatch(std::vector<GifColor> const& first, std::vector<GifColor> const& second)
+    {
+        return first.size() == second.size() &&
+            std::equal(first.begin(), first.end(), second.begin(), [](GifColor const& a, GifColor const& b)
+                {
+                    return a.R == b.R && a.G == b.G && a.B == b.B;
+                });
+    }
+}
+
+PaletteMapper::PaletteMapper()
+{
+    m_exactColors.resize(ExactSlotCount, EmptySlot);
+    m_exactIndices.resize(ExactSlotCount, 0);
+    m_cells.resize(CellCount, 0);
+}
+
+void PaletteMapper::SetPalette(std::vector<GifColor> const& palette)
+{
+    if (m_generation != 0 && PalettesMatch(palette, m_palette))
+    {
+        return;
+    }
+    if (palette.empty() || palette.size() > 256)
+    {
+        throw std::invalid_argument("Palettes must have between 1 and 256 entries");
+    }
+
+    m_palette = palette;
+    m_paletteChangeCount++;
+
+    // Cells from older generations read as empty. The generation only
+    // wraps every 255 palettes, that's when the cube gets cleared.
+    m_generation++;
+    if (m_generation > 0xFF)
+    {
+        std::fill(m_cells.begin(), m_cells.end(), static_cast<uint16_t>(0));
+        m_generation = 1;
+    }
+
+    std::fill(m_exactColors.begin(), m_exactColors.end(), EmptySlot);
+    // Insert in reverse so that duplicate colors map to their first entry
+    for (auto i = static_cast<int32_t>(m_palette.size()) - 1; i >= 0; i--)
+    {
+        auto&& entry = m_palette[i];
+        auto color = (static_cast<uint32_t>(entry.R) << 16) | (static_cast<uint32_t>(entry.G) << 8) | entry.B;
+        auto slot = HashColor(color);
+        while (m_exactColors[slot] != EmptySlot && m_exactColors[slot] != color)
+        {
+            slot = (slot + 1) & (ExactSlotCount - 1);
+        }
+        m_exactColors[slot] = color;
+        m_exactIndices[slot] = static_cast<uint8_t>(i);
+    }
+}
+
+uint8_t PaletteMapper::FillCell(uint32_t cell)
+{
+    // Use the center of the cell
+    constexpr uint32_t shift = 8 - BitsPerChannel;
+    constexpr uint32_t mask = (1u << BitsPerChannel) - 1;
+    constexpr uint32_t half = 1u << (shift - 1);
+    auto r = static_cast<uint8_t>((((cell >> (BitsPerChannel * 2)) & mask) << shift) | half);
+    auto g = static_cast<uint8_t>((((cell >> BitsPerChannel) & mask) << shift) | half);
+    auto b = static_cast<uint8_t>(((cell & mask) << shift) | half);
+    auto index = FindNearestColor(m_palette, r, g, b);
+    m_cells[cell] = static_cast<uint16_t>((m_generation << 8) | index);
+    return index;
+}
+
+std::optional<uint8_t> PaletteMapper::FindExact(uint32_t color) const
+{
+    auto slot = HashColor(color);
+    while (m_exactColors[slot] != EmptySlot)
+    {
+        if (m_exactColors[slot] == color)
+        {
+            return m_exactIndices[slot];
+        }
+        slot = (slot + 1) & (ExactSlotCount - 1);
+    }
+    return std::nullopt;
+}
+
+uint8_t PaletteMapper::MapPixel(uint32_t pixel)
+{
+    auto color = pixel & 0x00FFFFFF;
+    if (auto exact = FindExact(color))
+    {
+        return exact.value();
+    }
+
+    constexpr uint32_t shift = 8 - BitsPerChannel;
+    constexpr uint32_t mask = (1u << BitsPerChannel) - 1;
+    auto cell = (((color >> (16 + shift)) & mask) << (BitsPerChannel * 2)) |
+        (((color >> (8 + shift)) & mask) << BitsPerChannel) |
+        ((color >> shift) & mask);
+    auto value = m_cells[cell];
+    if ((value >> 8) == m_generation)
+    {
+        return static_cast<uint8_t>(value);
+    }
+    return FillCell(cell);
+}
+
+uint8_t PaletteMapper::MapColor(uint8_t r, uint8_t g, uint8_t b)
+{
+    return MapPixel((static_cast<uint32_t>(r) << 16) | (static_cast<uint32_t>(g) << 8) | b);
+}
+
+void PaletteMapper::MapPixels(uint8_t const* pixels, size_t stride, uint32_t width, uint32_t height, uint8_t* indices)
+{
+    if (m_generation == 0)
+    {
+        throw std::logic_error("A palette must be set before mapping pixels");
+    }
+
+    // Screen content is mostly runs of the same color
+    uint32_t previousPixel = 0;
+    uint8_t previousIndex = MapPixel(previousPixel);
+    for (uint32_t y = 0; y < height; y++)
+    {
+        auto row = pixels + (static_cast<size_t>(y) * stride);
+        for (uint32_t x = 0; x < width; x++)
+        {
+            uint32_t pixel = 0;
+            memcpy(&pixel, row + (static_cast<size_t>(x) * 4), sizeof(pixel));
+            // Ignore alpha
+            pixel &= 0x00FFFFFF;
+            if (pixel != previousPixel)
+            {
+                previousPixel = pixel;
+                previousIndex = MapPixel(pixel);
+            }
+            *indices++ = previousIndex;
+        }
+    }
+}
+
+double PaletteMapper::MeasureError(ColorHistogram const& histogram)
+{
+    if (m_generation == 0)
+    {
+        throw std::logic_error("A palette must be set before measuring its error");
+    }
+    if (histogram.TotalCount() == 0)
+    {
+        return 0.0;
+    }
+
+    double error = 0.0;
+    for (auto index : histogram.UsedBins())
+    {
+        auto&& bin = histogram[index];
+        auto r = static_cast<int32_t>((bin.R + bin.Count / 2) / bin.Count);
+        auto g = static_cast<int32_t>((bin.G + bin.Count / 2) / bin.Count);
+        auto b = static_cast<int32_t>((bin.B + bin.Count / 2) / bin.Count);
+        auto&& entry = m_palette[MapColor(static_cast<uint8_t>(r), static_cast<uint8_t>(g), static_cast<uint8_t>(b))];
+        auto dr = entry.R - r;
+        auto dg = entry.G - g;
+        auto db = entry.B - b;
+        error += static_cast<double>(dr * dr + dg * dg + db * db) * static_cast<double>(bin.Count);
+    }
+    return std::sqrt(error / (static_cast<double>(histogram.TotalCount()) * 3.0));
+}
+
+bool PaletteMapper::ContainsAll(std::vector<GifColor> const& colors) const
+{
+    if (m_generation == 0)
+    {
+        return false;
+    }
+    for (auto&& color : colors)
+    {
+        if (!FindExact((static_cast<uint32_t>(color.R) << 16) | (static_cast<uint32_t>(color.G) << 8) | color.B).has_value())
+        {
+            return false;
+        }
+    }
+    return true;
+}
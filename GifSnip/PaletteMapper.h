@@ -0,0 +1,59 @@
+#pragma once
+#include "GifWriter.h"
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+class ColorHistogram;
+
+// Maps BGRA8 pixels to palette indices. Colors that are in the palette
+// are found through a small hash table; everything else goes through a
+// 6-6-6 lookup cube whose cells are filled with the entry nearest to
+// their center the first time they're hit. The cube stays valid for as
+// long as the palette doesn't change.
+class PaletteMapper
+{
+public:
+    static constexpr uint32_t BitsPerChannel = 6;
+    static constexpr uint32_t CellCount = 1u << (BitsPerChannel * 3);
+
+    PaletteMapper();
+
+    // Passing the palette that's already set keeps the cached cells.
+    void SetPalette(std::vector<GifColor> const& palette);
+    std::vector<GifColor> const& Palette() const { return m_palette; }
+
+    uint8_t MapColor(uint8_t r, uint8_t g, uint8_t b);
+    // The indices are tightly packed.
+    void MapPixels(uint8_t const* pixels, size_t stride, uint32_t width, uint32_t height, uint8_t* indices);
+
+    // Estimates how well the palette fits the colors in the histogram as
+    // the root mean square error per channel, using each bin's average
+    // color.
+    double MeasureError(ColorHistogram const& histogram);
+    // True if every color is in the palette as-is
+    bool ContainsAll(std::vector<GifColor> const& colors) const;
+
+    // Number of times the palette actually changed
+    uint64_t PaletteChangeCount() const { return m_paletteChangeCount; }
+
+private:
+    uint8_t MapPixel(uint32_t pixel);
+    std::optional<uint8_t> FindExact(uint32_t color) const;
+    uint8_t FillCell(uint32_t cell);
+
+private:
+    static constexpr uint32_t ExactSlotCount = 512;
+    static constexpr uint32_t EmptySlot = 0xFFFFFFFF;
+
+    std::vector<GifColor> m_palette;
+    // Exact palette colors as 0x00RRGGBB, and the index they map to
+    std::vector<uint32_t> m_exactColors;
+    std::vector<uint8_t> m_exactIndices;
+    // Each cell holds the generation it was filled in above the index,
+    // so changing palettes doesn't require clearing the cube.
+    std::vector<uint16_t> m_cells;
+    uint16_t m_generation = 0;
+    uint64_t m_paletteChangeCount = 0;
+};
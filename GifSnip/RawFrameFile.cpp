@@ -0,0 +1,115 @@
+#include "RawFrameFile.h"
+#include <cstring>
+#include <stdexcept>
+
+namespace
+{
+    template <typename T>
+    bool ReadValue(std::ifstream& file, T& value)
+    {
+        return static_cast<bool>(file.read(reinterpret_cast<char*>(&value), sizeof(value)));
+    }
+
+    template <typename T>
+    void WriteValue(std::ofstream& file, T const& value)
+    {
+        file.write(reinterpret_cast<char const*>(&value), sizeof(value));
+    }
+}
+
+RawFrameReader::RawFrameReader(std::filesystem::path const& path)
+{
+    m_file.open(path, std::ios::binary);
+    if (!m_file.is_open())
+    {
+        throw std::runtime_error("Couldn't open " + path.string());
+    }
+
+    char signature[sizeof(RawFrameFile::Signature)] = {};
+    uint32_t version = 0;
+    if (!m_file.read(signature, sizeof(signature)) ||
+        memcmp(signature, RawFrameFile::Signature, sizeof(signature)) != 0 ||
+        !ReadValue(m_file, version) ||
+        !ReadValue(m_file, m_width) ||
+        !ReadValue(m_file, m_height))
+    {
+        throw std::runtime_error(path.string() + " isn't a raw frame recording");
+    }
+    if (version != RawFrameFile::Version)
+    {
+        throw std::runtime_error("Unsupported raw frame recording version");
+    }
+    if (m_width == 0 || m_height == 0)
+    {
+        throw std::runtime_error("Raw frame recording has no pixels");
+    }
+    m_pixels.resize(static_cast<size_t>(m_width) * m_height * 4);
+}
+
+bool RawFrameReader::TryGetNextFrame(SourceFrame& frame)
+{
+    int64_t ticks = 0;
+    if (!ReadValue(m_file, ticks))
+    {
+        return false;
+    }
+    if (!m_file.read(reinterpret_cast<char*>(m_pixels.data()), static_cast<std::streamsize>(m_pixels.size())))
+    {
+        throw std::runtime_error("Raw frame recording ends in the middle of a frame");
+    }
+
+    auto timeStamp = FrameTime(ticks);
+    if (!m_firstFrame && timeStamp < m_lastTimeStamp)
+    {
+        throw std::runtime_error("Raw frame recording isn't in time stamp order");
+    }
+    m_firstFrame = false;
+    m_lastTimeStamp = timeStamp;
+
+    frame.Surface.Data = m_pixels.data();
+    frame.Surface.Width = m_width;
+    frame.Surface.Height = m_height;
+    frame.Surface.Stride = static_cast<size_t>(m_width) * 4;
+    frame.SystemRelativeTime = timeStamp;
+    return true;
+}
+
+RawFrameWriter::RawFrameWriter(std::filesystem::path const& path, uint32_t width, uint32_t height)
+{
+    m_file.open(path, std::ios::binary | std::ios::trunc);
+    if (!m_file.is_open())
+    {
+        throw std::runtime_error("Couldn't open " + path.string() + " for writing");
+    }
+    m_width = width;
+    m_height = height;
+    m_file.write(RawFrameFile::Signature, sizeof(RawFrameFile::Signature));
+    WriteValue(m_file, RawFrameFile::Version);
+    WriteValue(m_file, m_width);
+    WriteValue(m_file, m_height);
+}
+
+void RawFrameWriter::WriteFrame(SourceFrame const& frame)
+{
+    auto&& surface = frame.Surface;
+    if (surface.Width != m_width || surface.Height != m_height)
+    {
+        throw std::invalid_argument("Frame size doesn't match the recording");
+    }
+
+    WriteValue(m_file, static_cast<int64_t>(frame.SystemRelativeTime.count()));
+    auto rowBytes = static_cast<std::streamsize>(m_width) * 4;
+    for (uint32_t y = 0; y < m_height; y++)
+    {
+        m_file.write(reinterpret_cast<char const*>(surface.Row(y)), rowBytes);
+    }
+    if (!m_file.good())
+    {
+        throw std::runtime_error("Failed to write raw frame");
+    }
+}
+
+void RawFrameWriter::Close()
+{
+    m_file.close();
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include "FrameSource.h"
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+// A recording of raw frames on disk, for replaying captures without
+// Windows.Graphics.Capture. The layout is, all little endian:
+//
+//   "GSRAWBGR"                     8 byte signature
+//   uint32 version, width, height
+//   then for every frame:
+//     int64 SystemRelativeTime     100ns units
+//     width * height * 4 bytes     BGRA8, tightly packed rows
+//
+// Frames must be stored in time stamp order.
+namespace RawFrameFile
+{
+    constexpr char Signature[8] = { 'G', 'S', 'R', 'A', 'W', 'B', 'G', 'R' };
+    constexpr uint32_t Version = 1;
+}
+
+class RawFrameReader : public FrameSource
+{
+public:
+    RawFrameReader(std::filesystem::path const& path);
+
+    uint32_t Width() const { return m_width; }
+    uint32_t Height() const { return m_height; }
+
+    bool TryGetNextFrame(SourceFrame& frame) override;
+
+private:
+    std::ifstream m_file;
+    uint32_t m_width = 0;
+    uint32_t m_height = 0;
+    std::vector<uint8_t> m_pixels;
+    FrameTime m_lastTimeStamp = {};
+    bool m_firstFrame = true;
+};
+
+class RawFrameWriter
+{
+public:
+    RawFrameWriter(std::filesystem::path const& path, uint32_t width, uint32_t height);
+
+    // The frame must be the size given to the constructor.
+    void WriteFrame(SourceFrame const& frame);
+    void Close();
+
+private:
+    std::ofstream m_file;
+    uint32_t m_width = 0;
+    uint32_t m_height = 0;
+};
@@ -0,0 +1,98 @@
+#include "RecordingPalette.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+RecordingPalette::RecordingPalette(uint32_t width, uint32_t height, uint32_t maxColors)
+{
+    m_width = width;
+    m_height = height;
+    m_maxColors = std::min(std::max(maxColors, 2u), UniqueColorSet::MaxColors);
+    auto pixelCount = static_cast<size_t>(width) * height;
+    m_pixels.assign(pixelCount, 0);
+    m_shownSince.assign(pixelCount, -1);
+}
+
+void RecordingPalette::AddRegion(DiffRect const& rect, FrameBufferView const& pixels, int64_t time)
+{
+    if (rect.Right > m_width || rect.Bottom > m_height || rect.Left > rect.Right || rect.Top > rect.Bottom)
+    {
+        throw std::invalid_argument("Region must lie within the recording");
+    }
+    if (pixels.Width != rect.Right - rect.Left || pixels.Height != rect.Bottom - rect.Top)
+    {
+        throw std::invalid_argument("Region pixels don't match their rect");
+    }
+
+    if (m_isExact)
+    {
+        m_isExact = m_uniqueColors.AddPixels(pixels.Data, pixels.Stride, pixels.Width, pixels.Height, m_maxColors);
+    }
+
+    for (uint32_t y = 0; y < pixels.Height; y++)
+    {
+        auto source = pixels.Row(y);
+        auto offset = (static_cast<size_t>(rect.Top + y) * m_width) + rect.Left;
+        auto shown = m_pixels.data() + offset;
+        auto shownSince = m_shownSince.data() + offset;
+        for (uint32_t x = 0; x < pixels.Width; x++)
+        {
+            uint32_t pixel = 0;
+            memcpy(&pixel, source + (static_cast<size_t>(x) * 4), sizeof(pixel));
+            pixel &= 0x00FFFFFF;
+            auto since = shownSince[x];
+            // Pixels that stay the same keep counting from when they
+            // first showed up
+            if (since >= 0 && shown[x] == pixel)
+            {
+                continue;
+            }
+            if (since >= 0 && time > since)
+            {
+                m_histogram.AddColor(shown[x], static_cast<uint64_t>(time - since));
+            }
+            shown[x] = pixel;
+            shownSince[x] = time;
+        }
+    }
+}
+
+std::vector<GifColor> RecordingPalette::Build(int64_t endTime)
+{
+    // Whatever is still up counts until the end. Neighbors tend to have
+    // been drawn together, so runs are counted at once.
+    size_t i = 0;
+    while (i < m_pixels.size())
+    {
+        auto pixel = m_pixels[i];
+        auto since = m_shownSince[i];
+        auto runStart = i;
+        while (i < m_pixels.size() && m_pixels[i] == pixel && m_shownSince[i] == since)
+        {
+            i++;
+        }
+        if (since >= 0 && endTime > since)
+        {
+            m_histogram.AddColor(pixel, static_cast<uint64_t>(endTime - since) * (i - runStart));
+        }
+    }
+    std::fill(m_shownSince.begin(), m_shownSince.end(), -1);
+
+    std::vector<GifColor> palette;
+    if (m_uniqueColors.Count() == 0)
+    {
+        return palette;
+    }
+    if (m_isExact)
+    {
+        m_uniqueColors.Colors(palette);
+        return palette;
+    }
+
+    // Built once per recording, so it's worth the best quantizer
+    QuantizerOptions options = {};
+    options.Algorithm = QuantizerAlgorithm::KMeans;
+    options.MaxColors = m_maxColors;
+    ColorQuantizer quantizer(options);
+    return quantizer.BuildPalette(m_histogram);
+}
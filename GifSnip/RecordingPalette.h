@@ -0,0 +1,39 @@
+#pragma once
+#include "ColorQuantizer.h"
+#include "DiffRect.h"
+#include "FrameBufferPool.h"
+#include "GifWriter.h"
+#include "UniqueColorSet.h"
+#include <cstdint>
+#include <vector>
+
+// Builds one palette for a whole recording. Its regions are replayed
+// in order and every color counts for as many pixels as show it, for
+// as long as they do, so a background that's up the whole time
+// outweighs a dialog that flashes by. Recordings with few enough colors
+// get exactly those.
+class RecordingPalette
+{
+public:
+    RecordingPalette(uint32_t width, uint32_t height, uint32_t maxColors);
+
+    // Times are in 10ms units and can't go backwards. Rects use
+    // exclusive Right/Bottom.
+    void AddRegion(DiffRect const& rect, FrameBufferView const& pixels, int64_t time);
+    // Everything still up is shown until the end time
+    std::vector<GifColor> Build(int64_t endTime);
+
+    // Whether Build returned the recording's own colors
+    bool IsExact() const { return m_isExact; }
+
+private:
+    uint32_t m_width = 0;
+    uint32_t m_height = 0;
+    uint32_t m_maxColors = 0;
+    // What's up and since when, -1 for pixels nothing has covered yet
+    std::vector<uint32_t> m_pixels;
+    std::vector<int64_t> m_shownSince;
+    ColorHistogram m_histogram;
+    UniqueColorSet m_uniqueColors;
+    bool m_isExact = true;
+};
@@ -0,0 +1,133 @@
+#pragma once
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+
+// Architecture detection and the bits needed to dispatch to vector
+// code paths at runtime. Code for a specific instruction set is
+// marked with the matching GIFSNIP_TARGET_* attribute so that it can
+// live next to the generic code without any special compiler flags.
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define GIFSNIP_X64 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#elif defined(_M_ARM64) || defined(__aarch64__)
+#define GIFSNIP_ARM64 1
+#include <arm_neon.h>
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define GIFSNIP_TARGET_SSE41 __attribute__((target("sse4.1")))
+#define GIFSNIP_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define GIFSNIP_TARGET_SSE41
+#define GIFSNIP_TARGET_AVX2
+#endif
+
+inline uint32_t CountTrailingZeros(uint32_t value)
+{
+#if defined(_MSC_VER)
+    unsigned long index = 0;
+    _BitScanForward(&index, value);
+    return static_cast<uint32_t>(index);
+#else
+    return static_cast<uint32_t>(__builtin_ctz(value));
+#endif
+}
+
+inline uint32_t HighestSetBit(uint32_t value)
+{
+#if defined(_MSC_VER)
+    unsigned long index = 0;
+    _BitScanReverse(&index, value);
+    return static_cast<uint32_t>(index);
+#else
+    return 31u - static_cast<uint32_t>(__builtin_clz(value));
+#endif
+}
+
+inline uint32_t PopCount(uint32_t value)
+{
+#if defined(_MSC_VER)
+    value = value - ((value >> 1) & 0x55555555);
+    value = (value & 0x33333333) + ((value >> 2) & 0x33333333);
+    return (((value + (value >> 4)) & 0x0F0F0F0F) * 0x01010101) >> 24;
+#else
+    return static_cast<uint32_t>(__builtin_popcount(value));
+#endif
+}
+
+struct CpuFeatures
+{
+    bool Sse41 = false;
+    bool Avx2 = false;
+    bool Neon = false;
+
+    static CpuFeatures const& Current()
+    {
+        static const CpuFeatures features = Detect();
+        return features;
+    }
+
+private:
+    static CpuFeatures Detect()
+    {
+        CpuFeatures features = {};
+#if defined(GIFSNIP_X64)
+#if defined(_MSC_VER)
+        int info[4] = {};
+        __cpuid(info, 1);
+        features.Sse41 = (info[2] & (1 << 19)) != 0;
+        auto osxsave = (info[2] & (1 << 27)) != 0;
+        auto avx = (info[2] & (1 << 28)) != 0;
+        if (osxsave && avx && (_xgetbv(0) & 0x6) == 0x6)
+        {
+            __cpuidex(info, 7, 0);
+            features.Avx2 = (info[1] & (1 << 5)) != 0;
+        }
+#else
+        __builtin_cpu_init();
+        features.Sse41 = __builtin_cpu_supports("sse4.1");
+        features.Avx2 = __builtin_cpu_supports("avx2");
+#endif
+#elif defined(GIFSNIP_ARM64)
+        features.Neon = true;
+#endif
+        ApplyLimit(features);
+        return features;
+    }
+
+    // GIFSNIP_CPU=scalar or GIFSNIP_CPU=sse4.1 caps the vector paths
+    // that get picked, so the narrower ones can be tested on machines
+    // that have wider ones.
+    static void ApplyLimit(CpuFeatures& features)
+    {
+        std::string limit;
+#if defined(_MSC_VER)
+        char* value = nullptr;
+        size_t length = 0;
+        if (_dupenv_s(&value, &length, "GIFSNIP_CPU") == 0 && value != nullptr)
+        {
+            limit = value;
+            free(value);
+        }
+#else
+        auto value = std::getenv("GIFSNIP_CPU");
+        if (value != nullptr)
+        {
+            limit = value;
+        }
+#endif
+        if (limit == "scalar")
+        {
+            features = {};
+        }
+        else if (limit == "sse4.1")
+        {
+            features.Avx2 = false;
+        }
+    }
+};
@@ -0,0 +1,93 @@
+#include "SoftwareFrameReadback.h"
+#include <cstring>
+#include <stdexcept>
+
+SoftwareFrameReadback::SoftwareFrameReadback(
+    uint32_t width,
+    uint32_t height,
+    uint32_t slotCount,
+    uint32_t framesUntilReady)
+{
+    if (slotCount == 0)
+    {
+        throw std::invalid_argument("Readback needs at least one slot");
+    }
+    m_width = width;
+    m_height = height;
+    m_framesUntilReady = framesUntilReady;
+    m_slots.resize(slotCount);
+    for (auto&& slot : m_slots)
+    {
+        slot.Pixels.resize(static_cast<size_t>(width) * height * 4);
+    }
+}
+
+bool SoftwareFrameReadback::Map(uint32_t index, bool wait, ReadbackData& data)
+{
+    auto&& slot = GetSlot(index);
+    if (slot.State != SlotState::Filled)
+    {
+        throw std::logic_error("Only filled slots can be mapped");
+    }
+    if (m_fillCount - slot.FillIndex < m_framesUntilReady)
+    {
+        if (!wait)
+        {
+            return false;
+        }
+        m_waitCount++;
+    }
+
+    slot.State = SlotState::Mapped;
+    data.Pixels.Data = slot.Pixels.data();
+    data.Pixels.Width = m_width;
+    data.Pixels.Height = m_height;
+    data.Pixels.Stride = static_cast<size_t>(m_width) * 4;
+    data.Diff = slot.Diff;
+    data.TileWords = slot.TileWords.data();
+    data.TileWordCount = slot.TileWords.size();
+    return true;
+}
+
+void SoftwareFrameReadback::Unmap(uint32_t index)
+{
+    auto&& slot = GetSlot(index);
+    if (slot.State != SlotState::Mapped)
+    {
+        throw std::logic_error("Slot isn't mapped");
+    }
+    slot.State = SlotState::Empty;
+}
+
+void SoftwareFrameReadback::Fill(
+    uint32_t index,
+    uint8_t const* pixels,
+    size_t stride,
+    std::optional<DiffRect> const& diff,
+    DirtyTileMap const& dirtyTiles)
+{
+    auto&& slot = GetSlot(index);
+    if (slot.State != SlotState::Empty)
+    {
+        throw std::logic_error("Slot is still in use");
+    }
+
+    auto rowBytes = static_cast<size_t>(m_width) * 4;
+    for (uint32_t y = 0; y < m_height; y++)
+    {
+        memcpy(slot.Pixels.data() + (static_cast<size_t>(y) * rowBytes), pixels + (static_cast<size_t>(y) * stride), rowBytes);
+    }
+    slot.Diff = diff;
+    slot.TileWords = dirtyTiles.Words();
+    slot.State = SlotState::Filled;
+    slot.FillIndex = ++m_fillCount;
+}
+
+SoftwareFrameReadback::Slot& SoftwareFrameReadback::GetSlot(uint32_t index)
+{
+    if (index >= m_slots.size())
+    {
+        throw std::out_of_range("No such readback slot");
+    }
+    return m_slots[index];
+}
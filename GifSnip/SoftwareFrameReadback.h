@@ -0,0 +1,64 @@
+#pragma once
+#include "FrameReadback.h"
+#include "DirtyTileMap.h"
+#include <cstdint>
+#include <vector>
+
+// FrameReadback backed by plain memory. Filling a slot copies right
+// away, but the copy can be made to look like it's still in flight,
+// the way a GPU copy would be. Used to drive the readback path without
+// a GPU.
+class SoftwareFrameReadback : public FrameReadback
+{
+public:
+    // A slot only reports that it's ready once framesUntilReady more
+    // slots have been filled after it. Mapping it any earlier without
+    // waiting fails, and with waiting counts as a wait.
+    SoftwareFrameReadback(
+        uint32_t width,
+        uint32_t height,
+        uint32_t slotCount,
+        uint32_t framesUntilReady = 0);
+
+    uint32_t SlotCount() const override { return static_cast<uint32_t>(m_slots.size()); }
+    bool Map(uint32_t slot, bool wait, ReadbackData& data) override;
+    void Unmap(uint32_t slot) override;
+
+    // Copies a frame and its diff into a slot that isn't in use.
+    void Fill(
+        uint32_t slot,
+        uint8_t const* pixels,
+        size_t stride,
+        std::optional<DiffRect> const& diff,
+        DirtyTileMap const& dirtyTiles);
+
+    // Times Map had to wait for a slot that wasn't ready yet
+    uint64_t WaitCount() const { return m_waitCount; }
+
+private:
+    enum class SlotState
+    {
+        Empty,
+        Filled,
+        Mapped,
+    };
+
+    struct Slot
+    {
+        std::vector<uint8_t> Pixels;
+        std::optional<DiffRect> Diff;
+        std::vector<uint32_t> TileWords;
+        SlotState State = SlotState::Empty;
+        uint64_t FillIndex = 0;
+    };
+
+    Slot& GetSlot(uint32_t slot);
+
+private:
+    uint32_t m_width = 0;
+    uint32_t m_height = 0;
+    uint32_t m_framesUntilReady = 0;
+    std::vector<Slot> m_slots;
+    uint64_t m_fillCount = 0;
+    uint64_t m_waitCount = 0;
+};
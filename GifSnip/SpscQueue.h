@@ -0,0 +1,181 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <vector>
+
+// A bounded ring for handing items from exactly one producer thread to
+// exactly one consumer thread. Pushing and popping never take a lock;
+// the mutex is only touched when one side has gone to sleep waiting on
+// the other and needs to be woken up.
+//
+// The queue never blocks the producer on its own. When it's full,
+// TryPush fails and it's up to the producer to decide what to do with
+// the item, which can be to wait for room with WaitForRoom.
+template <typename T>
+class SpscQueue
+{
+public:
+    SpscQueue(size_t capacity)
+    {
+        if (capacity == 0)
+        {
+            throw std::invalid_argument("Capacity must be at least 1");
+        }
+        // One slot is left empty to tell a full ring from an empty one
+        m_slots.resize(capacity + 1);
+    }
+
+    SpscQueue(SpscQueue const&) = delete;
+    SpscQueue& operator=(SpscQueue const&) = delete;
+
+    size_t Capacity() const { return m_slots.size() - 1; }
+    // Either thread, but only a snapshot when called from the producer
+    // while the consumer is running (or vice versa)
+    size_t Size() const
+    {
+        auto head = m_head.load(std::memory_order_acquire);
+        auto tail = m_tail.load(std::memory_order_acquire);
+        return tail >= head ? tail - head : tail + m_slots.size() - head;
+    }
+
+    // Producer only
+    bool IsFull() const
+    {
+        auto tail = m_tail.load(std::memory_order_relaxed);
+        return Next(tail) == m_head.load(std::memory_order_acquire);
+    }
+
+    // Producer only. Returns false, leaving the item untouched, if the
+    // queue is full.
+    bool TryPush(T&& item)
+    {
+        auto tail = m_tail.load(std::memory_order_relaxed);
+        auto next = Next(tail);
+        auto head = m_head.load(std::memory_order_acquire);
+        if (next == head)
+        {
+            return false;
+        }
+        m_slots[tail] = std::move(item);
+        m_tail.store(next, std::memory_order_seq_cst);
+
+        auto size = next >= head ? next - head : next + m_slots.size() - head;
+        if (size > m_highWaterMark.load(std::memory_order_relaxed))
+        {
+            m_highWaterMark.store(size, std::memory_order_relaxed);
+        }
+
+        // Pairs with the consumer setting m_consumerWaiting before its
+        // final check for items.
+        if (m_consumerWaiting.load(std::memory_order_seq_cst))
+        {
+            std::lock_guard lock(m_waitLock);
+            m_itemAvailable.notify_one();
+        }
+        return true;
+    }
+
+    // Producer only. Sleeps until the consumer has made room for an item.
+    void WaitForRoom()
+    {
+        while (IsFull())
+        {
+            std::unique_lock lock(m_waitLock);
+            m_producerWaiting.store(true, std::memory_order_seq_cst);
+            // Pairs with the consumer publishing m_head before checking
+            // m_producerWaiting
+            auto tail = m_tail.load(std::memory_order_relaxed);
+            if (Next(tail) != m_head.load(std::memory_order_seq_cst))
+            {
+                m_producerWaiting.store(false, std::memory_order_relaxed);
+                return;
+            }
+            m_roomAvailable.wait(lock);
+            m_producerWaiting.store(false, std::memory_order_relaxed);
+        }
+    }
+
+    // Producer only. Once closed, Pop returns nothing after the remaining
+    // items have been drained.
+    void Close()
+    {
+        std::lock_guard lock(m_waitLock);
+        m_closed.store(true, std::memory_order_seq_cst);
+        m_itemAvailable.notify_one();
+    }
+
+    // Consumer only
+    std::optional<T> TryPop()
+    {
+        auto head = m_head.load(std::memory_order_relaxed);
+        if (head == m_tail.load(std::memory_order_seq_cst))
+        {
+            return std::nullopt;
+        }
+        std::optional<T> item(std::move(m_slots[head]));
+        m_slots[head] = T();
+        m_head.store(Next(head), std::memory_order_seq_cst);
+
+        if (m_producerWaiting.load(std::memory_order_seq_cst))
+        {
+            std::lock_guard lock(m_waitLock);
+            m_roomAvailable.notify_one();
+        }
+        return item;
+    }
+
+    // Consumer only. Waits for the next item, returning nothing once the
+    // queue has been closed and drained.
+    std::optional<T> Pop()
+    {
+        while (true)
+        {
+            if (auto item = TryPop())
+            {
+                return item;
+            }
+
+            std::unique_lock lock(m_waitLock);
+            m_consumerWaiting.store(true, std::memory_order_seq_cst);
+            if (auto item = TryPop())
+            {
+                m_consumerWaiting.store(false, std::memory_order_relaxed);
+                return item;
+            }
+            if (m_closed.load(std::memory_order_seq_cst))
+            {
+                m_consumerWaiting.store(false, std::memory_order_relaxed);
+                return std::nullopt;
+            }
+            m_itemAvailable.wait(lock);
+            m_consumerWaiting.store(false, std::memory_order_relaxed);
+        }
+    }
+
+    // The most items that were ever waiting in the queue at once
+    size_t HighWaterMark() const { return m_highWaterMark.load(std::memory_order_relaxed); }
+
+private:
+    size_t Next(size_t index) const
+    {
+        index++;
+        return index == m_slots.size() ? 0 : index;
+    }
+
+private:
+    std::vector<T> m_slots;
+    // Kept on separate cache lines so the two threads don't contend
+    alignas(64) std::atomic<size_t> m_head = 0;
+    alignas(64) std::atomic<size_t> m_tail = 0;
+    std::atomic<size_t> m_highWaterMark = 0;
+    std::atomic<bool> m_consumerWaiting = false;
+    std::atomic<bool> m_producerWaiting = false;
+    std::atomic<bool> m_closed = false;
+    std::mutex m_waitLock;
+    std::condition_variable m_itemAvailable;
+    std::condition_variable m_roomAvailable;
+};
@@ -0,0 +1,36 @@
+#include "pch.h"
+#include "StreamGifOutputStream.h"
+
+namespace winrt
+{
+    using namespace Windows::Storage::Streams;
+}
+
+StreamGifOutputStream::StreamGifOutputStream(winrt::IRandomAccessStream const& stream)
+{
+    m_stream = stream;
+    m_streamWriter = winrt::DataWriter(stream);
+}
+
+void StreamGifOutputStream::Write(uint8_t const* data, size_t size)
+{
+    if (size > 0)
+    {
+        m_streamWriter.WriteBytes(winrt::array_view<uint8_t const>(data, data + size));
+        m_streamWriter.StoreAsync().get();
+    }
+}
+
+void StreamGifOutputStream::WriteAt(uint64_t offset, uint8_t const* data, size_t size)
+{
+    auto position = m_stream.Position();
+    m_stream.Seek(offset);
+    Write(data, size);
+    m_stream.Seek(position);
+}
+
+void StreamGifOutputStream::Finish()
+{
+    m_streamWriter.FlushAsync().get();
+    m_streamWriter.DetachStream();
+}
@@ -0,0 +1,18 @@
+#pragma once
+#include "GifOutputStream.h"
+
+// Writes a GIF to a WinRT stream. The stream is left open for the
+// caller, and detached from once finished.
+class StreamGifOutputStream : public GifOutputStream
+{
+public:
+    StreamGifOutputStream(winrt::Windows::Storage::Streams::IRandomAccessStream const& stream);
+
+    void Write(uint8_t const* data, size_t size) override;
+    void WriteAt(uint64_t offset, uint8_t const* data, size_t size) override;
+    void Finish() override;
+
+private:
+    winrt::Windows::Storage::Streams::IRandomAccessStream m_stream{ nullptr };
+    winrt::Windows::Storage::Streams::DataWriter m_streamWriter{ nullptr };
+};
@@ -6,10 +6,46 @@ struct DiffRect
     uint bottom;
 };
 
+cbuffer DiffConstants : register(b0)
+{
+    uint tileSize;
+    uint tileColumns;
+    uint2 textureSize;
+    // See DiffTolerance.h
+    uint toleranceMode;
+    uint threshold;
+    uint minDirtyPixels;
+    // Set unless the tolerance is exact. Rects are then rounded out to
+    // whole tiles and TextureUpdate.hlsl carries them over.
+    uint tolerant;
+};
+
 RWStructuredBuffer<DiffRect> diffBuffer : register(u0);
+// One bit per tile, row-major with 32 tiles per element
+RWStructuredBuffer<uint> tileBuffer : register(u1);
+// How many pixels changed, only kept when tolerant
+RWStructuredBuffer<uint> changedCountBuffer : register(u2);
 Texture2D<unorm float4> currentTexture : register(t0);
 Texture2D<unorm float4> previousTexture : register(t1);
 
+static const uint ToleranceModeLuma = 2;
+// Must match LumaWeights in DiffTolerance.h
+static const int3 LumaWeights = int3(38, 75, 15);
+static const uint LumaScale = 128;
+
+bool HasChanged(float4 currentColor, float4 previousColor)
+{
+    int4 current = int4(round(currentColor * 255.0f));
+    int4 previous = int4(round(previousColor * 255.0f));
+    if (toleranceMode == ToleranceModeLuma)
+    {
+        int lumaDistance = abs(dot(current.rgb - previous.rgb, LumaWeights));
+        return uint(lumaDistance) > threshold * LumaScale;
+    }
+    uint4 distance = uint4(abs(current - previous));
+    return any(distance > threshold);
+}
+
 [numthreads(2, 2, 1)]
 void main(uint3 DTid : SV_DispatchThreadID)
 {
@@ -18,12 +54,29 @@ void main(uint3 DTid : SV_DispatchThreadID)
     float4 currentColor = currentTexture[position];
     float4 previousColor = previousTexture[position];
 
-    if ((currentColor.x != previousColor.x) || (currentColor.y != previousColor.y) || (currentColor.z != previousColor.z) || (currentColor.w != previousColor.w))
+    if (HasChanged(currentColor, previousColor))
     {
         uint value = 0;
-        InterlockedMin(diffBuffer[0].left, position.x, value);
-        InterlockedMin(diffBuffer[0].top, position.y, value);
-        InterlockedMax(diffBuffer[0].right, position.x, value);
-        InterlockedMax(diffBuffer[0].bottom, position.y, value);
+        uint2 tile = position / tileSize;
+        if (tolerant)
+        {
+            uint2 first = tile * tileSize;
+            uint2 last = min(first + tileSize, textureSize) - 1;
+            InterlockedMin(diffBuffer[0].left, first.x, value);
+            InterlockedMin(diffBuffer[0].top, first.y, value);
+            InterlockedMax(diffBuffer[0].right, last.x, value);
+            InterlockedMax(diffBuffer[0].bottom, last.y, value);
+            InterlockedAdd(changedCountBuffer[0], 1, value);
+        }
+        else
+        {
+            InterlockedMin(diffBuffer[0].left, position.x, value);
+            InterlockedMin(diffBuffer[0].top, position.y, value);
+            InterlockedMax(diffBuffer[0].right, position.x, value);
+            InterlockedMax(diffBuffer[0].bottom, position.y, value);
+        }
+
+        uint tileIndex = (tile.y * tileColumns) + tile.x;
+        InterlockedOr(tileBuffer[tileIndex / 32], 1u << (tileIndex % 32), value);
     }
 }
\ No newline at end of file
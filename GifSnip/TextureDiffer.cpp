@@ -1,53 +1,85 @@
 #include "pch.h"
 #include "TextureDiffer.h"
 #include "TextureDiffShader.h"
+#include "TextureHashShader.h"
+#include "TextureUpdateShader.h"
 
 namespace winrt
 {
     using namespace Windows::Graphics;
 }
 
-template <typename T>
-T ReadFromBuffer(
-    winrt::com_ptr<ID3D11DeviceContext> const& d3dContext,
-    winrt::com_ptr<ID3D11Buffer> const& stagingBuffer)
+struct DiffConstants
 {
-    D3D11_BUFFER_DESC desc = {};
-    stagingBuffer->GetDesc(&desc);
-
-    assert(sizeof(T) <= desc.ByteWidth);
-
-    D3D11_MAPPED_SUBRESOURCE mapped = {};
-    d3dContext->Map(stagingBuffer.get(), 0, D3D11_MAP_READ, 0, &mapped);
-
-    T result = {};
-    result = *reinterpret_cast<T*>(mapped.pData);
-
-    d3dContext->Unmap(stagingBuffer.get(), 0);
-
-    return result;
-}
+    uint32_t TileSize;
+    uint32_t TileColumns;
+    uint32_t TextureWidth;
+    uint32_t TextureHeight;
+    uint32_t ToleranceMode;
+    uint32_t Threshold;
+    uint32_t MinDirtyPixels;
+    uint32_t Tolerant;
+};
 
 TextureDiffer::TextureDiffer(
     winrt::com_ptr<ID3D11Device> const& d3dDevice, 
     winrt::com_ptr<ID3D11DeviceContext> const& d3dContext, 
-    winrt::SizeInt32 textureSize)
+    winrt::SizeInt32 textureSize,
+    uint32_t tileSize,
+    ChangeDetection detection,
+    DiffTolerance const& tolerance)
 {
     m_d3dDevice = d3dDevice;
     m_d3dContext = d3dContext;
     m_textureSize = textureSize;
+    m_detection = detection;
+    m_tolerant = m_detection == ChangeDetection::Exact && !tolerance.IsExact();
+    m_dirtyTiles = DirtyTileMap(static_cast<uint32_t>(textureSize.Width), static_cast<uint32_t>(textureSize.Height), tileSize);
+
+    if (m_detection == ChangeDetection::Exact)
+    {
+        D3D11_TEXTURE2D_DESC previousTextureDesc = {};
+        previousTextureDesc.Width = static_cast<uint32_t>(textureSize.Width);
+        previousTextureDesc.Height = static_cast<uint32_t>(textureSize.Height);
+        previousTextureDesc.MipLevels = 1;
+        previousTextureDesc.ArraySize = 1;
+        previousTextureDesc.Format = DXGI_FORMAT_B8G8R8A8_UNORM;
+        previousTextureDesc.SampleDesc.Count = 1;
+        previousTextureDesc.Usage = D3D11_USAGE_DEFAULT;
+        previousTextureDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_RENDER_TARGET;
+        if (m_tolerant)
+        {
+            // Written a tile at a time by TextureUpdate.hlsl rather than
+            // copied. Typed UAV stores to BGRA aren't guaranteed, RGBA
+            // works since both shaders only see the channels by name.
+            previousTextureDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+            previousTextureDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_UNORDERED_ACCESS;
+        }
+        winrt::check_hresult(d3dDevice->CreateTexture2D(&previousTextureDesc, nullptr, m_previousTexture.put()));
+        winrt::check_hresult(d3dDevice->CreateShaderResourceView(m_previousTexture.get(), nullptr, m_previousTextureSRV.put()));
+        if (m_tolerant)
+        {
+            winrt::check_hresult(d3dDevice->CreateUnorderedAccessView(m_previousTexture.get(), nullptr, m_previousTextureUAV.put()));
+        }
+    }
+    else
+    {
+        // 8 bytes per tile instead of a copy of the frame
+        auto hashCount = m_dirtyTiles.ColumnCount() * m_dirtyTiles.RowCount();
+        D3D11_BUFFER_DESC hashBufferDesc = {};
+        hashBufferDesc.ByteWidth = static_cast<uint32_t>(hashCount * sizeof(uint64_t));
+        hashBufferDesc.Usage = D3D11_USAGE_DEFAULT;
+        hashBufferDesc.BindFlags = D3D11_BIND_UNORDERED_ACCESS;
+        hashBufferDesc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+        hashBufferDesc.StructureByteStride = sizeof(uint64_t);
+        winrt::check_hresult(d3dDevice->CreateBuffer(&hashBufferDesc, nullptr, m_hashBuffer.put()));
 
-    D3D11_TEXTURE2D_DESC previousTextureDesc = {};
-    previousTextureDesc.Width = static_cast<uint32_t>(textureSize.Width);
-    previousTextureDesc.Height = static_cast<uint32_t>(textureSize.Height);
-    previousTextureDesc.MipLevels = 1;
-    previousTextureDesc.ArraySize = 1;
-    previousTextureDesc.Format = DXGI_FORMAT_B8G8R8A8_UNORM;
-    previousTextureDesc.SampleDesc.Count = 1;
-    previousTextureDesc.Usage = D3D11_USAGE_DEFAULT;
-    previousTextureDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_RENDER_TARGET;
-    winrt::check_hresult(d3dDevice->CreateTexture2D(&previousTextureDesc, nullptr, m_previousTexture.put()));
-    winrt::check_hresult(d3dDevice->CreateShaderResourceView(m_previousTexture.get(), nullptr, m_previousTextureSRV.put()));
+        D3D11_UNORDERED_ACCESS_VIEW_DESC uavHashes = {};
+        uavHashes.Format = DXGI_FORMAT_UNKNOWN;
+        uavHashes.ViewDimension = D3D11_UAV_DIMENSION_BUFFER;
+        uavHashes.Buffer.NumElements = hashCount;
+        winrt::check_hresult(d3dDevice->CreateUnorderedAccessView(m_hashBuffer.get(), &uavHashes, m_hashBufferUAV.put()));
+    }
 
     auto diffBufferSize = static_cast<uint32_t>(sizeof(DiffRect));
 
@@ -72,11 +104,11 @@ TextureDiffer::TextureDiffer(
     initData.pSysMem = reinterpret_cast<void*>(&initialRect);
     winrt::check_hresult(d3dDevice->CreateBuffer(&diffDefaultBufferDesc, &initData, m_diffDefaultBuffer.put()));
 
-    D3D11_BUFFER_DESC diffStagingBufferDesc = {};
-    diffStagingBufferDesc.ByteWidth = diffBufferSize;
-    diffStagingBufferDesc.Usage = D3D11_USAGE_STAGING;
-    diffStagingBufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
-    winrt::check_hresult(d3dDevice->CreateBuffer(&diffStagingBufferDesc, nullptr, m_diffStagingBuffer.put()));
+    // What the first frame reports, since there's nothing to compare it to
+    DiffRect fullFrameRect = { 0, 0, static_cast<uint32_t>(textureSize.Width), static_cast<uint32_t>(textureSize.Height) };
+    D3D11_SUBRESOURCE_DATA fullFrameInitData = {};
+    fullFrameInitData.pSysMem = reinterpret_cast<void*>(&fullFrameRect);
+    winrt::check_hresult(d3dDevice->CreateBuffer(&diffDefaultBufferDesc, &fullFrameInitData, m_diffFullFrameBuffer.put()));
 
     D3D11_UNORDERED_ACCESS_VIEW_DESC uavDiff = {};
     uavDiff.Format = DXGI_FORMAT_UNKNOWN;
@@ -84,41 +116,193 @@ TextureDiffer::TextureDiffer(
     uavDiff.Buffer.NumElements = 1;
     winrt::check_hresult(d3dDevice->CreateUnorderedAccessView(m_diffBuffer.get(), &uavDiff, m_diffBufferUAV.put()));
 
-    winrt::check_hresult(d3dDevice->CreateComputeShader(g_main, ARRAYSIZE(g_main), nullptr, m_diffShader.put()));
+    // Tile buffers, one bit per tile
+    auto tileWordCount = static_cast<uint32_t>(m_dirtyTiles.Words().size());
+    auto tileBufferSize = static_cast<uint32_t>(tileWordCount * sizeof(uint32_t));
+
+    D3D11_BUFFER_DESC tileBufferDesc = {};
+    tileBufferDesc.ByteWidth = tileBufferSize;
+    tileBufferDesc.Usage = D3D11_USAGE_DEFAULT;
+    tileBufferDesc.BindFlags = D3D11_BIND_UNORDERED_ACCESS;
+    tileBufferDesc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+    tileBufferDesc.StructureByteStride = sizeof(uint32_t);
+    winrt::check_hresult(d3dDevice->CreateBuffer(&tileBufferDesc, nullptr, m_tileBuffer.put()));
+
+    D3D11_BUFFER_DESC tileDefaultBufferDesc = {};
+    tileDefaultBufferDesc.ByteWidth = tileBufferSize;
+    tileDefaultBufferDesc.Usage = D3D11_USAGE_DEFAULT;
+    tileDefaultBufferDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+    std::vector<uint32_t> initialTiles(tileWordCount, 0);
+    D3D11_SUBRESOURCE_DATA tileInitData = {};
+    tileInitData.pSysMem = reinterpret_cast<void*>(initialTiles.data());
+    winrt::check_hresult(d3dDevice->CreateBuffer(&tileDefaultBufferDesc, &tileInitData, m_tileDefaultBuffer.put()));
 
-    std::array<ID3D11UnorderedAccessView*, 1> uavs = { m_diffBufferUAV.get() };
+    m_dirtyTiles.MarkAll();
+    D3D11_SUBRESOURCE_DATA tileFullFrameInitData = {};
+    tileFullFrameInitData.pSysMem = reinterpret_cast<void*>(m_dirtyTiles.Words().data());
+    winrt::check_hresult(d3dDevice->CreateBuffer(&tileDefaultBufferDesc, &tileFullFrameInitData, m_tileFullFrameBuffer.put()));
+
+    D3D11_UNORDERED_ACCESS_VIEW_DESC uavTiles = {};
+    uavTiles.Format = DXGI_FORMAT_UNKNOWN;
+    uavTiles.ViewDimension = D3D11_UAV_DIMENSION_BUFFER;
+    uavTiles.Buffer.NumElements = tileWordCount;
+    winrt::check_hresult(d3dDevice->CreateUnorderedAccessView(m_tileBuffer.get(), &uavTiles, m_tileBufferUAV.put()));
+
+    if (m_tolerant)
+    {
+        D3D11_BUFFER_DESC countBufferDesc = {};
+        countBufferDesc.ByteWidth = sizeof(uint32_t);
+        countBufferDesc.Usage = D3D11_USAGE_DEFAULT;
+        countBufferDesc.BindFlags = D3D11_BIND_UNORDERED_ACCESS;
+        countBufferDesc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+        countBufferDesc.StructureByteStride = sizeof(uint32_t);
+        winrt::check_hresult(d3dDevice->CreateBuffer(&countBufferDesc, nullptr, m_changedCountBuffer.put()));
+
+        D3D11_BUFFER_DESC countDefaultBufferDesc = {};
+        countDefaultBufferDesc.ByteWidth = sizeof(uint32_t);
+        countDefaultBufferDesc.Usage = D3D11_USAGE_DEFAULT;
+        countDefaultBufferDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+        uint32_t initialCount = 0;
+        D3D11_SUBRESOURCE_DATA countInitData = {};
+        countInitData.pSysMem = reinterpret_cast<void*>(&initialCount);
+        winrt::check_hresult(d3dDevice->CreateBuffer(&countDefaultBufferDesc, &countInitData, m_changedCountDefaultBuffer.put()));
+
+        // The first frame always passes the minimum
+        uint32_t fullFrameCount = UINT32_MAX;
+        D3D11_SUBRESOURCE_DATA countFullFrameInitData = {};
+        countFullFrameInitData.pSysMem = reinterpret_cast<void*>(&fullFrameCount);
+        winrt::check_hresult(d3dDevice->CreateBuffer(&countDefaultBufferDesc, &countFullFrameInitData, m_changedCountFullFrameBuffer.put()));
+
+        D3D11_UNORDERED_ACCESS_VIEW_DESC uavCount = {};
+        uavCount.Format = DXGI_FORMAT_UNKNOWN;
+        uavCount.ViewDimension = D3D11_UAV_DIMENSION_BUFFER;
+        uavCount.Buffer.NumElements = 1;
+        winrt::check_hresult(d3dDevice->CreateUnorderedAccessView(m_changedCountBuffer.get(), &uavCount, m_changedCountUAV.put()));
+
+        winrt::check_hresult(d3dDevice->CreateComputeShader(g_textureUpdate, ARRAYSIZE(g_textureUpdate), nullptr, m_updateShader.put()));
+    }
+
+    DiffConstants constants = {};
+    constants.TileSize = m_dirtyTiles.TileSize();
+    constants.TileColumns = m_dirtyTiles.ColumnCount();
+    constants.TextureWidth = static_cast<uint32_t>(textureSize.Width);
+    constants.TextureHeight = static_cast<uint32_t>(textureSize.Height);
+    constants.ToleranceMode = static_cast<uint32_t>(tolerance.Mode);
+    constants.Threshold = tolerance.Mode == ToleranceMode::Exact ? 0 : tolerance.Threshold;
+    constants.MinDirtyPixels = tolerance.MinDirtyPixels;
+    constants.Tolerant = m_tolerant ? 1 : 0;
+    D3D11_BUFFER_DESC constantBufferDesc = {};
+    constantBufferDesc.ByteWidth = sizeof(DiffConstants);
+    constantBufferDesc.Usage = D3D11_USAGE_IMMUTABLE;
+    constantBufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+    D3D11_SUBRESOURCE_DATA constantInitData = {};
+    constantInitData.pSysMem = reinterpret_cast<void*>(&constants);
+    winrt::check_hresult(d3dDevice->CreateBuffer(&constantBufferDesc, &constantInitData, m_diffConstantBuffer.put()));
+
+    if (m_detection == ChangeDetection::Exact)
+    {
+        winrt::check_hresult(d3dDevice->CreateComputeShader(g_main, ARRAYSIZE(g_main), nullptr, m_diffShader.put()));
+    }
+    else
+    {
+        winrt::check_hresult(d3dDevice->CreateComputeShader(g_textureHash, ARRAYSIZE(g_textureHash), nullptr, m_diffShader.put()));
+    }
+
+    // At most one of the hash and count buffers is used, the other is null
+    auto thirdUAV = m_hashBufferUAV ? m_hashBufferUAV.get() : m_changedCountUAV.get();
+    std::array<ID3D11UnorderedAccessView*, 3> uavs = { m_diffBufferUAV.get(), m_tileBufferUAV.get(), thirdUAV };
+    std::array<ID3D11Buffer*, 1> constantBuffers = { m_diffConstantBuffer.get() };
     d3dContext->CSSetShader(m_diffShader.get(), nullptr, 0);
-    d3dContext->CSSetUnorderedAccessViews(0, 1, uavs.data(), nullptr);
+    d3dContext->CSSetUnorderedAccessViews(0, static_cast<uint32_t>(uavs.size()), uavs.data(), nullptr);
+    d3dContext->CSSetConstantBuffers(0, static_cast<uint32_t>(constantBuffers.size()), constantBuffers.data());
 }
 
-std::optional<DiffRect> TextureDiffer::ProcessFrame(winrt::com_ptr<ID3D11Texture2D> const& frameTexture)
+void TextureDiffer::ProcessFrame(winrt::com_ptr<ID3D11Texture2D> const& frameTexture)
 {
+    if (m_detection == ChangeDetection::TileHash)
+    {
+        ProcessFrameHashes(frameTexture);
+        return;
+    }
+    if (m_tolerant)
+    {
+        ProcessFrameWithTolerance(frameTexture);
+        return;
+    }
+
     if (m_firstFrame)
     {
         m_firstFrame = false;
+        m_d3dContext->CopyResource(m_diffBuffer.get(), m_diffFullFrameBuffer.get());
+        m_d3dContext->CopyResource(m_tileBuffer.get(), m_tileFullFrameBuffer.get());
         m_d3dContext->CopyResource(m_previousTexture.get(), frameTexture.get());
-        return std::optional<DiffRect>(DiffRect{ 0, 0, static_cast<uint32_t>(m_textureSize.Width), static_cast<uint32_t>(m_textureSize.Height) });
+        return;
     }
     
     winrt::com_ptr<ID3D11ShaderResourceView> frameTextureSRV;
     winrt::check_hresult(m_d3dDevice->CreateShaderResourceView(frameTexture.get(), nullptr, frameTextureSRV.put()));
 
     m_d3dContext->CopyResource(m_diffBuffer.get(), m_diffDefaultBuffer.get());
+    m_d3dContext->CopyResource(m_tileBuffer.get(), m_tileDefaultBuffer.get());
     std::array<ID3D11ShaderResourceView*, 2> srvs = { frameTextureSRV.get(), m_previousTextureSRV.get() };
     m_d3dContext->CSSetShaderResources(0, 2, srvs.data());
     m_d3dContext->Dispatch(static_cast<uint32_t>(m_textureSize.Width) / 2, static_cast<uint32_t>(m_textureSize.Height) / 2, 1);
 
-    m_d3dContext->CopyResource(m_diffStagingBuffer.get(), m_diffBuffer.get());
     m_d3dContext->CopyResource(m_previousTexture.get(), frameTexture.get());
+}
 
-    auto diffRect = ReadFromBuffer<DiffRect>(m_d3dContext, m_diffStagingBuffer);
+void TextureDiffer::ProcessFrameHashes(winrt::com_ptr<ID3D11Texture2D> const& frameTexture)
+{
+    winrt::com_ptr<ID3D11ShaderResourceView> frameTextureSRV;
+    winrt::check_hresult(m_d3dDevice->CreateShaderResourceView(frameTexture.get(), nullptr, frameTextureSRV.put()));
 
-    if (diffRect.IsValid())
+    // The first frame still needs hashing, its results just get replaced
+    m_d3dContext->CopyResource(m_diffBuffer.get(), m_diffDefaultBuffer.get());
+    m_d3dContext->CopyResource(m_tileBuffer.get(), m_tileDefaultBuffer.get());
+    std::array<ID3D11ShaderResourceView*, 1> srvs = { frameTextureSRV.get() };
+    m_d3dContext->CSSetShaderResources(0, 1, srvs.data());
+    m_d3dContext->Dispatch(m_dirtyTiles.ColumnCount(), m_dirtyTiles.RowCount(), 1);
+
+    if (m_firstFrame)
     {
-        return std::optional(diffRect);
+        m_firstFrame = false;
+        m_d3dContext->CopyResource(m_diffBuffer.get(), m_diffFullFrameBuffer.get());
+        m_d3dContext->CopyResource(m_tileBuffer.get(), m_tileFullFrameBuffer.get());
+    }
+}
+
+void TextureDiffer::ProcessFrameWithTolerance(winrt::com_ptr<ID3D11Texture2D> const& frameTexture)
+{
+    winrt::com_ptr<ID3D11ShaderResourceView> frameTextureSRV;
+    winrt::check_hresult(m_d3dDevice->CreateShaderResourceView(frameTexture.get(), nullptr, frameTextureSRV.put()));
+
+    // The first frame skips the comparison and carries over every tile
+    if (m_firstFrame)
+    {
+        m_firstFrame = false;
+        m_d3dContext->CopyResource(m_diffBuffer.get(), m_diffFullFrameBuffer.get());
+        m_d3dContext->CopyResource(m_tileBuffer.get(), m_tileFullFrameBuffer.get());
+        m_d3dContext->CopyResource(m_changedCountBuffer.get(), m_changedCountFullFrameBuffer.get());
     }
     else
     {
-        return std::nullopt;
+        m_d3dContext->CopyResource(m_diffBuffer.get(), m_diffDefaultBuffer.get());
+        m_d3dContext->CopyResource(m_tileBuffer.get(), m_tileDefaultBuffer.get());
+        m_d3dContext->CopyResource(m_changedCountBuffer.get(), m_changedCountDefaultBuffer.get());
+
+        // The previous frame can't be bound for reading and writing at once
+        std::array<ID3D11UnorderedAccessView*, 1> noUAVs = { nullptr };
+        m_d3dContext->CSSetUnorderedAccessViews(3, 1, noUAVs.data(), nullptr);
+        std::array<ID3D11ShaderResourceView*, 2> srvs = { frameTextureSRV.get(), m_previousTextureSRV.get() };
+        m_d3dContext->CSSetShaderResources(0, 2, srvs.data());
+        m_d3dContext->CSSetShader(m_diffShader.get(), nullptr, 0);
+        m_d3dContext->Dispatch(static_cast<uint32_t>(m_textureSize.Width) / 2, static_cast<uint32_t>(m_textureSize.Height) / 2, 1);
     }
+
+    std::array<ID3D11ShaderResourceView*, 2> updateSrvs = { frameTextureSRV.get(), nullptr };
+    m_d3dContext->CSSetShaderResources(0, 2, updateSrvs.data());
+    std::array<ID3D11UnorderedAccessView*, 1> updateUAVs = { m_previousTextureUAV.get() };
+    m_d3dContext->CSSetUnorderedAccessViews(3, 1, updateUAVs.data(), nullptr);
+    m_d3dContext->CSSetShader(m_updateShader.get(), nullptr, 0);
+    m_d3dContext->Dispatch((static_cast<uint32_t>(m_textureSize.Width) + 7) / 8, (static_cast<uint32_t>(m_textureSize.Height) + 7) / 8, 1);
 }
@@ -1,27 +1,8 @@
 #pragma once
-
-struct DiffRect
-{
-    uint32_t Left;
-    uint32_t Top;
-    uint32_t Right;
-    uint32_t Bottom;
-
-    uint32_t Width()
-    {
-        return Right - Left;
-    }
-
-    uint32_t Height()
-    {
-        return Bottom - Top;
-    }
-
-    bool IsValid()
-    {
-        return Right >= Left && Bottom >= Top;
-    }
-};
+#include "DiffRect.h"
+#include "DirtyTileMap.h"
+#include "DiffTolerance.h"
+#include "TileHash.h"
 
 class TextureDiffer
 {
@@ -29,9 +10,29 @@ public:
     TextureDiffer(
         winrt::com_ptr<ID3D11Device> const& d3dDevice,
         winrt::com_ptr<ID3D11DeviceContext> const& d3dContext,
-        winrt::Windows::Graphics::SizeInt32 textureSize);
+        winrt::Windows::Graphics::SizeInt32 textureSize,
+        uint32_t tileSize = DirtyTileMap::DefaultTileSize,
+        ChangeDetection detection = ChangeDetection::Exact,
+        DiffTolerance const& tolerance = {});
+
+    // Queues the comparison against the previous frame, or with
+    // ChangeDetection::TileHash, against its tile hashes. The results
+    // land in DiffBuffer() and TileBuffer() on the GPU, and stay there
+    // until the next call, so they can be read back whenever it suits
+    // the caller. For the first frame the whole frame is marked as
+    // changed. A tolerance only applies to ChangeDetection::Exact, and
+    // works like it does in CpuTextureDiffer.
+    void ProcessFrame(winrt::com_ptr<ID3D11Texture2D> const& frameTexture);
 
-    std::optional<DiffRect> ProcessFrame(winrt::com_ptr<ID3D11Texture2D> const& frameTexture);
+    // A single DiffRect, invalid (Left > Right) when nothing changed
+    winrt::com_ptr<ID3D11Buffer> const& DiffBuffer() const { return m_diffBuffer; }
+    // One bit per tile, laid out like DirtyTileMap
+    winrt::com_ptr<ID3D11Buffer> const& TileBuffer() const { return m_tileBuffer; }
+    uint32_t TileWordCount() const { return static_cast<uint32_t>(m_dirtyTiles.Words().size()); }
+
+private:
+    void ProcessFrameHashes(winrt::com_ptr<ID3D11Texture2D> const& frameTexture);
+    void ProcessFrameWithTolerance(winrt::com_ptr<ID3D11Texture2D> const& frameTexture);
 
 private:
     winrt::com_ptr<ID3D11Device> m_d3dDevice;
@@ -40,9 +41,28 @@ private:
     winrt::com_ptr<ID3D11Buffer> m_diffBuffer;
     winrt::com_ptr<ID3D11UnorderedAccessView> m_diffBufferUAV;
     winrt::com_ptr<ID3D11Buffer> m_diffDefaultBuffer;
-    winrt::com_ptr<ID3D11Buffer> m_diffStagingBuffer;
+    winrt::com_ptr<ID3D11Buffer> m_diffFullFrameBuffer;
+    winrt::com_ptr<ID3D11Buffer> m_diffConstantBuffer;
+    winrt::com_ptr<ID3D11Buffer> m_tileBuffer;
+    winrt::com_ptr<ID3D11UnorderedAccessView> m_tileBufferUAV;
+    winrt::com_ptr<ID3D11Buffer> m_tileDefaultBuffer;
+    winrt::com_ptr<ID3D11Buffer> m_tileFullFrameBuffer;
+    DirtyTileMap m_dirtyTiles;
+    // Exact
     winrt::com_ptr<ID3D11Texture2D> m_previousTexture;
     winrt::com_ptr<ID3D11ShaderResourceView> m_previousTextureSRV;
+    // Exact with a tolerance
+    winrt::com_ptr<ID3D11UnorderedAccessView> m_previousTextureUAV;
+    winrt::com_ptr<ID3D11ComputeShader> m_updateShader;
+    winrt::com_ptr<ID3D11Buffer> m_changedCountBuffer;
+    winrt::com_ptr<ID3D11UnorderedAccessView> m_changedCountUAV;
+    winrt::com_ptr<ID3D11Buffer> m_changedCountDefaultBuffer;
+    winrt::com_ptr<ID3D11Buffer> m_changedCountFullFrameBuffer;
+    bool m_tolerant = false;
+    // TileHash
+    winrt::com_ptr<ID3D11Buffer> m_hashBuffer;
+    winrt::com_ptr<ID3D11UnorderedAccessView> m_hashBufferUAV;
+    ChangeDetection m_detection = ChangeDetection::Exact;
     bool m_firstFrame = true;
     winrt::Windows::Graphics::SizeInt32 m_textureSize = {};
 };
\ No newline at end of file
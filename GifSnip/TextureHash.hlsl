@@ -0,0 +1,96 @@
+struct DiffRect
+{
+    uint left;
+    uint top;
+    uint right;
+    uint bottom;
+};
+
+cbuffer DiffConstants : register(b0)
+{
+    uint tileSize;
+    uint tileColumns;
+    uint2 textureSize;
+};
+
+RWStructuredBuffer<DiffRect> diffBuffer : register(u0);
+// One bit per tile, row-major with 32 tiles per element
+RWStructuredBuffer<uint> tileBuffer : register(u1);
+// The previous frame's hash for each tile, replaced as we go
+RWStructuredBuffer<uint2> hashBuffer : register(u2);
+Texture2D<unorm float4> currentTexture : register(t0);
+
+// Must match TileHash.cpp
+static const uint SeedStepA = 0x9E3779B1;
+static const uint SeedStepB = 0x85EBCA77;
+static const uint SeedOffsetB = 0xC2B2AE3D;
+
+groupshared uint laneA;
+groupshared uint laneB;
+
+uint Mix(uint value)
+{
+    value ^= value >> 16;
+    value *= 0x85EBCA6B;
+    value ^= value >> 13;
+    value *= 0xC2B2AE35;
+    value ^= value >> 16;
+    return value;
+}
+
+// One group per tile. Each thread sums a strided share of the tile's
+// pixels, and the group adds the shares up.
+[numthreads(16, 16, 1)]
+void main(uint3 Gid : SV_GroupID, uint3 GTid : SV_GroupThreadID, uint GI : SV_GroupIndex)
+{
+    if (GI == 0)
+    {
+        laneA = 0;
+        laneB = 0;
+    }
+    GroupMemoryBarrierWithGroupSync();
+
+    uint2 origin = Gid.xy * tileSize;
+    uint sumA = 0;
+    uint sumB = 0;
+    for (uint y = GTid.y; y < tileSize; y += 16)
+    {
+        for (uint x = GTid.x; x < tileSize; x += 16)
+        {
+            uint2 position = origin + uint2(x, y);
+            if (position.x < textureSize.x && position.y < textureSize.y)
+            {
+                // Rebuild the pixel as it sits in memory (BGRA)
+                uint4 color = uint4(round(currentTexture[position] * 255.0f));
+                uint pixel = color.b | (color.g << 8) | (color.r << 16) | (color.a << 24);
+                uint index = (y * tileSize) + x;
+                sumA += Mix(pixel ^ (index * SeedStepA));
+                sumB += Mix(pixel ^ ((index * SeedStepB) + SeedOffsetB));
+            }
+        }
+    }
+
+    uint value = 0;
+    InterlockedAdd(laneA, sumA, value);
+    InterlockedAdd(laneB, sumB, value);
+    GroupMemoryBarrierWithGroupSync();
+
+    if (GI == 0)
+    {
+        uint tileIndex = (Gid.y * tileColumns) + Gid.x;
+        uint2 hash = uint2(laneA, laneB);
+        uint2 previousHash = hashBuffer[tileIndex];
+        if (hash.x != previousHash.x || hash.y != previousHash.y)
+        {
+            hashBuffer[tileIndex] = hash;
+
+            uint2 last = min(origin + tileSize, textureSize) - 1;
+            InterlockedMin(diffBuffer[0].left, origin.x, value);
+            InterlockedMin(diffBuffer[0].top, origin.y, value);
+            InterlockedMax(diffBuffer[0].right, last.x, value);
+            InterlockedMax(diffBuffer[0].bottom, last.y, value);
+
+            InterlockedOr(tileBuffer[tileIndex / 32], 1u << (tileIndex % 32), value);
+        }
+    }
+}
@@ -0,0 +1,68 @@
+struct DiffRect
+{
+    uint left;
+    uint top;
+    uint right;
+    uint bottom;
+};
+
+cbuffer DiffConstants : register(b0)
+{
+    uint tileSize;
+    uint tileColumns;
+    uint2 textureSize;
+    uint toleranceMode;
+    uint threshold;
+    uint minDirtyPixels;
+    uint tolerant;
+};
+
+RWStructuredBuffer<DiffRect> diffBuffer : register(u0);
+// One bit per tile, row-major with 32 tiles per element
+RWStructuredBuffer<uint> tileBuffer : register(u1);
+RWStructuredBuffer<uint> changedCountBuffer : register(u2);
+RWTexture2D<unorm float4> previousTexture : register(u3);
+Texture2D<unorm float4> currentTexture : register(t0);
+
+// Runs after TextureDiff.hlsl when it's tolerant. Only the tiles it
+// reported are carried over into the previous frame, so changes below
+// the tolerance keep building up against the pixels we last reported.
+[numthreads(8, 8, 1)]
+void main(uint3 DTid : SV_DispatchThreadID)
+{
+    uint2 position = DTid.xy;
+    if (position.x >= textureSize.x || position.y >= textureSize.y)
+    {
+        return;
+    }
+
+    uint2 tile = position / tileSize;
+    uint tileIndex = (tile.y * tileColumns) + tile.x;
+    uint tileBit = 1u << (tileIndex % 32);
+    uint value = 0;
+
+    // Too little changed to be worth a frame, so report nothing. Every
+    // thread bails out here, so nobody looks at the tiles being cleared.
+    if (changedCountBuffer[0] < minDirtyPixels)
+    {
+        if (all((position % tileSize) == 0))
+        {
+            InterlockedAnd(tileBuffer[tileIndex / 32], ~tileBit, value);
+        }
+        if (position.x == 0 && position.y == 0)
+        {
+            DiffRect emptyRect;
+            emptyRect.left = textureSize.x;
+            emptyRect.top = textureSize.y;
+            emptyRect.right = 0;
+            emptyRect.bottom = 0;
+            diffBuffer[0] = emptyRect;
+        }
+        return;
+    }
+
+    if ((tileBuffer[tileIndex / 32] & tileBit) != 0)
+    {
+        previousTexture[position] = currentTexture[position];
+    }
+}
@@ -0,0 +1,199 @@
+#include "ThreadPool.h"
+#include "Trace.h"
+#include <algorithm>
+#include <atomic>
+#include <exception>
+
+struct ThreadPool::ParallelForState
+{
+    // Only called while the caller is still waiting, so it's never
+    // dangling.
+    std::function<void(size_t)> const* Function = nullptr;
+    size_t Count = 0;
+    std::atomic<size_t> NextIndex = 0;
+    std::atomic<size_t> Completed = 0;
+    // The caller and every helper hold a reference
+    std::atomic<size_t> References = 0;
+    std::atomic<bool> Failed = false;
+    std::exception_ptr Error;
+    std::mutex Lock;
+    std::condition_variable Done;
+};
+
+ThreadPool::ThreadPool(uint32_t threadCount)
+{
+    if (threadCount == 0)
+    {
+        threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+
+    m_threads.reserve(threadCount);
+    for (uint32_t i = 0; i < threadCount; i++)
+    {
+        m_threads.emplace_back([this]() { WorkerLoop(); });
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_stopping = true;
+    }
+    m_taskAvailable.notify_all();
+    for (auto&& thread : m_threads)
+    {
+        thread.join();
+    }
+}
+
+void ThreadPool::Submit(std::function<void()> task)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        if (m_taskCount == m_tasks.size())
+        {
+            // Unroll the ring into a bigger one
+            std::vector<std::function<void()>> tasks(std::max<size_t>(m_tasks.size() * 2, 16));
+            for (size_t i = 0; i < m_taskCount; i++)
+            {
+                tasks[i] = std::move(m_tasks[(m_firstTask + i) % m_tasks.size()]);
+            }
+            m_tasks.swap(tasks);
+            m_firstTask = 0;
+            m_allocationCount++;
+        }
+        m_tasks[(m_firstTask + m_taskCount) % m_tasks.size()] = std::move(task);
+        m_taskCount++;
+    }
+    m_taskAvailable.notify_one();
+}
+
+void ThreadPool::ParallelFor(size_t count, std::function<void(size_t)> const& function)
+{
+    if (count == 0)
+    {
+        return;
+    }
+    if (count == 1 || m_threads.empty())
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            function(i);
+        }
+        return;
+    }
+
+    auto helperCount = std::min(count - 1, m_threads.size());
+    auto state = AcquireParallelForState();
+    state->Function = &function;
+    state->Count = count;
+    state->References = helperCount + 1;
+
+    for (size_t i = 0; i < helperCount; i++)
+    {
+        Submit([this, state]()
+            {
+                RunParallelFor(state);
+                ReleaseParallelForState(state);
+            });
+    }
+    RunParallelFor(state);
+
+    std::exception_ptr error;
+    {
+        std::unique_lock<std::mutex> lock(state->Lock);
+        state->Done.wait(lock, [&]() { return state->Completed.load() == state->Count; });
+        error = std::move(state->Error);
+        state->Error = nullptr;
+    }
+    ReleaseParallelForState(state);
+    if (error)
+    {
+        std::rethrow_exception(error);
+    }
+}
+
+void ThreadPool::RunParallelFor(ParallelForState* state)
+{
+    size_t index = 0;
+    while ((index = state->NextIndex.fetch_add(1)) < state->Count)
+    {
+        // Once a call has thrown, the rest only count as done
+        if (!state->Failed.load())
+        {
+            try
+            {
+                (*state->Function)(index);
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(state->Lock);
+                if (!state->Failed.exchange(true))
+                {
+                    state->Error = std::current_exception();
+                }
+            }
+        }
+        if (state->Completed.fetch_add(1) + 1 == state->Count)
+        {
+            std::lock_guard<std::mutex> lock(state->Lock);
+            state->Done.notify_all();
+        }
+    }
+}
+
+uint64_t ThreadPool::AllocationCount() const
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+    return m_allocationCount;
+}
+
+ThreadPool::ParallelForState* ThreadPool::AcquireParallelForState()
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+    if (m_freeParallelForStates.empty())
+    {
+        m_parallelForStates.push_back(std::make_unique<ParallelForState>());
+        m_freeParallelForStates.reserve(m_parallelForStates.size());
+        m_allocationCount++;
+        return m_parallelForStates.back().get();
+    }
+    auto state = m_freeParallelForStates.back();
+    m_freeParallelForStates.pop_back();
+    state->NextIndex = 0;
+    state->Completed = 0;
+    state->Failed = false;
+    return state;
+}
+
+void ThreadPool::ReleaseParallelForState(ParallelForState* state)
+{
+    if (state->References.fetch_sub(1) == 1)
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_freeParallelForStates.push_back(state);
+    }
+}
+
+void ThreadPool::WorkerLoop()
+{
+    Trace::SetThreadName("ThreadPool");
+    while (true)
+    {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(m_lock);
+            m_taskAvailable.wait(lock, [&]() { return m_stopping || m_taskCount > 0; });
+            if (m_stopping && m_taskCount == 0)
+            {
+                return;
+            }
+            task = std::move(m_tasks[m_firstTask]);
+            m_tasks[m_firstTask] = nullptr;
+            m_firstTask = (m_firstTask + 1) % m_tasks.size();
+            m_taskCount--;
+        }
+        task();
+    }
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool
+{
+public:
+    // A thread count of 0 uses one thread per hardware thread.
+    ThreadPool(uint32_t threadCount = 0);
+    ~ThreadPool();
+
+    ThreadPool(ThreadPool const&) = delete;
+    ThreadPool& operator=(ThreadPool const&) = delete;
+
+    uint32_t ThreadCount() const { return static_cast<uint32_t>(m_threads.size()); }
+
+    void Submit(std::function<void()> task);
+
+    // Calls function(i) for every i in [0, count) and waits for all of
+    // them to finish. The calling thread takes part in the work, so this
+    // is safe to call from within a task running on the pool. If any
+    // call throws, the rest are skipped and the first exception is
+    // rethrown here once the others are done.
+    void ParallelFor(size_t count, std::function<void(size_t)> const& function);
+
+    // How many times the pool had to go to the heap for its task ring
+    // or ParallelFor's bookkeeping. It stops growing once the pool has
+    // seen its busiest moment.
+    uint64_t AllocationCount() const;
+
+private:
+    struct ParallelForState;
+
+    void WorkerLoop();
+    static void RunParallelFor(ParallelForState* state);
+    ParallelForState* AcquireParallelForState();
+    void ReleaseParallelForState(ParallelForState* state);
+
+private:
+    std::vector<std::thread> m_threads;
+    // A ring of pending tasks. It only grows, so once it's big enough
+    // submitting a task doesn't allocate.
+    std::vector<std::function<void()>> m_tasks;
+    size_t m_firstTask = 0;
+    size_t m_taskCount = 0;
+    // Helpers can start after ParallelFor has returned, so its state is
+    // only reused once every one of them has let go of it.
+    std::vector<std::unique_ptr<ParallelForState>> m_parallelForStates;
+    std::vector<ParallelForState*> m_freeParallelForStates;
+    uint64_t m_allocationCount = 0;
+    mutable std::mutex m_lock;
+    std::condition_variable m_taskAvailable;
+    bool m_stopping = false;
+};
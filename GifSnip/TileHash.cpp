@@ -0,0 +1,334 @@
+#include "TileHash.h"
+#include "ThreadPool.h"
+#include "Simd.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace
+{
+    // Bands smaller than this aren't worth the hand off to another thread.
+    constexpr uint32_t MinRowsPerBand = 64;
+
+    // Per-position seeds for the two lanes. Both are linear in the
+    // position so that the vector paths can step them with an add.
+    constexpr uint32_t SeedStepA = 0x9E3779B1;
+    constexpr uint32_t SeedStepB = 0x85EBCA77;
+    constexpr uint32_t SeedOffsetB = 0xC2B2AE3D;
+
+    // MurmurHash3's finalizer, a bijection on 32 bits
+    inline uint32_t Mix(uint32_t value)
+    {
+        value ^= value >> 16;
+        value *= 0x85EBCA6B;
+        value ^= value >> 13;
+        value *= 0xC2B2AE35;
+        value ^= value >> 16;
+        return value;
+    }
+
+    // Each tile column sums into this many slots per lane, so that the
+    // vector paths can keep one slot per vector lane. The slots are only
+    // added up once the tile is done.
+    constexpr uint32_t SlotsPerLane = 8;
+    constexpr uint32_t SlotsPerTile = SlotsPerLane * 2;
+
+    // Adds one row of pixels to the slots of every tile it crosses. The
+    // row's first pixel in each tile is at position firstIndex.
+    using HashRowFunction = void(*)(uint32_t const* pixels, uint32_t width, uint32_t tileSize, uint32_t firstIndex, uint32_t* slots);
+
+    void HashSpanScalar(uint32_t const* pixels, uint32_t count, uint32_t firstIndex, uint32_t* slots)
+    {
+        auto seedA = firstIndex * SeedStepA;
+        auto seedB = (firstIndex * SeedStepB) + SeedOffsetB;
+        for (uint32_t i = 0; i < count; i++)
+        {
+            slots[0] += Mix(pixels[i] ^ seedA);
+            slots[SlotsPerLane] += Mix(pixels[i] ^ seedB);
+            seedA += SeedStepA;
+            seedB += SeedStepB;
+        }
+    }
+
+    void HashRowScalar(uint32_t const* pixels, uint32_t width, uint32_t tileSize, uint32_t firstIndex, uint32_t* slots)
+    {
+        for (uint32_t left = 0; left < width; left += tileSize, slots += SlotsPerTile)
+        {
+            HashSpanScalar(pixels + left, std::min(tileSize, width - left), firstIndex, slots);
+        }
+    }
+
+#if defined(GIFSNIP_X64)
+    GIFSNIP_TARGET_SSE41 inline __m128i MixSse41(__m128i value)
+    {
+        value = _mm_xor_si128(value, _mm_srli_epi32(value, 16));
+        value = _mm_mullo_epi32(value, _mm_set1_epi32(static_cast<int>(0x85EBCA6B)));
+        value = _mm_xor_si128(value, _mm_srli_epi32(value, 13));
+        value = _mm_mullo_epi32(value, _mm_set1_epi32(static_cast<int>(0xC2B2AE35)));
+        return _mm_xor_si128(value, _mm_srli_epi32(value, 16));
+    }
+
+    GIFSNIP_TARGET_SSE41 void HashRowSse41(uint32_t const* pixels, uint32_t width, uint32_t tileSize, uint32_t firstIndex, uint32_t* slots)
+    {
+        auto index = _mm_add_epi32(_mm_set1_epi32(static_cast<int>(firstIndex)), _mm_setr_epi32(0, 1, 2, 3));
+        auto firstSeedA = _mm_mullo_epi32(index, _mm_set1_epi32(static_cast<int>(SeedStepA)));
+        auto firstSeedB = _mm_add_epi32(_mm_mullo_epi32(index, _mm_set1_epi32(static_cast<int>(SeedStepB))), _mm_set1_epi32(static_cast<int>(SeedOffsetB)));
+        auto stepA = _mm_set1_epi32(static_cast<int>(SeedStepA * 4));
+        auto stepB = _mm_set1_epi32(static_cast<int>(SeedStepB * 4));
+        for (uint32_t left = 0; left < width; left += tileSize, slots += SlotsPerTile)
+        {
+            auto count = std::min(tileSize, width - left);
+            auto tilePixels = pixels + left;
+            auto seedA = firstSeedA;
+            auto seedB = firstSeedB;
+            auto sumA = _mm_loadu_si128(reinterpret_cast<__m128i const*>(slots));
+            auto sumB = _mm_loadu_si128(reinterpret_cast<__m128i const*>(slots + SlotsPerLane));
+            uint32_t i = 0;
+            for (; i + 4 <= count; i += 4)
+            {
+                auto value = _mm_loadu_si128(reinterpret_cast<__m128i const*>(tilePixels + i));
+                sumA = _mm_add_epi32(sumA, MixSse41(_mm_xor_si128(value, seedA)));
+                sumB = _mm_add_epi32(sumB, MixSse41(_mm_xor_si128(value, seedB)));
+                seedA = _mm_add_epi32(seedA, stepA);
+                seedB = _mm_add_epi32(seedB, stepB);
+            }
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(slots), sumA);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(slots + SlotsPerLane), sumB);
+            HashSpanScalar(tilePixels + i, count - i, firstIndex + i, slots);
+        }
+    }
+
+    GIFSNIP_TARGET_AVX2 inline __m256i MixAvx2(__m256i value)
+    {
+        value = _mm256_xor_si256(value, _mm256_srli_epi32(value, 16));
+        value = _mm256_mullo_epi32(value, _mm256_set1_epi32(static_cast<int>(0x85EBCA6B)));
+        value = _mm256_xor_si256(value, _mm256_srli_epi32(value, 13));
+        value = _mm256_mullo_epi32(value, _mm256_set1_epi32(static_cast<int>(0xC2B2AE35)));
+        return _mm256_xor_si256(value, _mm256_srli_epi32(value, 16));
+    }
+
+    GIFSNIP_TARGET_AVX2 void HashRowAvx2(uint32_t const* pixels, uint32_t width, uint32_t tileSize, uint32_t firstIndex, uint32_t* slots)
+    {
+        auto index = _mm256_add_epi32(_mm256_set1_epi32(static_cast<int>(firstIndex)), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+        auto firstSeedA = _mm256_mullo_epi32(index, _mm256_set1_epi32(static_cast<int>(SeedStepA)));
+        auto firstSeedB = _mm256_add_epi32(_mm256_mullo_epi32(index, _mm256_set1_epi32(static_cast<int>(SeedStepB))), _mm256_set1_epi32(static_cast<int>(SeedOffsetB)));
+        auto stepA = _mm256_set1_epi32(static_cast<int>(SeedStepA * 8));
+        auto stepB = _mm256_set1_epi32(static_cast<int>(SeedStepB * 8));
+        for (uint32_t left = 0; left < width; left += tileSize, slots += SlotsPerTile)
+        {
+            auto count = std::min(tileSize, width - left);
+            auto tilePixels = pixels + left;
+            auto seedA = firstSeedA;
+            auto seedB = firstSeedB;
+            auto sumA = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(slots));
+            auto sumB = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(slots + SlotsPerLane));
+            uint32_t i = 0;
+            for (; i + 8 <= count; i += 8)
+            {
+                auto value = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(tilePixels + i));
+                sumA = _mm256_add_epi32(sumA, MixAvx2(_mm256_xor_si256(value, seedA)));
+                sumB = _mm256_add_epi32(sumB, MixAvx2(_mm256_xor_si256(value, seedB)));
+                seedA = _mm256_add_epi32(seedA, stepA);
+                seedB = _mm256_add_epi32(seedB, stepB);
+            }
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(slots), sumA);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(slots + SlotsPerLane), sumB);
+            HashSpanScalar(tilePixels + i, count - i, firstIndex + i, slots);
+        }
+    }
+#elif defined(GIFSNIP_ARM64)
+    inline uint32x4_t MixNeon(uint32x4_t value)
+    {
+        value = veorq_u32(value, vshrq_n_u32(value, 16));
+        value = vmulq_n_u32(value, 0x85EBCA6B);
+        value = veorq_u32(value, vshrq_n_u32(value, 13));
+        value = vmulq_n_u32(value, 0xC2B2AE35);
+        return veorq_u32(value, vshrq_n_u32(value, 16));
+    }
+
+    void HashRowNeon(uint32_t const* pixels, uint32_t width, uint32_t tileSize, uint32_t firstIndex, uint32_t* slots)
+    {
+        uint32_t const offsets[4] = { 0, 1, 2, 3 };
+        auto index = vaddq_u32(vdupq_n_u32(firstIndex), vld1q_u32(offsets));
+        auto firstSeedA = vmulq_n_u32(index, SeedStepA);
+        auto firstSeedB = vaddq_u32(vmulq_n_u32(index, SeedStepB), vdupq_n_u32(SeedOffsetB));
+        auto stepA = vdupq_n_u32(SeedStepA * 4);
+        auto stepB = vdupq_n_u32(SeedStepB * 4);
+        for (uint32_t left = 0; left < width; left += tileSize, slots += SlotsPerTile)
+        {
+            auto count = std::min(tileSize, width - left);
+            auto tilePixels = pixels + left;
+            auto seedA = firstSeedA;
+            auto seedB = firstSeedB;
+            auto sumA = vld1q_u32(slots);
+            auto sumB = vld1q_u32(slots + SlotsPerLane);
+            uint32_t i = 0;
+            for (; i + 4 <= count; i += 4)
+            {
+                auto value = vld1q_u32(tilePixels + i);
+                sumA = vaddq_u32(sumA, MixNeon(veorq_u32(value, seedA)));
+                sumB = vaddq_u32(sumB, MixNeon(veorq_u32(value, seedB)));
+                seedA = vaddq_u32(seedA, stepA);
+                seedB = vaddq_u32(seedB, stepB);
+            }
+            vst1q_u32(slots, sumA);
+            vst1q_u32(slots + SlotsPerLane, sumB);
+            HashSpanScalar(tilePixels + i, count - i, firstIndex + i, slots);
+        }
+    }
+#endif
+
+    HashRowFunction SelectKernel()
+    {
+        static const HashRowFunction kernel = []()
+        {
+            HashRowFunction result = HashRowScalar;
+#if defined(GIFSNIP_X64)
+            auto&& features = CpuFeatures::Current();
+            if (features.Avx2)
+            {
+                result = HashRowAvx2;
+            }
+            else if (features.Sse41)
+            {
+                result = HashRowSse41;
+            }
+#elif defined(GIFSNIP_ARM64)
+            result = HashRowNeon;
+#endif
+            return result;
+        }();
+        return kernel;
+    }
+}
+
+size_t TileHash::SlotCount(uint32_t width, uint32_t tileSize)
+{
+    auto columnCount = (width + tileSize - 1) / tileSize;
+    return static_cast<size_t>(columnCount) * SlotsPerTile;
+}
+
+void TileHash::HashTileRows(
+    uint8_t const* pixels,
+    size_t stride,
+    uint32_t width,
+    uint32_t height,
+    uint32_t tileSize,
+    uint32_t firstRow,
+    uint32_t lastRow,
+    uint64_t* hashes,
+    uint32_t* slots)
+{
+    auto kernel = SelectKernel();
+    auto columnCount = (width + tileSize - 1) / tileSize;
+    auto slotCount = SlotCount(width, tileSize);
+    for (auto row = firstRow; row < lastRow; row++)
+    {
+        std::fill_n(slots, slotCount, 0u);
+        auto top = row * tileSize;
+        auto bottom = std::min(top + tileSize, height);
+        for (auto y = top; y < bottom; y++)
+        {
+            auto rowPixels = reinterpret_cast<uint32_t const*>(pixels + (static_cast<size_t>(y) * stride));
+            kernel(rowPixels, width, tileSize, (y - top) * tileSize, slots);
+        }
+
+        auto rowHashes = hashes + (static_cast<size_t>(row) * columnCount);
+        for (uint32_t column = 0; column < columnCount; column++)
+        {
+            auto tileSlots = slots + (static_cast<size_t>(column) * SlotsPerTile);
+            uint32_t laneA = 0;
+            uint32_t laneB = 0;
+            for (uint32_t slot = 0; slot < SlotsPerLane; slot++)
+            {
+                laneA += tileSlots[slot];
+                laneB += tileSlots[SlotsPerLane + slot];
+            }
+            rowHashes[column] = Pack(laneA, laneB);
+        }
+    }
+}
+
+TileHashDiffer::TileHashDiffer(uint32_t width, uint32_t height, ThreadPool* threadPool, uint32_t tileSize)
+{
+    if (tileSize == 0)
+    {
+        throw std::invalid_argument("Tile size must be non-zero");
+    }
+
+    m_width = width;
+    m_height = height;
+    m_tileSize = tileSize;
+    m_columnCount = (width + tileSize - 1) / tileSize;
+    m_rowCount = (height + tileSize - 1) / tileSize;
+    m_threadPool = threadPool;
+    m_hashes.resize(static_cast<size_t>(m_columnCount) * m_rowCount, 0);
+    m_nextHashes.resize(m_hashes.size(), 0);
+
+    if (m_threadPool != nullptr)
+    {
+        m_bandCount = std::min(m_height / MinRowsPerBand, m_threadPool->ThreadCount() * 2);
+    }
+    m_bandCount = std::max(std::min(m_bandCount, m_rowCount), 1u);
+    m_slots.resize(static_cast<size_t>(m_bandCount) * TileHash::SlotCount(m_width, m_tileSize));
+}
+
+std::optional<DiffRect> TileHashDiffer::ProcessFrame(uint8_t const* pixels, size_t stride, DirtyTileMap& dirtyTiles)
+{
+    if (dirtyTiles.TileSize() != m_tileSize || dirtyTiles.ColumnCount() != m_columnCount || dirtyTiles.RowCount() != m_rowCount)
+    {
+        throw std::invalid_argument("Tile map doesn't match the hashed tiles");
+    }
+
+    if (m_bandCount == 1)
+    {
+        TileHash::HashTileRows(pixels, stride, m_width, m_height, m_tileSize, 0, m_rowCount, m_nextHashes.data(), m_slots.data());
+    }
+    else
+    {
+        auto rowsPerBand = (m_rowCount + m_bandCount - 1) / m_bandCount;
+        auto slotCount = TileHash::SlotCount(m_width, m_tileSize);
+        m_threadPool->ParallelFor(m_bandCount, [&](size_t band)
+            {
+                auto firstRow = std::min(static_cast<uint32_t>(band) * rowsPerBand, m_rowCount);
+                auto lastRow = std::min(firstRow + rowsPerBand, m_rowCount);
+                TileHash::HashTileRows(pixels, stride, m_width, m_height, m_tileSize, firstRow, lastRow, m_nextHashes.data(), m_slots.data() + (band * slotCount));
+            });
+    }
+    m_hashes.swap(m_nextHashes);
+
+    if (m_firstFrame)
+    {
+        m_firstFrame = false;
+        dirtyTiles.MarkAll();
+        return std::optional(DiffRect{ 0, 0, m_width, m_height });
+    }
+
+    // Same initial values as the shader's diff buffer
+    DiffRect result = { m_width, m_height, 0, 0 };
+    dirtyTiles.Clear();
+    for (uint32_t row = 0; row < m_rowCount; row++)
+    {
+        for (uint32_t column = 0; column < m_columnCount; column++)
+        {
+            auto index = (static_cast<size_t>(row) * m_columnCount) + column;
+            if (m_hashes[index] == m_nextHashes[index])
+            {
+                continue;
+            }
+            dirtyTiles.Mark(column, row);
+            result.Left = std::min(result.Left, column * m_tileSize);
+            result.Top = std::min(result.Top, row * m_tileSize);
+            result.Right = std::max(result.Right, std::min((column + 1) * m_tileSize, m_width) - 1);
+            result.Bottom = std::max(result.Bottom, std::min((row + 1) * m_tileSize, m_height) - 1);
+        }
+    }
+
+    if (result.IsValid())
+    {
+        return std::optional(result);
+    }
+    else
+    {
+        return std::nullopt;
+    }
+}
@@ -0,0 +1,87 @@
+#pragma once
+#include "DirtyTileMap.h"
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+class ThreadPool;
+
+enum class ChangeDetection
+{
+    // Compares every pixel against a full copy of the previous frame.
+    // Rects are exact to the pixel.
+    Exact,
+    // Keeps a 64-bit hash per tile instead of the previous frame and
+    // compares those. Rects are rounded out to whole tiles.
+    TileHash,
+};
+
+// The hash TextureHash.hlsl computes, made of two 32-bit lanes. Each
+// pixel is mixed with its position in the tile by two different
+// bijections and the results are summed per lane. Sums don't care about
+// order, so tiles can be hashed a row (or on the GPU, a thread) at a
+// time, and since the mix is a bijection a single changed pixel always
+// changes both lanes.
+namespace TileHash
+{
+    // Lane A in the low 32 bits, lane B in the high ones. This is also
+    // how the shader's uint2 lands in memory.
+    inline uint64_t Pack(uint32_t laneA, uint32_t laneB)
+    {
+        return static_cast<uint64_t>(laneA) | (static_cast<uint64_t>(laneB) << 32);
+    }
+
+    // How many sums HashTileRows keeps while it hashes a row of tiles
+    size_t SlotCount(uint32_t width, uint32_t tileSize);
+
+    // Hashes the tile rows [firstRow, lastRow) of a row-pitched BGRA8
+    // frame into hashes, one per tile laid out like DirtyTileMap. The
+    // slots are scratch space of SlotCount entries, which calls running
+    // at the same time can't share.
+    void HashTileRows(
+        uint8_t const* pixels,
+        size_t stride,
+        uint32_t width,
+        uint32_t height,
+        uint32_t tileSize,
+        uint32_t firstRow,
+        uint32_t lastRow,
+        uint64_t* hashes,
+        uint32_t* slots);
+}
+
+// Finds dirty tiles by comparing tile hashes from one frame to the next.
+// The state is 8 bytes per tile rather than 4 bytes per pixel, at 32x32
+// tiles that's 1/512th of a copy of the frame.
+class TileHashDiffer
+{
+public:
+    TileHashDiffer(
+        uint32_t width,
+        uint32_t height,
+        ThreadPool* threadPool = nullptr,
+        uint32_t tileSize = DirtyTileMap::DefaultTileSize);
+
+    // Marks the tiles whose hash changed in dirtyTiles and returns their
+    // bounding box in pixels (inclusive Right/Bottom, clamped to the
+    // frame), or nothing if no tile changed. The first frame is always
+    // changed everywhere.
+    std::optional<DiffRect> ProcessFrame(uint8_t const* pixels, size_t stride, DirtyTileMap& dirtyTiles);
+
+    std::vector<uint64_t> const& Hashes() const { return m_hashes; }
+
+private:
+    uint32_t m_width = 0;
+    uint32_t m_height = 0;
+    uint32_t m_tileSize = 0;
+    uint32_t m_columnCount = 0;
+    uint32_t m_rowCount = 0;
+    ThreadPool* m_threadPool = nullptr;
+    uint32_t m_bandCount = 1;
+    std::vector<uint64_t> m_hashes;
+    std::vector<uint64_t> m_nextHashes;
+    // SlotCount entries per band
+    std::vector<uint32_t> m_slots;
+    bool m_firstFrame = true;
+};
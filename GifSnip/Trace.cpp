@@ -0,0 +1,219 @@
+#include "Trace.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace
+{
+    enum class EventType : uint8_t
+    {
+        Span,
+        Counter,
+    };
+
+    struct TraceEvent
+    {
+        char const* Name;
+        // Nanoseconds since tracing started
+        int64_t Start;
+        // The end of a span, or the value of a counter
+        int64_t Value;
+        EventType Type;
+    };
+
+    // Only its own thread writes to a buffer, the lock is there for
+    // whoever writes the trace out.
+    struct ThreadBuffer
+    {
+        std::mutex Lock;
+        std::vector<TraceEvent> Events;
+        uint64_t EventCount = 0;
+        uint32_t ThreadId = 0;
+        std::string ThreadName;
+    };
+
+    struct TraceState
+    {
+        std::mutex Lock;
+        std::vector<std::shared_ptr<ThreadBuffer>> Buffers;
+        uint32_t EventsPerThread = Trace::DefaultEventsPerThread;
+        uint32_t NextThreadId = 1;
+        // Bumped by Enable so threads know to start a new buffer
+        std::atomic<uint64_t> Session = 0;
+        // When Enable was last called, in steady clock nanoseconds
+        std::atomic<int64_t> Epoch = 0;
+    };
+
+    int64_t SteadyNanoseconds()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    TraceState& State()
+    {
+        static TraceState state;
+        return state;
+    }
+
+    thread_local std::shared_ptr<ThreadBuffer> t_buffer;
+    thread_local uint64_t t_bufferSession = 0;
+    thread_local char const* t_threadName = nullptr;
+
+    ThreadBuffer& CurrentBuffer()
+    {
+        auto&& state = State();
+        std::lock_guard lock(state.Lock);
+        auto session = state.Session.load(std::memory_order_relaxed);
+        if (t_buffer == nullptr || t_bufferSession != session)
+        {
+            auto buffer = std::make_shared<ThreadBuffer>();
+            buffer->Events.resize(state.EventsPerThread);
+            buffer->ThreadId = t_buffer != nullptr ? t_buffer->ThreadId : state.NextThreadId++;
+            buffer->ThreadName = t_threadName != nullptr ? t_threadName : "";
+            state.Buffers.push_back(buffer);
+            t_buffer = std::move(buffer);
+            t_bufferSession = session;
+        }
+        return *t_buffer;
+    }
+
+    void Record(TraceEvent const& event)
+    {
+        // Only looks the buffer up in the registry when it may be stale
+        auto&& buffer = (t_buffer != nullptr && t_bufferSession == State().Session.load(std::memory_order_relaxed)) ? *t_buffer : CurrentBuffer();
+        std::lock_guard lock(buffer.Lock);
+        buffer.Events[buffer.EventCount % buffer.Events.size()] = event;
+        buffer.EventCount++;
+    }
+
+    void WriteEscaped(FILE* file, char const* text)
+    {
+        for (auto character = text; *character != '\0'; character++)
+        {
+            if (*character == '"' || *character == '\\')
+            {
+                fputc('\\', file);
+            }
+            fputc(*character, file);
+        }
+    }
+}
+
+int64_t Trace::Detail::Now()
+{
+    return SteadyNanoseconds() - State().Epoch.load(std::memory_order_relaxed);
+}
+
+void Trace::Detail::RecordSpan(char const* name, int64_t start, int64_t end)
+{
+    Record(TraceEvent{ name, start, end, EventType::Span });
+}
+
+void Trace::Enable(uint32_t eventsPerThread)
+{
+    if (eventsPerThread == 0)
+    {
+        throw std::invalid_argument("Traces need room for at least one event per thread");
+    }
+    auto&& state = State();
+    {
+        std::lock_guard lock(state.Lock);
+        state.Buffers.clear();
+        state.EventsPerThread = eventsPerThread;
+        state.Session++;
+        state.Epoch.store(SteadyNanoseconds(), std::memory_order_relaxed);
+    }
+    Detail::Enabled.store(true, std::memory_order_relaxed);
+}
+
+void Trace::Disable()
+{
+    Detail::Enabled.store(false, std::memory_order_relaxed);
+}
+
+void Trace::SetThreadName(char const* name)
+{
+    t_threadName = name;
+    if (IsEnabled())
+    {
+        auto&& buffer = CurrentBuffer();
+        std::lock_guard lock(buffer.Lock);
+        buffer.ThreadName = name;
+    }
+}
+
+void Trace::Counter(char const* name, int64_t value)
+{
+    if (IsEnabled())
+    {
+        Record(TraceEvent{ name, Detail::Now(), value, EventType::Counter });
+    }
+}
+
+void Trace::WriteChromeTrace(std::filesystem::path const& path)
+{
+    auto file = fopen(path.string().c_str(), "w");
+    if (file == nullptr)
+    {
+        throw std::runtime_error("Couldn't open " + path.string());
+    }
+
+    auto&& state = State();
+    std::lock_guard stateLock(state.Lock);
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    auto first = true;
+    for (auto&& buffer : state.Buffers)
+    {
+        std::lock_guard lock(buffer->Lock);
+        if (!buffer->ThreadName.empty())
+        {
+            fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"", first ? "" : ",\n", buffer->ThreadId);
+            WriteEscaped(file, buffer->ThreadName.c_str());
+            fprintf(file, "\"}}");
+            first = false;
+        }
+
+        // Oldest first, the ring may have wrapped around
+        auto capacity = buffer->Events.size();
+        auto count = std::min<uint64_t>(buffer->EventCount, capacity);
+        for (uint64_t i = buffer->EventCount - count; i < buffer->EventCount; i++)
+        {
+            auto&& event = buffer->Events[i % capacity];
+            fprintf(file, "%s{\"name\":\"", first ? "" : ",\n");
+            WriteEscaped(file, event.Name);
+            if (event.Type == EventType::Span)
+            {
+                fprintf(file, "\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                    buffer->ThreadId,
+                    static_cast<double>(event.Start) / 1000.0,
+                    static_cast<double>(event.Value - event.Start) / 1000.0);
+            }
+            else
+            {
+                fprintf(file, "\",\"ph\":\"C\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"args\":{\"value\":%lld}}",
+                    buffer->ThreadId,
+                    static_cast<double>(event.Start) / 1000.0,
+                    static_cast<long long>(event.Value));
+            }
+            first = false;
+        }
+        buffer->EventCount = 0;
+    }
+    fprintf(file, "\n]}\n");
+    auto failed = ferror(file) != 0;
+    fclose(file);
+
+    // Buffers that only we still hold belong to threads that are gone
+    state.Buffers.erase(
+        std::remove_if(state.Buffers.begin(), state.Buffers.end(), [](auto&& buffer) { return buffer.use_count() == 1; }),
+        state.Buffers.end());
+    if (failed)
+    {
+        throw std::runtime_error("Couldn't write " + path.string());
+    }
+}
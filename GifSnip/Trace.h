@@ -0,0 +1,66 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+
+// Instrumentation that's always compiled in. Spans and counters are
+// recorded into a ring buffer per thread, keeping the most recent
+// events, and written out in Chrome's trace_event format (load it in
+// chrome://tracing or Perfetto). While tracing is off, recording
+// anything costs one relaxed atomic load.
+//
+// Names must outlive the trace, in practice they're string literals.
+namespace Trace
+{
+    constexpr uint32_t DefaultEventsPerThread = 1u << 16;
+
+    namespace Detail
+    {
+        inline std::atomic<bool> Enabled = false;
+        int64_t Now();
+        void RecordSpan(char const* name, int64_t start, int64_t end);
+    }
+
+    inline bool IsEnabled() { return Detail::Enabled.load(std::memory_order_relaxed); }
+
+    // Starts recording, throwing away anything recorded earlier.
+    void Enable(uint32_t eventsPerThread = DefaultEventsPerThread);
+    void Disable();
+
+    // Shows up as the calling thread's name in the trace. Can be called
+    // whether or not tracing is on.
+    void SetThreadName(char const* name);
+    void Counter(char const* name, int64_t value);
+
+    // Writes everything recorded so far and throws it away.
+    void WriteChromeTrace(std::filesystem::path const& path);
+}
+
+// Records the time between its construction and destruction, if tracing
+// was on when it was constructed.
+class TraceSpan
+{
+public:
+    explicit TraceSpan(char const* name)
+    {
+        if (Trace::IsEnabled())
+        {
+            m_name = name;
+            m_start = Trace::Detail::Now();
+        }
+    }
+    ~TraceSpan()
+    {
+        if (m_name != nullptr)
+        {
+            Trace::Detail::RecordSpan(m_name, m_start, Trace::Detail::Now());
+        }
+    }
+
+    TraceSpan(TraceSpan const&) = delete;
+    TraceSpan& operator=(TraceSpan const&) = delete;
+
+private:
+    char const* m_name = nullptr;
+    int64_t m_start = 0;
+};
@@ -0,0 +1,115 @@
+#include "UniqueColorSet.h"
+#include "Simd.h"
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    uint32_t HashColor(uint32_t color)
+    {
+        return (color * 0x9E3779B1u) >> 25;
+    }
+
+    // Returns a bitmask of the slots in the bucket that hold the color,
+    // and of the ones that are empty.
+    void MatchBucket(uint32_t const* bucket, uint32_t color, uint32_t& found, uint32_t& empty)
+    {
+#if defined(GIFSNIP_X64)
+        auto slots = _mm_loadu_si128(reinterpret_cast<__m128i const*>(bucket));
+        found = static_cast<uint32_t>(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(slots, _mm_set1_epi32(static_cast<int>(color))))));
+        empty = static_cast<uint32_t>(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(slots, _mm_set1_epi32(-1)))));
+#elif defined(GIFSNIP_ARM64)
+        static const uint32_t bits[4] = { 1, 2, 4, 8 };
+        auto slots = vld1q_u32(bucket);
+        auto weights = vld1q_u32(bits);
+        found = vaddvq_u32(vandq_u32(vceqq_u32(slots, vdupq_n_u32(color)), weights));
+        empty = vaddvq_u32(vandq_u32(vceqq_u32(slots, vdupq_n_u32(0xFFFFFFFF)), weights));
+#else
+        found = 0;
+        empty = 0;
+        for (uint32_t i = 0; i < 4; i++)
+        {
+            found |= (bucket[i] == color ? 1u : 0u) << i;
+            empty |= (bucket[i] == 0xFFFFFFFF ? 1u : 0u) << i;
+        }
+#endif
+    }
+}
+
+UniqueColorSet::UniqueColorSet()
+{
+    m_slots.resize(BucketCount * SlotsPerBucket, EmptySlot);
+    m_colors.reserve(MaxColors + 1);
+}
+
+void UniqueColorSet::Clear()
+{
+    std::fill(m_slots.begin(), m_slots.end(), EmptySlot);
+    m_colors.clear();
+}
+
+bool UniqueColorSet::Insert(uint32_t color)
+{
+    auto bucket = HashColor(color);
+    // The table holds twice as many slots as we'll ever insert, so
+    // there's always an empty slot to stop at.
+    while (true)
+    {
+        auto slots = m_slots.data() + (static_cast<size_t>(bucket) * SlotsPerBucket);
+        uint32_t found = 0;
+        uint32_t empty = 0;
+        MatchBucket(slots, color, found, empty);
+        if (found != 0)
+        {
+            return false;
+        }
+        if (empty != 0)
+        {
+            slots[CountTrailingZeros(empty)] = color;
+            m_colors.push_back(color);
+            return true;
+        }
+        bucket = (bucket + 1) & (BucketCount - 1);
+    }
+}
+
+bool UniqueColorSet::AddPixels(uint8_t const* pixels, size_t stride, uint32_t width, uint32_t height, uint32_t maxColors)
+{
+    maxColors = std::min(maxColors, MaxColors);
+    if (m_colors.size() > maxColors)
+    {
+        return false;
+    }
+
+    uint32_t previousPixel = EmptySlot;
+    for (uint32_t y = 0; y < height; y++)
+    {
+        auto row = pixels + (static_cast<size_t>(y) * stride);
+        for (uint32_t x = 0; x < width; x++)
+        {
+            uint32_t pixel = 0;
+            memcpy(&pixel, row + (static_cast<size_t>(x) * 4), sizeof(pixel));
+            pixel &= 0x00FFFFFF;
+            // Skip runs of the same color
+            if (pixel == previousPixel)
+            {
+                continue;
+            }
+            previousPixel = pixel;
+            if (Insert(pixel) && m_colors.size() > maxColors)
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+void UniqueColorSet::Colors(std::vector<GifColor>& colors) const
+{
+    colors.clear();
+    for (auto color : m_colors)
+    {
+        colors.push_back(GifColor{ static_cast<uint8_t>(color >> 16), static_cast<uint8_t>(color >> 8), static_cast<uint8_t>(color) });
+    }
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include "GifWriter.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Collects the distinct colors of a BGRA8 region, giving up as soon as
+// there are too many to fit in a GIF palette. The set is a small table
+// of 4-slot buckets so that a lookup is a single vector compare.
+class UniqueColorSet
+{
+public:
+    static constexpr uint32_t MaxColors = 256;
+
+    UniqueColorSet();
+
+    void Clear();
+    // Returns false once more than maxColors distinct colors have been
+    // seen. Alpha is ignored.
+    bool AddPixels(uint8_t const* pixels, size_t stride, uint32_t width, uint32_t height, uint32_t maxColors = MaxColors);
+
+    size_t Count() const { return m_colors.size(); }
+    // Replaces the contents of colors with the colors in the order they
+    // were first seen.
+    void Colors(std::vector<GifColor>& colors) const;
+
+private:
+    bool Insert(uint32_t color);
+
+private:
+    static constexpr uint32_t SlotsPerBucket = 4;
+    static constexpr uint32_t BucketCount = 128;
+    static constexpr uint32_t EmptySlot = 0xFFFFFFFF;
+
+    std::vector<uint32_t> m_slots;
+    std::vector<uint32_t> m_colors;
+};
@@ -2,6 +2,10 @@
 #include "DisplaysUtil.h"
 #include "MainWindow.h"
 #include "CaptureGifEncoder.h"
+#include "HeadlessGifEncoder.h"
+#include "RawFrameFile.h"
+#include "FileGifOutputStream.h"
+#include "GifOptimizer.h"
 
 namespace winrt
 {
@@ -27,9 +31,58 @@ enum class GifRecordingStatus
 };
 
 winrt::IAsyncOperation<winrt::StorageFile> CreateOutputFile();
+int ReplayRecording(std::filesystem::path const& inputPath, std::filesystem::path const& outputPath, GifEncoderOptions const& options);
+int OptimizeGifs(std::filesystem::path const& inputPath, std::filesystem::path const& outputPath, GifEncoderOptions const& options);
+int PrintUsage(std::wstring const& badArg);
+void PrintStatistics(GifEncoderStatistics const& statistics);
 
-int __stdcall wmain()
+int __stdcall wmain(int argc, wchar_t* argv[])
 {
+    // GifSnip.exe [options] [--replay recording.raw output.gif]
+    // GifSnip.exe [options] --optimize <input.gif output.gif | input output>
+    //   --trace trace.json     write a trace of the recording
+    //   --two-pass             spool frames, encode at the end
+    //   --recording-palette    two-pass, try one palette for it all
+    GifEncoderOptions options = {};
+    std::vector<std::wstring> args(argv + 1, argv + argc);
+    std::wstring command;
+    std::vector<std::wstring> paths;
+    for (size_t i = 0; i < args.size(); i++)
+    {
+        auto&& arg = args[i];
+        auto remaining = args.size() - i - 1;
+        if (arg == L"--trace" && remaining >= 1)
+        {
+            options.TraceFile = args[++i];
+        }
+        else if (arg == L"--two-pass" || arg == L"--recording-palette")
+        {
+            options.SpoolFile = std::filesystem::temp_directory_path() / L"GifSnip.spool";
+            if (arg == L"--recording-palette")
+            {
+                options.UseRecordingPalette = true;
+            }
+        }
+        else if ((arg == L"--replay" || arg == L"--optimize") && command.empty() && remaining >= 2)
+        {
+            command = arg;
+            paths = { args[i + 1], args[i + 2] };
+            i += 2;
+        }
+        else
+        {
+            return PrintUsage(arg);
+        }
+    }
+    if (command == L"--replay")
+    {
+        return ReplayRecording(paths[0], paths[1], options);
+    }
+    if (command == L"--optimize")
+    {
+        return OptimizeGifs(paths[0], paths[1], options);
+    }
+
     winrt::check_bool(SetProcessDpiAwarenessContext(DPI_AWARENESS_CONTEXT_PER_MONITOR_AWARE_V2));
 
     // Initialize COM
@@ -58,7 +111,7 @@ int __stdcall wmain()
     window.Show();
     wprintf(L"Drag to select an area of the screen to record...\n");
     auto gifStatus = GifRecordingStatus::None;
-    auto encoder = std::make_unique<CaptureGifEncoder>(d3dDevice);
+    auto encoder = std::make_unique<CaptureGifEncoder>(d3dDevice, options);
 
     // Message pump
     MSG msg = {};
@@ -131,6 +184,7 @@ int __stdcall wmain()
                     encoder->Stop();
                     gifStatus = GifRecordingStatus::Ended;
                     wprintf(L"Done!\n");
+                    PrintStatistics(encoder->Statistics());
                     PostQuitMessage(0);
                 }
                 break;
@@ -151,4 +205,108 @@ winrt::IAsyncOperation<winrt::StorageFile> CreateOutputFile()
     auto folder = co_await winrt::StorageFolder::GetFolderFromPathAsync(currentPath.wstring());
     auto file = co_await folder.CreateFileAsync(L"recording.gif", winrt::CreationCollisionOption::ReplaceExisting);
     co_return file;
-}
\ No newline at end of file
+}
+
+int ReplayRecording(std::filesystem::path const& inputPath, std::filesystem::path const& outputPath, GifEncoderOptions const& options)
+{
+    // Runs the same pipeline as a capture, without capturing anything
+    RawFrameReader reader(inputPath);
+    FileGifOutputStream output(outputPath);
+    HeadlessGifEncoder encoder(output, DiffRect{ 0, 0, reader.Width(), reader.Height() }, options);
+    encoder.ProcessFrames(reader);
+    encoder.Stop();
+    wprintf(L"Done!\n");
+    PrintStatistics(encoder.Statistics());
+    return 0;
+}
+
+int OptimizeGifs(std::filesystem::path const& inputPath, std::filesystem::path const& outputPath, GifEncoderOptions const& options)
+{
+    auto files = GifOptimizer::ListFiles(inputPath, outputPath);
+    GifOptimizer optimizer(GifOptimizer::OfflineOptions(options));
+    auto results = optimizer.OptimizeAll(files, [](GifOptimizerResult const& result)
+        {
+            if (!result.Error.empty())
+            {
+                wprintf(L"%s: %S\n", result.Input.c_str(), result.Error.c_str());
+                return;
+            }
+            wprintf(L"%s: %llu -> %llu bytes, %llu of %llu frames%s\n",
+                result.Input.c_str(),
+                static_cast<unsigned long long>(result.InputBytes),
+                static_cast<unsigned long long>(result.OutputBytes),
+                static_cast<unsigned long long>(result.FramesWritten),
+                static_cast<unsigned long long>(result.FramesRead),
+                result.KeptOriginal ? L", kept the original" : L"");
+        });
+
+    uint64_t inputBytes = 0;
+    uint64_t outputBytes = 0;
+    size_t failedCount = 0;
+    for (auto&& result : results)
+    {
+        inputBytes += result.InputBytes;
+        outputBytes += result.OutputBytes;
+        failedCount += result.Error.empty() ? 0 : 1;
+    }
+    wprintf(L"Optimized %zu of %zu files: %llu -> %llu bytes\n",
+        results.size() - failedCount,
+        results.size(),
+        static_cast<unsigned long long>(inputBytes),
+        static_cast<unsigned long long>(outputBytes));
+    return failedCount == 0 ? 0 : 1;
+}
+
+int PrintUsage(std::wstring const& badArg)
+{
+    fwprintf(stderr, L"Unknown or incomplete argument: %s\n", badArg.c_str());
+    fwprintf(stderr, L"Usage: GifSnip.exe [options] [--replay <recording.raw> <output.gif>]\n");
+    fwprintf(stderr, L"       GifSnip.exe [options] --optimize <input.gif output.gif | input output>\n");
+    fwprintf(stderr, L"Options: --trace <trace.json>, --two-pass, --recording-palette\n");
+    return 1;
+}
+
+void PrintStatistics(GifEncoderStatistics const& statistics)
+{
+    wprintf(L"Frames received: %llu, throttled: %llu, unchanged: %llu, encoded: %llu\n",
+        static_cast<unsigned long long>(statistics.FramesReceived),
+        static_cast<unsigned long long>(statistics.ThrottledFrames),
+        static_cast<unsigned long long>(statistics.UnchangedFrames),
+        static_cast<unsigned long long>(statistics.FramesEncoded));
+    wprintf(L"Throttled while idle: %llu, while behind: %llu, longest sample interval: %llums\n",
+        static_cast<unsigned long long>(statistics.IdleThrottledFrames),
+        static_cast<unsigned long long>(statistics.BacklogThrottledFrames),
+        static_cast<unsigned long long>(statistics.LongestSampleInterval));
+    wprintf(L"Exact palettes: %llu of %llu regions\n",
+        static_cast<unsigned long long>(statistics.ExactPaletteRegions),
+        static_cast<unsigned long long>(statistics.RegionsEncoded));
+    wprintf(L"Reused palettes: %llu, global palette: %llu regions\n",
+        static_cast<unsigned long long>(statistics.ReusedPaletteRegions),
+        static_cast<unsigned long long>(statistics.GlobalPaletteRegions));
+    wprintf(L"Frames unchanged after mapping: %llu, regions cut down: %llu\n",
+        static_cast<unsigned long long>(statistics.InvisibleFrames),
+        static_cast<unsigned long long>(statistics.ShrunkRegions));
+    wprintf(L"Skipped frames: %llu, queue high water mark: %llu\n",
+        static_cast<unsigned long long>(statistics.CoalescedFrames),
+        static_cast<unsigned long long>(statistics.QueueHighWaterMark));
+    wprintf(L"Most frames compressed at once: %llu\n",
+        static_cast<unsigned long long>(statistics.MaxFramesInFlight));
+    wprintf(L"Frame buffer allocations: %llu\n",
+        static_cast<unsigned long long>(statistics.FrameBufferAllocations));
+    wprintf(L"Readback stalls: %llu\n",
+        static_cast<unsigned long long>(statistics.ReadbackStalls));
+    if (statistics.SpoolBytes > 0)
+    {
+        wprintf(L"Spooled: %llu bytes\n",
+            static_cast<unsigned long long>(statistics.SpoolBytes));
+    }
+    if (statistics.RecordingPaletteBytes > 0)
+    {
+        auto recordingPaletteKept = statistics.RecordingPaletteBytes < statistics.LocalPaletteBytes;
+        wprintf(L"Recording palette: %llu bytes, per-region palettes: %llu bytes, kept %s, saving %llu bytes\n",
+            static_cast<unsigned long long>(statistics.RecordingPaletteBytes),
+            static_cast<unsigned long long>(statistics.LocalPaletteBytes),
+            recordingPaletteKept ? L"recording palette" : L"per-region palettes",
+            static_cast<unsigned long long>(recordingPaletteKept ? statistics.LocalPaletteBytes - statistics.RecordingPaletteBytes : 0));
+    }
+}